@@ -20,44 +20,39 @@ raft_status_t raft_propose_batch(raft_node_t* node,
     if (count == 0) return RAFT_INVALID_ARG;
     if (!commands || !command_lens) return RAFT_INVALID_ARG;
 
-    uint64_t first_index = 0;
     uint64_t term = node->persistent.current_term;
+    uint64_t next_index = raft_log_last_index(node->log) + 1;
 
-    /* Append all entries to log */
+    raft_entry_t* entries = malloc(count * sizeof(raft_entry_t));
+    if (!entries) return RAFT_NO_MEMORY;
     for (size_t i = 0; i < count; i++) {
-        uint64_t index;
-        raft_status_t status = raft_log_append(node->log, term,
-                                                commands[i], command_lens[i],
-                                                &index);
-        if (status != RAFT_OK) {
-            /* Rollback on failure - truncate any entries we added */
-            if (first_index > 0) {
-                raft_log_truncate_after(node->log, first_index - 1);
-            }
-            return status;
-        }
+        entries[i].term = term;
+        entries[i].index = next_index + i;
+        entries[i].type = RAFT_ENTRY_COMMAND;
+        entries[i].command = (char*)commands[i];
+        entries[i].command_len = command_lens[i];
+    }
 
-        if (i == 0) {
-            first_index = index;
-        }
+    /* Append all entries to log in one step */
+    uint64_t first_index;
+    raft_status_t status = raft_log_append_batch(node->log, entries, count,
+                                                 &first_index);
+    if (status != RAFT_OK) {
+        free(entries);
+        return status;
+    }
 
-        /* Persist if storage is enabled */
-        if (node->storage) {
-            raft_entry_t entry = {
-                .term = term,
-                .index = index,
-                .type = RAFT_ENTRY_COMMAND,
-                .command = (char*)commands[i],
-                .command_len = command_lens[i],
-            };
-            raft_status_t persist_status = raft_storage_append_entry(node->storage, &entry);
-            if (persist_status != RAFT_OK) {
-                /* Rollback on persistence failure */
-                raft_log_truncate_after(node->log, first_index - 1);
-                return persist_status;
-            }
+    /* Persist the whole batch with a single vectored write */
+    if (node->storage) {
+        status = raft_storage_append_entries(node->storage, entries, count);
+        if (status != RAFT_OK) {
+            /* Rollback on persistence failure */
+            raft_log_truncate_after(node->log, first_index - 1);
+            free(entries);
+            return status;
         }
     }
+    free(entries);
 
     /* Update match_index for self (leader) */
     if (node->leader_state.match_index) {
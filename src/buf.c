@@ -0,0 +1,49 @@
+/**
+ * buf.c - Reference-counted byte buffers implementation
+ */
+
+#include "buf.h"
+#include <stdlib.h>
+
+raft_buf_t* raft_buf_alloc(size_t len) {
+    raft_buf_t* buf = malloc(sizeof(raft_buf_t) + len);
+    if (!buf) return NULL;
+
+    buf->refcount = 1;
+    buf->data = (char*)(buf + 1);
+    buf->len = len;
+    buf->free_fn = NULL;
+    buf->free_ctx = NULL;
+    return buf;
+}
+
+raft_buf_t* raft_buf_wrap(void* data, size_t len,
+                          raft_buf_free_fn free_fn, void* ctx) {
+    raft_buf_t* buf = malloc(sizeof(raft_buf_t));
+    if (!buf) return NULL;
+
+    buf->refcount = 1;
+    buf->data = data;
+    buf->len = len;
+    buf->free_fn = free_fn;
+    buf->free_ctx = ctx;
+    return buf;
+}
+
+raft_buf_t* raft_buf_ref(raft_buf_t* buf) {
+    if (buf) buf->refcount++;
+    return buf;
+}
+
+void raft_buf_unref(raft_buf_t* buf) {
+    if (!buf || --buf->refcount > 0) return;
+
+    if (buf->data != (char*)(buf + 1)) {
+        if (buf->free_fn) {
+            buf->free_fn(buf->data, buf->len, buf->free_ctx);
+        } else {
+            free(buf->data);
+        }
+    }
+    free(buf);
+}
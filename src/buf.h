@@ -0,0 +1,55 @@
+/**
+ * buf.h - Reference-counted byte buffers
+ *
+ * Lets one copy of a command be shared by the in-memory log, the WAL
+ * writer and the replication path instead of each making its own copy.
+ * Reference counts are not atomic; buffers follow the node's threading
+ * rules.
+ */
+
+#ifndef RAFT_BUF_H
+#define RAFT_BUF_H
+
+#include "types.h"
+
+/**
+ * Release callback invoked when the last reference is dropped
+ */
+typedef void (*raft_buf_free_fn)(void* data, size_t len, void* ctx);
+
+/**
+ * Reference-counted buffer
+ */
+typedef struct raft_buf {
+    uint32_t refcount;          /* Live references */
+    char* data;                 /* Buffer contents */
+    size_t len;                 /* Length of data */
+    raft_buf_free_fn free_fn;   /* Release callback (NULL = free(data)) */
+    void* free_ctx;             /* Context for free_fn */
+} raft_buf_t;
+
+/**
+ * Allocate a buffer of len bytes (single allocation, refcount 1)
+ */
+raft_buf_t* raft_buf_alloc(size_t len);
+
+/**
+ * Wrap caller memory, taking ownership of it (refcount 1)
+ * free_fn is called with (data, len, ctx) on release; NULL means free(data).
+ * Returns NULL on allocation failure, in which case ownership stays with
+ * the caller.
+ */
+raft_buf_t* raft_buf_wrap(void* data, size_t len,
+                          raft_buf_free_fn free_fn, void* ctx);
+
+/**
+ * Take an additional reference
+ */
+raft_buf_t* raft_buf_ref(raft_buf_t* buf);
+
+/**
+ * Drop a reference, releasing the buffer when it was the last one
+ */
+void raft_buf_unref(raft_buf_t* buf);
+
+#endif /* RAFT_BUF_H */
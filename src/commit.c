@@ -5,6 +5,7 @@
 #include "commit.h"
 #include "raft.h"
 #include "log.h"
+#include "storage.h"
 #include <stdlib.h>
 
 static int compare_uint64(const void* a, const void* b) {
@@ -25,8 +26,8 @@ uint64_t raft_get_majority_match_index(raft_node_t* node) {
 
     for (int32_t i = 0; i < node->num_nodes; i++) {
         if (i == node->node_id) {
-            /* Leader's match_index is its last log index */
-            sorted[i] = raft_log_last_index(node->log);
+            /* Leader's match_index is its last durable log index */
+            sorted[i] = raft_durable_index(node);
         } else {
             sorted[i] = node->leader_state.match_index[i];
         }
@@ -47,16 +48,35 @@ bool raft_is_committed(raft_node_t* node, uint64_t index) {
     return index <= node->volatile_state.commit_index;
 }
 
+/* Under RAFT_SYNC_BATCH the leader syncs its own appends only once
+ * enough followers hold entries past them for its copy to be what
+ * holds up a commit */
+static void sync_for_commit(raft_node_t* node) {
+    if (!node->storage) return;
+
+    uint64_t durable = raft_durable_index(node);
+    int32_t ahead = 0;
+    for (int32_t i = 0; i < node->num_nodes; i++) {
+        if (i != node->node_id && node->leader_state.match_index[i] > durable) {
+            ahead++;
+        }
+    }
+    if (ahead >= node->num_nodes / 2) raft_storage_sync_for_ack(node->storage);
+}
+
 raft_status_t raft_advance_commit_index(raft_node_t* node) {
     if (!node) return RAFT_INVALID_ARG;
     if (node->role != RAFT_LEADER) return RAFT_NOT_LEADER;
 
+    sync_for_commit(node);
+
     uint64_t last_index = raft_log_last_index(node->log);
+    uint64_t durable_index = raft_durable_index(node);
     uint64_t new_commit = node->volatile_state.commit_index;
 
     /* Find highest index replicated on majority */
     for (uint64_t n = node->volatile_state.commit_index + 1; n <= last_index; n++) {
-        int count = 1;  /* Leader counts itself */
+        int count = (n <= durable_index) ? 1 : 0;  /* Leader counts itself once durable */
 
         for (int32_t i = 0; i < node->num_nodes; i++) {
             if (i != node->node_id &&
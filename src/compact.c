@@ -0,0 +1,121 @@
+/**
+ * compact.c - Auto-compaction scheduling
+ */
+
+#include "compact.h"
+#include "raft.h"
+#include "log.h"
+#include "storage.h"
+#include "param.h"
+#include <string.h>
+
+void raft_compact_tick(raft_node_t* node, uint64_t elapsed_ms) {
+    if (!node) return;
+    raft_compact_t* c = &node->compact;
+    uint64_t last = raft_log_last_index(node->log);
+
+    /* Entries recovered at startup are not load */
+    if (!c->sampling) {
+        c->sampling = true;
+        c->window_index = last;
+        c->window_ms = 0;
+        return;
+    }
+
+    c->window_ms += elapsed_ms;
+    if (c->window_ms < RAFT_COMPACT_RATE_WINDOW_MS) return;
+
+    /* A truncated log appended nothing this window */
+    uint64_t appended = last > c->window_index ? last - c->window_index : 0;
+    double rate = (double)appended * 1000.0 / (double)c->window_ms;
+    c->fast_rate += (rate - c->fast_rate) / RAFT_COMPACT_FAST_WINDOWS;
+    c->slow_rate += (rate - c->slow_rate) / RAFT_COMPACT_SLOW_WINDOWS;
+    c->window_ms = 0;
+    c->window_index = last;
+
+    c->stats.entry_rate = (uint64_t)c->fast_rate;
+    c->stats.base_rate = (uint64_t)c->slow_rate;
+}
+
+/* Entries arriving well above their long-run rate, and no reason to
+ * think the snapshot would be over quickly */
+static bool in_burst(const raft_compact_t* c) {
+    if (c->fast_rate < RAFT_COMPACT_BURST_RATE) return false;
+    if (c->fast_rate < RAFT_COMPACT_BURST_FACTOR * c->slow_rate) return false;
+    return c->stats.snapshots == 0 || c->stats.cost_us >= RAFT_COMPACT_CHEAP_US;
+}
+
+static raft_compact_decision_t decide(raft_compact_t* c, uint64_t entries) {
+    const raft_compact_stats_t* s = &c->stats;
+    size_t memory_budget = c->memory_budget ? c->memory_budget : RAFT_COMPACT_MEMORY_BUDGET;
+    uint64_t disk_budget = c->disk_budget ? c->disk_budget : RAFT_COMPACT_DISK_BUDGET;
+
+    if (entries == 0) return RAFT_COMPACT_IDLE;
+    if (s->resident_bytes > memory_budget) return RAFT_COMPACT_FORCE_MEMORY;
+    if (s->storage_bytes > disk_budget) return RAFT_COMPACT_FORCE_DISK;
+
+    if (entries < RAFT_AUTO_COMPACTION_THRESHOLD && s->log_bytes < RAFT_COMPACT_LOG_BYTES) {
+        return RAFT_COMPACT_IDLE;
+    }
+    if (!in_burst(c)) return RAFT_COMPACT_RUN;
+
+    if (entries >= (uint64_t)RAFT_AUTO_COMPACTION_THRESHOLD * RAFT_COMPACT_MAX_DEFER ||
+        s->log_bytes >= (uint64_t)RAFT_COMPACT_LOG_BYTES * RAFT_COMPACT_MAX_DEFER) {
+        return RAFT_COMPACT_FORCE_BACKLOG;
+    }
+    return RAFT_COMPACT_DEFER;
+}
+
+bool raft_compact_check(raft_node_t* node) {
+    if (!node || !node->log) return false;
+    raft_compact_t* c = &node->compact;
+
+    raft_log_memory_t memory;
+    raft_log_memory(node->log, &memory);
+    c->stats.resident_bytes = memory.resident_bytes;
+    c->stats.log_bytes = memory.resident_bytes + memory.evicted_bytes;
+    c->stats.storage_bytes = raft_storage_log_bytes(node->storage);
+
+    raft_compact_decision_t decision = decide(c, raft_log_count(node->log));
+    c->stats.last_decision = decision;
+    c->stats.checks++;
+    switch (decision) {
+    case RAFT_COMPACT_IDLE:
+        return false;
+    case RAFT_COMPACT_RUN:
+        c->stats.runs++;
+        break;
+    case RAFT_COMPACT_DEFER:
+        c->stats.deferred++;
+        break;
+    case RAFT_COMPACT_FORCE_MEMORY:
+        c->stats.forced_memory++;
+        break;
+    case RAFT_COMPACT_FORCE_DISK:
+        c->stats.forced_disk++;
+        break;
+    case RAFT_COMPACT_FORCE_BACKLOG:
+        c->stats.forced_backlog++;
+        break;
+    }
+    return decision != RAFT_COMPACT_DEFER;
+}
+
+void raft_compact_record_cost(raft_node_t* node, uint64_t elapsed_us) {
+    if (!node) return;
+    raft_compact_stats_t* s = &node->compact.stats;
+
+    /* Weighted towards history so one outlier does not swing it */
+    s->cost_us = s->snapshots == 0 ? elapsed_us : (s->cost_us * 3 + elapsed_us) / 4;
+    s->last_cost_us = elapsed_us;
+    s->snapshots++;
+}
+
+void raft_compact_stats(raft_node_t* node, raft_compact_stats_t* out) {
+    if (!out) return;
+    if (!node) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    *out = node->compact.stats;
+}
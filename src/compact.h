@@ -0,0 +1,94 @@
+/**
+ * compact.h - Auto-compaction scheduling
+ *
+ * Decides when raft_maybe_compact takes a snapshot. Compaction is due
+ * once the log holds RAFT_AUTO_COMPACTION_THRESHOLD entries or
+ * RAFT_COMPACT_LOG_BYTES of payload. While entries arrive in a burst,
+ * it is put off unless earlier snapshots show it to be cheap; it goes
+ * ahead whatever the load once resident payload or the storage
+ * backend's log passes its budget, or the log has grown
+ * RAFT_COMPACT_MAX_DEFER times past the trigger.
+ *
+ * The entry rate is sampled from raft_tick every
+ * RAFT_COMPACT_RATE_WINDOW_MS and smoothed twice: a burst is a recent
+ * rate well above the long-run one, so sustained load stops counting as
+ * a burst once the long-run rate has caught up.
+ */
+
+#ifndef RAFT_COMPACT_H
+#define RAFT_COMPACT_H
+
+#include "types.h"
+
+/**
+ * What a compaction check decided
+ */
+typedef enum {
+    RAFT_COMPACT_IDLE = 0,          /* Not due */
+    RAFT_COMPACT_RUN = 1,           /* Due, and the load allows it */
+    RAFT_COMPACT_DEFER = 2,         /* Due, put off during a burst */
+    RAFT_COMPACT_FORCE_MEMORY = 3,  /* Resident payload over budget */
+    RAFT_COMPACT_FORCE_DISK = 4,    /* Storage log over budget */
+    RAFT_COMPACT_FORCE_BACKLOG = 5, /* Put off for too long */
+} raft_compact_decision_t;
+
+/**
+ * Compaction scheduling statistics
+ */
+typedef struct raft_compact_stats {
+    uint64_t checks;            /* Checks made */
+    uint64_t runs;              /* Checks that decided RAFT_COMPACT_RUN */
+    uint64_t deferred;          /* ... RAFT_COMPACT_DEFER */
+    uint64_t forced_memory;     /* ... RAFT_COMPACT_FORCE_MEMORY */
+    uint64_t forced_disk;       /* ... RAFT_COMPACT_FORCE_DISK */
+    uint64_t forced_backlog;    /* ... RAFT_COMPACT_FORCE_BACKLOG */
+    raft_compact_decision_t last_decision;
+    uint64_t entry_rate;        /* Entries appended per second, recently */
+    uint64_t base_rate;         /* Entries appended per second, long run */
+    uint64_t snapshots;         /* Snapshots timed */
+    uint64_t last_cost_us;      /* How long the last one took */
+    uint64_t cost_us;           /* How long the next is expected to take */
+    uint64_t log_bytes;         /* Log payload bytes at the last check */
+    uint64_t resident_bytes;    /* Those held in memory */
+    uint64_t storage_bytes;     /* Bytes of log the storage backend held */
+} raft_compact_stats_t;
+
+/**
+ * Per-node scheduler state
+ */
+typedef struct raft_compact {
+    size_t memory_budget;       /* Resident payload that forces compaction (0 = default) */
+    uint64_t disk_budget;       /* Storage log bytes that force it (0 = default) */
+    bool sampling;              /* window_index is set */
+    uint64_t window_ms;         /* Time in the current rate window */
+    uint64_t window_index;      /* Last log index when it opened */
+    double fast_rate;           /* Entries/s over the last few windows */
+    double slow_rate;           /* Entries/s over many */
+    raft_compact_stats_t stats;
+} raft_compact_t;
+
+/**
+ * Account elapsed time towards the entry rate
+ * Called from raft_tick.
+ */
+void raft_compact_tick(raft_node_t* node, uint64_t elapsed_ms);
+
+/**
+ * Decide whether auto-compaction should snapshot now
+ * Records the decision in the node's statistics.
+ *
+ * @return true for RAFT_COMPACT_RUN and the forced decisions
+ */
+bool raft_compact_check(raft_node_t* node);
+
+/**
+ * Record how long a snapshot took, from its start until committed
+ */
+void raft_compact_record_cost(raft_node_t* node, uint64_t elapsed_us);
+
+/**
+ * Get compaction scheduling statistics
+ */
+void raft_compact_stats(raft_node_t* node, raft_compact_stats_t* out);
+
+#endif /* RAFT_COMPACT_H */
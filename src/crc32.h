@@ -1,7 +1,10 @@
 /**
- * crc32.h - CRC32 checksum for data integrity
+ * crc32.h - CRC32 and CRC32C checksums for data integrity
  *
- * Provides CRC32 calculation for verifying data integrity in storage.
+ * CRC32C (Castagnoli) protects WAL records and uses the SSE4.2 crc32
+ * instruction where available. CRC32 (the zlib polynomial) covers the
+ * small state, term-runs and snapshot files and WAL segments written
+ * before format version 3.
  */
 
 #ifndef RAFT_CRC32_H
@@ -9,6 +12,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 
 /**
  * Calculate CRC32 checksum for data
@@ -20,4 +24,26 @@ uint32_t crc32(const void* data, size_t len);
  */
 uint32_t crc32_update(uint32_t crc, const void* data, size_t len);
 
+/**
+ * Calculate CRC32C checksum for data
+ */
+uint32_t crc32c(const void* data, size_t len);
+
+/**
+ * Update CRC32C incrementally (for streaming data)
+ * Dispatches to the fastest implementation this CPU supports.
+ */
+uint32_t crc32c_update(uint32_t crc, const void* data, size_t len);
+
+/**
+ * Update CRC32C with the portable slicing-by-8 code only
+ * For checking and benchmarking the hardware path against.
+ */
+uint32_t crc32c_update_sw(uint32_t crc, const void* data, size_t len);
+
+/**
+ * Check whether crc32c_update runs on SSE4.2/PCLMUL instructions
+ */
+bool crc32c_hw_available(void);
+
 #endif /* RAFT_CRC32_H */
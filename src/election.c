@@ -5,6 +5,7 @@
 #include "election.h"
 #include "raft.h"
 #include "timer.h"
+#include "install.h"
 #include "log.h"
 #include "rpc.h"
 #include "param.h"
@@ -34,6 +35,18 @@ __attribute__((weak)) raft_status_t raft_storage_save_state(void* storage,
     return RAFT_OK;
 }
 
+__attribute__((weak)) raft_status_t raft_storage_stage_state(void* storage,
+                                                              uint64_t current_term,
+                                                              int32_t voted_for) {
+    (void)storage; (void)current_term; (void)voted_for;
+    return RAFT_OK;
+}
+
+__attribute__((weak)) raft_status_t raft_storage_sync_state(void* storage) {
+    (void)storage;
+    return RAFT_OK;
+}
+
 /* Helper to persist state if storage is enabled */
 static void persist_state(raft_node_t* node) {
     if (node->storage) {
@@ -43,8 +56,16 @@ static void persist_state(raft_node_t* node) {
     }
 }
 
-void raft_step_down(raft_node_t* node, uint64_t new_term) {
-    if (!node) return;
+/* Write state to the WAL, leaving the sync to whatever follows */
+static void stage_state(raft_node_t* node) {
+    if (node->storage) {
+        raft_storage_stage_state(node->storage,
+                                  node->persistent.current_term,
+                                  node->persistent.voted_for);
+    }
+}
+
+static void step_down(raft_node_t* node, uint64_t new_term, bool sync) {
 
     node->role = RAFT_FOLLOWER;
     node->persistent.current_term = new_term;
@@ -58,11 +79,25 @@ void raft_step_down(raft_node_t* node, uint64_t new_term) {
     }
 
     /* Persist state change */
-    persist_state(node);
+    if (sync) {
+        persist_state(node);
+    } else {
+        stage_state(node);
+    }
 
     raft_reset_election_timer(node);
 }
 
+void raft_step_down(raft_node_t* node, uint64_t new_term) {
+    if (!node) return;
+    step_down(node, new_term, true);
+}
+
+void raft_step_down_staged(raft_node_t* node, uint64_t new_term) {
+    if (!node) return;
+    step_down(node, new_term, false);
+}
+
 static bool is_log_up_to_date(raft_node_t* node, uint64_t last_log_term,
                                uint64_t last_log_index) {
     uint64_t my_last_term = raft_log_last_term(node->log);
@@ -247,9 +282,10 @@ raft_status_t raft_handle_request_vote(raft_node_t* node,
     response->term = node->persistent.current_term;
     response->vote_granted = false;
 
-    /* If request term > current term, step down */
+    /* If request term > current term, step down; a granted vote below
+     * syncs the new term with it */
     if (request->term > node->persistent.current_term) {
-        raft_step_down(node, request->term);
+        raft_step_down_staged(node, request->term);
         response->term = node->persistent.current_term;
     }
 
@@ -274,6 +310,10 @@ raft_status_t raft_handle_request_vote(raft_node_t* node,
         raft_reset_election_timer(node);
     }
 
+    /* The new term must be durable before replying even without a vote */
+    if (node->storage && raft_storage_sync_state(node->storage) != RAFT_OK) {
+        return RAFT_IO_ERROR;
+    }
     return RAFT_OK;
 }
 
@@ -320,6 +360,8 @@ raft_status_t raft_handle_append_entries(raft_node_t* node,
     response->term = node->persistent.current_term;
     response->success = false;
     response->match_index = 0;
+    response->conflict_term = 0;
+    response->conflict_index = 0;
 
     /* If request term > current term, step down */
     if (request->term > node->persistent.current_term) {
@@ -435,6 +477,23 @@ raft_status_t raft_receive_message(raft_node_t* node, int32_t from_node,
                 (const raft_append_entries_response_t*)msg);
         }
 
+        case RAFT_MSG_INSTALL_SNAPSHOT: {
+            raft_install_snapshot_response_t response;
+            raft_status_t status = raft_handle_install_snapshot(node, msg, msg_len,
+                                                                &response);
+            if (status == RAFT_OK && node->send_fn) {
+                node->send_fn(node, from_node, &response, sizeof(response),
+                              node->user_data);
+            }
+            return status;
+        }
+
+        case RAFT_MSG_INSTALL_SNAPSHOT_RESPONSE: {
+            if (msg_len < sizeof(raft_install_snapshot_response_t)) return RAFT_INVALID_ARG;
+            return raft_handle_install_snapshot_response(node, from_node,
+                (const raft_install_snapshot_response_t*)msg);
+        }
+
         case RAFT_MSG_PRE_VOTE: {
             if (msg_len < sizeof(raft_pre_vote_t)) return RAFT_INVALID_ARG;
             raft_pre_vote_response_t response;
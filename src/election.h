@@ -68,6 +68,13 @@ raft_status_t raft_handle_timeout_now(raft_node_t* node,
  */
 void raft_step_down(raft_node_t* node, uint64_t new_term);
 
+/**
+ * Step down like raft_step_down, writing the new term without syncing it
+ * For handlers about to sync the WAL anyway; they must call
+ * raft_storage_sync_state before replying.
+ */
+void raft_step_down_staged(raft_node_t* node, uint64_t new_term);
+
 /**
  * Send heartbeats to all peers (leader only)
  */
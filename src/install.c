@@ -0,0 +1,373 @@
+/**
+ * install.c - Chunked InstallSnapshot transfer implementation (Phase 5)
+ *
+ * Chunks are raw bytes of the snapshot file, so the leader reads them
+ * with pread and the follower writes them with pwrite; neither holds
+ * more than one chunk of the state in memory. A follower whose snapshots
+ * already reach the leader's base is sent the deltas past them instead.
+ */
+
+#include "install.h"
+#include "raft.h"
+#include "election.h"
+#include "commit.h"
+#include "replication.h"
+#include "snapshot.h"
+#include "param.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+/* Leader side: the snapshot going to one peer */
+typedef struct {
+    int fd;                     /* Snapshot file being sent (-1 = none) */
+    uint64_t last_index;        /* Snapshot being sent */
+    uint64_t last_term;
+    uint64_t size;              /* Length of the file */
+    uint64_t next_offset;       /* Next byte to send */
+    uint64_t acked;             /* Bytes the peer holds without a gap */
+    uint64_t acked_at_heartbeat;    /* acked at the last heartbeat (UINT64_MAX = none yet) */
+    uint64_t prev_index;        /* Snapshot point the delta being sent applies on (0 = base) */
+    bool probing;               /* Base sent a chunk at a time until the peer's tip is known */
+    bool peer_known;            /* peer_snapshot has been reported */
+    uint64_t peer_snapshot;     /* Tip of the peer's snapshots, kept across transfers */
+} install_send_t;
+
+struct raft_install {
+    install_send_t* sends;      /* Leader: one per peer */
+    char* chunk;                /* Leader: message buffer, header plus one chunk */
+    raft_snapshot_receiver_t* receiver;  /* Follower: file being received (NULL if none) */
+    uint64_t recv_term;         /* Leader term the file is received in */
+    uint64_t recv_index;        /* Snapshot being received */
+    uint64_t recv_snapshot_term;
+    uint64_t recv_prev;         /* Snapshot point it applies on (0 = base) */
+    uint64_t recv_size;         /* Length of the file once its last chunk is in (0 = unknown) */
+};
+
+static size_t chunk_size(const raft_node_t* node) {
+    return node->snapshot_chunk_size ? node->snapshot_chunk_size : RAFT_SNAPSHOT_CHUNK_SIZE;
+}
+
+static uint64_t max_inflight(const raft_node_t* node) {
+    return node->snapshot_max_inflight ? node->snapshot_max_inflight :
+                                         RAFT_SNAPSHOT_MAX_INFLIGHT;
+}
+
+static raft_install_t* get_install(raft_node_t* node) {
+    if (node->install) return node->install;
+
+    raft_install_t* install = calloc(1, sizeof(raft_install_t));
+    if (!install) return NULL;
+    install->sends = calloc(node->num_nodes, sizeof(install_send_t));
+    if (!install->sends) {
+        free(install);
+        return NULL;
+    }
+    for (int32_t i = 0; i < node->num_nodes; i++) {
+        install->sends[i].fd = -1;
+    }
+    node->install = install;
+    return install;
+}
+
+static void close_send(install_send_t* send) {
+    if (send->fd >= 0) close(send->fd);
+    send->fd = -1;
+}
+
+static void drop_receive(raft_install_t* install) {
+    raft_snapshot_receiver_abort(install->receiver);
+    install->receiver = NULL;
+}
+
+/* pread() until len bytes are in */
+static raft_status_t read_chunk(int fd, char* buf, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pread(fd, buf, len, (off_t)offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return RAFT_IO_ERROR;
+        buf += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return RAFT_OK;
+}
+
+/* Tip of this node's snapshots (0 = none) */
+static uint64_t snapshot_tip(raft_node_t* node) {
+    raft_snapshot_meta_t meta;
+    if (raft_snapshot_load_meta(node->data_dir, &meta) != RAFT_OK) return 0;
+    return meta.last_index;
+}
+
+/* Send chunks until the window of unacknowledged ones is full */
+static raft_status_t send_chunks(raft_node_t* node, int32_t peer_id, install_send_t* send) {
+    size_t chunk = chunk_size(node);
+    uint64_t window = send->probing ? chunk : chunk * max_inflight(node);
+    raft_install_snapshot_t* msg = (raft_install_snapshot_t*)node->install->chunk;
+
+    while (send->next_offset < send->size && send->next_offset - send->acked < window) {
+        size_t len = send->size - send->next_offset < chunk ?
+                     (size_t)(send->size - send->next_offset) : chunk;
+        raft_status_t status = read_chunk(send->fd, (char*)(msg + 1), len, send->next_offset);
+        if (status != RAFT_OK) {
+            close_send(send);
+            return status;
+        }
+
+        msg->type = RAFT_MSG_INSTALL_SNAPSHOT;
+        msg->term = node->persistent.current_term;
+        msg->leader_id = node->node_id;
+        msg->last_index = send->last_index;
+        msg->last_term = send->last_term;
+        msg->prev_index = send->prev_index;
+        msg->offset = send->next_offset;
+        msg->data_len = (uint32_t)len;
+        msg->done = send->next_offset + len == send->size;
+
+        if (node->send_fn) {
+            node->send_fn(node, peer_id, msg, sizeof(*msg) + len, node->user_data);
+        } else {
+            struct iovec iov = { .iov_base = msg, .iov_len = sizeof(*msg) + len };
+            node->sendv_fn(node, peer_id, &iov, 1, node->user_data);
+        }
+        send->next_offset += len;
+    }
+    return RAFT_OK;
+}
+
+raft_status_t raft_install_snapshot_send(raft_node_t* node, int32_t peer_id) {
+    if (!node) return RAFT_INVALID_ARG;
+    if (node->role != RAFT_LEADER) return RAFT_NOT_LEADER;
+    if (peer_id < 0 || peer_id >= node->num_nodes) return RAFT_INVALID_ARG;
+    if (!node->data_dir) return RAFT_NOT_FOUND;
+
+    raft_install_t* install = get_install(node);
+    if (!install) return RAFT_NO_MEMORY;
+    if (!install->chunk) {
+        install->chunk = malloc(sizeof(raft_install_snapshot_t) + chunk_size(node));
+        if (!install->chunk) return RAFT_NO_MEMORY;
+    }
+
+    install_send_t* send = &install->sends[peer_id];
+    if (send->fd < 0) {
+        raft_snapshot_meta_t meta;
+        raft_status_t status = raft_snapshot_open_file(node->data_dir, send->peer_snapshot,
+                                                       &meta, &send->prev_index,
+                                                       &send->fd, &send->size);
+        if (status != RAFT_OK) return status;
+        send->last_index = meta.last_index;
+        send->last_term = meta.last_term;
+        send->next_offset = 0;
+        send->acked = 0;
+        send->acked_at_heartbeat = UINT64_MAX;
+
+        /* With deltas to offer, learn what the peer holds from its first
+         * ack before sending it the whole base */
+        send->probing = !send->peer_known && send->prev_index == 0 &&
+                        raft_snapshot_delta_count(node->data_dir) > 0;
+    }
+
+    return send_chunks(node, peer_id, send);
+}
+
+void raft_install_snapshot_heartbeat(raft_node_t* node) {
+    if (!node || !node->install) return;
+
+    for (int32_t i = 0; i < node->num_nodes; i++) {
+        install_send_t* send = &node->install->sends[i];
+        if (send->fd < 0) continue;
+
+        /* Nothing acked for a whole interval: chunks were lost, or the
+         * peer was cut off; resend from what it holds */
+        if (send->acked == send->acked_at_heartbeat) {
+            send->next_offset = send->acked;
+        }
+        send->acked_at_heartbeat = send->acked;
+    }
+}
+
+raft_status_t raft_handle_install_snapshot(raft_node_t* node,
+                                           const void* msg, size_t msg_len,
+                                           raft_install_snapshot_response_t* response) {
+    if (!node || !msg || !response) return RAFT_INVALID_ARG;
+    if (msg_len < sizeof(raft_install_snapshot_t)) return RAFT_INVALID_ARG;
+
+    const raft_install_snapshot_t* request = (const raft_install_snapshot_t*)msg;
+    if (request->data_len > msg_len - sizeof(*request)) return RAFT_INVALID_ARG;
+
+    response->type = RAFT_MSG_INSTALL_SNAPSHOT_RESPONSE;
+    response->term = node->persistent.current_term;
+    response->success = false;
+    response->last_index = request->last_index;
+    response->offset = 0;
+    response->snapshot_index = node->data_dir ? snapshot_tip(node) : 0;
+    response->done = false;
+
+    /* Step down if request has higher term */
+    if (request->term > node->persistent.current_term) {
+        raft_step_down(node, request->term);
+        response->term = node->persistent.current_term;
+    }
+
+    /* Reject if request term < current term */
+    if (request->term < node->persistent.current_term) {
+        return RAFT_OK;
+    }
+
+    /* Valid chunk from the leader - reset election timer */
+    node->election_timer_ms = 0;
+    node->current_leader = request->leader_id;
+    if (node->role == RAFT_CANDIDATE) {
+        node->role = RAFT_FOLLOWER;
+        node->votes_received = 0;
+    }
+
+    /* Everything the snapshot covers is already committed here */
+    if (request->last_index <= node->volatile_state.commit_index) {
+        if (node->install) drop_receive(node->install);
+        response->success = true;
+        response->done = true;
+        return RAFT_OK;
+    }
+
+    /* Nowhere to put it, or nothing to load it into the state machine */
+    if (!node->data_dir || !raft_snapshot_can_restore(node, request->prev_index > 0)) {
+        return RAFT_OK;
+    }
+
+    raft_install_t* install = get_install(node);
+    if (!install) return RAFT_NO_MEMORY;
+
+    /* Another snapshot, or one from another leader, starts over; the
+     * same one picks up where it left off */
+    if (install->receiver &&
+        (install->recv_term != request->term ||
+         install->recv_index != request->last_index ||
+         install->recv_snapshot_term != request->last_term ||
+         install->recv_prev != request->prev_index)) {
+        drop_receive(install);
+    }
+    if (!install->receiver) {
+        /* A delta needs the snapshot it applies on; the leader sends the
+         * base instead once it sees our tip */
+        if (request->prev_index > response->snapshot_index) return RAFT_OK;
+
+        raft_status_t status = raft_snapshot_receiver_open(node->data_dir, &install->receiver);
+        if (status != RAFT_OK) return status;
+        install->recv_term = request->term;
+        install->recv_index = request->last_index;
+        install->recv_snapshot_term = request->last_term;
+        install->recv_prev = request->prev_index;
+        install->recv_size = 0;
+    }
+
+    raft_status_t status = raft_snapshot_receiver_write(install->receiver, request->offset,
+                                                        request + 1, request->data_len);
+    if (status != RAFT_OK) {
+        drop_receive(install);
+        return RAFT_OK;
+    }
+    if (request->done) install->recv_size = request->offset + request->data_len;
+
+    response->success = true;
+    response->offset = raft_snapshot_receiver_length(install->receiver);
+    if (install->recv_size == 0 || response->offset < install->recv_size) {
+        return RAFT_OK;
+    }
+
+    /* The whole file is in: check it, move it into place and install it.
+     * A background snapshot finishing later would overwrite it */
+    raft_snapshot_wait(node);
+    raft_snapshot_meta_t meta;
+    status = raft_snapshot_receiver_commit(install->receiver, install->recv_prev, &meta);
+    install->receiver = NULL;
+    if (status == RAFT_OK) status = raft_snapshot_install_file(node, &meta);
+    if (status != RAFT_OK) {
+        response->success = false;
+        response->offset = 0;
+        return RAFT_OK;
+    }
+    response->snapshot_index = meta.last_index;
+    response->done = true;
+    return RAFT_OK;
+}
+
+raft_status_t raft_handle_install_snapshot_response(
+    raft_node_t* node,
+    int32_t from_node,
+    const raft_install_snapshot_response_t* response) {
+
+    if (!node || !response) return RAFT_INVALID_ARG;
+    if (from_node < 0 || from_node >= node->num_nodes) return RAFT_INVALID_ARG;
+    if (node->role != RAFT_LEADER) return RAFT_OK;
+
+    /* Step down if response has higher term */
+    if (response->term > node->persistent.current_term) {
+        raft_step_down(node, response->term);
+        return RAFT_OK;
+    }
+
+    /* Ignore stale responses */
+    if (response->term < node->persistent.current_term) {
+        return RAFT_OK;
+    }
+
+    install_send_t* send = node->install ? &node->install->sends[from_node] : NULL;
+    bool current = send && send->fd >= 0 && send->last_index == response->last_index;
+    if (send) {
+        send->peer_snapshot = response->snapshot_index;
+        send->peer_known = true;
+    }
+
+    if (response->done) {
+        if (current) close_send(send);
+        if (response->last_index > node->leader_state.match_index[from_node]) {
+            node->leader_state.match_index[from_node] = response->last_index;
+            raft_advance_commit_index(node);
+        }
+        if (node->leader_state.next_index[from_node] <= response->last_index) {
+            node->leader_state.next_index[from_node] = response->last_index + 1;
+        }
+        /* Carry on with the entries after the snapshot */
+        return raft_replicate_to_peer(node, from_node);
+    }
+
+    if (!current) return RAFT_OK;
+
+    /* The follower threw the file away; start over at the next heartbeat */
+    if (!response->success) {
+        close_send(send);
+        return RAFT_OK;
+    }
+
+    /* The peer's snapshots reach the base, so deltas will do */
+    if (send->probing) {
+        send->probing = false;
+        if (send->peer_snapshot >= send->last_index) {
+            close_send(send);
+            return raft_install_snapshot_send(node, from_node);
+        }
+    }
+
+    if (response->offset > send->acked) {
+        send->acked = response->offset;
+        if (send->next_offset < send->acked) send->next_offset = send->acked;
+    }
+    return send_chunks(node, from_node, send);
+}
+
+void raft_install_snapshot_reset(raft_node_t* node) {
+    if (!node || !node->install) return;
+
+    raft_install_t* install = node->install;
+    for (int32_t i = 0; i < node->num_nodes; i++) {
+        close_send(&install->sends[i]);
+    }
+    drop_receive(install);
+    free(install->sends);
+    free(install->chunk);
+    free(install);
+    node->install = NULL;
+}
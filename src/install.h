@@ -0,0 +1,57 @@
+/**
+ * install.h - Chunked InstallSnapshot transfer (Phase 5)
+ *
+ * A leader whose log no longer holds the entries a follower needs sends
+ * it the snapshot file instead, in chunks read straight from disk with
+ * a bounded number unacknowledged. The follower writes each chunk into
+ * a temporary file at its offset and acks how much it holds without a
+ * gap; a transfer that stalls (lost chunks, a partition) resumes from
+ * that offset instead of starting over.
+ */
+
+#ifndef RAFT_INSTALL_H
+#define RAFT_INSTALL_H
+
+#include "types.h"
+#include "rpc.h"
+
+/**
+ * Send a peer the next chunks of the snapshot (leader only)
+ * Called by raft_replicate_to_peer for a peer whose next_index is at or
+ * below the log's base. Starts a transfer if none is running and sends
+ * chunks until snapshot_max_inflight are unacknowledged.
+ *
+ * @return RAFT_OK if the peer is being sent the snapshot, RAFT_NOT_FOUND
+ *         if there is no snapshot to send
+ */
+raft_status_t raft_install_snapshot_send(raft_node_t* node, int32_t peer_id);
+
+/**
+ * Rewind transfers that made no progress since the last heartbeat
+ * Their unacknowledged chunks are sent again from the follower's ack.
+ */
+void raft_install_snapshot_heartbeat(raft_node_t* node);
+
+/**
+ * Handle an InstallSnapshot chunk (follower side)
+ * Once the whole file is in, it is checked, moved into place and
+ * installed with raft_snapshot_install_file.
+ */
+raft_status_t raft_handle_install_snapshot(raft_node_t* node,
+                                           const void* msg, size_t msg_len,
+                                           raft_install_snapshot_response_t* response);
+
+/**
+ * Handle an InstallSnapshot response (leader side)
+ */
+raft_status_t raft_handle_install_snapshot_response(
+    raft_node_t* node,
+    int32_t from_node,
+    const raft_install_snapshot_response_t* response);
+
+/**
+ * Drop every transfer in progress, sending or receiving
+ */
+void raft_install_snapshot_reset(raft_node_t* node);
+
+#endif /* RAFT_INSTALL_H */
@@ -1,23 +1,328 @@
 /**
  * log.c - Raft log management implementation
+ *
+ * The log is a ring of fixed-size segments. Appends fill the last
+ * segment and allocate a new one when it is full; prefix truncation
+ * advances head_offset and releases segments that become empty. The
+ * ring itself only stores segment pointers, so growing it copies
+ * seg_count pointers rather than every entry.
+ *
+ * Command payloads are stored inline in the slot when they fit in
+ * RAFT_LOG_INLINE_SIZE, bump-allocated from the owning segment's arena
+ * when they are small, and malloc'd individually only when they are
+ * large. Arena memory is returned in bulk when the segment is released.
+ * Commands handed over in a raft_buf_t are referenced, not copied.
+ *
+ * Term runs are appended as terms change and trimmed on tail truncation
+ * only, so they outlive compaction and term lookups are a binary search.
+ *
+ * Under a memory budget, payloads of entries that are no longer needed
+ * in memory are evicted oldest first and read back through a loader on
+ * access. memory.resident_bytes counts arena chunks attached to live
+ * segments plus heap and shared payloads.
  */
 
 #include "log.h"
-#include "param.h"
 #include <stdlib.h>
 #include <string.h>
 
+#define SEG_ENTRIES RAFT_LOG_SEGMENT_ENTRIES
+
+/* Largest payload served from a segment arena */
+#define ARENA_MAX_ALLOC (RAFT_LOG_ARENA_CHUNK_SIZE / 4)
+
+static inline raft_log_segment_t* log_segment(raft_log_t* log, size_t n) {
+    return log->segments[(log->seg_head + n) & (log->seg_capacity - 1)];
+}
+
+static inline raft_log_slot_t* log_slot(raft_log_t* log, size_t pos) {
+    size_t off = log->head_offset + pos;
+    return &log_segment(log, off / SEG_ENTRIES)->slots[off % SEG_ENTRIES];
+}
+
+/* ========== Payload arena ========== */
+
+static char* arena_alloc(raft_log_t* log, raft_log_segment_t* seg, size_t len) {
+    raft_arena_chunk_t* chunk = seg->arena;
+    if (!chunk || RAFT_LOG_ARENA_CHUNK_SIZE - chunk->used < len) {
+        chunk = malloc(sizeof(raft_arena_chunk_t) + RAFT_LOG_ARENA_CHUNK_SIZE);
+        if (!chunk) return NULL;
+        chunk->used = 0;
+        chunk->next = seg->arena;
+        seg->arena = chunk;
+        log->memory.resident_bytes += RAFT_LOG_ARENA_CHUNK_SIZE;
+    }
+
+    char* ptr = chunk->data + chunk->used;
+    chunk->used += len;
+    return ptr;
+}
+
+/* Give back everything allocated at or after ptr */
+static void arena_rewind(raft_log_t* log, raft_log_segment_t* seg, const char* ptr) {
+    raft_arena_chunk_t* chunk = seg->arena;
+    while (chunk && !(ptr >= chunk->data && ptr <= chunk->data + chunk->used)) {
+        raft_arena_chunk_t* next = chunk->next;
+        free(chunk);
+        log->memory.resident_bytes -= RAFT_LOG_ARENA_CHUNK_SIZE;
+        chunk = next;
+    }
+    seg->arena = chunk;
+    if (chunk) chunk->used = (size_t)(ptr - chunk->data);
+}
+
+/* Empty the arena but keep its oldest chunk for reuse */
+static void arena_reset(raft_log_segment_t* seg) {
+    raft_arena_chunk_t* chunk = seg->arena;
+    while (chunk && chunk->next) {
+        raft_arena_chunk_t* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    seg->arena = chunk;
+    if (chunk) chunk->used = 0;
+}
+
+static void arena_free(raft_log_segment_t* seg) {
+    arena_reset(seg);
+    free(seg->arena);
+    seg->arena = NULL;
+}
+
+/* Bytes of arena chunks held by seg */
+static size_t arena_bytes(const raft_log_segment_t* seg) {
+    size_t bytes = 0;
+    for (raft_arena_chunk_t* chunk = seg->arena; chunk; chunk = chunk->next) {
+        bytes += RAFT_LOG_ARENA_CHUNK_SIZE;
+    }
+    return bytes;
+}
+
+/* ========== Segments ========== */
+
+static void segment_release(raft_log_t* log, raft_log_segment_t* seg) {
+    log->memory.resident_bytes -= arena_bytes(seg);
+    if (!log->spare) {
+        arena_reset(seg);
+        log->spare = seg;
+    } else {
+        arena_free(seg);
+        free(seg);
+    }
+}
+
+static raft_log_segment_t* segment_acquire(raft_log_t* log) {
+    raft_log_segment_t* seg = log->spare;
+    if (seg) {
+        log->spare = NULL;
+        log->memory.resident_bytes += arena_bytes(seg);
+        return seg;
+    }
+    seg = malloc(sizeof(raft_log_segment_t));
+    if (seg) seg->arena = NULL;
+    return seg;
+}
+
+static raft_status_t log_grow_ring(raft_log_t* log) {
+    size_t new_capacity = log->seg_capacity * 2;
+    raft_log_segment_t** new_segments = malloc(new_capacity * sizeof(*new_segments));
+    if (!new_segments) return RAFT_NO_MEMORY;
+
+    /* Unwrap the ring so the first segment lands in slot 0 */
+    for (size_t i = 0; i < log->seg_count; i++) {
+        new_segments[i] = log_segment(log, i);
+    }
+
+    free(log->segments);
+    log->segments = new_segments;
+    log->seg_capacity = new_capacity;
+    log->seg_head = 0;
+    return RAFT_OK;
+}
+
+/* ========== Slots ========== */
+
+static raft_status_t slot_store_payload(raft_log_t* log,
+                                        raft_log_segment_t* seg,
+                                        raft_log_slot_t* slot,
+                                        const char* command,
+                                        size_t command_len) {
+    char* dst;
+
+    if (!command || command_len == 0) {
+        slot->kind = RAFT_PAYLOAD_NONE;
+        slot->entry.command = NULL;
+        slot->entry.command_len = 0;
+        return RAFT_OK;
+    }
+
+    if (command_len <= RAFT_LOG_INLINE_SIZE) {
+        slot->kind = RAFT_PAYLOAD_INLINE;
+        dst = slot->inline_data;
+    } else if (command_len <= ARENA_MAX_ALLOC) {
+        slot->kind = RAFT_PAYLOAD_ARENA;
+        dst = arena_alloc(log, seg, command_len);
+    } else {
+        slot->kind = RAFT_PAYLOAD_HEAP;
+        dst = malloc(command_len);
+        if (dst) log->memory.resident_bytes += command_len;
+    }
+    if (!dst) return RAFT_NO_MEMORY;
+
+    memcpy(dst, command, command_len);
+    slot->entry.command = dst;
+    slot->entry.command_len = command_len;
+    return RAFT_OK;
+}
+
+/* Drop a slot's individually owned payload, leaving arena bytes alone */
+static void slot_drop_payload(raft_log_t* log, raft_log_slot_t* slot) {
+    if (slot->kind == RAFT_PAYLOAD_HEAP) {
+        free(slot->entry.command);
+        log->memory.resident_bytes -= slot->entry.command_len;
+    } else if (slot->kind == RAFT_PAYLOAD_SHARED) {
+        raft_buf_unref(slot->owner);
+        log->memory.resident_bytes -= slot->entry.command_len;
+    } else if (slot->kind == RAFT_PAYLOAD_EVICTED) {
+        log->memory.evicted_bytes -= slot->entry.command_len;
+    }
+    slot->entry.command = NULL;
+}
+
+/* Free individually owned payloads in positions [from, to) */
+static void log_free_commands(raft_log_t* log, size_t from, size_t to) {
+    for (size_t pos = from; pos < to; pos++) {
+        raft_log_slot_t* slot = log_slot(log, pos);
+        slot_drop_payload(log, slot);
+        slot->kind = RAFT_PAYLOAD_NONE;
+    }
+}
+
+/* Release trailing segments that no longer hold any entry */
+static void log_trim_tail(raft_log_t* log) {
+    if (log->count == 0) log->head_offset = 0;
+
+    size_t needed = (log->head_offset + log->count + SEG_ENTRIES - 1) / SEG_ENTRIES;
+    while (log->seg_count > needed) {
+        log->seg_count--;
+        segment_release(log, log_segment(log, log->seg_count));
+    }
+    if (log->seg_count == 0) log->seg_head = 0;
+}
+
+/* ========== Term runs ========== */
+
+/* Record that first_index was written in term, replacing stale runs */
+static raft_status_t runs_note(raft_log_t* log, uint64_t first_index, uint64_t term) {
+    while (log->run_count > 0 &&
+           log->runs[log->run_count - 1].first_index >= first_index) {
+        log->run_count--;
+    }
+    if (log->run_count > 0 && log->runs[log->run_count - 1].term == term) {
+        return RAFT_OK;
+    }
+
+    if (log->run_count == log->run_capacity) {
+        size_t new_capacity = log->run_capacity ? log->run_capacity * 2 : 8;
+        raft_term_run_t* new_runs = realloc(log->runs, new_capacity * sizeof(*new_runs));
+        if (!new_runs) return RAFT_NO_MEMORY;
+        log->runs = new_runs;
+        log->run_capacity = new_capacity;
+    }
+
+    log->runs[log->run_count].first_index = first_index;
+    log->runs[log->run_count].term = term;
+    log->run_count++;
+    return RAFT_OK;
+}
+
+/* Position of the run covering index (run_count if none) */
+static size_t runs_find(raft_log_t* log, uint64_t index) {
+    size_t lo = 0, hi = log->run_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (log->runs[mid].first_index <= index) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo == 0 ? log->run_count : lo - 1;
+}
+
+/* Position of the run for term (run_count if none); terms never decrease */
+static size_t runs_find_term(raft_log_t* log, uint64_t term) {
+    size_t lo = 0, hi = log->run_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (log->runs[mid].term < term) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < log->run_count && log->runs[lo].term == term) return lo;
+    return log->run_count;
+}
+
+/* ========== Eviction ========== */
+
+/* Drop a slot's payload from memory; it can be reloaded by index */
+static void slot_evict(raft_log_t* log, raft_log_slot_t* slot) {
+    if (slot->kind != RAFT_PAYLOAD_ARENA && slot->kind != RAFT_PAYLOAD_HEAP &&
+        slot->kind != RAFT_PAYLOAD_SHARED) {
+        return;
+    }
+
+    slot_drop_payload(log, slot);
+    slot->kind = RAFT_PAYLOAD_EVICTED;
+    log->memory.evicted_bytes += slot->entry.command_len;
+    log->memory.evictions++;
+}
+
+/* Read an evicted payload back into a heap copy */
+static raft_status_t slot_reload(raft_log_t* log, raft_log_slot_t* slot) {
+    if (!log->load_fn) return RAFT_NOT_FOUND;
+
+    char* command = NULL;
+    size_t command_len = 0;
+    raft_status_t status = log->load_fn(log->load_ctx, slot->entry.index,
+                                        slot->entry.term, &command, &command_len);
+    if (status != RAFT_OK) return status;
+    if (command_len != slot->entry.command_len) {
+        free(command);
+        return RAFT_CORRUPTION;
+    }
+
+    slot->kind = RAFT_PAYLOAD_HEAP;
+    slot->entry.command = command;
+    log->memory.evicted_bytes -= command_len;
+    log->memory.resident_bytes += command_len;
+    log->memory.reloads++;
+
+    if (log->reload_low == 0 || slot->entry.index < log->reload_low) {
+        log->reload_low = slot->entry.index;
+    }
+    return RAFT_OK;
+}
+
+/* ========== Public API ========== */
+
 raft_log_t* raft_log_create(void) {
     raft_log_t* log = calloc(1, sizeof(raft_log_t));
     if (!log) return NULL;
 
-    log->entries = calloc(RAFT_LOG_INITIAL_CAPACITY, sizeof(raft_entry_t));
-    if (!log->entries) {
+    log->segments = calloc(RAFT_LOG_INITIAL_SEGMENTS, sizeof(raft_log_segment_t*));
+    if (!log->segments) {
         free(log);
         return NULL;
     }
 
-    log->capacity = RAFT_LOG_INITIAL_CAPACITY;
+    log->seg_capacity = RAFT_LOG_INITIAL_SEGMENTS;
+    log->seg_head = 0;
+    log->seg_count = 0;
+    log->head_offset = 0;
+    log->spare = NULL;
     log->count = 0;
     log->base_index = 0;
     log->base_term = 0;
@@ -28,51 +333,171 @@ raft_log_t* raft_log_create(void) {
 void raft_log_destroy(raft_log_t* log) {
     if (!log) return;
 
-    for (size_t i = 0; i < log->count; i++) {
-        free(log->entries[i].command);
+    log_free_commands(log, 0, log->count);
+    for (size_t i = 0; i < log->seg_count; i++) {
+        raft_log_segment_t* seg = log_segment(log, i);
+        arena_free(seg);
+        free(seg);
+    }
+    if (log->spare) {
+        arena_free(log->spare);
+        free(log->spare);
     }
-    free(log->entries);
+    free(log->runs);
+    free(log->segments);
     free(log);
 }
 
-static raft_status_t log_grow(raft_log_t* log) {
-    size_t new_capacity = log->capacity * 2;
-    raft_entry_t* new_entries = realloc(log->entries,
-                                        new_capacity * sizeof(raft_entry_t));
-    if (!new_entries) return RAFT_NO_MEMORY;
-
-    log->entries = new_entries;
-    log->capacity = new_capacity;
+/* Open segments until count more entries fit; on failure the extra
+ * segments are released again */
+static raft_status_t log_reserve(raft_log_t* log, size_t count) {
+    size_t needed = (log->head_offset + log->count + count + SEG_ENTRIES - 1) / SEG_ENTRIES;
+
+    while (log->seg_count < needed) {
+        if (log->seg_count == log->seg_capacity && log_grow_ring(log) != RAFT_OK) {
+            log_trim_tail(log);
+            return RAFT_NO_MEMORY;
+        }
+        raft_log_segment_t* seg = segment_acquire(log);
+        if (!seg) {
+            log_trim_tail(log);
+            return RAFT_NO_MEMORY;
+        }
+        log->segments[(log->seg_head + log->seg_count) & (log->seg_capacity - 1)] = seg;
+        log->seg_count++;
+    }
     return RAFT_OK;
 }
 
+/* Make room for one more entry and return its (unfilled) slot */
+static raft_log_slot_t* log_next_slot(raft_log_t* log, raft_log_segment_t** out_seg) {
+    if (log_reserve(log, 1) != RAFT_OK) return NULL;
+
+    size_t off = log->head_offset + log->count;
+    raft_log_segment_t* seg = log_segment(log, off / SEG_ENTRIES);
+    if (out_seg) *out_seg = seg;
+    return &seg->slots[off % SEG_ENTRIES];
+}
+
+/* Fill in the entry header of the next slot and make it visible */
+static void log_commit_slot(raft_log_t* log, raft_log_slot_t* slot,
+                            uint64_t term, uint64_t* out_index) {
+    raft_entry_t* entry = &slot->entry;
+    entry->term = term;
+    entry->index = log->base_index + log->count + 1;
+    entry->type = RAFT_ENTRY_COMMAND;
+
+    log->count++;
+
+    if (out_index) *out_index = entry->index;
+}
+
 raft_status_t raft_log_append(raft_log_t* log, uint64_t term,
                               const char* command, size_t command_len,
                               uint64_t* out_index) {
     if (!log) return RAFT_INVALID_ARG;
 
-    if (log->count >= log->capacity) {
-        raft_status_t status = log_grow(log);
-        if (status != RAFT_OK) return status;
+    if (runs_note(log, log->base_index + log->count + 1, term) != RAFT_OK) {
+        return RAFT_NO_MEMORY;
     }
 
-    raft_entry_t* entry = &log->entries[log->count];
-    entry->term = term;
-    entry->index = log->base_index + log->count + 1;
+    raft_log_segment_t* seg;
+    raft_log_slot_t* slot = log_next_slot(log, &seg);
+    if (!slot) return RAFT_NO_MEMORY;
 
-    if (command && command_len > 0) {
-        entry->command = malloc(command_len);
-        if (!entry->command) return RAFT_NO_MEMORY;
-        memcpy(entry->command, command, command_len);
-        entry->command_len = command_len;
-    } else {
-        entry->command = NULL;
-        entry->command_len = 0;
+    if (slot_store_payload(log, seg, slot, command, command_len) != RAFT_OK) {
+        log_trim_tail(log);
+        return RAFT_NO_MEMORY;
     }
 
-    log->count++;
+    log_commit_slot(log, slot, term, out_index);
+    return RAFT_OK;
+}
 
-    if (out_index) *out_index = entry->index;
+raft_status_t raft_log_append_shared(raft_log_t* log, uint64_t term,
+                                     raft_buf_t* owner,
+                                     const char* command, size_t command_len,
+                                     uint64_t* out_index) {
+    if (!log || !owner) return RAFT_INVALID_ARG;
+
+    /* Copying a few bytes inline beats holding a reference */
+    if (command_len <= RAFT_LOG_INLINE_SIZE) {
+        return raft_log_append(log, term, command, command_len, out_index);
+    }
+
+    if (runs_note(log, log->base_index + log->count + 1, term) != RAFT_OK) {
+        return RAFT_NO_MEMORY;
+    }
+
+    raft_log_slot_t* slot = log_next_slot(log, NULL);
+    if (!slot) return RAFT_NO_MEMORY;
+
+    slot->kind = RAFT_PAYLOAD_SHARED;
+    slot->owner = raft_buf_ref(owner);
+    slot->entry.command = (char*)command;
+    slot->entry.command_len = command_len;
+    log->memory.resident_bytes += command_len;
+
+    log_commit_slot(log, slot, term, out_index);
+    return RAFT_OK;
+}
+
+raft_status_t raft_log_append_batch(raft_log_t* log,
+                                    const raft_entry_t* entries, size_t count,
+                                    uint64_t* out_first_index) {
+    if (!log || !entries || count == 0) return RAFT_INVALID_ARG;
+
+    uint64_t first_index = log->base_index + log->count + 1;
+    size_t saved_runs = log->run_count;
+
+    /* Note terms and size the shared payload block in one pass */
+    size_t block_len = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].command && entries[i].command_len > RAFT_LOG_INLINE_SIZE) {
+            block_len += entries[i].command_len;
+        }
+        if (runs_note(log, first_index + i, entries[i].term) != RAFT_OK) {
+            log->run_count = saved_runs;
+            return RAFT_NO_MEMORY;
+        }
+    }
+
+    raft_buf_t* block = NULL;
+    if (log_reserve(log, count) != RAFT_OK ||
+        (block_len > 0 && !(block = raft_buf_alloc(block_len)))) {
+        log_trim_tail(log);
+        log->run_count = saved_runs;
+        return RAFT_NO_MEMORY;
+    }
+
+    /* Nothing can fail from here on */
+    char* dst = block ? block->data : NULL;
+    for (size_t i = 0; i < count; i++) {
+        raft_log_slot_t* slot = log_slot(log, log->count);
+        const char* command = entries[i].command;
+        size_t command_len = command ? entries[i].command_len : 0;
+
+        if (command_len == 0) {
+            slot->kind = RAFT_PAYLOAD_NONE;
+            slot->entry.command = NULL;
+        } else if (command_len <= RAFT_LOG_INLINE_SIZE) {
+            slot->kind = RAFT_PAYLOAD_INLINE;
+            slot->entry.command = slot->inline_data;
+        } else {
+            slot->kind = RAFT_PAYLOAD_SHARED;
+            slot->owner = raft_buf_ref(block);
+            slot->entry.command = dst;
+            dst += command_len;
+            log->memory.resident_bytes += command_len;
+        }
+        if (command_len > 0) memcpy(slot->entry.command, command, command_len);
+        slot->entry.command_len = command_len;
+
+        log_commit_slot(log, slot, entries[i].term, NULL);
+    }
+    if (block) raft_buf_unref(block);
+
+    if (out_first_index) *out_first_index = first_index;
     return RAFT_OK;
 }
 
@@ -80,10 +505,14 @@ const raft_entry_t* raft_log_get(raft_log_t* log, uint64_t index) {
     if (!log || index == 0) return NULL;
     if (index <= log->base_index) return NULL;
 
-    size_t offset = index - log->base_index - 1;
-    if (offset >= log->count) return NULL;
+    uint64_t pos = index - log->base_index - 1;
+    if (pos >= log->count) return NULL;
 
-    return &log->entries[offset];
+    raft_log_slot_t* slot = log_slot(log, (size_t)pos);
+    if (slot->kind == RAFT_PAYLOAD_EVICTED && slot_reload(log, slot) != RAFT_OK) {
+        return NULL;
+    }
+    return &slot->entry;
 }
 
 raft_status_t raft_log_truncate_after(raft_log_t* log, uint64_t after_index) {
@@ -92,19 +521,43 @@ raft_status_t raft_log_truncate_after(raft_log_t* log, uint64_t after_index) {
     uint64_t last = raft_log_last_index(log);
     if (after_index >= last) return RAFT_OK;
 
-    /* Free entries being removed */
-    for (uint64_t i = after_index + 1; i <= last; i++) {
-        size_t offset = i - log->base_index - 1;
-        free(log->entries[offset].command);
-        log->entries[offset].command = NULL;
+    size_t keep = (after_index <= log->base_index) ?
+                  0 : (size_t)(after_index - log->base_index);
+
+    /* If the cut lands inside a surviving segment, find the first arena
+     * payload being dropped there so the arena can be rewound to it */
+    raft_log_segment_t* cut_seg = NULL;
+    const char* rewind_to = NULL;
+    size_t off = log->head_offset + keep;
+    if (keep > 0 && off % SEG_ENTRIES != 0) {
+        size_t seg_start = off - off % SEG_ENTRIES;
+        size_t live = log->head_offset + log->count - seg_start;
+        size_t stop = live < SEG_ENTRIES ? live : SEG_ENTRIES;
+        cut_seg = log_segment(log, off / SEG_ENTRIES);
+        for (size_t i = off % SEG_ENTRIES; i < stop; i++) {
+            if (cut_seg->slots[i].kind == RAFT_PAYLOAD_ARENA) {
+                rewind_to = cut_seg->slots[i].entry.command;
+                break;
+            }
+        }
     }
 
-    if (after_index <= log->base_index) {
-        log->count = 0;
-    } else {
-        log->count = after_index - log->base_index;
+    /* Free entries being removed */
+    log_free_commands(log, keep, log->count);
+    if (rewind_to) arena_rewind(log, cut_seg, rewind_to);
+
+    log->count = keep;
+    log_trim_tail(log);
+
+    /* Forget runs that started after the new end of the log */
+    uint64_t cut = log->base_index + keep;
+    while (log->run_count > 0 && log->runs[log->run_count - 1].first_index > cut) {
+        log->run_count--;
     }
 
+    if (log->evicted_index > cut) log->evicted_index = cut;
+    if (log->reload_low > cut) log->reload_low = 0;
+
     return RAFT_OK;
 }
 
@@ -118,28 +571,50 @@ raft_status_t raft_log_truncate_before(raft_log_t* log, uint64_t before_index) {
     }
 
     /* Save term of entry just before truncation point */
-    const raft_entry_t* prev_entry = raft_log_get(log, before_index - 1);
-    uint64_t new_base_term = prev_entry ? prev_entry->term : log->base_term;
-
-    /* Free entries being removed */
-    for (uint64_t i = log->base_index + 1; i < before_index; i++) {
-        size_t offset = i - log->base_index - 1;
-        free(log->entries[offset].command);
+    uint64_t new_base_term = raft_log_term_at(log, before_index - 1);
+
+    /* Free individually owned payloads; arena payloads go with their segment */
+    size_t entries_to_remove = (size_t)(before_index - log->base_index - 1);
+    log_free_commands(log, 0, entries_to_remove);
+
+    /* Drop segments that are now entirely in front of the head */
+    log->head_offset += entries_to_remove;
+    log->count -= entries_to_remove;
+    while (log->head_offset >= SEG_ENTRIES) {
+        segment_release(log, log_segment(log, 0));
+        log->seg_head = (log->seg_head + 1) & (log->seg_capacity - 1);
+        log->seg_count--;
+        log->head_offset -= SEG_ENTRIES;
     }
+    log_trim_tail(log);
 
-    /* Shift remaining entries */
-    size_t entries_to_remove = before_index - log->base_index - 1;
-    size_t remaining = log->count - entries_to_remove;
-
-    if (remaining > 0) {
-        memmove(log->entries, &log->entries[entries_to_remove],
-                remaining * sizeof(raft_entry_t));
-    }
-
-    log->count = remaining;
     log->base_index = before_index - 1;
     log->base_term = new_base_term;
 
+    if (log->evicted_index < log->base_index) log->evicted_index = log->base_index;
+    if (log->reload_low <= log->base_index) log->reload_low = 0;
+
+    return RAFT_OK;
+}
+
+raft_status_t raft_log_reset(raft_log_t* log, uint64_t base_index,
+                             uint64_t base_term) {
+    if (!log) return RAFT_INVALID_ARG;
+
+    log_free_commands(log, 0, log->count);
+    log->count = 0;
+    log_trim_tail(log);
+
+    log->base_index = base_index;
+    log->base_term = base_term;
+    log->evicted_index = base_index;
+    log->reload_low = 0;
+
+    /* Only the snapshot point itself is known after a reset */
+    log->run_count = 0;
+    if (base_index > 0) {
+        return runs_note(log, base_index, base_term);
+    }
     return RAFT_OK;
 }
 
@@ -150,17 +625,109 @@ uint64_t raft_log_last_index(raft_log_t* log) {
 
 uint64_t raft_log_last_term(raft_log_t* log) {
     if (!log || log->count == 0) return log ? log->base_term : 0;
-    return log->entries[log->count - 1].term;
+    return log_slot(log, log->count - 1)->entry.term;
 }
 
 uint64_t raft_log_term_at(raft_log_t* log, uint64_t index) {
     if (!log || index == 0) return 0;
     if (index == log->base_index) return log->base_term;
+    if (index > raft_log_last_index(log)) return 0;
+
+    size_t i = runs_find(log, index);
+    return i < log->run_count ? log->runs[i].term : 0;
+}
+
+uint64_t raft_log_first_index_of_term(raft_log_t* log, uint64_t term) {
+    if (!log || term == 0) return 0;
 
-    const raft_entry_t* entry = raft_log_get(log, index);
-    return entry ? entry->term : 0;
+    size_t i = runs_find_term(log, term);
+    return i < log->run_count ? log->runs[i].first_index : 0;
+}
+
+uint64_t raft_log_last_index_of_term(raft_log_t* log, uint64_t term) {
+    if (!log || term == 0) return 0;
+
+    size_t i = runs_find_term(log, term);
+    if (i == log->run_count) return 0;
+    if (i + 1 < log->run_count) return log->runs[i + 1].first_index - 1;
+    return raft_log_last_index(log);
+}
+
+const raft_term_run_t* raft_log_term_runs(raft_log_t* log, size_t* count) {
+    if (count) *count = log ? log->run_count : 0;
+    return log ? log->runs : NULL;
+}
+
+raft_status_t raft_log_restore_term_runs(raft_log_t* log,
+                                         const raft_term_run_t* runs,
+                                         size_t count) {
+    if (!log || (count > 0 && !runs)) return RAFT_INVALID_ARG;
+    if (log->count > 0) return RAFT_INVALID_ARG;
+
+    log->run_count = 0;
+    for (size_t i = 0; i < count && runs[i].first_index <= log->base_index; i++) {
+        if (runs_note(log, runs[i].first_index, runs[i].term) != RAFT_OK) {
+            return RAFT_NO_MEMORY;
+        }
+    }
+
+    /* The snapshot point always wins over older history */
+    if (log->base_index > 0) {
+        return runs_note(log, log->base_index, log->base_term);
+    }
+    return RAFT_OK;
 }
 
 size_t raft_log_count(raft_log_t* log) {
     return log ? log->count : 0;
 }
+
+void raft_log_set_loader(raft_log_t* log, raft_log_load_fn fn, void* ctx) {
+    if (!log) return;
+    log->load_fn = fn;
+    log->load_ctx = ctx;
+}
+
+raft_status_t raft_log_evict(raft_log_t* log, uint64_t upto_index,
+                             size_t budget) {
+    if (!log) return RAFT_INVALID_ARG;
+    if (!log->load_fn) return RAFT_OK;
+
+    uint64_t last = raft_log_last_index(log);
+    if (upto_index > last) upto_index = last;
+
+    /* Payloads read back for lagging readers go first */
+    if (log->reload_low > log->base_index) {
+        for (uint64_t index = log->reload_low; index <= log->evicted_index; index++) {
+            slot_evict(log, log_slot(log, (size_t)(index - log->base_index - 1)));
+        }
+    }
+    log->reload_low = 0;
+
+    if (log->evicted_index < log->base_index) log->evicted_index = log->base_index;
+    while (log->memory.resident_bytes > budget && log->evicted_index < upto_index) {
+        size_t pos = (size_t)(log->evicted_index - log->base_index);
+        raft_log_slot_t* slot = log_slot(log, pos);
+        slot_evict(log, slot);
+        log->evicted_index++;
+
+        /* Arena memory goes once its whole segment is evicted */
+        size_t off = log->head_offset + pos;
+        if (off % SEG_ENTRIES == SEG_ENTRIES - 1) {
+            raft_log_segment_t* seg = log_segment(log, off / SEG_ENTRIES);
+            log->memory.resident_bytes -= arena_bytes(seg);
+            arena_free(seg);
+        }
+    }
+
+    return RAFT_OK;
+}
+
+void raft_log_memory(raft_log_t* log, raft_log_memory_t* out) {
+    if (!out) return;
+    if (!log) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    *out = log->memory;
+}
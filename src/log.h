@@ -8,16 +8,112 @@
 #define RAFT_LOG_H
 
 #include "types.h"
+#include "param.h"
+#include "buf.h"
+
+/**
+ * Where a log slot keeps its command bytes
+ */
+typedef enum {
+    RAFT_PAYLOAD_NONE = 0,      /* No command */
+    RAFT_PAYLOAD_INLINE = 1,    /* In the slot itself */
+    RAFT_PAYLOAD_ARENA = 2,     /* Bump-allocated in the segment arena */
+    RAFT_PAYLOAD_HEAP = 3,      /* Individually malloc'd (large commands) */
+    RAFT_PAYLOAD_SHARED = 4,    /* Inside a referenced raft_buf_t */
+    RAFT_PAYLOAD_EVICTED = 5,   /* Dropped from memory, reloaded on demand */
+} raft_payload_kind_t;
+
+/**
+ * Callback that re-reads an evicted payload (e.g. from the WAL)
+ * Must return a malloc'd copy of the command written at index in term;
+ * the log takes ownership of it.
+ */
+typedef raft_status_t (*raft_log_load_fn)(void* ctx, uint64_t index,
+                                          uint64_t term, char** command,
+                                          size_t* command_len);
+
+/**
+ * Payload memory statistics
+ */
+typedef struct raft_log_memory {
+    size_t resident_bytes;  /* Payload bytes held in memory (arena chunks,
+                               heap and shared payloads; not inline) */
+    size_t evicted_bytes;   /* Payload bytes currently evicted */
+    uint64_t evictions;     /* Payloads evicted so far */
+    uint64_t reloads;       /* Evicted payloads read back so far */
+} raft_log_memory_t;
+
+/**
+ * Log slot - an entry plus its payload bookkeeping
+ * entry.command points at inline_data, the segment arena, the heap,
+ * or into the shared buffer held in owner.
+ */
+typedef struct raft_log_slot {
+    raft_entry_t entry;
+    raft_payload_kind_t kind;
+    union {
+        char inline_data[RAFT_LOG_INLINE_SIZE];
+        raft_buf_t* owner;      /* Reference held for RAFT_PAYLOAD_SHARED */
+    };
+} raft_log_slot_t;
+
+/**
+ * Payload arena chunk (RAFT_LOG_ARENA_CHUNK_SIZE bytes of data)
+ * Chunks are pushed newest first, so allocation order matches list
+ * order and tail truncation can rewind the arena.
+ */
+typedef struct raft_arena_chunk {
+    struct raft_arena_chunk* next;  /* Older chunk */
+    size_t used;                    /* Bytes handed out from data */
+    char data[];
+} raft_arena_chunk_t;
+
+/**
+ * Log segment - a fixed-size chunk of entries
+ *
+ * Segments never move once allocated, so appends never copy existing
+ * entries and entry pointers stay valid until the entry is removed.
+ * Payloads that do not fit inline are bump-allocated from the segment's
+ * arena and released in bulk with the segment.
+ */
+typedef struct raft_log_segment {
+    raft_arena_chunk_t* arena;  /* Newest arena chunk (NULL if none) */
+    raft_log_slot_t slots[RAFT_LOG_SEGMENT_ENTRIES];
+} raft_log_segment_t;
 
 /**
  * Raft log structure
+ *
+ * Entries live in a ring of segments. Position p (0-based from
+ * base_index + 1) is found at offset head_offset + p counted from the
+ * first segment, so lookups stay O(1) and prefix truncation only
+ * releases whole segments.
+ *
+ * Terms are also tracked as a sorted list of runs that survives
+ * compaction, so term lookups never touch entries and still work for
+ * indexes that have been compacted away.
+ *
+ * Payloads of entries up to evicted_index may have been dropped to stay
+ * within a memory budget; raft_log_get reads them back through load_fn.
  */
 struct raft_log {
-    raft_entry_t* entries;  /* Array of log entries */
-    size_t capacity;        /* Allocated capacity */
+    raft_log_segment_t** segments;  /* Ring of segment pointers */
+    size_t seg_capacity;    /* Slots in the segment ring (power of two) */
+    size_t seg_head;        /* Ring slot of the first segment */
+    size_t seg_count;       /* Number of segments in use */
+    size_t head_offset;     /* Offset of first entry in first segment */
+    raft_log_segment_t* spare;  /* Cached free segment for reuse */
     size_t count;           /* Number of entries */
+    raft_term_run_t* runs;  /* Term runs, sorted by first_index */
+    size_t run_count;       /* Number of term runs */
+    size_t run_capacity;    /* Allocated term runs */
     uint64_t base_index;    /* Index of first entry (for compaction) */
     uint64_t base_term;     /* Term of entry before base_index */
+    raft_log_memory_t memory;   /* Payload memory accounting */
+    uint64_t evicted_index; /* Payloads up to here have been evicted */
+    uint64_t reload_low;    /* Lowest reloaded index behind evicted_index (0 if none) */
+    raft_log_load_fn load_fn;   /* Reads evicted payloads back (NULL = never evict) */
+    void* load_ctx;         /* Context for load_fn */
 };
 
 /**
@@ -38,9 +134,33 @@ raft_status_t raft_log_append(raft_log_t* log, uint64_t term,
                               const char* command, size_t command_len,
                               uint64_t* out_index);
 
+/**
+ * Append an entry whose command lives in a shared buffer
+ * The log takes its own reference to owner instead of copying, unless
+ * the command is small enough to be stored inline.
+ * command must point into owner's data.
+ */
+raft_status_t raft_log_append_shared(raft_log_t* log, uint64_t term,
+                                     raft_buf_t* owner,
+                                     const char* command, size_t command_len,
+                                     uint64_t* out_index);
+
+/**
+ * Append several entries at once
+ * Slots for all entries are reserved up front and every payload too large
+ * to store inline is copied into one shared block, so the batch costs a
+ * single payload allocation. Each entry's term, command and command_len
+ * are used; indexes are assigned from *out_first_index on. Either all
+ * entries are appended or none are.
+ */
+raft_status_t raft_log_append_batch(raft_log_t* log,
+                                    const raft_entry_t* entries, size_t count,
+                                    uint64_t* out_first_index);
+
 /**
  * Get an entry by index (1-based)
- * Returns NULL if index is out of range
+ * An evicted payload is read back through the log's loader first.
+ * Returns NULL if index is out of range or the payload cannot be loaded
  */
 const raft_entry_t* raft_log_get(raft_log_t* log, uint64_t index);
 
@@ -57,6 +177,13 @@ raft_status_t raft_log_truncate_after(raft_log_t* log, uint64_t after_index);
  */
 raft_status_t raft_log_truncate_before(raft_log_t* log, uint64_t before_index);
 
+/**
+ * Discard all entries and restart the log after base_index
+ * Used when installing a snapshot or recovering from one
+ */
+raft_status_t raft_log_reset(raft_log_t* log, uint64_t base_index,
+                             uint64_t base_term);
+
 /**
  * Get the index of the last entry (0 if empty)
  */
@@ -69,12 +196,58 @@ uint64_t raft_log_last_term(raft_log_t* log);
 
 /**
  * Get the term of entry at given index (0 if not found)
+ * Answered from the term runs in O(log terms), including for indexes
+ * that have been compacted into a snapshot.
  */
 uint64_t raft_log_term_at(raft_log_t* log, uint64_t index);
 
+/**
+ * Get the first known index written in term (0 if none)
+ */
+uint64_t raft_log_first_index_of_term(raft_log_t* log, uint64_t term);
+
+/**
+ * Get the last index written in term (0 if none)
+ */
+uint64_t raft_log_last_index_of_term(raft_log_t* log, uint64_t term);
+
+/**
+ * Get the term runs (for persistence)
+ */
+const raft_term_run_t* raft_log_term_runs(raft_log_t* log, size_t* count);
+
+/**
+ * Restore term runs for the compacted prefix of an empty log
+ * Runs past base_index are ignored; they are rebuilt as entries are
+ * appended.
+ */
+raft_status_t raft_log_restore_term_runs(raft_log_t* log,
+                                         const raft_term_run_t* runs,
+                                         size_t count);
+
 /**
  * Get number of entries in log
  */
 size_t raft_log_count(raft_log_t* log);
 
+/**
+ * Set the callback used to read evicted payloads back
+ * Eviction is disabled until a loader is set.
+ */
+void raft_log_set_loader(raft_log_t* log, raft_log_load_fn fn, void* ctx);
+
+/**
+ * Evict payloads of entries up to upto_index, oldest first, until
+ * resident payload bytes fit in budget
+ * Payloads reloaded since the last call are evicted again. Arena
+ * memory is released once every payload in its segment is evicted.
+ */
+raft_status_t raft_log_evict(raft_log_t* log, uint64_t upto_index,
+                             size_t budget);
+
+/**
+ * Get payload memory statistics
+ */
+void raft_log_memory(raft_log_t* log, raft_log_memory_t* out);
+
 #endif /* RAFT_LOG_H */
@@ -0,0 +1,225 @@
+/**
+ * lz.c - LZ77 block compression implementation
+ *
+ * Each sequence starts with a token byte: literal count in the high
+ * nibble, match length minus LZ_MIN_MATCH in the low one. A nibble of 15
+ * is continued by bytes that are added on, up to and including the
+ * first that is not 255. The literals follow, then the match offset as
+ * two little-endian bytes and the match length's continuation. The last
+ * sequence stops after its literals; running out of input there is what
+ * ends the block.
+ *
+ * Matches are found through a hash table of the last position each
+ * 4-byte prefix was seen at, one probe per position. Where nothing has
+ * matched for a while the scan takes growing steps, so incompressible
+ * data goes through quickly.
+ */
+
+#include "lz.h"
+#include <string.h>
+
+#define LZ_MIN_MATCH    4
+#define LZ_MAX_OFFSET   65535
+#define LZ_HASH_LOG     14
+#define LZ_SKIP_SHIFT   6       /* Step grows by one every 64 misses */
+
+static uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t read64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t hash4(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_LOG);
+}
+
+size_t raft_lz_bound(size_t len) {
+    return len + len / 255 + 16;
+}
+
+/* A nibble's continuation bytes */
+static uint8_t* put_length(uint8_t* op, size_t n) {
+    while (n >= 255) {
+        *op++ = 255;
+        n -= 255;
+    }
+    *op++ = (uint8_t)n;
+    return op;
+}
+
+/* Append one sequence; match_len 0 makes it the last. NULL if it would
+ * not fit before oend */
+static uint8_t* put_sequence(uint8_t* op, uint8_t* oend, const uint8_t* literals,
+                             size_t lit_len, size_t offset, size_t match_len) {
+    size_t extra = match_len > 0 ? match_len - LZ_MIN_MATCH : 0;
+    size_t worst = 1 + lit_len / 255 + 1 + lit_len + 2 + extra / 255 + 1;
+    if (worst > (size_t)(oend - op)) return NULL;
+
+    uint8_t* token = op++;
+    *token = (uint8_t)((lit_len < 15 ? lit_len : 15) << 4);
+    if (lit_len >= 15) op = put_length(op, lit_len - 15);
+    memcpy(op, literals, lit_len);
+    op += lit_len;
+    if (match_len == 0) return op;
+
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+    *token |= (uint8_t)(extra < 15 ? extra : 15);
+    if (extra >= 15) op = put_length(op, extra - 15);
+    return op;
+}
+
+size_t raft_lz_compress(const void* src, size_t len, void* dst, size_t cap) {
+    const uint8_t* in = src;
+    const uint8_t* end = in + len;
+    const uint8_t* ip = in;
+    const uint8_t* anchor = in;
+    uint8_t* op = dst;
+    uint8_t* oend = op + cap;
+    uint32_t table[1 << LZ_HASH_LOG];
+    memset(table, 0, sizeof(table));
+
+    size_t misses = 0;
+    while (len >= LZ_MIN_MATCH && ip <= end - LZ_MIN_MATCH) {
+        uint32_t seq = read32(ip);
+        uint32_t h = hash4(seq);
+        const uint8_t* ref = in + table[h];
+        table[h] = (uint32_t)(ip - in);
+        if (ref >= ip || ip - ref > LZ_MAX_OFFSET || read32(ref) != seq) {
+            ip += 1 + (misses++ >> LZ_SKIP_SHIFT);
+            continue;
+        }
+        misses = 0;
+
+        /* Grow the match back into the literals, then forward */
+        while (ip > anchor && ref > in && ip[-1] == ref[-1]) {
+            ip--;
+            ref--;
+        }
+        const uint8_t* mp = ip + LZ_MIN_MATCH;
+        const uint8_t* rp = ref + LZ_MIN_MATCH;
+        while (mp + 8 <= end && read64(mp) == read64(rp)) {
+            mp += 8;
+            rp += 8;
+        }
+        while (mp < end && *mp == *rp) {
+            mp++;
+            rp++;
+        }
+
+        op = put_sequence(op, oend, anchor, (size_t)(ip - anchor), (size_t)(ip - ref),
+                          (size_t)(mp - ip));
+        if (!op) return 0;
+        ip = mp;
+        anchor = ip;
+        if (ip - 2 > in && ip <= end - LZ_MIN_MATCH) {
+            table[hash4(read32(ip - 2))] = (uint32_t)(ip - 2 - in);
+        }
+    }
+
+    op = put_sequence(op, oend, anchor, (size_t)(end - anchor), 0, 0);
+    return op ? (size_t)(op - (uint8_t*)dst) : 0;
+}
+
+/* Add a nibble's continuation bytes to *n */
+static bool get_length(const uint8_t** ip, const uint8_t* iend, size_t* n) {
+    uint8_t b;
+    do {
+        if (*ip >= iend) return false;
+        b = *(*ip)++;
+        *n += b;
+    } while (b == 255);
+    return true;
+}
+
+raft_status_t raft_lz_decompress(const void* src, size_t len, void* dst, size_t cap,
+                                 size_t* out_len) {
+    const uint8_t* ip = src;
+    const uint8_t* iend = ip + len;
+    uint8_t* start = dst;
+    uint8_t* op = start;
+    uint8_t* oend = op + cap;
+
+    for (;;) {
+        if (ip >= iend) return RAFT_CORRUPTION;
+        uint8_t token = *ip++;
+
+        size_t lit_len = token >> 4;
+
+        /* Common case: neither length continued and room in both buffers
+         * for whole-word copies, which may run past what is needed.
+         * Enough input follows that this is not the last sequence */
+        if (lit_len < 15 && (token & 15) < 15 && iend - ip >= 32 && oend - op >= 48) {
+            memcpy(op, ip, 16);
+            op += lit_len;
+            ip += lit_len;
+            size_t offset = (size_t)ip[0] | (size_t)ip[1] << 8;
+            ip += 2;
+            if (offset == 0 || offset > (size_t)(op - start)) return RAFT_CORRUPTION;
+            size_t match_len = (size_t)(token & 15) + LZ_MIN_MATCH;
+            const uint8_t* ref = op - offset;
+            if (offset >= 8) {
+                memcpy(op, ref, 8);
+                memcpy(op + 8, ref + 8, 8);
+                memcpy(op + 16, ref + 16, 8);
+                op += match_len;
+            } else {
+                uint8_t* mend = op + match_len;
+                while (op < mend) *op++ = *ref++;
+            }
+            continue;
+        }
+
+        if (lit_len == 15 && !get_length(&ip, iend, &lit_len)) return RAFT_CORRUPTION;
+        if (lit_len > (size_t)(iend - ip) || lit_len > (size_t)(oend - op)) {
+            return RAFT_CORRUPTION;
+        }
+        /* Short runs with room behind them are copied a whole 16 bytes */
+        if (lit_len <= 16 && iend - ip >= 16 && oend - op >= 16) {
+            memcpy(op, ip, 16);
+        } else {
+            memcpy(op, ip, lit_len);
+        }
+        op += lit_len;
+        ip += lit_len;
+        if (ip == iend) break;
+
+        if (iend - ip < 2) return RAFT_CORRUPTION;
+        size_t offset = (size_t)ip[0] | (size_t)ip[1] << 8;
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - start)) return RAFT_CORRUPTION;
+
+        size_t match_len = token & 15;
+        if (match_len == 15 && !get_length(&ip, iend, &match_len)) return RAFT_CORRUPTION;
+        match_len += LZ_MIN_MATCH;
+        if (match_len > (size_t)(oend - op)) return RAFT_CORRUPTION;
+
+        /* A match may overlap its own output (a repeated run); copy in
+         * steps no longer than the offset, running up to 7 bytes past
+         * the match where the buffer has room */
+        const uint8_t* ref = op - offset;
+        uint8_t* mend = op + match_len;
+        if (offset >= 8 && (size_t)(oend - op) >= match_len + 8) {
+            do {
+                memcpy(op, ref, 8);
+                op += 8;
+                ref += 8;
+            } while (op < mend);
+            op = mend;
+        } else if (offset >= match_len) {
+            memcpy(op, ref, match_len);
+            op = mend;
+        } else {
+            while (op < mend) *op++ = *ref++;
+        }
+    }
+
+    *out_len = (size_t)(op - start);
+    return RAFT_OK;
+}
@@ -0,0 +1,38 @@
+/**
+ * lz.h - LZ77 block compression for snapshot state
+ *
+ * A small byte-oriented codec in the LZ4 family: a block is a run of
+ * sequences, each some literal bytes followed by a copy of earlier
+ * output up to 64 KB back. Blocks are independent of each other, so a
+ * writer can compress them on several threads and a reader decompress
+ * them one at a time as they arrive. Decompression checks every length
+ * and offset against both buffers, so damaged input fails cleanly.
+ */
+
+#ifndef RAFT_LZ_H
+#define RAFT_LZ_H
+
+#include "types.h"
+
+/**
+ * Largest compressed size of len bytes
+ */
+size_t raft_lz_bound(size_t len);
+
+/**
+ * Compress a block
+ * @return Compressed length, or 0 if it does not fit in cap; passing a
+ *         cap below len keeps only output that is actually smaller
+ */
+size_t raft_lz_compress(const void* src, size_t len, void* dst, size_t cap);
+
+/**
+ * Decompress a block
+ * @param out_len Output: bytes written to dst
+ * @return RAFT_OK, or RAFT_CORRUPTION if src is not a valid block or
+ *         decompresses to more than cap bytes
+ */
+raft_status_t raft_lz_decompress(const void* src, size_t len, void* dst, size_t cap,
+                                 size_t* out_len);
+
+#endif /* RAFT_LZ_H */
@@ -20,8 +20,43 @@
 /* Maximum log entries before compaction */
 #define RAFT_LOG_COMPACTION_THRESHOLD 10000
 
-/* Initial log capacity */
-#define RAFT_LOG_INITIAL_CAPACITY     64
+/* Entries per log segment (must be a power of two) */
+#define RAFT_LOG_SEGMENT_ENTRIES      1024
+
+/* Initial number of slots in the log's segment ring (must be a power of two) */
+#define RAFT_LOG_INITIAL_SEGMENTS     16
+
+/* Commands up to this size are stored inline in the log slot */
+#define RAFT_LOG_INLINE_SIZE          80
+
+/* Size of each payload arena chunk owned by a log segment */
+#define RAFT_LOG_ARENA_CHUNK_SIZE     (64 * 1024)
+
+/* Preallocated size of each WAL segment file */
+#define RAFT_WAL_SEGMENT_SIZE         (8 * 1024 * 1024)
+
+/* Dropped WAL segments kept on disk for reuse instead of being deleted */
+#define RAFT_WAL_SPARE_SEGMENTS       2
+
+/* Operations the io_uring WAL backend can have queued at once */
+#define RAFT_WAL_URING_DEPTH          256
+
+/* Size of each of the two term/vote slots in raft_state.dat; one
+ * sector, so writing one slot never disturbs the other */
+#define RAFT_STATE_SLOT_SIZE          512
+
+/* Address space reserved for the mmap backend's log file; the file
+ * cannot grow past it */
+#define RAFT_MMAP_RESERVE_SIZE        ((size_t)16 << 30)
+
+/* Step by which the mmap backend extends and maps its log file */
+#define RAFT_MMAP_GROW_SIZE           (4 * 1024 * 1024)
+
+/* Threads verifying WAL records during recovery (0 = one per online CPU) */
+#define RAFT_RECOVERY_THREADS         0
+
+/* Records per CRC verification task during recovery */
+#define RAFT_RECOVERY_TASK_RECORDS    4096
 
 /* Maximum command size in bytes */
 #define RAFT_MAX_COMMAND_SIZE         (1024 * 1024)
@@ -29,7 +64,62 @@
 /* PreVote enabled by default (Phase 6) */
 #define RAFT_PREVOTE_ENABLED          1
 
+/* Snapshot writer staging buffer; larger chunks are written directly */
+#define RAFT_SNAPSHOT_BUFFER_SIZE     (256 * 1024)
+
+/* Snapshot bytes written before writeback of them is started, so the
+ * final fsync does not have the whole file to flush */
+#define RAFT_SNAPSHOT_WRITEBACK_BYTES (8 * 1024 * 1024)
+
+/* Snapshot bytes per InstallSnapshot chunk */
+#define RAFT_SNAPSHOT_CHUNK_SIZE      (256 * 1024)
+
+/* InstallSnapshot chunks a leader sends ahead of the follower's ack */
+#define RAFT_SNAPSHOT_MAX_INFLIGHT    8
+
+/* Runs of a snapshot a follower can hold past a gap while receiving it;
+ * a chunk that would need another is dropped and sent again */
+#define RAFT_SNAPSHOT_RECV_RANGES     32
+
+/* Snapshot state compressed as one independent block (RAFT_SNAPSHOT_CODEC_LZ) */
+#define RAFT_SNAPSHOT_BLOCK_SIZE      (256 * 1024)
+
+/* Threads compressing snapshot blocks (0 = one per online CPU) */
+#define RAFT_SNAPSHOT_COMPRESS_THREADS 0
+
 /* Auto compaction threshold (entries since last snapshot) */
 #define RAFT_AUTO_COMPACTION_THRESHOLD 1000
 
+/* Log payload bytes that make auto-compaction due, however few entries */
+#define RAFT_COMPACT_LOG_BYTES        (64 * 1024 * 1024)
+
+/* Resident log payload bytes that force auto-compaction, whatever the load */
+#define RAFT_COMPACT_MEMORY_BUDGET    ((size_t)256 << 20)
+
+/* Bytes of log held by the storage backend that force auto-compaction */
+#define RAFT_COMPACT_DISK_BUDGET      ((uint64_t)1 << 30)
+
+/* Period over which the rate of appended entries is sampled */
+#define RAFT_COMPACT_RATE_WINDOW_MS   100
+
+/* Samples the recent and the long-run entry rates are smoothed over */
+#define RAFT_COMPACT_FAST_WINDOWS     2
+#define RAFT_COMPACT_SLOW_WINDOWS     64
+
+/* A burst: a recent rate of at least RAFT_COMPACT_BURST_RATE entries/s
+ * and RAFT_COMPACT_BURST_FACTOR times the long-run rate */
+#define RAFT_COMPACT_BURST_RATE       1000
+#define RAFT_COMPACT_BURST_FACTOR     2
+
+/* Snapshots expected to take less than this are not deferred */
+#define RAFT_COMPACT_CHEAP_US         1000
+
+/* Multiple of the entry and byte triggers at which a deferred
+ * compaction is forced */
+#define RAFT_COMPACT_MAX_DEFER        4
+
+/* Deltas auto-compaction chains on a base before writing a full
+ * snapshot again */
+#define RAFT_SNAPSHOT_MAX_DELTAS      16
+
 #endif /* RAFT_PARAM_H */
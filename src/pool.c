@@ -0,0 +1,125 @@
+/**
+ * pool.c - Fixed-size worker thread pool implementation
+ *
+ * One batch runs at a time. Tasks are claimed under the pool lock, so
+ * each should be coarse enough that the lock is not the bottleneck.
+ */
+
+#include "pool.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+struct raft_pool {
+    pthread_t* workers;
+    size_t worker_count;
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;   /* A batch was posted or the pool stops */
+    pthread_cond_t work_done;    /* The last task of a batch finished */
+    raft_pool_task_fn fn;
+    void* ctx;
+    size_t next_task;            /* Next task to hand out */
+    size_t task_count;           /* Tasks in the current batch */
+    size_t tasks_done;
+    bool stopping;
+};
+
+/* Claim and run tasks until the batch is handed out; lock is held on
+ * entry and exit */
+static void run_tasks(raft_pool_t* pool) {
+    while (pool->next_task < pool->task_count) {
+        size_t task = pool->next_task++;
+        pthread_mutex_unlock(&pool->lock);
+        pool->fn(pool->ctx, task);
+        pthread_mutex_lock(&pool->lock);
+        if (++pool->tasks_done == pool->task_count) {
+            pthread_cond_signal(&pool->work_done);
+        }
+    }
+}
+
+static void* worker_main(void* arg) {
+    raft_pool_t* pool = (raft_pool_t*)arg;
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stopping) {
+        run_tasks(pool);
+        if (pool->stopping) break;
+        pthread_cond_wait(&pool->work_ready, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+raft_pool_t* raft_pool_create(size_t threads) {
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (size_t)cpus : 1;
+    }
+
+    raft_pool_t* pool = calloc(1, sizeof(raft_pool_t));
+    if (!pool) return NULL;
+    pool->workers = calloc(threads, sizeof(pthread_t));
+    if (!pool->workers) {
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+
+    /* Fewer workers than asked for still makes a working pool */
+    for (size_t i = 0; i + 1 < threads; i++) {
+        if (pthread_create(&pool->workers[pool->worker_count], NULL,
+                           worker_main, pool) != 0) {
+            break;
+        }
+        pool->worker_count++;
+    }
+    return pool;
+}
+
+void raft_pool_destroy(raft_pool_t* pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = 0; i < pool->worker_count; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->work_done);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+}
+
+size_t raft_pool_threads(raft_pool_t* pool) {
+    return pool ? pool->worker_count + 1 : 1;
+}
+
+void raft_pool_run(raft_pool_t* pool, raft_pool_task_fn fn, void* ctx, size_t count) {
+    if (count == 0) return;
+    if (!pool || pool->worker_count == 0) {
+        for (size_t i = 0; i < count; i++) fn(ctx, i);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->next_task = 0;
+    pool->task_count = count;
+    pool->tasks_done = 0;
+    pthread_cond_broadcast(&pool->work_ready);
+
+    run_tasks(pool);
+    while (pool->tasks_done < pool->task_count) {
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+    pool->task_count = 0;
+    pool->next_task = 0;
+    pthread_mutex_unlock(&pool->lock);
+}
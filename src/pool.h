@@ -0,0 +1,46 @@
+/**
+ * pool.h - Fixed-size worker thread pool
+ *
+ * Runs a batch of independent tasks across a set of worker threads and
+ * the calling thread, returning once all of them are done. Used where
+ * work splits cleanly into chunks, such as verifying WAL records at
+ * recovery; task functions must not touch node state.
+ */
+
+#ifndef RAFT_POOL_H
+#define RAFT_POOL_H
+
+#include "types.h"
+
+typedef struct raft_pool raft_pool_t;
+
+/**
+ * Task callback, called once for each task index in the batch
+ */
+typedef void (*raft_pool_task_fn)(void* ctx, size_t task);
+
+/**
+ * Create a pool that runs tasks on threads threads in all
+ * The caller counts as one of them, so threads - 1 workers are started;
+ * 0 means one per online CPU.
+ * @return Pool or NULL on failure
+ */
+raft_pool_t* raft_pool_create(size_t threads);
+
+/**
+ * Stop and join the workers
+ */
+void raft_pool_destroy(raft_pool_t* pool);
+
+/**
+ * Number of threads tasks run on, the caller included
+ */
+size_t raft_pool_threads(raft_pool_t* pool);
+
+/**
+ * Run fn(ctx, 0) .. fn(ctx, count - 1) and wait for all of them
+ * Tasks are handed out in order but may finish in any order.
+ */
+void raft_pool_run(raft_pool_t* pool, raft_pool_task_fn fn, void* ctx, size_t count);
+
+#endif /* RAFT_POOL_H */
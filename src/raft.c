@@ -3,6 +3,7 @@
  */
 
 #include "raft.h"
+#include "rpc.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -12,9 +13,23 @@ __attribute__((weak)) raft_status_t raft_replicate_log(raft_node_t* node) {
     return RAFT_OK;
 }
 
+__attribute__((weak)) raft_status_t raft_advance_commit_index(raft_node_t* node) {
+    (void)node;
+    return RAFT_OK;
+}
+
 /* Storage functions - weak symbols for Phase 4+ */
-__attribute__((weak)) raft_storage_t* raft_storage_open(const char* data_dir, bool sync_writes) {
-    (void)data_dir; (void)sync_writes;
+__attribute__((weak)) const raft_storage_ops_t* raft_storage_backend_ops(
+    raft_storage_backend_t backend) {
+    (void)backend;
+    return NULL;
+}
+
+__attribute__((weak)) raft_storage_t* raft_storage_open_ops(const raft_storage_ops_t* ops,
+                                                             const char* data_dir,
+                                                             bool sync_writes,
+                                                             raft_io_backend_t io_backend) {
+    (void)ops; (void)data_dir; (void)sync_writes; (void)io_backend;
     return NULL;
 }
 
@@ -22,6 +37,116 @@ __attribute__((weak)) void raft_storage_close(raft_storage_t* storage) {
     (void)storage;
 }
 
+__attribute__((weak)) raft_status_t raft_storage_append_entry(raft_storage_t* storage,
+                                                               const raft_entry_t* entry) {
+    (void)storage; (void)entry;
+    return RAFT_OK;
+}
+
+__attribute__((weak)) raft_status_t raft_storage_append_entries(raft_storage_t* storage,
+                                                                 const raft_entry_t* entries,
+                                                                 size_t count) {
+    (void)storage; (void)entries; (void)count;
+    return RAFT_OK;
+}
+
+__attribute__((weak)) raft_status_t raft_storage_truncate_log(raft_storage_t* storage,
+                                                               uint64_t after_index) {
+    (void)storage; (void)after_index;
+    return RAFT_OK;
+}
+
+__attribute__((weak)) raft_status_t raft_storage_read_entry(raft_storage_t* storage,
+                                                              uint64_t index,
+                                                              raft_entry_t* out) {
+    (void)storage; (void)index; (void)out;
+    return RAFT_NOT_FOUND;
+}
+
+__attribute__((weak)) raft_status_t raft_storage_set_group_commit(raft_storage_t* storage,
+                                                                   uint64_t window_us) {
+    (void)storage; (void)window_us;
+    return RAFT_OK;
+}
+
+__attribute__((weak)) raft_status_t raft_storage_set_recovery_threads(raft_storage_t* storage,
+                                                                       size_t threads) {
+    (void)storage; (void)threads;
+    return RAFT_OK;
+}
+
+__attribute__((weak)) raft_status_t raft_storage_set_sync_policy(raft_storage_t* storage,
+                                                                 raft_sync_policy_t policy,
+                                                                 uint64_t interval_us,
+                                                                 uint64_t interval_bytes) {
+    (void)storage; (void)policy; (void)interval_us; (void)interval_bytes;
+    return RAFT_OK;
+}
+
+__attribute__((weak)) raft_status_t raft_storage_sync_if_due(raft_storage_t* storage) {
+    (void)storage;
+    return RAFT_OK;
+}
+
+__attribute__((weak)) raft_status_t raft_storage_sync_for_ack(raft_storage_t* storage) {
+    (void)storage;
+    return RAFT_OK;
+}
+
+__attribute__((weak)) raft_status_t raft_storage_poll(raft_storage_t* storage) {
+    (void)storage;
+    return RAFT_OK;
+}
+
+__attribute__((weak)) uint64_t raft_storage_durable_index(raft_storage_t* storage) {
+    (void)storage;
+    return UINT64_MAX;
+}
+
+/* Snapshot transfer - weak symbols for Phase 5+ */
+__attribute__((weak)) raft_status_t raft_install_snapshot_send(raft_node_t* node,
+                                                                int32_t peer_id) {
+    (void)node; (void)peer_id;
+    return RAFT_NOT_FOUND;
+}
+
+__attribute__((weak)) void raft_install_snapshot_heartbeat(raft_node_t* node) {
+    (void)node;
+}
+
+__attribute__((weak)) raft_status_t raft_handle_install_snapshot(
+    raft_node_t* node, const void* msg, size_t msg_len,
+    raft_install_snapshot_response_t* response) {
+    (void)node; (void)msg; (void)msg_len; (void)response;
+    return RAFT_INVALID_ARG;
+}
+
+__attribute__((weak)) raft_status_t raft_handle_install_snapshot_response(
+    raft_node_t* node, int32_t from_node,
+    const raft_install_snapshot_response_t* response) {
+    (void)node; (void)from_node; (void)response;
+    return RAFT_INVALID_ARG;
+}
+
+__attribute__((weak)) void raft_install_snapshot_reset(raft_node_t* node) {
+    (void)node;
+}
+
+/* Background snapshots - weak symbols for Phase 4+ */
+__attribute__((weak)) raft_status_t raft_snapshot_poll(raft_node_t* node) {
+    (void)node;
+    return RAFT_OK;
+}
+
+__attribute__((weak)) raft_status_t raft_snapshot_wait(raft_node_t* node) {
+    (void)node;
+    return RAFT_OK;
+}
+
+__attribute__((weak)) void raft_compact_tick(raft_node_t* node, uint64_t elapsed_ms) {
+    (void)node; (void)elapsed_ms;
+}
+
 __attribute__((weak)) raft_status_t raft_recover(raft_node_t* node,
                                                   raft_storage_t* storage,
                                                   void* result) {
@@ -29,6 +154,24 @@ __attribute__((weak)) raft_status_t raft_recover(raft_node_t* node,
     return RAFT_OK;
 }
 
+/* Read an evicted payload back from the WAL */
+static raft_status_t load_payload(void* ctx, uint64_t index, uint64_t term,
+                                  char** command, size_t* command_len) {
+    raft_node_t* node = (raft_node_t*)ctx;
+    raft_entry_t entry;
+
+    raft_status_t status = raft_storage_read_entry(node->storage, index, &entry);
+    if (status != RAFT_OK) return status;
+    if (entry.term != term) {
+        free(entry.command);
+        return RAFT_CORRUPTION;
+    }
+
+    *command = entry.command;
+    *command_len = entry.command_len;
+    return RAFT_OK;
+}
+
 raft_node_t* raft_create(const raft_config_t* config) {
     if (!config || config->node_id < 0 || config->num_nodes < 1) {
         return NULL;
@@ -41,6 +184,7 @@ raft_node_t* raft_create(const raft_config_t* config) {
     node->num_nodes = config->num_nodes;
     node->apply_fn = config->apply_fn;
     node->send_fn = config->send_fn;
+    node->sendv_fn = config->sendv_fn;
     node->user_data = config->user_data;
 
     node->role = RAFT_FOLLOWER;
@@ -79,6 +223,14 @@ raft_node_t* raft_create(const raft_config_t* config) {
     /* Persistence (Phase 4+) */
     node->storage = NULL;
     node->data_dir = NULL;
+    node->log_memory_budget = config->log_memory_budget;
+
+    /* Snapshot transfer (Phase 5+) */
+    node->snapshot_chunk_size = config->snapshot_chunk_size;
+    node->snapshot_max_inflight = config->snapshot_max_inflight;
+    node->install = NULL;
+    node->compact.memory_budget = config->compaction_memory_budget;
+    node->compact.disk_budget = config->compaction_disk_budget;
 
     if (config->data_dir) {
         node->data_dir = strdup(config->data_dir);
@@ -89,10 +241,20 @@ raft_node_t* raft_create(const raft_config_t* config) {
             return NULL;
         }
 
-        node->storage = raft_storage_open(config->data_dir, true);
+        const raft_storage_ops_t* ops = config->storage_ops;
+        if (!ops) ops = raft_storage_backend_ops(config->storage_backend);
+        node->storage = raft_storage_open_ops(ops, config->data_dir,
+                                              config->sync_policy != RAFT_SYNC_NONE,
+                                              config->io_backend);
         if (node->storage) {
             /* Recover state from storage */
+            raft_storage_set_recovery_threads(node->storage, config->recovery_threads);
             raft_recover(node, node->storage, NULL);
+            raft_log_set_loader(node->log, load_payload, node);
+            raft_storage_set_group_commit(node->storage, config->group_commit_us);
+            raft_storage_set_sync_policy(node->storage, config->sync_policy,
+                                         (uint64_t)config->sync_interval_ms * 1000,
+                                         config->sync_interval_bytes);
         }
     }
 
@@ -102,6 +264,8 @@ raft_node_t* raft_create(const raft_config_t* config) {
 void raft_destroy(raft_node_t* node) {
     if (!node) return;
 
+    raft_install_snapshot_reset(node);
+    raft_snapshot_wait(node);
     raft_storage_close(node->storage);
     free(node->data_dir);
     raft_log_destroy(node->log);
@@ -131,6 +295,32 @@ raft_status_t raft_stop(raft_node_t* node) {
     return RAFT_OK;
 }
 
+/* Persist and replicate an entry that was just appended at index */
+static raft_status_t propose_appended(raft_node_t* node, uint64_t index) {
+    if (node->storage) {
+        raft_status_t status = raft_storage_append_entry(node->storage,
+                                                          raft_log_get(node->log, index));
+        if (status != RAFT_OK) {
+            raft_log_truncate_after(node->log, index - 1);
+            return status;
+        }
+    }
+
+    /* For single-node cluster, entry is committed once durable */
+    if (node->num_nodes == 1) {
+        if (node->storage) raft_storage_sync_for_ack(node->storage);
+        uint64_t durable = raft_durable_index(node);
+        if (durable > node->volatile_state.commit_index) {
+            node->volatile_state.commit_index = durable;
+        }
+    } else {
+        /* Trigger replication to followers */
+        raft_replicate_log(node);
+    }
+
+    return RAFT_OK;
+}
+
 raft_status_t raft_propose(raft_node_t* node, const char* command,
                            size_t command_len, uint64_t* out_index) {
     if (!node) return RAFT_INVALID_ARG;
@@ -142,16 +332,41 @@ raft_status_t raft_propose(raft_node_t* node, const char* command,
                                            command, command_len, &index);
     if (status != RAFT_OK) return status;
 
+    status = propose_appended(node, index);
+    if (status != RAFT_OK) return status;
+
     if (out_index) *out_index = index;
+    return RAFT_OK;
+}
 
-    /* For single-node cluster, entry is committed immediately */
-    if (node->num_nodes == 1) {
-        node->volatile_state.commit_index = index;
-    } else {
-        /* Trigger replication to followers */
-        raft_replicate_log(node);
+raft_status_t raft_propose_owned(raft_node_t* node, char* command,
+                                 size_t command_len, uint64_t* out_index) {
+    if (!node) return RAFT_INVALID_ARG;
+    if (!node->running) return RAFT_STOPPED;
+    if (node->role != RAFT_LEADER) return RAFT_NOT_LEADER;
+
+    raft_buf_t* buf = raft_buf_wrap(command, command_len, NULL, NULL);
+    if (!buf) return RAFT_NO_MEMORY;
+
+    uint64_t index;
+    raft_status_t status = raft_log_append_shared(node->log,
+                                                  node->persistent.current_term,
+                                                  buf, command, command_len, &index);
+    if (status == RAFT_OK) {
+        status = propose_appended(node, index);
+    }
+
+    if (status != RAFT_OK) {
+        /* Hand the bytes back to the caller */
+        buf->data = NULL;
+        raft_buf_unref(buf);
+        return status;
     }
 
+    /* The log now holds the reference that matters */
+    raft_buf_unref(buf);
+
+    if (out_index) *out_index = index;
     return RAFT_OK;
 }
 
@@ -191,7 +406,8 @@ raft_status_t raft_become_leader(raft_node_t* node) {
     node->role = RAFT_LEADER;
     node->current_leader = node->node_id;
 
-    /* Initialize leader state */
+    /* Initialize leader state; transfers from an earlier term are void */
+    raft_install_snapshot_reset(node);
     free(node->leader_state.next_index);
     free(node->leader_state.match_index);
 
@@ -231,4 +447,85 @@ void raft_apply_committed(raft_node_t* node) {
             node->apply_fn(node, entry, node->user_data);
         }
     }
+
+    raft_evict_payloads(node);
+}
+
+uint64_t raft_durable_index(raft_node_t* node) {
+    if (!node) return 0;
+
+    uint64_t last = raft_log_last_index(node->log);
+    if (!node->storage) return last;
+
+    uint64_t durable = raft_storage_durable_index(node->storage);
+    return durable < last ? durable : last;
+}
+
+/* Tell the leader about entries that became durable after the
+ * AppendEntries carrying them was answered, rather than waiting for
+ * the next heartbeat; only what the leader has verified is acked */
+static void ack_durable(raft_node_t* node, uint64_t before, uint64_t durable) {
+    if (!node->send_fn || node->current_leader < 0) return;
+    if (node->verified_term != node->persistent.current_term) return;
+
+    uint64_t acked = before < node->verified_index ? before : node->verified_index;
+    uint64_t match = durable < node->verified_index ? durable : node->verified_index;
+    if (match <= acked) return;
+
+    raft_append_entries_response_t response = {
+        .type = RAFT_MSG_APPEND_ENTRIES_RESPONSE,
+        .term = node->persistent.current_term,
+        .success = true,
+        .match_index = match,
+    };
+    node->send_fn(node, node->current_leader, &response, sizeof(response),
+                  node->user_data);
+}
+
+raft_status_t raft_sync_wal(raft_node_t* node) {
+    if (!node || !node->storage) return RAFT_OK;
+
+    uint64_t before = raft_durable_index(node);
+    raft_status_t status = raft_storage_poll(node->storage);
+    if (status != RAFT_OK) return status;
+    status = raft_storage_sync_if_due(node->storage);
+    if (status != RAFT_OK) return status;
+    /* A single-node leader commits here, so batched appends are due */
+    if (node->role == RAFT_LEADER && node->num_nodes == 1) {
+        status = raft_storage_sync_for_ack(node->storage);
+        if (status != RAFT_OK) return status;
+    }
+
+    uint64_t durable = raft_durable_index(node);
+    if (durable == before) return RAFT_OK;
+    if (node->role == RAFT_FOLLOWER) {
+        ack_durable(node, before, durable);
+        return RAFT_OK;
+    }
+    if (node->role != RAFT_LEADER) return RAFT_OK;
+
+    if (node->num_nodes == 1) {
+        if (durable > node->volatile_state.commit_index) {
+            node->volatile_state.commit_index = durable;
+            raft_apply_committed(node);
+        }
+        return RAFT_OK;
+    }
+    return raft_advance_commit_index(node);
+}
+
+void raft_evict_payloads(raft_node_t* node) {
+    if (!node || node->log_memory_budget == 0) return;
+
+    /* Keep anything a follower may still need */
+    uint64_t upto = node->volatile_state.last_applied;
+    if (node->role == RAFT_LEADER && node->leader_state.match_index) {
+        for (int32_t i = 0; i < node->num_nodes; i++) {
+            if (i != node->node_id && node->leader_state.match_index[i] < upto) {
+                upto = node->leader_state.match_index[i];
+            }
+        }
+    }
+
+    raft_log_evict(node->log, upto, node->log_memory_budget);
 }
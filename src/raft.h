@@ -9,10 +9,15 @@
 
 #include "types.h"
 #include "log.h"
+#include "compact.h"
 
 /* Forward declaration for storage */
 typedef struct raft_storage raft_storage_t;
 
+/* Forward declaration for snapshot transfer */
+typedef struct raft_install raft_install_t;
+typedef struct raft_snapshot_job raft_snapshot_job_t;
+
 /**
  * Raft node structure
  */
@@ -22,6 +27,7 @@ struct raft_node {
     int32_t num_nodes;
     raft_apply_fn apply_fn;
     raft_send_fn send_fn;
+    raft_sendv_fn sendv_fn;
     void* user_data;
 
     /* Current role */
@@ -57,6 +63,16 @@ struct raft_node {
     /* Persistence (Phase 4+) */
     raft_storage_t* storage;    /* Persistent storage (NULL if not enabled) */
     char* data_dir;             /* Data directory path */
+    size_t log_memory_budget;   /* Resident payload budget (0 = unlimited) */
+    uint64_t verified_index;    /* Follower: last index known to match the leader */
+    uint64_t verified_term;     /* Term verified_index was established in */
+
+    /* Snapshot transfer (Phase 5+) */
+    uint32_t snapshot_chunk_size;   /* InstallSnapshot chunk bytes (0 = default) */
+    uint32_t snapshot_max_inflight; /* Chunks sent ahead of the ack (0 = default) */
+    raft_install_t* install;    /* Transfers in progress (NULL until one starts) */
+    raft_snapshot_job_t* snapshot_job;  /* Background snapshot (NULL if none) */
+    raft_compact_t compact;     /* Auto-compaction scheduling */
 };
 
 /**
@@ -87,6 +103,15 @@ raft_status_t raft_stop(raft_node_t* node);
 raft_status_t raft_propose(raft_node_t* node, const char* command,
                            size_t command_len, uint64_t* out_index);
 
+/**
+ * Propose a command, taking ownership of a malloc'd buffer
+ * The log, storage and replication paths all reference command instead
+ * of copying it; it is freed with free() once nothing needs it anymore.
+ * On error the buffer is untouched and still belongs to the caller.
+ */
+raft_status_t raft_propose_owned(raft_node_t* node, char* command,
+                                 size_t command_len, uint64_t* out_index);
+
 /**
  * Check if this node is the leader
  */
@@ -132,4 +157,26 @@ raft_status_t raft_become_leader(raft_node_t* node);
  */
 void raft_apply_committed(raft_node_t* node);
 
+/**
+ * Get the last log index that is on stable storage
+ * How soon appends get there is up to the sync policy (see
+ * raft_sync_policy_t); without storage this is the last log index.
+ */
+uint64_t raft_durable_index(raft_node_t* node);
+
+/**
+ * Reap completed asynchronous WAL I/O and sync any appends the sync
+ * policy holds back that are now due
+ * Called from raft_tick. A leader then commits what became durable; a
+ * follower acks it to the leader straight away.
+ */
+raft_status_t raft_sync_wal(raft_node_t* node);
+
+/**
+ * Evict log payloads that no longer need to stay in memory
+ * Only entries that are applied (and, on a leader, replicated to every
+ * peer) are evicted, and only when storage can read them back.
+ */
+void raft_evict_payloads(raft_node_t* node);
+
 #endif /* RAFT_H */
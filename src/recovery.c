@@ -16,18 +16,26 @@ typedef struct {
     uint64_t last_term;
 } recovery_ctx_t;
 
-/* Callback to add recovered entries to in-memory log */
+/* Callback to add recovered entries to in-memory log
+ * Payloads stay in the WAL mapping; the log keeps a reference to it
+ * until the entries are compacted or evicted */
 static raft_status_t recover_entry_cb(void* ctx,
                                        uint64_t term,
                                        uint64_t index,
+                                       raft_buf_t* owner,
                                        const char* command,
                                        size_t command_len) {
     recovery_ctx_t* rctx = (recovery_ctx_t*)ctx;
 
+    /* Entries already covered by the snapshot are skipped */
+    if (index <= rctx->node->log->base_index) {
+        return RAFT_OK;
+    }
+
     /* Append to in-memory log */
     uint64_t out_index;
-    raft_status_t status = raft_log_append(rctx->node->log, term,
-                                            command, command_len, &out_index);
+    raft_status_t status = raft_log_append_shared(rctx->node->log, term, owner,
+                                                   command, command_len, &out_index);
     if (status != RAFT_OK) return status;
 
     /* Verify index matches */
@@ -59,8 +67,15 @@ raft_status_t raft_recover(raft_node_t* node,
         if (status == RAFT_OK) {
             local_result.had_snapshot = true;
             /* Set log base from snapshot */
-            node->log->base_index = snap_meta.last_index;
-            node->log->base_term = snap_meta.last_term;
+            raft_log_reset(node->log, snap_meta.last_index, snap_meta.last_term);
+
+            /* Restore terms of compacted entries */
+            raft_term_run_t* runs = NULL;
+            size_t run_count = 0;
+            if (raft_storage_load_term_runs(storage, &runs, &run_count) == RAFT_OK) {
+                raft_log_restore_term_runs(node->log, runs, run_count);
+                free(runs);
+            }
         }
     }
 
@@ -85,7 +100,7 @@ raft_status_t raft_recover(raft_node_t* node,
         .last_term = 0,
     };
 
-    status = raft_storage_iterate_log(storage, recover_entry_cb, &ctx);
+    status = raft_storage_iterate_log_mapped(storage, recover_entry_cb, &ctx);
     if (status != RAFT_OK) return status;
 
     local_result.log_entries_count = ctx.count;
@@ -7,20 +7,66 @@
 #include "log.h"
 #include "commit.h"
 #include "election.h"
+#include "install.h"
+#include "storage.h"
 #include "param.h"
 #include <stdlib.h>
 #include <string.h>
 
+/* Wire prefix written before each entry's command bytes */
+typedef struct {
+    uint64_t term;
+    uint32_t command_len;
+} __attribute__((packed)) entry_prefix_t;
+
+/* Send AppendEntries as a gather list that points into the log
+ * Every entry the header counts must be resident. */
+static raft_status_t send_entries_gather(raft_node_t* node, int32_t peer_id,
+                                         const raft_append_entries_t* header,
+                                         uint64_t next_idx) {
+    struct iovec iov[1 + 2 * RAFT_MAX_ENTRIES_PER_APPEND];
+    entry_prefix_t prefixes[RAFT_MAX_ENTRIES_PER_APPEND];
+    int iovcnt = 0;
+
+    iov[iovcnt].iov_base = (void*)header;
+    iov[iovcnt].iov_len = sizeof(*header);
+    iovcnt++;
+
+    for (uint32_t i = 0; i < header->entries_count; i++) {
+        const raft_entry_t* entry = raft_log_get(node->log, next_idx + i);
+        prefixes[i].term = entry->term;
+        prefixes[i].command_len = (uint32_t)entry->command_len;
+        iov[iovcnt].iov_base = &prefixes[i];
+        iov[iovcnt].iov_len = sizeof(prefixes[i]);
+        iovcnt++;
+
+        if (entry->command_len > 0) {
+            iov[iovcnt].iov_base = entry->command;
+            iov[iovcnt].iov_len = entry->command_len;
+            iovcnt++;
+        }
+    }
+
+    node->sendv_fn(node, peer_id, iov, iovcnt, node->user_data);
+    return RAFT_OK;
+}
+
 raft_status_t raft_replicate_to_peer(raft_node_t* node, int32_t peer_id) {
     if (!node) return RAFT_INVALID_ARG;
     if (node->role != RAFT_LEADER) return RAFT_NOT_LEADER;
     if (peer_id < 0 || peer_id >= node->num_nodes) return RAFT_INVALID_ARG;
     if (peer_id == node->node_id) return RAFT_OK;
-    if (!node->send_fn) return RAFT_OK;
+    if (!node->send_fn && !node->sendv_fn) return RAFT_OK;
 
     uint64_t next_idx = node->leader_state.next_index[peer_id];
     uint64_t last_idx = raft_log_last_index(node->log);
 
+    /* Entries the log has compacted away only exist in the snapshot */
+    if (next_idx <= node->log->base_index) {
+        raft_status_t status = raft_install_snapshot_send(node, peer_id);
+        if (status != RAFT_NOT_FOUND) return status;
+    }
+
     /* Prepare AppendEntries header */
     uint64_t prev_log_index = (next_idx > 1) ? next_idx - 1 : 0;
     uint64_t prev_log_term = raft_log_term_at(node->log, prev_log_index);
@@ -34,44 +80,54 @@ raft_status_t raft_replicate_to_peer(raft_node_t* node, int32_t peer_id) {
         }
     }
 
-    /* Calculate message size */
+    /* The follower places entries by position, so an evicted payload
+     * that cannot be read back ends the batch. Reloaded payloads stay
+     * resident until the next eviction pass. */
     size_t msg_size = sizeof(raft_append_entries_t);
     for (uint32_t i = 0; i < entries_count; i++) {
         const raft_entry_t* entry = raft_log_get(node->log, next_idx + i);
-        if (entry) {
-            msg_size += sizeof(uint64_t) + sizeof(uint32_t) + entry->command_len;
+        if (!entry) {
+            entries_count = i;
+            break;
         }
+        msg_size += sizeof(uint64_t) + sizeof(uint32_t) + entry->command_len;
+    }
+
+    raft_append_entries_t header = {
+        .type = RAFT_MSG_APPEND_ENTRIES,
+        .term = node->persistent.current_term,
+        .leader_id = node->node_id,
+        .prev_log_index = prev_log_index,
+        .prev_log_term = prev_log_term,
+        .leader_commit = node->volatile_state.commit_index,
+        .entries_count = entries_count,
+    };
+
+    /* Zero-copy path: reference entry payloads in place */
+    if (node->sendv_fn) {
+        return send_entries_gather(node, peer_id, &header, next_idx);
     }
 
     /* Allocate and fill message */
     void* msg = malloc(msg_size);
     if (!msg) return RAFT_NO_MEMORY;
 
-    raft_append_entries_t* header = (raft_append_entries_t*)msg;
-    header->type = RAFT_MSG_APPEND_ENTRIES;
-    header->term = node->persistent.current_term;
-    header->leader_id = node->node_id;
-    header->prev_log_index = prev_log_index;
-    header->prev_log_term = prev_log_term;
-    header->leader_commit = node->volatile_state.commit_index;
-    header->entries_count = entries_count;
+    memcpy(msg, &header, sizeof(header));
 
     /* Serialize entries after header */
     char* ptr = (char*)msg + sizeof(raft_append_entries_t);
     for (uint32_t i = 0; i < entries_count; i++) {
         const raft_entry_t* entry = raft_log_get(node->log, next_idx + i);
-        if (entry) {
-            /* Write term */
-            memcpy(ptr, &entry->term, sizeof(uint64_t));
-            ptr += sizeof(uint64_t);
-            /* Write command length */
-            uint32_t len = (uint32_t)entry->command_len;
-            memcpy(ptr, &len, sizeof(uint32_t));
-            ptr += sizeof(uint32_t);
-            /* Write command data */
-            memcpy(ptr, entry->command, entry->command_len);
-            ptr += entry->command_len;
-        }
+        /* Write term */
+        memcpy(ptr, &entry->term, sizeof(uint64_t));
+        ptr += sizeof(uint64_t);
+        /* Write command length */
+        uint32_t len = (uint32_t)entry->command_len;
+        memcpy(ptr, &len, sizeof(uint32_t));
+        ptr += sizeof(uint32_t);
+        /* Write command data */
+        memcpy(ptr, entry->command, entry->command_len);
+        ptr += entry->command_len;
     }
 
     node->send_fn(node, peer_id, msg, msg_size, node->user_data);
@@ -117,39 +173,56 @@ raft_status_t raft_handle_append_entries_response(
         /* Update match_index and next_index */
         if (response->match_index > node->leader_state.match_index[from_node]) {
             node->leader_state.match_index[from_node] = response->match_index;
-            node->leader_state.next_index[from_node] = response->match_index + 1;
+            /* A durable-index ack can trail entries already sent */
+            if (node->leader_state.next_index[from_node] <= response->match_index) {
+                node->leader_state.next_index[from_node] = response->match_index + 1;
+            }
         }
         /* Try to advance commit index */
         raft_advance_commit_index(node);
+        /* The slowest peer may have just caught up */
+        raft_evict_payloads(node);
     } else {
-        /* Decrement next_index and retry */
-        if (node->leader_state.next_index[from_node] > 1) {
-            node->leader_state.next_index[from_node]--;
+        /* Use the follower's conflict hint to skip a whole term at a time;
+         * fall back to decrementing next_index */
+        uint64_t next = node->leader_state.next_index[from_node];
+        uint64_t hint = 0;
+        if (response->conflict_term > 0) {
+            uint64_t last = raft_log_last_index_of_term(node->log, response->conflict_term);
+            hint = last ? last + 1 : response->conflict_index;
+        } else {
+            hint = response->conflict_index;
+        }
+
+        if (hint > 0 && hint < next) {
+            node->leader_state.next_index[from_node] = hint;
+        } else if (next > 1) {
+            node->leader_state.next_index[from_node] = next - 1;
         }
     }
 
     return RAFT_OK;
 }
 
-raft_status_t raft_handle_append_entries_with_log(
+static raft_status_t append_entries(
     raft_node_t* node,
     const void* msg,
     size_t msg_len,
     raft_append_entries_response_t* response) {
 
-    if (!node || !msg || !response) return RAFT_INVALID_ARG;
-    if (msg_len < sizeof(raft_append_entries_t)) return RAFT_INVALID_ARG;
-
     const raft_append_entries_t* request = (const raft_append_entries_t*)msg;
 
     response->type = RAFT_MSG_APPEND_ENTRIES_RESPONSE;
     response->term = node->persistent.current_term;
     response->success = false;
     response->match_index = 0;
+    response->conflict_term = 0;
+    response->conflict_index = 0;
 
-    /* Step down if request has higher term */
+    /* Step down if request has higher term; the new term goes out with
+     * the entries' sync */
     if (request->term > node->persistent.current_term) {
-        raft_step_down(node, request->term);
+        raft_step_down_staged(node, request->term);
         response->term = node->persistent.current_term;
     }
 
@@ -172,54 +245,91 @@ raft_status_t raft_handle_append_entries_with_log(
     if (request->prev_log_index > 0) {
         uint64_t term_at_prev = raft_log_term_at(node->log, request->prev_log_index);
         if (term_at_prev == 0 || term_at_prev != request->prev_log_term) {
-            /* Log doesn't contain entry at prev_log_index with matching term */
+            /* Log doesn't contain entry at prev_log_index with matching term.
+             * Hint where the leader should resume: skip the whole
+             * conflicting term, or jump to our end if we are short. */
             response->match_index = raft_log_last_index(node->log);
+            response->conflict_term = term_at_prev;
+            response->conflict_index = term_at_prev ?
+                raft_log_first_index_of_term(node->log, term_at_prev) :
+                response->match_index + 1;
             return RAFT_OK;
         }
     }
 
+    /* Last index this request checked against the log or appended; the
+     * message may hold fewer entries than it claims */
+    uint64_t verified = request->prev_log_index;
+
     /* Process entries if any */
     if (request->entries_count > 0) {
         const char* ptr = (const char*)msg + sizeof(raft_append_entries_t);
         const char* end = (const char*)msg + msg_len;
 
-        for (uint32_t i = 0; i < request->entries_count && ptr < end; i++) {
-            uint64_t entry_index = request->prev_log_index + 1 + i;
+        /* Never trust entries_count further than the message can hold */
+        size_t max_entries = (size_t)(end - ptr) / sizeof(entry_prefix_t);
+        size_t capacity = request->entries_count < max_entries ?
+                          request->entries_count : max_entries;
+        raft_entry_t* fresh = capacity ? malloc(capacity * sizeof(raft_entry_t)) : NULL;
+        size_t fresh_count = 0;
+        if (capacity > 0 && !fresh) return RAFT_NO_MEMORY;
 
-            /* Read entry term */
-            if (ptr + sizeof(uint64_t) > end) break;
-            uint64_t entry_term;
-            memcpy(&entry_term, ptr, sizeof(uint64_t));
-            ptr += sizeof(uint64_t);
+        for (uint32_t i = 0; i < capacity; i++) {
+            uint64_t entry_index = request->prev_log_index + 1 + i;
 
-            /* Read command length */
-            if (ptr + sizeof(uint32_t) > end) break;
-            uint32_t cmd_len;
-            memcpy(&cmd_len, ptr, sizeof(uint32_t));
-            ptr += sizeof(uint32_t);
+            /* Read entry term and command length */
+            if (ptr + sizeof(entry_prefix_t) > end) break;
+            entry_prefix_t prefix;
+            memcpy(&prefix, ptr, sizeof(prefix));
+            ptr += sizeof(prefix);
 
             /* Read command data */
-            if (ptr + cmd_len > end) break;
+            if (prefix.command_len > (size_t)(end - ptr)) break;
+            const char* command = ptr;
+            ptr += prefix.command_len;
+
+            /* Skip entries we already have; a conflict deletes this and
+             * all following entries */
+            if (entry_index <= raft_log_last_index(node->log)) {
+                uint64_t existing_term = raft_log_term_at(node->log, entry_index);
+                if (existing_term == 0 || existing_term == prefix.term) {
+                    verified = entry_index;
+                    continue;
+                }
 
-            /* Check for conflict */
-            uint64_t existing_term = raft_log_term_at(node->log, entry_index);
-            if (existing_term != 0 && existing_term != entry_term) {
-                /* Conflict - delete this and all following entries */
                 raft_log_truncate_after(node->log, entry_index - 1);
+                if (node->storage) {
+                    raft_storage_truncate_log(node->storage, entry_index - 1);
+                }
             }
 
-            /* Append if not already present */
-            if (entry_index > raft_log_last_index(node->log)) {
-                raft_log_append(node->log, entry_term, ptr, cmd_len, NULL);
-            }
+            fresh[fresh_count].term = prefix.term;
+            fresh[fresh_count].index = entry_index;
+            fresh[fresh_count].type = RAFT_ENTRY_COMMAND;
+            fresh[fresh_count].command = (char*)command;
+            fresh[fresh_count].command_len = prefix.command_len;
+            fresh_count++;
+        }
 
-            ptr += cmd_len;
+        /* Append the new tail in one step and persist it with one write so
+         * the WAL mirrors the log */
+        if (fresh_count > 0) {
+            uint64_t first_index;
+            raft_status_t appended = raft_log_append_batch(node->log, fresh, fresh_count,
+                                                           &first_index);
+            if (appended == RAFT_OK && node->storage &&
+                raft_storage_append_entries(node->storage, fresh, fresh_count) != RAFT_OK) {
+                raft_log_truncate_after(node->log, first_index - 1);
+                appended = RAFT_IO_ERROR;
+            }
+            if (appended == RAFT_OK) verified = fresh[fresh_count - 1].index;
         }
+        free(fresh);
     }
 
     /* Update commit index */
     if (request->leader_commit > node->volatile_state.commit_index) {
-        uint64_t last_new_index = request->prev_log_index + request->entries_count;
+        uint64_t last_new_index = verified;
         uint64_t last_log = raft_log_last_index(node->log);
         uint64_t new_commit = request->leader_commit;
         if (last_new_index < new_commit) new_commit = last_new_index;
@@ -228,8 +338,33 @@ raft_status_t raft_handle_append_entries_with_log(
         raft_apply_committed(node);
     }
 
+    /* Only acknowledge what this request verified and is on stable
+     * storage; entries past it may be stale ones from an old leader */
+    raft_status_t status = RAFT_OK;
+    if (node->storage) status = raft_storage_sync_for_ack(node->storage);
+    node->verified_index = verified;
+    node->verified_term = node->persistent.current_term;
+    uint64_t durable = raft_durable_index(node);
     response->success = true;
-    response->match_index = raft_log_last_index(node->log);
+    response->match_index = durable < verified ? durable : verified;
+
+    return status;
+}
+
+raft_status_t raft_handle_append_entries_with_log(
+    raft_node_t* node,
+    const void* msg,
+    size_t msg_len,
+    raft_append_entries_response_t* response) {
+
+    if (!node || !msg || !response) return RAFT_INVALID_ARG;
+    if (msg_len < sizeof(raft_append_entries_t)) return RAFT_INVALID_ARG;
+
+    raft_status_t status = append_entries(node, msg, msg_len, response);
+    if (status != RAFT_OK) return status;
 
+    /* A term taken from this request must be durable before the reply;
+     * usually the append above already synced it */
+    if (node->storage) return raft_storage_sync_state(node->storage);
     return RAFT_OK;
 }
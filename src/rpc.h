@@ -65,11 +65,16 @@ typedef struct {
     uint64_t term;              /* Current term, for leader to update itself */
     bool success;               /* True if follower contained entry matching prev_log */
     uint64_t match_index;       /* Highest index known to be replicated */
+    uint64_t conflict_term;     /* On mismatch: follower's term at prev_log_index (0 if missing) */
+    uint64_t conflict_index;    /* On mismatch: first index of conflict_term, or last index + 1 */
 } raft_append_entries_response_t;
 
 /**
  * InstallSnapshot RPC request
- * Used to send snapshots to followers that are too far behind
+ * Used to send snapshots to followers that are too far behind. Each
+ * chunk carries bytes of the snapshot file as it is on disk, header
+ * included, starting at offset. The file is the base, or a delta for a
+ * follower whose snapshots already reach the point it applies on.
  */
 typedef struct {
     raft_msg_type_t type;
@@ -77,9 +82,10 @@ typedef struct {
     int32_t leader_id;          /* So follower can redirect clients */
     uint64_t last_index;        /* Index of last entry included in snapshot */
     uint64_t last_term;         /* Term of last entry included in snapshot */
-    uint64_t offset;            /* Byte offset for chunked transfer */
+    uint64_t prev_index;        /* Snapshot point a delta applies on (0 = the file is a base) */
+    uint64_t offset;            /* Byte offset of this chunk in the snapshot file */
     uint32_t data_len;          /* Length of data in this chunk */
-    bool done;                  /* True if this is the last chunk */
+    bool done;                  /* True if this chunk ends the file */
     /* Snapshot data follows this header */
 } raft_install_snapshot_t;
 
@@ -89,7 +95,11 @@ typedef struct {
 typedef struct {
     raft_msg_type_t type;
     uint64_t term;              /* Current term, for leader to update itself */
-    bool success;               /* True if snapshot was accepted */
+    bool success;               /* False if the transfer must start over */
+    uint64_t last_index;        /* Snapshot this answers for */
+    uint64_t offset;            /* Bytes of the file held without a gap */
+    uint64_t snapshot_index;    /* Tip of the follower's snapshots (0 = none) */
+    bool done;                  /* True once the follower has the snapshot installed */
 } raft_install_snapshot_response_t;
 
 /**
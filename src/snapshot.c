@@ -2,44 +2,452 @@
  * snapshot.c - Snapshot support implementation
  *
  * Full implementation for Phase 5, auto-compaction for Phase 6.
+ *
+ * Snapshots are written and read in chunks, so neither side has to hold
+ * the whole state machine in memory. The header comes first in the file
+ * but is written last, once the state's length and CRC32C are known.
+ *
+ * A compressed state is a run of blocks, each a block_header_t and the
+ * block's bytes as LZ output, or as they are where that came out no
+ * smaller. The writer stages one block per pool thread and compresses
+ * them together; the reader decompresses one block at a time. The CRCs
+ * cover the state as pushed, so a reader checks it the same either way.
  */
 
+#define _GNU_SOURCE
 #include "snapshot.h"
+#include "compact.h"
 #include "crc32.h"
 #include "raft.h"
 #include "log.h"
 #include "param.h"
+#include "pool.h"
+#include "lz.h"
+#include "storage.h"
 #include <stdio.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <time.h>
 
-/* Global snapshot callback (per-node in production, simplified here) */
+/* Global snapshot callbacks (per-node in production, simplified here) */
 static raft_snapshot_cb g_snapshot_cb = NULL;
 static void* g_snapshot_user_data = NULL;
+static raft_snapshot_write_cb g_snapshot_write_cb = NULL;
+static void* g_snapshot_write_user_data = NULL;
+static raft_snapshot_restore_cb g_snapshot_restore_cb = NULL;
+static void* g_snapshot_restore_user_data = NULL;
+static raft_snapshot_delta_cb g_snapshot_delta_cb = NULL;
+static void* g_snapshot_delta_user_data = NULL;
+static raft_snapshot_restore_cb g_snapshot_restore_delta_cb = NULL;
+static void* g_snapshot_restore_delta_user_data = NULL;
+static raft_snapshot_restore_mapped_cb g_snapshot_restore_mapped_cb = NULL;
+static void* g_snapshot_restore_mapped_user_data = NULL;
+static raft_snapshot_freeze_cb g_snapshot_freeze_cb = NULL;
+static void* g_snapshot_freeze_user_data = NULL;
+static raft_snapshot_freeze_delta_cb g_snapshot_freeze_delta_cb = NULL;
+static void* g_snapshot_freeze_delta_user_data = NULL;
+static uint32_t g_snapshot_codec = RAFT_SNAPSHOT_CODEC_NONE;
 
-/* Snapshot file header */
+/* Snapshot file header; version 1 files have padding for state_crc,
+ * and files before version 3 end at stored_len */
 typedef struct {
     uint32_t magic;
     uint32_t version;
-    uint32_t crc32;
-    uint32_t padding;
+    uint32_t crc32;       /* CRC32C of state_crc to the header's end (v1: CRC32 of index + term) */
+    uint32_t state_crc;   /* CRC32C of the state */
     uint64_t last_index;
     uint64_t last_term;
-    uint64_t state_len;
+    uint64_t state_len;   /* Before compression */
+    uint64_t stored_len;  /* Bytes following the header */
+    uint32_t codec;       /* RAFT_SNAPSHOT_CODEC_* */
+    uint32_t block_size;  /* Largest block the state was compressed in */
 } __attribute__((packed)) snapshot_header_t;
 
-static char* make_snapshot_path(const char* data_dir) {
-    size_t len = strlen(data_dir) + strlen(RAFT_SNAPSHOT_FILE) + 2;
+#define HEADER_CRC_OFFSET offsetof(snapshot_header_t, state_crc)
+#define HEADER_V2_SIZE    offsetof(snapshot_header_t, stored_len)
+
+/* Block of a compressed state; stored_len == raw_len means stored as is */
+typedef struct {
+    uint32_t raw_len;
+    uint32_t stored_len;
+} __attribute__((packed)) block_header_t;
+
+/* Delta chain manifest: a header, then one entry per delta, oldest first */
+typedef struct {
+    uint32_t magic;
+    uint32_t crc32;       /* CRC32C of base_index through the last entry */
+    uint64_t base_index;  /* Base snapshot the chain is on; any other base makes it stale */
+    uint32_t count;
+    uint32_t reserved;
+} __attribute__((packed)) manifest_header_t;
+
+typedef struct {
+    uint64_t last_index;
+    uint64_t last_term;
+    uint64_t prev_index;  /* Snapshot point the delta applies on */
+    uint64_t state_len;
+} __attribute__((packed)) manifest_entry_t;
+
+#define MANIFEST_CRC_OFFSET offsetof(manifest_header_t, base_index)
+
+struct raft_snapshot_writer {
+    char* dir;
+    char* path;
+    char* tmp_path;
+    int fd;
+    snapshot_header_t header;
+    uint32_t crc;               /* Running CRC32C of the state */
+    char* buf;                  /* Staged chunks, RAFT_SNAPSHOT_BUFFER_SIZE */
+    size_t buf_len;
+    size_t buf_size;
+    uint64_t state_len;         /* State bytes pushed */
+    uint64_t written;           /* Stored bytes handed to the file */
+    uint64_t writeback_from;    /* Stored offset writeback has been started up to */
+    raft_status_t status;       /* First failure, returned from then on */
+    bool delta;                 /* Chained on the snapshot at prev_index */
+    uint64_t prev_index;
+    raft_pool_t* pool;          /* Compresses the staged blocks (LZ only) */
+    char* out;                  /* One slot per staged block: header, then bytes */
+    size_t* out_len;
+};
+
+struct raft_snapshot_reader {
+    int fd;
+    bool checked;               /* Version 2 on: state_crc covers the state */
+    uint64_t state_len;
+    uint64_t remaining;
+    uint32_t crc;
+    uint32_t expected_crc;
+    uint64_t file_len;          /* Header and stored bytes */
+    uint32_t codec;
+    uint32_t block_size;
+    uint64_t stored_left;       /* Stored bytes not read yet */
+    char* block;                /* Decompressed block being handed out */
+    size_t block_len;
+    size_t block_pos;
+    char* stored;               /* Compressed block as read */
+};
+
+struct raft_snapshot_mapping {
+    void* base;                 /* Whole file, or the decompressed state (NULL if empty) */
+    size_t map_len;
+    size_t offset;              /* Where the state starts in base */
+    size_t state_len;
+};
+
+/* Snapshot written on its own thread from a frozen view of the state */
+struct raft_snapshot_job {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    bool done;                  /* Guarded by lock */
+    raft_status_t status;       /* Outcome, valid once done */
+    raft_snapshot_view_t view;
+    raft_snapshot_writer_t* writer;
+    uint64_t last_index;        /* Log is compacted up to here on success */
+    uint64_t started_us;        /* When the state was frozen */
+    uint64_t elapsed_us;        /* Until committed, valid once done */
+};
+
+/* Bytes [start, end) of a file being received */
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+} byte_range_t;
+
+struct raft_snapshot_receiver {
+    char* dir;
+    char* path;
+    char* tmp_path;
+    int fd;
+    uint64_t length;            /* Bytes held without a gap from offset 0 */
+    byte_range_t ranges[RAFT_SNAPSHOT_RECV_RANGES];  /* Held past the gap, sorted */
+    size_t range_count;
+};
+
+/* Persist term runs so compacted terms survive a restart */
+static void persist_term_runs(raft_node_t* node) {
+    if (node->storage) {
+        size_t count;
+        const raft_term_run_t* runs = raft_log_term_runs(node->log, &count);
+        raft_storage_save_term_runs(node->storage, runs, count);
+    }
+}
+
+/* Drop the log prefix a committed snapshot covers */
+static void compact_log(raft_node_t* node, uint64_t last_index) {
+    /* Truncate log up to last_index - releases whole segments */
+    raft_log_truncate_before(node->log, last_index + 1);
+    persist_term_runs(node);
+    if (node->storage) {
+        raft_storage_compact_log(node->storage, last_index);
+    }
+}
+
+static char* make_dir_path(const char* data_dir, const char* name) {
+    size_t len = strlen(data_dir) + strlen(name) + 2;
     char* path = malloc(len);
     if (path) {
-        snprintf(path, len, "%s/%s", data_dir, RAFT_SNAPSHOT_FILE);
+        snprintf(path, len, "%s/%s", data_dir, name);
     }
     return path;
 }
 
+static char* make_snapshot_path(const char* data_dir) {
+    return make_dir_path(data_dir, RAFT_SNAPSHOT_FILE);
+}
+
+/* Path of the delta ending at last_index */
+static char* make_delta_path(const char* data_dir, uint64_t last_index) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s%llu.dat", RAFT_SNAPSHOT_DELTA_PREFIX,
+             (unsigned long long)last_index);
+    return make_dir_path(data_dir, name);
+}
+
+/* Bytes of header a file of this version starts with */
+static size_t header_size(const snapshot_header_t* header) {
+    return header->version == RAFT_SNAPSHOT_VERSION ? sizeof(*header) : HEADER_V2_SIZE;
+}
+
+static uint32_t header_crc(const snapshot_header_t* header) {
+    if (header->version == RAFT_SNAPSHOT_VERSION_V1) {
+        return crc32(&header->last_index,
+                     sizeof(header->last_index) + sizeof(header->last_term));
+    }
+    return crc32c((const char*)header + HEADER_CRC_OFFSET,
+                  header_size(header) - HEADER_CRC_OFFSET);
+}
+
+/* Open a snapshot file and check its header; one from before version 3
+ * is filled in as stored uncompressed */
+static raft_status_t open_snapshot_path(const char* path, snapshot_header_t* header,
+                                        int* fd_out) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return RAFT_NOT_FOUND;
+
+    raft_status_t status = RAFT_OK;
+    if (read(fd, header, HEADER_V2_SIZE) != (ssize_t)HEADER_V2_SIZE) {
+        status = RAFT_IO_ERROR;
+    } else if (header->magic != RAFT_SNAPSHOT_MAGIC ||
+               header->version < RAFT_SNAPSHOT_VERSION_V1 ||
+               header->version > RAFT_SNAPSHOT_VERSION) {
+        status = RAFT_CORRUPTION;
+    } else if (header->version == RAFT_SNAPSHOT_VERSION) {
+        size_t rest = sizeof(*header) - HEADER_V2_SIZE;
+        if (read(fd, (char*)header + HEADER_V2_SIZE, rest) != (ssize_t)rest) {
+            status = RAFT_IO_ERROR;
+        }
+    } else {
+        header->stored_len = header->state_len;
+        header->codec = RAFT_SNAPSHOT_CODEC_NONE;
+        header->block_size = 0;
+    }
+    if (status == RAFT_OK && header->crc32 != header_crc(header)) {
+        status = RAFT_CORRUPTION;
+    }
+    if (status == RAFT_OK && header->codec != RAFT_SNAPSHOT_CODEC_NONE &&
+        (header->codec != RAFT_SNAPSHOT_CODEC_LZ || header->block_size == 0)) {
+        status = RAFT_CORRUPTION;
+    }
+    if (status != RAFT_OK) {
+        close(fd);
+        return status;
+    }
+    *fd_out = fd;
+    return RAFT_OK;
+}
+
+/* Open the snapshot file in data_dir and check its header */
+static raft_status_t open_snapshot(const char* data_dir, snapshot_header_t* header,
+                                   int* fd_out) {
+    char* path = make_snapshot_path(data_dir);
+    if (!path) return RAFT_NO_MEMORY;
+
+    raft_status_t status = open_snapshot_path(path, header, fd_out);
+    free(path);
+    return status;
+}
+
+/* Path of a temporary file next to the snapshot */
+static char* make_temp_path(const char* path, const char* suffix) {
+    size_t len = strlen(path) + strlen(suffix) + 1;
+    char* tmp = malloc(len);
+    if (tmp) snprintf(tmp, len, "%s%s", path, suffix);
+    return tmp;
+}
+
+/* write() until len bytes are out */
+static raft_status_t write_all(int fd, const void* data, size_t len) {
+    const char* p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return RAFT_IO_ERROR;
+        p += n;
+        len -= (size_t)n;
+    }
+    return RAFT_OK;
+}
+
+/* read() until len bytes are in */
+static raft_status_t read_all(int fd, void* data, size_t len) {
+    char* p = data;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return RAFT_IO_ERROR;
+        p += n;
+        len -= (size_t)n;
+    }
+    return RAFT_OK;
+}
+
+static uint32_t manifest_crc(const manifest_header_t* header, const manifest_entry_t* entries) {
+    uint32_t crc = crc32c_update(0, (const char*)header + MANIFEST_CRC_OFFSET,
+                                 sizeof(*header) - MANIFEST_CRC_OFFSET);
+    return crc32c_update(crc, entries, header->count * sizeof(manifest_entry_t));
+}
+
+/* Read the base snapshot's header and the deltas chained on it; a
+ * missing or stale manifest is an empty chain */
+static raft_status_t load_chain(const char* data_dir, snapshot_header_t* base,
+                                manifest_entry_t** entries, uint32_t* count) {
+    *entries = NULL;
+    *count = 0;
+
+    int fd;
+    raft_status_t status = open_snapshot(data_dir, base, &fd);
+    if (status != RAFT_OK) return status;
+    close(fd);
+
+    char* path = make_dir_path(data_dir, RAFT_SNAPSHOT_MANIFEST);
+    if (!path) return RAFT_NO_MEMORY;
+    fd = open(path, O_RDONLY);
+    free(path);
+    if (fd < 0) return RAFT_OK;
+
+    manifest_header_t header;
+    manifest_entry_t* list = NULL;
+    struct stat st;
+    status = read_all(fd, &header, sizeof(header));
+    if (status == RAFT_OK && fstat(fd, &st) < 0) status = RAFT_IO_ERROR;
+    if (status == RAFT_OK && header.magic != RAFT_SNAPSHOT_MANIFEST_MAGIC) {
+        status = RAFT_CORRUPTION;
+    }
+    /* The count is not covered by a checked CRC yet; the file holds
+     * exactly the entries it claims, so it bounds the allocation */
+    if (status == RAFT_OK &&
+        (uint64_t)st.st_size != sizeof(header) + (uint64_t)header.count * sizeof(manifest_entry_t)) {
+        status = RAFT_CORRUPTION;
+    }
+    if (status == RAFT_OK && header.count > 0) {
+        list = malloc(header.count * sizeof(manifest_entry_t));
+        if (!list) status = RAFT_NO_MEMORY;
+        if (status == RAFT_OK) {
+            status = read_all(fd, list, header.count * sizeof(manifest_entry_t));
+        }
+    }
+    close(fd);
+    if (status == RAFT_OK && header.crc32 != manifest_crc(&header, list)) {
+        status = RAFT_CORRUPTION;
+    }
+    if (status != RAFT_OK || header.base_index != base->last_index) {
+        free(list);
+        return status;
+    }
+    *entries = list;
+    *count = header.count;
+    return RAFT_OK;
+}
+
+/* Replace the manifest with one listing count deltas on base_index */
+static raft_status_t write_manifest(const char* data_dir, uint64_t base_index,
+                                    const manifest_entry_t* entries, uint32_t count) {
+    char* path = make_dir_path(data_dir, RAFT_SNAPSHOT_MANIFEST);
+    char* tmp_path = path ? make_temp_path(path, ".tmp") : NULL;
+    if (!tmp_path) {
+        free(path);
+        return RAFT_NO_MEMORY;
+    }
+
+    manifest_header_t header = {
+        .magic = RAFT_SNAPSHOT_MANIFEST_MAGIC,
+        .base_index = base_index,
+        .count = count,
+    };
+    header.crc32 = manifest_crc(&header, entries);
+
+    raft_status_t status = RAFT_IO_ERROR;
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        status = write_all(fd, &header, sizeof(header));
+        if (status == RAFT_OK) {
+            status = write_all(fd, entries, count * sizeof(manifest_entry_t));
+        }
+        if (status == RAFT_OK && fsync(fd) < 0) status = RAFT_IO_ERROR;
+        close(fd);
+    }
+    if (status == RAFT_OK && rename(tmp_path, path) != 0) status = RAFT_IO_ERROR;
+    if (status != RAFT_OK) unlink(tmp_path);
+    free(tmp_path);
+    free(path);
+    return status;
+}
+
+/* Append a delta that is in place to the chain; its base must still be
+ * the chain's tip */
+static raft_status_t chain_delta(const char* data_dir, const manifest_entry_t* delta) {
+    snapshot_header_t base;
+    manifest_entry_t* entries;
+    uint32_t count;
+    raft_status_t status = load_chain(data_dir, &base, &entries, &count);
+    if (status != RAFT_OK) return status;
+
+    uint64_t tip = count > 0 ? entries[count - 1].last_index : base.last_index;
+    manifest_entry_t* grown = NULL;
+    if (delta->prev_index > tip || delta->last_index <= tip) {
+        status = RAFT_NOT_FOUND;
+    } else {
+        grown = realloc(entries, (count + 1) * sizeof(manifest_entry_t));
+        if (!grown) status = RAFT_NO_MEMORY;
+    }
+    if (status != RAFT_OK) {
+        free(entries);
+        return status;
+    }
+    grown[count] = *delta;
+    status = write_manifest(data_dir, base.last_index, grown, count + 1);
+    free(grown);
+    return status;
+}
+
+/* Remove the manifest and every delta; called once a new base is in place */
+static void drop_deltas(const char* data_dir) {
+    char* path = make_dir_path(data_dir, RAFT_SNAPSHOT_MANIFEST);
+    if (path) unlink(path);
+    free(path);
+
+    DIR* dir = opendir(data_dir);
+    if (!dir) return;
+    size_t prefix_len = strlen(RAFT_SNAPSHOT_DELTA_PREFIX);
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, RAFT_SNAPSHOT_DELTA_PREFIX, prefix_len) != 0) continue;
+        path = make_dir_path(data_dir, entry->d_name);
+        if (path) unlink(path);
+        free(path);
+    }
+    closedir(dir);
+}
+
 bool raft_snapshot_exists(const char* data_dir) {
     if (!data_dir) return false;
 
@@ -47,7 +455,7 @@ bool raft_snapshot_exists(const char* data_dir) {
     if (!path) return false;
 
     struct stat st;
-    bool exists = (stat(path, &st) == 0 && st.st_size >= (off_t)sizeof(snapshot_header_t));
+    bool exists = (stat(path, &st) == 0 && st.st_size >= (off_t)HEADER_V2_SIZE);
     free(path);
     return exists;
 }
@@ -56,176 +464,855 @@ raft_status_t raft_snapshot_load_meta(const char* data_dir,
                                        raft_snapshot_meta_t* meta) {
     if (!data_dir || !meta) return RAFT_INVALID_ARG;
 
-    char* path = make_snapshot_path(data_dir);
-    if (!path) return RAFT_NO_MEMORY;
+    snapshot_header_t base;
+    manifest_entry_t* entries;
+    uint32_t count;
+    raft_status_t status = load_chain(data_dir, &base, &entries, &count);
+    if (status != RAFT_OK) return status;
 
-    int fd = open(path, O_RDONLY);
-    free(path);
-    if (fd < 0) return RAFT_NOT_FOUND;
+    /* The chain's tip: what a restart recovers to */
+    if (count > 0) {
+        meta->last_index = entries[count - 1].last_index;
+        meta->last_term = entries[count - 1].last_term;
+    } else {
+        meta->last_index = base.last_index;
+        meta->last_term = base.last_term;
+    }
+    free(entries);
+    return RAFT_OK;
+}
 
-    snapshot_header_t header;
-    ssize_t n = read(fd, &header, sizeof(header));
-    close(fd);
+uint32_t raft_snapshot_delta_count(const char* data_dir) {
+    if (!data_dir) return 0;
 
-    if (n != sizeof(header)) return RAFT_IO_ERROR;
-    if (header.magic != RAFT_SNAPSHOT_MAGIC) return RAFT_CORRUPTION;
-    if (header.version != RAFT_SNAPSHOT_VERSION) return RAFT_CORRUPTION;
+    snapshot_header_t base;
+    manifest_entry_t* entries;
+    uint32_t count;
+    if (load_chain(data_dir, &base, &entries, &count) != RAFT_OK) return 0;
+    free(entries);
+    return count;
+}
 
-    /* Verify CRC (covers last_index, last_term, state_len) */
-    uint32_t expected_crc = crc32(&header.last_index,
-                                   sizeof(header.last_index) + sizeof(header.last_term));
-    if (header.crc32 != expected_crc) return RAFT_CORRUPTION;
+/* Start a writer whose file is renamed to path on commit; takes path */
+static raft_status_t open_writer(const char* data_dir, char* path, uint64_t last_index,
+                                 uint64_t last_term, raft_snapshot_writer_t** writer) {
+    raft_snapshot_writer_t* w = calloc(1, sizeof(raft_snapshot_writer_t));
+    if (!w) {
+        free(path);
+        return RAFT_NO_MEMORY;
+    }
+    w->fd = -1;
+    w->dir = strdup(data_dir);
+    w->path = path;
+    w->buf_size = RAFT_SNAPSHOT_BUFFER_SIZE;
+    bool ok = true;
 
-    meta->last_index = header.last_index;
-    meta->last_term = header.last_term;
+    /* Uncompressed snapshots keep the version 2 layout older builds read */
+    w->header.version = RAFT_SNAPSHOT_VERSION_V2;
+    if (g_snapshot_codec == RAFT_SNAPSHOT_CODEC_LZ) {
+        w->header.version = RAFT_SNAPSHOT_VERSION;
+        w->header.codec = RAFT_SNAPSHOT_CODEC_LZ;
+        w->header.block_size = RAFT_SNAPSHOT_BLOCK_SIZE;
+        w->pool = raft_pool_create(RAFT_SNAPSHOT_COMPRESS_THREADS);
+        size_t blocks = raft_pool_threads(w->pool);
+        w->buf_size = blocks * RAFT_SNAPSHOT_BLOCK_SIZE;
+        w->out = malloc(blocks * (sizeof(block_header_t) + RAFT_SNAPSHOT_BLOCK_SIZE));
+        w->out_len = calloc(blocks, sizeof(size_t));
+        ok = w->pool && w->out && w->out_len;
+    }
+    w->buf = malloc(w->buf_size);
+    if (w->path) w->tmp_path = make_temp_path(w->path, ".tmp");
+    if (!ok || !w->dir || !w->path || !w->tmp_path || !w->buf) {
+        raft_snapshot_writer_abort(w);
+        return RAFT_NO_MEMORY;
+    }
+
+    /* Write to temp file first, then rename for atomicity; the header
+     * is filled in once the state's length and CRC are known */
+    w->fd = open(w->tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (w->fd < 0 || write_all(w->fd, &w->header, header_size(&w->header)) != RAFT_OK) {
+        raft_snapshot_writer_abort(w);
+        return RAFT_IO_ERROR;
+    }
+    w->header.magic = RAFT_SNAPSHOT_MAGIC;
+    w->header.last_index = last_index;
+    w->header.last_term = last_term;
+    *writer = w;
+    return RAFT_OK;
+}
+
+raft_status_t raft_snapshot_writer_open(const char* data_dir,
+                                         uint64_t last_index,
+                                         uint64_t last_term,
+                                         raft_snapshot_writer_t** writer) {
+    if (!data_dir || !writer) return RAFT_INVALID_ARG;
+    return open_writer(data_dir, make_snapshot_path(data_dir), last_index, last_term, writer);
+}
+
+raft_status_t raft_snapshot_delta_writer_open(const char* data_dir,
+                                               uint64_t last_index,
+                                               uint64_t last_term,
+                                               raft_snapshot_writer_t** writer) {
+    if (!data_dir || !writer) return RAFT_INVALID_ARG;
+
+    raft_snapshot_meta_t tip;
+    raft_status_t status = raft_snapshot_load_meta(data_dir, &tip);
+    if (status != RAFT_OK) return status;
+    if (last_index <= tip.last_index) return RAFT_INVALID_ARG;
+
+    status = open_writer(data_dir, make_delta_path(data_dir, last_index), last_index,
+                         last_term, writer);
+    if (status != RAFT_OK) return status;
+    (*writer)->delta = true;
+    (*writer)->prev_index = tip.last_index;
+    return RAFT_OK;
+}
+
+/* Hand staged or direct bytes to the file, starting writeback of each
+ * RAFT_SNAPSHOT_WRITEBACK_BYTES as it fills */
+static raft_status_t writer_put(raft_snapshot_writer_t* w, const void* data, size_t len) {
+    raft_status_t status = write_all(w->fd, data, len);
+    if (status != RAFT_OK) return status;
+    w->written += len;
+
+    if (w->written - w->writeback_from >= RAFT_SNAPSHOT_WRITEBACK_BYTES) {
+        sync_file_range(w->fd, (off_t)(header_size(&w->header) + w->writeback_from),
+                        (off_t)(w->written - w->writeback_from), SYNC_FILE_RANGE_WRITE);
+        w->writeback_from = w->written;
+    }
     return RAFT_OK;
 }
 
+/* Compress one staged block into its slot, or copy it there as it is
+ * if that comes out no smaller */
+static void compress_task(void* ctx, size_t task) {
+    raft_snapshot_writer_t* w = ctx;
+    const char* raw = w->buf + task * RAFT_SNAPSHOT_BLOCK_SIZE;
+    size_t raw_len = w->buf_len - task * RAFT_SNAPSHOT_BLOCK_SIZE;
+    if (raw_len > RAFT_SNAPSHOT_BLOCK_SIZE) raw_len = RAFT_SNAPSHOT_BLOCK_SIZE;
+
+    char* slot = w->out + task * (sizeof(block_header_t) + RAFT_SNAPSHOT_BLOCK_SIZE);
+    char* dst = slot + sizeof(block_header_t);
+    size_t stored_len = raft_lz_compress(raw, raw_len, dst, raw_len - 1);
+    if (stored_len == 0) {
+        memcpy(dst, raw, raw_len);
+        stored_len = raw_len;
+    }
+    block_header_t block = { (uint32_t)raw_len, (uint32_t)stored_len };
+    memcpy(slot, &block, sizeof(block));
+    w->out_len[task] = sizeof(block) + stored_len;
+}
+
+/* Compress the staged blocks across the pool and write them in order */
+static raft_status_t writer_put_blocks(raft_snapshot_writer_t* w) {
+    size_t blocks = (w->buf_len + RAFT_SNAPSHOT_BLOCK_SIZE - 1) / RAFT_SNAPSHOT_BLOCK_SIZE;
+    raft_pool_run(w->pool, compress_task, w, blocks);
+    w->buf_len = 0;
+
+    raft_status_t status = RAFT_OK;
+    for (size_t i = 0; i < blocks && status == RAFT_OK; i++) {
+        status = writer_put(w, w->out + i * (sizeof(block_header_t) + RAFT_SNAPSHOT_BLOCK_SIZE),
+                            w->out_len[i]);
+    }
+    return status;
+}
+
+raft_status_t raft_snapshot_writer_write(raft_snapshot_writer_t* writer,
+                                          const void* data, size_t len) {
+    if (!writer || (len > 0 && !data)) return RAFT_INVALID_ARG;
+    if (writer->status != RAFT_OK) return writer->status;
+    if (len == 0) return RAFT_OK;
+
+    writer->crc = crc32c_update(writer->crc, data, len);
+    writer->state_len += len;
+
+    /* Compressed: everything goes through the staged blocks */
+    raft_status_t status = RAFT_OK;
+    if (writer->pool) {
+        const char* p = data;
+        while (len > 0 && status == RAFT_OK) {
+            size_t n = writer->buf_size - writer->buf_len;
+            if (n > len) n = len;
+            memcpy(writer->buf + writer->buf_len, p, n);
+            writer->buf_len += n;
+            p += n;
+            len -= n;
+            if (writer->buf_len == writer->buf_size) status = writer_put_blocks(writer);
+        }
+        writer->status = status;
+        return status;
+    }
+
+    /* Top up the staging buffer; a chunk it cannot take whole goes
+     * straight to the file once what is staged has gone ahead of it */
+    if (len <= RAFT_SNAPSHOT_BUFFER_SIZE - writer->buf_len) {
+        memcpy(writer->buf + writer->buf_len, data, len);
+        writer->buf_len += len;
+        if (writer->buf_len < RAFT_SNAPSHOT_BUFFER_SIZE) return RAFT_OK;
+        data = NULL;
+        len = 0;
+    }
+    if (writer->buf_len > 0) {
+        status = writer_put(writer, writer->buf, writer->buf_len);
+        writer->buf_len = 0;
+    }
+    if (status == RAFT_OK && len >= RAFT_SNAPSHOT_BUFFER_SIZE) {
+        status = writer_put(writer, data, len);
+    } else if (status == RAFT_OK && len > 0) {
+        memcpy(writer->buf, data, len);
+        writer->buf_len = len;
+    }
+    writer->status = status;
+    return status;
+}
+
+uint64_t raft_snapshot_writer_length(raft_snapshot_writer_t* writer) {
+    return writer ? writer->state_len : 0;
+}
+
+raft_status_t raft_snapshot_writer_commit(raft_snapshot_writer_t* writer) {
+    if (!writer) return RAFT_INVALID_ARG;
+
+    raft_status_t status = writer->status;
+    if (status == RAFT_OK && writer->buf_len > 0 && writer->pool) {
+        status = writer_put_blocks(writer);
+    } else if (status == RAFT_OK && writer->buf_len > 0) {
+        status = writer_put(writer, writer->buf, writer->buf_len);
+        writer->buf_len = 0;
+    }
+    size_t header_len = header_size(&writer->header);
+    if (status == RAFT_OK) {
+        writer->header.state_len = writer->state_len;
+        writer->header.stored_len = writer->written;
+        writer->header.state_crc = writer->crc;
+        writer->header.crc32 = header_crc(&writer->header);
+        if (pwrite(writer->fd, &writer->header, header_len, 0) != (ssize_t)header_len ||
+            fsync(writer->fd) < 0) {
+            status = RAFT_IO_ERROR;
+        }
+    }
+    if (status == RAFT_OK) {
+        close(writer->fd);
+        writer->fd = -1;
+        /* Atomic rename */
+        if (rename(writer->tmp_path, writer->path) != 0) status = RAFT_IO_ERROR;
+    }
+
+    /* A delta joins the chain; a new base makes the old chain moot */
+    if (status == RAFT_OK && writer->delta) {
+        manifest_entry_t entry = {
+            .last_index = writer->header.last_index,
+            .last_term = writer->header.last_term,
+            .prev_index = writer->prev_index,
+            .state_len = writer->header.state_len,
+        };
+        status = chain_delta(writer->dir, &entry);
+        if (status != RAFT_OK) unlink(writer->path);
+    } else if (status == RAFT_OK) {
+        drop_deltas(writer->dir);
+    }
+
+    raft_snapshot_writer_abort(writer);
+    return status;
+}
+
+void raft_snapshot_writer_abort(raft_snapshot_writer_t* writer) {
+    if (!writer) return;
+    if (writer->fd >= 0) close(writer->fd);
+    if (writer->tmp_path) unlink(writer->tmp_path);
+    raft_pool_destroy(writer->pool);
+    free(writer->out);
+    free(writer->out_len);
+    free(writer->buf);
+    free(writer->tmp_path);
+    free(writer->path);
+    free(writer->dir);
+    free(writer);
+}
+
 raft_status_t raft_snapshot_create(const char* data_dir,
                                     uint64_t last_index,
                                     uint64_t last_term,
                                     const void* state_data,
                                     size_t state_len) {
-    if (!data_dir) return RAFT_INVALID_ARG;
+    raft_snapshot_writer_t* writer;
+    raft_status_t status = raft_snapshot_writer_open(data_dir, last_index, last_term, &writer);
+    if (status != RAFT_OK) return status;
 
-    char* path = make_snapshot_path(data_dir);
-    if (!path) return RAFT_NO_MEMORY;
+    if (state_data && state_len > 0) {
+        status = raft_snapshot_writer_write(writer, state_data, state_len);
+    }
+    if (status != RAFT_OK) {
+        raft_snapshot_writer_abort(writer);
+        return status;
+    }
+    return raft_snapshot_writer_commit(writer);
+}
 
-    /* Write to temp file first, then rename for atomicity */
-    size_t tmp_len = strlen(path) + 5;
-    char* tmp_path = malloc(tmp_len);
-    if (!tmp_path) {
-        free(path);
-        return RAFT_NO_MEMORY;
+/* Open a reader on the snapshot file at path */
+static raft_status_t open_reader(const char* path, raft_snapshot_meta_t* meta,
+                                 raft_snapshot_reader_t** reader) {
+    raft_snapshot_reader_t* r = calloc(1, sizeof(raft_snapshot_reader_t));
+    if (!r) return RAFT_NO_MEMORY;
+
+    snapshot_header_t header;
+    raft_status_t status = open_snapshot_path(path, &header, &r->fd);
+    if (status != RAFT_OK) {
+        free(r);
+        return status;
     }
-    snprintf(tmp_path, tmp_len, "%s.tmp", path);
+    posix_fadvise(r->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
 
-    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-    if (fd < 0) {
-        free(path);
-        free(tmp_path);
-        return RAFT_IO_ERROR;
+    r->checked = header.version != RAFT_SNAPSHOT_VERSION_V1;
+    r->state_len = header.state_len;
+    r->remaining = header.state_len;
+    r->expected_crc = header.state_crc;
+    r->file_len = header_size(&header) + header.stored_len;
+    r->codec = header.codec;
+    r->block_size = header.block_size;
+    r->stored_left = header.stored_len;
+    if (r->codec != RAFT_SNAPSHOT_CODEC_NONE) {
+        r->block = malloc(r->block_size);
+        r->stored = malloc(r->block_size);
+        if (!r->block || !r->stored) {
+            raft_snapshot_reader_close(r);
+            return RAFT_NO_MEMORY;
+        }
     }
 
-    /* Prepare header */
-    snapshot_header_t header = {
-        .magic = RAFT_SNAPSHOT_MAGIC,
-        .version = RAFT_SNAPSHOT_VERSION,
-        .padding = 0,
-        .last_index = last_index,
-        .last_term = last_term,
-        .state_len = state_len,
-    };
-    header.crc32 = crc32(&header.last_index,
-                          sizeof(header.last_index) + sizeof(header.last_term));
+    meta->last_index = header.last_index;
+    meta->last_term = header.last_term;
+    *reader = r;
+    return RAFT_OK;
+}
 
-    /* Write header */
-    ssize_t n = write(fd, &header, sizeof(header));
-    if (n != sizeof(header)) {
-        close(fd);
-        unlink(tmp_path);
-        free(path);
-        free(tmp_path);
-        return RAFT_IO_ERROR;
+raft_status_t raft_snapshot_reader_open(const char* data_dir,
+                                         raft_snapshot_meta_t* meta,
+                                         raft_snapshot_reader_t** reader) {
+    if (!data_dir || !meta || !reader) return RAFT_INVALID_ARG;
+
+    char* path = make_snapshot_path(data_dir);
+    if (!path) return RAFT_NO_MEMORY;
+
+    raft_status_t status = open_reader(path, meta, reader);
+    free(path);
+    return status;
+}
+
+raft_status_t raft_snapshot_delta_reader_open(const char* data_dir, uint32_t i,
+                                               raft_snapshot_meta_t* meta,
+                                               raft_snapshot_reader_t** reader) {
+    if (!data_dir || !meta || !reader) return RAFT_INVALID_ARG;
+
+    snapshot_header_t base;
+    manifest_entry_t* entries;
+    uint32_t count;
+    raft_status_t status = load_chain(data_dir, &base, &entries, &count);
+    if (status != RAFT_OK) return status;
+    if (i >= count) {
+        free(entries);
+        return RAFT_NOT_FOUND;
     }
 
-    /* Write state data */
-    if (state_data && state_len > 0) {
-        n = write(fd, state_data, state_len);
-        if (n != (ssize_t)state_len) {
-            close(fd);
-            unlink(tmp_path);
-            free(path);
-            free(tmp_path);
-            return RAFT_IO_ERROR;
+    char* path = make_delta_path(data_dir, entries[i].last_index);
+    status = path ? open_reader(path, meta, reader) : RAFT_NO_MEMORY;
+    if (status == RAFT_NOT_FOUND) status = RAFT_CORRUPTION;    /* Listed but gone */
+    free(path);
+    free(entries);
+    return status;
+}
+
+uint64_t raft_snapshot_reader_length(raft_snapshot_reader_t* reader) {
+    return reader ? reader->state_len : 0;
+}
+
+/* Read and decompress the next block into dst, which holds raw_len */
+static raft_status_t reader_decode(raft_snapshot_reader_t* r, const block_header_t* block,
+                                   char* dst) {
+    if (block->stored_len == block->raw_len) return read_all(r->fd, dst, block->raw_len);
+
+    raft_status_t status = read_all(r->fd, r->stored, block->stored_len);
+    if (status != RAFT_OK) return status;
+    size_t n;
+    status = raft_lz_decompress(r->stored, block->stored_len, dst, block->raw_len, &n);
+    if (status == RAFT_OK && n != block->raw_len) status = RAFT_CORRUPTION;
+    return status;
+}
+
+/* Hand out up to len bytes of the current block, reading the next one
+ * once it is used up; one that fits goes straight into buf */
+static raft_status_t reader_read_block(raft_snapshot_reader_t* r, char* buf, size_t len,
+                                       size_t* n) {
+    if (r->block_pos == r->block_len) {
+        block_header_t block;
+        if (r->stored_left < sizeof(block)) return RAFT_CORRUPTION;
+        raft_status_t status = read_all(r->fd, &block, sizeof(block));
+        if (status != RAFT_OK) return status;
+        if (block.raw_len == 0 || block.raw_len > r->block_size ||
+            block.raw_len > r->remaining || block.stored_len > block.raw_len ||
+            sizeof(block) + block.stored_len > r->stored_left) {
+            return RAFT_CORRUPTION;
         }
+        r->stored_left -= sizeof(block) + block.stored_len;
+
+        if (len >= block.raw_len) {
+            *n = block.raw_len;
+            return reader_decode(r, &block, buf);
+        }
+        status = reader_decode(r, &block, r->block);
+        if (status != RAFT_OK) return status;
+        r->block_len = block.raw_len;
+        r->block_pos = 0;
     }
 
-    fsync(fd);
-    close(fd);
+    size_t take = r->block_len - r->block_pos;
+    if (take > len) take = len;
+    memcpy(buf, r->block + r->block_pos, take);
+    r->block_pos += take;
+    *n = take;
+    return RAFT_OK;
+}
 
-    /* Atomic rename */
-    if (rename(tmp_path, path) != 0) {
-        unlink(tmp_path);
-        free(path);
-        free(tmp_path);
-        return RAFT_IO_ERROR;
+raft_status_t raft_snapshot_reader_read(raft_snapshot_reader_t* reader,
+                                         void* buf, size_t len, size_t* n) {
+    if (!reader || !n || (len > 0 && !buf)) return RAFT_INVALID_ARG;
+    *n = 0;
+    if (reader->remaining == 0 || len == 0) return RAFT_OK;
+
+    if (len > reader->remaining) len = (size_t)reader->remaining;
+    size_t got;
+    if (reader->codec != RAFT_SNAPSHOT_CODEC_NONE) {
+        raft_status_t status = reader_read_block(reader, buf, len, &got);
+        if (status != RAFT_OK) return status;
+    } else {
+        ssize_t r;
+        do {
+            r = read(reader->fd, buf, len);
+        } while (r < 0 && errno == EINTR);
+        if (r <= 0) return RAFT_IO_ERROR;     /* Cut short */
+        got = (size_t)r;
     }
 
-    free(path);
-    free(tmp_path);
+    *n = got;
+    reader->remaining -= got;
+    if (reader->codec != RAFT_SNAPSHOT_CODEC_NONE && reader->remaining == 0 &&
+        reader->stored_left != 0) {
+        return RAFT_CORRUPTION;     /* Blocks past the end of the state */
+    }
+    if (reader->checked) {
+        reader->crc = crc32c_update(reader->crc, buf, got);
+        if (reader->remaining == 0 && reader->crc != reader->expected_crc) {
+            return RAFT_CORRUPTION;
+        }
+    }
     return RAFT_OK;
 }
 
+void raft_snapshot_reader_close(raft_snapshot_reader_t* reader) {
+    if (!reader) return;
+    close(reader->fd);
+    free(reader->block);
+    free(reader->stored);
+    free(reader);
+}
+
 raft_status_t raft_snapshot_load(const char* data_dir,
                                   raft_snapshot_meta_t* meta,
                                   void** state_data,
                                   size_t* state_len) {
     if (!data_dir || !meta || !state_data || !state_len) return RAFT_INVALID_ARG;
 
-    char* path = make_snapshot_path(data_dir);
-    if (!path) return RAFT_NO_MEMORY;
+    raft_snapshot_reader_t* reader;
+    raft_status_t status = raft_snapshot_reader_open(data_dir, meta, &reader);
+    if (status != RAFT_OK) return status;
 
-    int fd = open(path, O_RDONLY);
-    free(path);
-    if (fd < 0) return RAFT_NOT_FOUND;
+    size_t len = (size_t)reader->state_len;
+    char* data = NULL;
+    if (len > 0) {
+        data = malloc(len);
+        if (!data) {
+            raft_snapshot_reader_close(reader);
+            return RAFT_NO_MEMORY;
+        }
+    }
+    size_t done = 0;
+    while (status == RAFT_OK && done < len) {
+        size_t n;
+        status = raft_snapshot_reader_read(reader, data + done, len - done, &n);
+        done += n;
+    }
+    raft_snapshot_reader_close(reader);
+
+    if (status != RAFT_OK) {
+        free(data);
+        return status;
+    }
+    *state_data = data;
+    *state_len = len;
+    return RAFT_OK;
+}
+
+/* Decompress a compressed state into anonymous memory, read-only once
+ * it is filled in */
+static raft_status_t map_decoded(const char* data_dir, raft_snapshot_meta_t* meta,
+                                 raft_snapshot_mapping_t** mapping) {
+    raft_snapshot_reader_t* reader;
+    raft_status_t status = raft_snapshot_reader_open(data_dir, meta, &reader);
+    if (status != RAFT_OK) return status;
+
+    raft_snapshot_mapping_t* m = calloc(1, sizeof(raft_snapshot_mapping_t));
+    if (!m || reader->state_len > SIZE_MAX) {
+        free(m);
+        raft_snapshot_reader_close(reader);
+        return RAFT_NO_MEMORY;
+    }
+    m->state_len = (size_t)reader->state_len;
+    if (m->state_len > 0) {
+        m->map_len = m->state_len;
+        m->base = mmap(NULL, m->map_len, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (m->base == MAP_FAILED) {
+            free(m);
+            raft_snapshot_reader_close(reader);
+            return RAFT_NO_MEMORY;
+        }
+    }
+
+    size_t done = 0;
+    while (status == RAFT_OK && done < m->state_len) {
+        size_t n;
+        status = raft_snapshot_reader_read(reader, (char*)m->base + done,
+                                           m->state_len - done, &n);
+        done += n;
+    }
+    raft_snapshot_reader_close(reader);
+    if (status == RAFT_OK && m->base) mprotect(m->base, m->map_len, PROT_READ);
+    if (status != RAFT_OK) {
+        raft_snapshot_unmap(m);
+        return status;
+    }
+    *mapping = m;
+    return RAFT_OK;
+}
+
+raft_status_t raft_snapshot_map(const char* data_dir,
+                                 raft_snapshot_meta_t* meta,
+                                 bool verify,
+                                 raft_snapshot_mapping_t** mapping) {
+    if (!data_dir || !meta || !mapping) return RAFT_INVALID_ARG;
 
     snapshot_header_t header;
-    ssize_t n = read(fd, &header, sizeof(header));
-    if (n != sizeof(header)) {
+    int fd;
+    raft_status_t status = open_snapshot(data_dir, &header, &fd);
+    if (status != RAFT_OK) return status;
+    if (header.codec != RAFT_SNAPSHOT_CODEC_NONE) {
         close(fd);
-        return RAFT_IO_ERROR;
+        return map_decoded(data_dir, meta, mapping);
     }
 
-    if (header.magic != RAFT_SNAPSHOT_MAGIC) {
+    size_t header_len = header_size(&header);
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
         close(fd);
-        return RAFT_CORRUPTION;
+        return RAFT_IO_ERROR;
+    }
+    if (header.state_len > SIZE_MAX - header_len) {
+        close(fd);
+        return RAFT_NO_MEMORY;
     }
-    if (header.version != RAFT_SNAPSHOT_VERSION) {
+    /* Cut short */
+    if ((uint64_t)st.st_size < header_len + header.state_len) {
         close(fd);
-        return RAFT_CORRUPTION;
+        return RAFT_IO_ERROR;
     }
 
-    /* Verify CRC */
-    uint32_t expected_crc = crc32(&header.last_index,
-                                   sizeof(header.last_index) + sizeof(header.last_term));
-    if (header.crc32 != expected_crc) {
+    raft_snapshot_mapping_t* m = calloc(1, sizeof(raft_snapshot_mapping_t));
+    if (!m) {
         close(fd);
-        return RAFT_CORRUPTION;
+        return RAFT_NO_MEMORY;
+    }
+    m->state_len = (size_t)header.state_len;
+    m->offset = header_len;
+
+    /* Mapped from offset 0 since the header does not fill a page; the
+     * mapping holds the file open. A state about to be checksummed is
+     * read in up front, in large reads rather than a fault per page */
+    bool check = verify && header.version != RAFT_SNAPSHOT_VERSION_V1;
+    if (m->state_len > 0) {
+        m->map_len = header_len + m->state_len;
+        m->base = mmap(NULL, m->map_len, PROT_READ, MAP_PRIVATE | (check ? MAP_POPULATE : 0),
+                       fd, 0);
+        if (m->base == MAP_FAILED) {
+            close(fd);
+            free(m);
+            return RAFT_IO_ERROR;
+        }
+    }
+    close(fd);
+
+    if (m->base && check) {
+        uint32_t crc = crc32c((const char*)m->base + m->offset, m->state_len);
+        if (crc != header.state_crc) {
+            raft_snapshot_unmap(m);
+            return RAFT_CORRUPTION;
+        }
+    } else if (m->base) {
+        madvise(m->base, m->map_len, MADV_WILLNEED);
     }
 
     meta->last_index = header.last_index;
     meta->last_term = header.last_term;
-    *state_len = header.state_len;
+    *mapping = m;
+    return RAFT_OK;
+}
 
-    /* Read state data */
-    if (header.state_len > 0) {
-        *state_data = malloc(header.state_len);
-        if (!*state_data) {
-            close(fd);
-            return RAFT_NO_MEMORY;
-        }
-        n = read(fd, *state_data, header.state_len);
-        if (n != (ssize_t)header.state_len) {
-            free(*state_data);
-            *state_data = NULL;
-            close(fd);
-            return RAFT_IO_ERROR;
+const void* raft_snapshot_mapping_data(const raft_snapshot_mapping_t* mapping) {
+    if (!mapping || !mapping->base) return NULL;
+    return (const char*)mapping->base + mapping->offset;
+}
+
+size_t raft_snapshot_mapping_length(const raft_snapshot_mapping_t* mapping) {
+    return mapping ? mapping->state_len : 0;
+}
+
+void raft_snapshot_unmap(raft_snapshot_mapping_t* mapping) {
+    if (!mapping) return;
+    if (mapping->base) munmap(mapping->base, mapping->map_len);
+    free(mapping);
+}
+
+raft_status_t raft_snapshot_open_file(const char* data_dir,
+                                       uint64_t peer_index,
+                                       raft_snapshot_meta_t* meta,
+                                       uint64_t* prev_index,
+                                       int* fd, uint64_t* size) {
+    if (!data_dir || !meta || !prev_index || !fd || !size) return RAFT_INVALID_ARG;
+
+    snapshot_header_t base;
+    manifest_entry_t* entries;
+    uint32_t count;
+    raft_status_t status = load_chain(data_dir, &base, &entries, &count);
+    if (status != RAFT_OK) return status;
+
+    /* The first delta past what the peer holds, if it applies there */
+    *prev_index = 0;
+    if (peer_index >= base.last_index) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (entries[i].last_index > peer_index) {
+                if (entries[i].prev_index <= peer_index) {
+                    *prev_index = entries[i].prev_index;
+                    peer_index = entries[i].last_index;
+                }
+                break;
+            }
         }
-    } else {
-        *state_data = NULL;
     }
+    free(entries);
 
-    close(fd);
+    char* path = *prev_index ? make_delta_path(data_dir, peer_index) :
+                               make_snapshot_path(data_dir);
+    if (!path) return RAFT_NO_MEMORY;
+    snapshot_header_t header;
+    int file;
+    status = open_snapshot_path(path, &header, &file);
+    free(path);
+    if (status != RAFT_OK) return status;
+
+    struct stat st;
+    if (fstat(file, &st) < 0) {
+        close(file);
+        return RAFT_IO_ERROR;
+    }
+    posix_fadvise(file, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    meta->last_index = header.last_index;
+    meta->last_term = header.last_term;
+    *fd = file;
+    *size = (uint64_t)st.st_size;
+    return RAFT_OK;
+}
+
+raft_status_t raft_snapshot_receiver_open(const char* data_dir,
+                                           raft_snapshot_receiver_t** receiver) {
+    if (!data_dir || !receiver) return RAFT_INVALID_ARG;
+
+    raft_snapshot_receiver_t* r = calloc(1, sizeof(raft_snapshot_receiver_t));
+    if (!r) return RAFT_NO_MEMORY;
+    r->fd = -1;
+    r->dir = strdup(data_dir);
+    r->path = make_snapshot_path(data_dir);
+    if (r->path) r->tmp_path = make_temp_path(r->path, ".recv");
+    if (!r->dir || !r->path || !r->tmp_path) {
+        raft_snapshot_receiver_abort(r);
+        return RAFT_NO_MEMORY;
+    }
+
+    r->fd = open(r->tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (r->fd < 0) {
+        raft_snapshot_receiver_abort(r);
+        return RAFT_IO_ERROR;
+    }
+    *receiver = r;
+    return RAFT_OK;
+}
+
+/* Record [start, end) as held, merging it into length or the ranges */
+static void receiver_mark(raft_snapshot_receiver_t* r, uint64_t start, uint64_t end) {
+    size_t i = 0;
+    while (i < r->range_count && r->ranges[i].end < start) i++;
+
+    /* Swallow every range this one overlaps or touches */
+    size_t j = i;
+    while (j < r->range_count && r->ranges[j].start <= end) {
+        if (r->ranges[j].start < start) start = r->ranges[j].start;
+        if (r->ranges[j].end > end) end = r->ranges[j].end;
+        j++;
+    }
+    memmove(&r->ranges[i + 1], &r->ranges[j], (r->range_count - j) * sizeof(byte_range_t));
+    r->ranges[i].start = start;
+    r->ranges[i].end = end;
+    r->range_count = r->range_count - (j - i) + 1;
+
+    /* The gap may have closed */
+    if (r->ranges[0].start <= r->length) {
+        if (r->ranges[0].end > r->length) r->length = r->ranges[0].end;
+        memmove(&r->ranges[0], &r->ranges[1], (r->range_count - 1) * sizeof(byte_range_t));
+        r->range_count--;
+    }
+}
+
+raft_status_t raft_snapshot_receiver_write(raft_snapshot_receiver_t* receiver,
+                                            uint64_t offset,
+                                            const void* data, size_t len) {
+    if (!receiver || (len > 0 && !data)) return RAFT_INVALID_ARG;
+
+    /* Skip what is already held in front of the gap */
+    if (offset + len <= receiver->length) return RAFT_OK;
+    if (offset < receiver->length) {
+        size_t skip = (size_t)(receiver->length - offset);
+        data = (const char*)data + skip;
+        len -= skip;
+        offset = receiver->length;
+    }
+    if (len == 0 ||
+        (offset > receiver->length && receiver->range_count == RAFT_SNAPSHOT_RECV_RANGES)) {
+        return RAFT_OK;
+    }
+
+    const char* p = data;
+    uint64_t at = offset;
+    size_t left = len;
+    while (left > 0) {
+        ssize_t n = pwrite(receiver->fd, p, left, (off_t)at);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return RAFT_IO_ERROR;
+        p += n;
+        at += (uint64_t)n;
+        left -= (size_t)n;
+    }
+    receiver_mark(receiver, offset, offset + len);
     return RAFT_OK;
 }
 
+uint64_t raft_snapshot_receiver_length(raft_snapshot_receiver_t* receiver) {
+    return receiver ? receiver->length : 0;
+}
+
+raft_status_t raft_snapshot_receiver_commit(raft_snapshot_receiver_t* receiver,
+                                             uint64_t prev_index,
+                                             raft_snapshot_meta_t* meta) {
+    if (!receiver || !meta) return RAFT_INVALID_ARG;
+
+    /* Read the whole file back through a reader, which checks the CRCs */
+    raft_snapshot_reader_t* reader;
+    raft_status_t status = open_reader(receiver->tmp_path, meta, &reader);
+    if (status == RAFT_NOT_FOUND) status = RAFT_IO_ERROR;
+    uint64_t state_len = status == RAFT_OK ? reader->state_len : 0;
+    if (status == RAFT_OK) {
+        if (reader->file_len != receiver->length ||
+            receiver->range_count > 0) {
+            status = RAFT_CORRUPTION;
+        }
+        char* buf = status == RAFT_OK ? malloc(RAFT_SNAPSHOT_BUFFER_SIZE) : NULL;
+        if (status == RAFT_OK && !buf) status = RAFT_NO_MEMORY;
+        size_t n = 1;
+        while (status == RAFT_OK && n > 0) {
+            status = raft_snapshot_reader_read(reader, buf, RAFT_SNAPSHOT_BUFFER_SIZE, &n);
+        }
+        free(buf);
+        raft_snapshot_reader_close(reader);
+    }
+
+    if (status == RAFT_OK && fsync(receiver->fd) < 0) status = RAFT_IO_ERROR;
+
+    /* A delta goes in place beside the base and joins the chain */
+    char* path = receiver->path;
+    if (status == RAFT_OK && prev_index > 0) {
+        path = make_delta_path(receiver->dir, meta->last_index);
+        if (!path) status = RAFT_NO_MEMORY;
+    }
+    if (status == RAFT_OK) {
+        close(receiver->fd);
+        receiver->fd = -1;
+        if (rename(receiver->tmp_path, path) != 0) status = RAFT_IO_ERROR;
+    }
+    if (status == RAFT_OK && prev_index > 0) {
+        manifest_entry_t entry = {
+            .last_index = meta->last_index,
+            .last_term = meta->last_term,
+            .prev_index = prev_index,
+            .state_len = state_len,
+        };
+        status = chain_delta(receiver->dir, &entry);
+        if (status != RAFT_OK) unlink(path);
+    } else if (status == RAFT_OK) {
+        drop_deltas(receiver->dir);
+    }
+    if (path != receiver->path) free(path);
+
+    raft_snapshot_receiver_abort(receiver);
+    return status;
+}
+
+void raft_snapshot_receiver_abort(raft_snapshot_receiver_t* receiver) {
+    if (!receiver) return;
+    if (receiver->fd >= 0) close(receiver->fd);
+    if (receiver->tmp_path) unlink(receiver->tmp_path);
+    free(receiver->tmp_path);
+    free(receiver->path);
+    free(receiver->dir);
+    free(receiver);
+}
+
+/* Reset the log and volatile state to a snapshot that is in place */
+static void install_point(raft_node_t* node, const raft_snapshot_meta_t* meta) {
+    /* Discard entire log and set its base to the snapshot point; the WAL
+     * must not keep entries past it either */
+    raft_log_reset(node->log, meta->last_index, meta->last_term);
+    if (node->storage) {
+        raft_storage_truncate_log(node->storage, meta->last_index);
+        raft_storage_compact_log(node->storage, meta->last_index);
+    }
+    persist_term_runs(node);
+
+    /* Update volatile state */
+    if (meta->last_index > node->volatile_state.commit_index) {
+        node->volatile_state.commit_index = meta->last_index;
+    }
+    if (meta->last_index > node->volatile_state.last_applied) {
+        node->volatile_state.last_applied = meta->last_index;
+    }
+}
+
 raft_status_t raft_snapshot_install(raft_node_t* node,
                                      const raft_snapshot_meta_t* meta,
                                      const void* state_data,
                                      size_t state_len) {
     if (!node || !meta) return RAFT_INVALID_ARG;
 
+    /* A background snapshot must not land on top of this one */
+    raft_snapshot_wait(node);
+
     /* Save snapshot to disk if persistence is enabled */
     if (node->data_dir) {
         raft_status_t status = raft_snapshot_create(node->data_dir,
@@ -236,30 +1323,63 @@ raft_status_t raft_snapshot_install(raft_node_t* node,
         if (status != RAFT_OK) return status;
     }
 
-    /* Discard entire log and reset to snapshot state */
-    raft_log_t* log = node->log;
+    install_point(node, meta);
+    return RAFT_OK;
+}
 
-    /* Free all existing entries */
-    for (size_t i = 0; i < log->count; i++) {
-        free(log->entries[i].command);
-    }
-    log->count = 0;
+raft_status_t raft_snapshot_install_file(raft_node_t* node,
+                                          raft_snapshot_meta_t* meta) {
+    if (!node || !node->data_dir) return RAFT_INVALID_ARG;
+    raft_snapshot_wait(node);
 
-    /* Set log base to snapshot point */
-    log->base_index = meta->last_index;
-    log->base_term = meta->last_term;
+    raft_snapshot_meta_t installed;
+    raft_status_t status;
+    uint32_t deltas = raft_snapshot_delta_count(node->data_dir);
+    if (deltas > 0) {
+        /* The state machine already holds what the delta applies on */
+        if (!g_snapshot_restore_delta_cb) return RAFT_INVALID_ARG;
 
-    /* Update volatile state */
-    if (meta->last_index > node->volatile_state.commit_index) {
-        node->volatile_state.commit_index = meta->last_index;
-    }
-    if (meta->last_index > node->volatile_state.last_applied) {
-        node->volatile_state.last_applied = meta->last_index;
+        raft_snapshot_reader_t* reader;
+        status = raft_snapshot_delta_reader_open(node->data_dir, deltas - 1, &installed,
+                                                 &reader);
+        if (status != RAFT_OK) return status;
+
+        status = g_snapshot_restore_delta_cb(node, &installed, reader,
+                                             g_snapshot_restore_delta_user_data);
+        raft_snapshot_reader_close(reader);
+    } else if (g_snapshot_restore_mapped_cb) {
+        /* Checked when it was received; reading it again here would put
+         * the whole file back on the install path */
+        raft_snapshot_mapping_t* mapping;
+        status = raft_snapshot_map(node->data_dir, &installed, false, &mapping);
+        if (status != RAFT_OK) return status;
+        status = g_snapshot_restore_mapped_cb(node, &installed, mapping,
+                                              g_snapshot_restore_mapped_user_data);
+    } else {
+        /* Resetting the log without loading the state would lose it */
+        if (!g_snapshot_restore_cb) return RAFT_INVALID_ARG;
+
+        raft_snapshot_reader_t* reader;
+        status = raft_snapshot_reader_open(node->data_dir, &installed, &reader);
+        if (status != RAFT_OK) return status;
+
+        status = g_snapshot_restore_cb(node, &installed, reader,
+                                       g_snapshot_restore_user_data);
+        raft_snapshot_reader_close(reader);
     }
+    if (status != RAFT_OK) return status;
 
+    install_point(node, &installed);
+    if (meta) *meta = installed;
     return RAFT_OK;
 }
 
+bool raft_snapshot_can_restore(raft_node_t* node, bool delta) {
+    (void)node;  /* Would be per-node in production */
+    if (delta) return g_snapshot_restore_delta_cb != NULL;
+    return g_snapshot_restore_cb || g_snapshot_restore_mapped_cb;
+}
+
 void raft_set_snapshot_callback(raft_node_t* node, raft_snapshot_cb callback,
                                  void* user_data) {
     (void)node;  /* Would be per-node in production */
@@ -267,75 +1387,304 @@ void raft_set_snapshot_callback(raft_node_t* node, raft_snapshot_cb callback,
     g_snapshot_user_data = user_data;
 }
 
+void raft_set_snapshot_writer(raft_node_t* node, raft_snapshot_write_cb callback,
+                               void* user_data) {
+    (void)node;  /* Would be per-node in production */
+    g_snapshot_write_cb = callback;
+    g_snapshot_write_user_data = user_data;
+}
+
+void raft_set_snapshot_restore(raft_node_t* node, raft_snapshot_restore_cb callback,
+                                void* user_data) {
+    (void)node;  /* Would be per-node in production */
+    g_snapshot_restore_cb = callback;
+    g_snapshot_restore_user_data = user_data;
+}
+
+void raft_set_snapshot_delta(raft_node_t* node, raft_snapshot_delta_cb callback,
+                              void* user_data) {
+    (void)node;  /* Would be per-node in production */
+    g_snapshot_delta_cb = callback;
+    g_snapshot_delta_user_data = user_data;
+}
+
+void raft_set_snapshot_restore_delta(raft_node_t* node, raft_snapshot_restore_cb callback,
+                                      void* user_data) {
+    (void)node;  /* Would be per-node in production */
+    g_snapshot_restore_delta_cb = callback;
+    g_snapshot_restore_delta_user_data = user_data;
+}
+
+void raft_set_snapshot_restore_mapped(raft_node_t* node,
+                                       raft_snapshot_restore_mapped_cb callback,
+                                       void* user_data) {
+    (void)node;  /* Would be per-node in production */
+    g_snapshot_restore_mapped_cb = callback;
+    g_snapshot_restore_mapped_user_data = user_data;
+}
+
+void raft_set_snapshot_freeze(raft_node_t* node, raft_snapshot_freeze_cb callback,
+                               void* user_data) {
+    (void)node;  /* Would be per-node in production */
+    g_snapshot_freeze_cb = callback;
+    g_snapshot_freeze_user_data = user_data;
+}
+
+void raft_set_snapshot_freeze_delta(raft_node_t* node,
+                                     raft_snapshot_freeze_delta_cb callback,
+                                     void* user_data) {
+    (void)node;  /* Would be per-node in production */
+    g_snapshot_freeze_delta_cb = callback;
+    g_snapshot_freeze_delta_user_data = user_data;
+}
+
+raft_status_t raft_set_snapshot_compression(raft_node_t* node, uint32_t codec) {
+    (void)node;  /* Would be per-node in production */
+    if (codec != RAFT_SNAPSHOT_CODEC_NONE && codec != RAFT_SNAPSHOT_CODEC_LZ) {
+        return RAFT_INVALID_ARG;
+    }
+    g_snapshot_codec = codec;
+    return RAFT_OK;
+}
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void* snapshot_job_run(void* arg) {
+    raft_snapshot_job_t* job = arg;
+
+    raft_status_t status = job->view.write(job->view.state, job->writer);
+    if (status == RAFT_OK) {
+        status = raft_snapshot_writer_commit(job->writer);
+    } else {
+        raft_snapshot_writer_abort(job->writer);
+    }
+    job->writer = NULL;
+    if (job->view.release) job->view.release(job->view.state);
+
+    uint64_t elapsed_us = now_us() - job->started_us;
+    pthread_mutex_lock(&job->lock);
+    job->status = status;
+    job->elapsed_us = elapsed_us;
+    job->done = true;
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+/* Freeze the state, or what changed since the chain's tip, and hand it
+ * to a snapshot thread */
+static raft_status_t start_job(raft_node_t* node, uint64_t last_index, uint64_t last_term,
+                               bool delta) {
+    raft_snapshot_job_t* job = calloc(1, sizeof(raft_snapshot_job_t));
+    if (!job) return RAFT_NO_MEMORY;
+    job->last_index = last_index;
+    job->started_us = now_us();
+
+    raft_status_t status;
+    if (delta) {
+        raft_snapshot_meta_t tip;
+        status = raft_snapshot_load_meta(node->data_dir, &tip);
+        if (status == RAFT_OK) {
+            status = g_snapshot_freeze_delta_cb(node, tip.last_index, &job->view,
+                                                g_snapshot_freeze_delta_user_data);
+        }
+    } else {
+        status = g_snapshot_freeze_cb(node, &job->view, g_snapshot_freeze_user_data);
+    }
+    if (status != RAFT_OK) {
+        free(job);
+        return status;
+    }
+    if (delta) {
+        status = raft_snapshot_delta_writer_open(node->data_dir, last_index, last_term,
+                                                 &job->writer);
+    } else {
+        status = raft_snapshot_writer_open(node->data_dir, last_index, last_term,
+                                           &job->writer);
+    }
+    if (status == RAFT_OK) {
+        pthread_mutex_init(&job->lock, NULL);
+        if (pthread_create(&job->thread, NULL, snapshot_job_run, job) != 0) {
+            pthread_mutex_destroy(&job->lock);
+            raft_snapshot_writer_abort(job->writer);
+            status = RAFT_NO_MEMORY;
+        }
+    }
+    if (status != RAFT_OK) {
+        if (job->view.release) job->view.release(job->view.state);
+        free(job);
+        return status;
+    }
+    node->snapshot_job = job;
+    return RAFT_OK;
+}
+
+/* Join a finished job and compact the log if its snapshot was committed */
+static raft_status_t finish_job(raft_node_t* node) {
+    raft_snapshot_job_t* job = node->snapshot_job;
+    pthread_join(job->thread, NULL);
+    pthread_mutex_destroy(&job->lock);
+    node->snapshot_job = NULL;
+
+    raft_status_t status = job->status;
+    if (status == RAFT_OK) {
+        raft_compact_record_cost(node, job->elapsed_us);
+        compact_log(node, job->last_index);
+    }
+    free(job);
+    return status;
+}
+
+bool raft_snapshot_in_progress(raft_node_t* node) {
+    return node && node->snapshot_job;
+}
+
+raft_status_t raft_snapshot_poll(raft_node_t* node) {
+    if (!node || !node->snapshot_job) return RAFT_OK;
+
+    pthread_mutex_lock(&node->snapshot_job->lock);
+    bool done = node->snapshot_job->done;
+    pthread_mutex_unlock(&node->snapshot_job->lock);
+    return done ? finish_job(node) : RAFT_OK;
+}
+
+raft_status_t raft_snapshot_wait(raft_node_t* node) {
+    if (!node || !node->snapshot_job) return RAFT_OK;
+    return finish_job(node);
+}
+
 uint64_t raft_entries_since_snapshot(raft_node_t* node) {
     if (!node || !node->log) return 0;
     return raft_log_count(node->log);
 }
 
+/* Whether the next snapshot can be a delta: there is a base, and unless
+ * nothing could write a full snapshot, the chain is still cheaper to
+ * load than one would be */
+static bool delta_due(const char* data_dir, bool can_rebase) {
+    snapshot_header_t base;
+    manifest_entry_t* entries;
+    uint32_t count;
+    if (load_chain(data_dir, &base, &entries, &count) != RAFT_OK) return false;
+
+    uint64_t delta_bytes = 0;
+    for (uint32_t i = 0; i < count; i++) delta_bytes += entries[i].state_len;
+    free(entries);
+    return !can_rebase ||
+           (count < RAFT_SNAPSHOT_MAX_DELTAS && delta_bytes < base.state_len);
+}
+
+/* Chain what changed since the tip as a delta at compact_index */
+static raft_status_t write_delta(raft_node_t* node, uint64_t compact_index,
+                                 uint64_t compact_term) {
+    raft_snapshot_meta_t tip;
+    raft_status_t status = raft_snapshot_load_meta(node->data_dir, &tip);
+    if (status != RAFT_OK) return status;
+
+    raft_snapshot_writer_t* writer;
+    status = raft_snapshot_delta_writer_open(node->data_dir, compact_index, compact_term,
+                                             &writer);
+    if (status != RAFT_OK) return status;
+
+    status = g_snapshot_delta_cb(node, tip.last_index, writer, g_snapshot_delta_user_data);
+    if (status != RAFT_OK) {
+        raft_snapshot_writer_abort(writer);
+        return status;
+    }
+    status = raft_snapshot_writer_commit(writer);
+    if (status != RAFT_OK) return status;
+
+    compact_log(node, compact_index);
+    return RAFT_OK;
+}
+
 raft_status_t raft_maybe_compact(raft_node_t* node) {
     if (!node || !node->data_dir) return RAFT_OK;
 
-    /* Check if we have enough entries to compact */
-    uint64_t entries = raft_entries_since_snapshot(node);
-    if (entries < RAFT_AUTO_COMPACTION_THRESHOLD) {
-        return RAFT_OK;
+    /* One background snapshot at a time; compact once it has finished */
+    if (node->snapshot_job) {
+        return raft_snapshot_poll(node);
     }
 
     /* Need a snapshot callback to create state */
-    if (!g_snapshot_cb) {
+    bool can_rebase = g_snapshot_freeze_cb || g_snapshot_write_cb || g_snapshot_cb;
+    bool can_delta = g_snapshot_freeze_delta_cb || g_snapshot_delta_cb;
+    if (!can_rebase && !can_delta) {
         return RAFT_OK;
     }
 
     /* Only compact up to last_applied */
     uint64_t compact_index = node->volatile_state.last_applied;
-    if (compact_index == 0) {
+    if (compact_index == 0 || compact_index <= node->log->base_index) {
         return RAFT_OK;
     }
 
-    /* Get the term at compact_index */
-    const raft_entry_t* entry = raft_log_get(node->log, compact_index);
-    uint64_t compact_term = entry ? entry->term : node->log->base_term;
-
-    /* Get state data from callback */
-    void* state_data = NULL;
-    size_t state_len = 0;
-    raft_status_t status = g_snapshot_cb(node, &state_data, &state_len,
-                                          g_snapshot_user_data);
-    if (status != RAFT_OK) {
-        return status;
+    /* Weigh the log's size against the current load */
+    if (!raft_compact_check(node)) {
+        return RAFT_OK;
     }
 
-    /* Create snapshot */
-    status = raft_snapshot_create(node->data_dir, compact_index, compact_term,
-                                   state_data, state_len);
-    free(state_data);
+    /* Get the term at compact_index */
+    uint64_t compact_term = raft_log_term_at(node->log, compact_index);
+    uint64_t started_us = now_us();
 
-    if (status != RAFT_OK) {
-        return status;
+    /* Only what changed, while the chain stays short; else the whole
+     * state again, which replaces the chain. A delta written on the
+     * node's thread would stall it as a background snapshot would not,
+     * so with a freeze callback only a frozen delta will do */
+    if (can_delta && delta_due(node->data_dir, can_rebase)) {
+        if (g_snapshot_freeze_delta_cb) {
+            return start_job(node, compact_index, compact_term, true);
+        }
+        if (!g_snapshot_freeze_cb) {
+            raft_status_t status = write_delta(node, compact_index, compact_term);
+            if (status == RAFT_OK) raft_compact_record_cost(node, now_us() - started_us);
+            return status;
+        }
+    }
+    if (!can_rebase) {
+        return RAFT_OK;
     }
 
-    /* Truncate log up to compact_index */
-    raft_log_t* log = node->log;
+    /* Written in the background; the log is compacted when it is done */
+    if (g_snapshot_freeze_cb) {
+        return start_job(node, compact_index, compact_term, false);
+    }
 
-    /* Free entries up to compact_index */
-    uint64_t entries_to_remove = compact_index - log->base_index;
-    for (uint64_t i = 0; i < entries_to_remove && i < log->count; i++) {
-        free(log->entries[i].command);
+    /* Stream the state into the snapshot file */
+    raft_snapshot_writer_t* writer;
+    raft_status_t status = raft_snapshot_writer_open(node->data_dir, compact_index,
+                                                      compact_term, &writer);
+    if (status != RAFT_OK) {
+        return status;
     }
 
-    /* Shift remaining entries */
-    if (entries_to_remove < log->count) {
-        size_t remaining = log->count - entries_to_remove;
-        memmove(log->entries, log->entries + entries_to_remove,
-                remaining * sizeof(raft_entry_t));
-        log->count = remaining;
+    if (g_snapshot_write_cb) {
+        status = g_snapshot_write_cb(node, writer, g_snapshot_write_user_data);
     } else {
-        log->count = 0;
+        void* state_data = NULL;
+        size_t state_len = 0;
+        status = g_snapshot_cb(node, &state_data, &state_len, g_snapshot_user_data);
+        if (status == RAFT_OK && state_len > 0) {
+            status = raft_snapshot_writer_write(writer, state_data, state_len);
+        }
+        free(state_data);
+    }
+    if (status != RAFT_OK) {
+        raft_snapshot_writer_abort(writer);
+        return status;
     }
 
-    log->base_index = compact_index;
-    log->base_term = compact_term;
+    status = raft_snapshot_writer_commit(writer);
+    if (status != RAFT_OK) {
+        return status;
+    }
 
+    raft_compact_record_cost(node, now_us() - started_us);
+    compact_log(node, compact_index);
     return RAFT_OK;
 }
 
@@ -343,4 +1692,19 @@ raft_status_t raft_maybe_compact(raft_node_t* node) {
 void raft_snapshot_reset_callback(void) {
     g_snapshot_cb = NULL;
     g_snapshot_user_data = NULL;
+    g_snapshot_write_cb = NULL;
+    g_snapshot_write_user_data = NULL;
+    g_snapshot_restore_cb = NULL;
+    g_snapshot_restore_user_data = NULL;
+    g_snapshot_restore_mapped_cb = NULL;
+    g_snapshot_restore_mapped_user_data = NULL;
+    g_snapshot_delta_cb = NULL;
+    g_snapshot_delta_user_data = NULL;
+    g_snapshot_restore_delta_cb = NULL;
+    g_snapshot_restore_delta_user_data = NULL;
+    g_snapshot_freeze_cb = NULL;
+    g_snapshot_freeze_user_data = NULL;
+    g_snapshot_freeze_delta_cb = NULL;
+    g_snapshot_freeze_delta_user_data = NULL;
+    g_snapshot_codec = RAFT_SNAPSHOT_CODEC_NONE;
 }
@@ -2,6 +2,10 @@
  * snapshot.h - Snapshot support for Raft log compaction
  *
  * Provides snapshot creation, loading, and installation for log compaction.
+ * A snapshot is a base file holding the whole state, optionally followed
+ * by a chain of deltas listed in a manifest; each delta holds only what
+ * changed since the snapshot point it applies on. The state may be
+ * stored compressed, in blocks that are decompressed as it is read.
  */
 
 #ifndef RAFT_SNAPSHOT_H
@@ -10,8 +14,15 @@
 #include "types.h"
 
 #define RAFT_SNAPSHOT_MAGIC   0x52534E50  /* "RSNP" */
-#define RAFT_SNAPSHOT_VERSION 1
+#define RAFT_SNAPSHOT_VERSION    3  /* Codec in the header; written for compressed state */
+#define RAFT_SNAPSHOT_VERSION_V2 2  /* State covered by a CRC32C; written uncompressed */
+#define RAFT_SNAPSHOT_VERSION_V1 1  /* Header-only CRC32, read only */
+#define RAFT_SNAPSHOT_CODEC_NONE 0  /* State stored as it is */
+#define RAFT_SNAPSHOT_CODEC_LZ   1  /* State in LZ-compressed blocks (lz.h) */
 #define RAFT_SNAPSHOT_FILE    "raft_snapshot.dat"
+#define RAFT_SNAPSHOT_DELTA_PREFIX "raft_snapshot_delta_"  /* Then <last index>.dat */
+#define RAFT_SNAPSHOT_MANIFEST "raft_snapshot.manifest"
+#define RAFT_SNAPSHOT_MANIFEST_MAGIC 0x52534D46  /* "RSMF" */
 
 /**
  * Snapshot metadata
@@ -21,6 +32,28 @@ typedef struct raft_snapshot_meta {
     uint64_t last_term;   /* Term of last entry included in snapshot */
 } raft_snapshot_meta_t;
 
+/**
+ * Snapshot being written; state is pushed to it in chunks
+ */
+typedef struct raft_snapshot_writer raft_snapshot_writer_t;
+
+/**
+ * Snapshot being read; state is pulled from it in chunks
+ */
+typedef struct raft_snapshot_reader raft_snapshot_reader_t;
+
+/**
+ * Snapshot file being received from the leader; raw file bytes are
+ * written to it at their offsets, in any order
+ */
+typedef struct raft_snapshot_receiver raft_snapshot_receiver_t;
+
+/**
+ * Snapshot state mapped read-only into memory; pages are read from the
+ * file as they are touched
+ */
+typedef struct raft_snapshot_mapping raft_snapshot_mapping_t;
+
 /**
  * Check if a snapshot exists in the data directory
  */
@@ -28,14 +61,21 @@ bool raft_snapshot_exists(const char* data_dir);
 
 /**
  * Load snapshot metadata (not the full snapshot data)
- * Returns RAFT_NOT_FOUND if no snapshot exists
+ * Describes the tip of the chain: the last delta, or the base if there
+ * are none. Returns RAFT_NOT_FOUND if no snapshot exists
  */
 raft_status_t raft_snapshot_load_meta(const char* data_dir,
                                        raft_snapshot_meta_t* meta);
 
+/**
+ * Get the number of deltas chained on the base snapshot
+ */
+uint32_t raft_snapshot_delta_count(const char* data_dir);
+
 /**
  * Create a snapshot with the given state data
- * This saves the snapshot to disk and can be used for log compaction
+ * This saves the snapshot to disk and can be used for log compaction.
+ * Shorthand for a writer given the whole state as one chunk.
  *
  * @param data_dir Directory to save snapshot
  * @param last_index Index of last log entry included in snapshot
@@ -52,7 +92,8 @@ raft_status_t raft_snapshot_create(const char* data_dir,
 
 /**
  * Load a complete snapshot including state data
- * Caller must free *state_data when done
+ * Caller must free *state_data when done. Holds the whole state in
+ * memory; raft_snapshot_reader_open reads it in chunks instead.
  *
  * @param data_dir Directory containing snapshot
  * @param meta Output: snapshot metadata
@@ -65,6 +106,204 @@ raft_status_t raft_snapshot_load(const char* data_dir,
                                   void** state_data,
                                   size_t* state_len);
 
+/**
+ * Start writing a snapshot
+ * The state goes to a temporary file as it is pushed; the existing
+ * snapshot stays in place until raft_snapshot_writer_commit.
+ *
+ * @param data_dir Directory to save snapshot
+ * @param last_index Index of last log entry included in snapshot
+ * @param last_term Term of last log entry included in snapshot
+ * @param writer Output: writer handle
+ * @return RAFT_OK on success
+ */
+raft_status_t raft_snapshot_writer_open(const char* data_dir,
+                                         uint64_t last_index,
+                                         uint64_t last_term,
+                                         raft_snapshot_writer_t** writer);
+
+/**
+ * Append a chunk of state
+ * Chunks are checksummed as they arrive and staged in a buffer of
+ * RAFT_SNAPSHOT_BUFFER_SIZE; larger ones are written straight through.
+ * When compressing, a block per thread is staged and the blocks are
+ * compressed together once it fills.
+ * After a failure every later call returns the same error.
+ */
+raft_status_t raft_snapshot_writer_write(raft_snapshot_writer_t* writer,
+                                          const void* data, size_t len);
+
+/**
+ * Get the number of state bytes pushed so far, before compression
+ */
+uint64_t raft_snapshot_writer_length(raft_snapshot_writer_t* writer);
+
+/**
+ * Finish the snapshot: write its header, sync, and rename it into place
+ * Frees the writer whatever the outcome.
+ */
+raft_status_t raft_snapshot_writer_commit(raft_snapshot_writer_t* writer);
+
+/**
+ * Drop a snapshot being written; the existing one is left alone
+ */
+void raft_snapshot_writer_abort(raft_snapshot_writer_t* writer);
+
+/**
+ * Open the snapshot in data_dir for reading
+ *
+ * @param data_dir Directory containing snapshot
+ * @param meta Output: snapshot metadata
+ * @param reader Output: reader handle
+ * @return RAFT_OK on success, RAFT_NOT_FOUND if no snapshot
+ */
+raft_status_t raft_snapshot_reader_open(const char* data_dir,
+                                         raft_snapshot_meta_t* meta,
+                                         raft_snapshot_reader_t** reader);
+
+/**
+ * Start writing a delta on the tip of the chain
+ * Used like raft_snapshot_writer_open; the state pushed is what changed
+ * since the tip. Committing it makes it the new tip.
+ *
+ * @return RAFT_OK on success, RAFT_NOT_FOUND if there is no base snapshot,
+ *         RAFT_INVALID_ARG if last_index is not past the tip
+ */
+raft_status_t raft_snapshot_delta_writer_open(const char* data_dir,
+                                               uint64_t last_index,
+                                               uint64_t last_term,
+                                               raft_snapshot_writer_t** writer);
+
+/**
+ * Open a reader on delta i of the chain, 0 being the oldest
+ * Restoring the state means reading the base, then every delta in order.
+ *
+ * @return RAFT_OK on success, RAFT_NOT_FOUND if there is no such delta
+ */
+raft_status_t raft_snapshot_delta_reader_open(const char* data_dir, uint32_t i,
+                                               raft_snapshot_meta_t* meta,
+                                               raft_snapshot_reader_t** reader);
+
+/**
+ * Get the total length of the snapshot's state
+ */
+uint64_t raft_snapshot_reader_length(raft_snapshot_reader_t* reader);
+
+/**
+ * Read the next chunk of state
+ * Sets *n to the bytes read, 0 once the state is exhausted. The read
+ * that reaches the end checks the state's CRC and returns
+ * RAFT_CORRUPTION if it does not match; a file cut short returns
+ * RAFT_IO_ERROR.
+ */
+raft_status_t raft_snapshot_reader_read(raft_snapshot_reader_t* reader,
+                                         void* buf, size_t len, size_t* n);
+
+/**
+ * Close a reader
+ */
+void raft_snapshot_reader_close(raft_snapshot_reader_t* reader);
+
+/**
+ * Map a snapshot's state instead of reading it into a buffer
+ * Nothing is copied: a state machine that can parse in place serves from
+ * the mapping while the pages it has not touched are still on disk. The
+ * mapping stays valid after the file is replaced by a later snapshot.
+ * A compressed state cannot be mapped as it is; it is decompressed into
+ * anonymous memory instead, and checked on the way whatever verify says.
+ *
+ * @param data_dir Directory containing snapshot
+ * @param meta Output: snapshot metadata
+ * @param verify Check the state's CRC first, which reads every page;
+ *        without it the state is only read ahead in the background
+ * @param mapping Output: mapping handle, released with raft_snapshot_unmap
+ * @return RAFT_OK on success, RAFT_NOT_FOUND if no snapshot
+ */
+raft_status_t raft_snapshot_map(const char* data_dir,
+                                 raft_snapshot_meta_t* meta,
+                                 bool verify,
+                                 raft_snapshot_mapping_t** mapping);
+
+/**
+ * Start of the mapped state (NULL if it is empty); read-only
+ */
+const void* raft_snapshot_mapping_data(const raft_snapshot_mapping_t* mapping);
+
+/**
+ * Length of the mapped state
+ */
+size_t raft_snapshot_mapping_length(const raft_snapshot_mapping_t* mapping);
+
+/**
+ * Release a mapping; its data must not be used afterwards
+ */
+void raft_snapshot_unmap(raft_snapshot_mapping_t* mapping);
+
+/**
+ * Open the snapshot file in data_dir a peer needs, to be sent as it is on disk
+ * A peer whose snapshots reach at least the base gets the first delta
+ * past them, if that delta applies on what it holds; otherwise the base.
+ * The descriptor covers the whole file, header included, and stays
+ * readable if a newer snapshot replaces the file; the caller closes it.
+ *
+ * @param data_dir Directory containing snapshot
+ * @param peer_index Tip of the peer's snapshots (0 if unknown or none)
+ * @param meta Output: metadata of the file
+ * @param prev_index Output: snapshot point a delta applies on, 0 for the base
+ * @param fd Output: descriptor open for reading
+ * @param size Output: length of the file
+ * @return RAFT_OK on success, RAFT_NOT_FOUND if no snapshot
+ */
+raft_status_t raft_snapshot_open_file(const char* data_dir,
+                                       uint64_t peer_index,
+                                       raft_snapshot_meta_t* meta,
+                                       uint64_t* prev_index,
+                                       int* fd, uint64_t* size);
+
+/**
+ * Start receiving a snapshot file
+ * Bytes go to a temporary file; the existing snapshot stays in place
+ * until raft_snapshot_receiver_commit.
+ */
+raft_status_t raft_snapshot_receiver_open(const char* data_dir,
+                                           raft_snapshot_receiver_t** receiver);
+
+/**
+ * Write bytes of the snapshot file at offset
+ * Chunks may arrive out of order or more than once. Up to
+ * RAFT_SNAPSHOT_RECV_RANGES runs past a gap are tracked; a chunk that
+ * would need another is dropped, to be sent again.
+ */
+raft_status_t raft_snapshot_receiver_write(raft_snapshot_receiver_t* receiver,
+                                            uint64_t offset,
+                                            const void* data, size_t len);
+
+/**
+ * Get the number of bytes received without a gap from the start
+ */
+uint64_t raft_snapshot_receiver_length(raft_snapshot_receiver_t* receiver);
+
+/**
+ * Finish receiving: check the file, sync it and rename it into place
+ * The header and (for version 2) the state's CRC are verified and the
+ * file must end where the state does. Frees the receiver whatever the
+ * outcome; a file that fails the check returns RAFT_CORRUPTION.
+ *
+ * @param receiver Receiver holding the whole file
+ * @param prev_index 0 for a base, which replaces the chain; else the
+ *        snapshot point the delta applies on, which must not be past the
+ *        tip (RAFT_NOT_FOUND otherwise)
+ * @param meta Output: metadata of the received snapshot
+ */
+raft_status_t raft_snapshot_receiver_commit(raft_snapshot_receiver_t* receiver,
+                                             uint64_t prev_index,
+                                             raft_snapshot_meta_t* meta);
+
+/**
+ * Drop a snapshot being received; the existing one is left alone
+ */
+void raft_snapshot_receiver_abort(raft_snapshot_receiver_t* receiver);
+
 /**
  * Install a snapshot received from leader
  * This replaces the current state with the snapshot
@@ -80,6 +319,29 @@ raft_status_t raft_snapshot_install(raft_node_t* node,
                                      const void* state_data,
                                      size_t state_len);
 
+/**
+ * Install the snapshot already in the node's data directory
+ * Like raft_snapshot_install for a snapshot that was written in place,
+ * such as one received from the leader: the state machine is loaded
+ * from it through the restore callback, and the log is then reset to
+ * it. If the tip of the chain is a delta, only the delta is applied,
+ * through the delta restore callback.
+ *
+ * @param node Raft node to install snapshot on
+ * @param meta Output: metadata of the installed snapshot (may be NULL)
+ * @return RAFT_OK on success, RAFT_NOT_FOUND if no snapshot,
+ *         RAFT_INVALID_ARG if no restore callback could load it
+ */
+raft_status_t raft_snapshot_install_file(raft_node_t* node,
+                                          raft_snapshot_meta_t* meta);
+
+/**
+ * Check if a received snapshot could be loaded into the state machine
+ * For a base, true once a restore or mapped restore callback is set;
+ * for a delta, once a delta restore callback is.
+ */
+bool raft_snapshot_can_restore(raft_node_t* node, bool delta);
+
 /**
  * Callback for creating snapshot state data
  * Called when auto-compaction triggers a snapshot
@@ -101,6 +363,210 @@ typedef raft_status_t (*raft_snapshot_cb)(raft_node_t* node,
 void raft_set_snapshot_callback(raft_node_t* node, raft_snapshot_cb callback,
                                  void* user_data);
 
+/**
+ * Callback streaming snapshot state into a writer
+ * Called when auto-compaction triggers a snapshot. Pushes the state with
+ * raft_snapshot_writer_write; the caller commits or aborts the writer
+ * depending on the result.
+ *
+ * @param node Raft node
+ * @param writer Writer to push the state to
+ * @param user_data User context
+ * @return RAFT_OK on success
+ */
+typedef raft_status_t (*raft_snapshot_write_cb)(raft_node_t* node,
+                                                 raft_snapshot_writer_t* writer,
+                                                 void* user_data);
+
+/**
+ * Set the streaming snapshot callback for auto-compaction
+ * Takes precedence over a callback set with raft_set_snapshot_callback.
+ */
+void raft_set_snapshot_writer(raft_node_t* node, raft_snapshot_write_cb callback,
+                               void* user_data);
+
+/**
+ * Callback streaming a delta into a writer
+ * Pushes what changed after since_index, in a form that, applied to the
+ * state at any index from since_index to the delta's own, gives the
+ * state at the delta's index (every changed key or page as it now is,
+ * deletions included). A delta whose commit fails is not on the chain,
+ * so the next one is again asked for changes since the same point.
+ *
+ * @param node Raft node
+ * @param since_index Tip of the chain the delta goes on
+ * @param writer Writer to push the changes to
+ * @param user_data User context
+ * @return RAFT_OK on success
+ */
+typedef raft_status_t (*raft_snapshot_delta_cb)(raft_node_t* node,
+                                                 uint64_t since_index,
+                                                 raft_snapshot_writer_t* writer,
+                                                 void* user_data);
+
+/**
+ * Set the delta callback for auto-compaction
+ * With a base snapshot in place, compaction writes a delta instead of
+ * the whole state, until RAFT_SNAPSHOT_MAX_DELTAS are chained or they
+ * hold as much as the base. The next compaction then writes a full
+ * snapshot through the other callbacks, replacing the chain; with none
+ * set, deltas go on being chained.
+ */
+void raft_set_snapshot_delta(raft_node_t* node, raft_snapshot_delta_cb callback,
+                              void* user_data);
+
+/**
+ * Callback loading the state machine from a snapshot
+ * Called by raft_snapshot_install_file before the log is reset to the
+ * snapshot. Pulls the state with raft_snapshot_reader_read; the reader
+ * is closed by the caller.
+ *
+ * @param node Raft node
+ * @param meta Metadata of the snapshot
+ * @param reader Reader positioned at the start of the state
+ * @param user_data User context
+ * @return RAFT_OK on success
+ */
+typedef raft_status_t (*raft_snapshot_restore_cb)(raft_node_t* node,
+                                                   const raft_snapshot_meta_t* meta,
+                                                   raft_snapshot_reader_t* reader,
+                                                   void* user_data);
+
+/**
+ * Set the callback restoring state from an installed snapshot
+ */
+void raft_set_snapshot_restore(raft_node_t* node, raft_snapshot_restore_cb callback,
+                                void* user_data);
+
+/**
+ * Set the callback applying an installed delta to the state machine
+ * Called like the restore callback, with a reader on the delta.
+ */
+void raft_set_snapshot_restore_delta(raft_node_t* node, raft_snapshot_restore_cb callback,
+                                      void* user_data);
+
+/**
+ * Callback handed an installed snapshot's state as a mapping
+ * Called by raft_snapshot_install_file like raft_snapshot_restore_cb,
+ * but without copying the state. The callback owns the mapping whatever
+ * it returns, and releases it with raft_snapshot_unmap once it no longer
+ * serves from it. The file's CRCs were checked as it was received.
+ *
+ * @param node Raft node
+ * @param meta Metadata of the snapshot
+ * @param mapping The snapshot's state
+ * @param user_data User context
+ * @return RAFT_OK on success
+ */
+typedef raft_status_t (*raft_snapshot_restore_mapped_cb)(raft_node_t* node,
+                                                          const raft_snapshot_meta_t* meta,
+                                                          raft_snapshot_mapping_t* mapping,
+                                                          void* user_data);
+
+/**
+ * Set the callback restoring state from a mapping of an installed snapshot
+ * Takes precedence over a callback set with raft_set_snapshot_restore.
+ */
+void raft_set_snapshot_restore_mapped(raft_node_t* node,
+                                       raft_snapshot_restore_mapped_cb callback,
+                                       void* user_data);
+
+/**
+ * Frozen copy of the state, written to a snapshot off the node's thread
+ * write() runs on a snapshot thread while the node keeps applying and
+ * replicating, so it may only touch what the view holds; release() runs
+ * after it, on the same thread.
+ */
+typedef struct raft_snapshot_view {
+    void* state;
+    raft_status_t (*write)(void* state, raft_snapshot_writer_t* writer);
+    void (*release)(void* state);   /* NULL if nothing to free */
+} raft_snapshot_view_t;
+
+/**
+ * Callback freezing the state machine at last_applied
+ * Called on the node's thread when auto-compaction triggers. Fills in a
+ * view that stays valid while later entries are applied: a copy, or a
+ * copy-on-write reference the state machine stops mutating in place.
+ *
+ * @param node Raft node
+ * @param view View to fill in
+ * @param user_data User context
+ * @return RAFT_OK on success
+ */
+typedef raft_status_t (*raft_snapshot_freeze_cb)(raft_node_t* node,
+                                                  raft_snapshot_view_t* view,
+                                                  void* user_data);
+
+/**
+ * Set the callback for background auto-compaction
+ * Takes precedence over the other snapshot callbacks. The snapshot is
+ * written on its own thread and the log is compacted by the first
+ * raft_snapshot_poll after it is committed.
+ */
+void raft_set_snapshot_freeze(raft_node_t* node, raft_snapshot_freeze_cb callback,
+                               void* user_data);
+
+/**
+ * Callback freezing what changed after since_index
+ * Called on the node's thread, like raft_snapshot_freeze_cb, when
+ * auto-compaction writes a delta. The view's write pushes the changes as
+ * raft_snapshot_delta_cb would, but from the frozen view.
+ *
+ * @param node Raft node
+ * @param since_index Tip of the chain the delta goes on
+ * @param view View to fill in
+ * @param user_data User context
+ * @return RAFT_OK on success
+ */
+typedef raft_status_t (*raft_snapshot_freeze_delta_cb)(raft_node_t* node,
+                                                        uint64_t since_index,
+                                                        raft_snapshot_view_t* view,
+                                                        void* user_data);
+
+/**
+ * Set the callback for background delta snapshots
+ * Takes precedence over raft_set_snapshot_delta. Deltas are then written
+ * on the snapshot thread like background full snapshots. With a freeze
+ * callback but no frozen delta callback, auto-compaction writes full
+ * snapshots in the background rather than deltas on the node's thread.
+ */
+void raft_set_snapshot_freeze_delta(raft_node_t* node,
+                                     raft_snapshot_freeze_delta_cb callback,
+                                     void* user_data);
+
+/**
+ * Set the codec snapshots are written with
+ * Applies to every writer opened afterwards, auto-compaction's included;
+ * RAFT_SNAPSHOT_CODEC_NONE (the default) keeps the state as it is. With
+ * RAFT_SNAPSHOT_CODEC_LZ the state is compressed in blocks of
+ * RAFT_SNAPSHOT_BLOCK_SIZE, on RAFT_SNAPSHOT_COMPRESS_THREADS threads,
+ * and InstallSnapshot sends the compressed file. Readers handle either,
+ * whichever is set.
+ *
+ * @return RAFT_OK, or RAFT_INVALID_ARG for an unknown codec
+ */
+raft_status_t raft_set_snapshot_compression(raft_node_t* node, uint32_t codec);
+
+/**
+ * Check if a background snapshot is being written
+ */
+bool raft_snapshot_in_progress(raft_node_t* node);
+
+/**
+ * Finish a background snapshot if its thread is done
+ * Called from raft_tick. Compacts the log if the snapshot was committed.
+ *
+ * @return RAFT_OK if nothing finished or compaction succeeded, else the
+ *         error the snapshot failed with
+ */
+raft_status_t raft_snapshot_poll(raft_node_t* node);
+
+/**
+ * Block until a background snapshot is finished, then as raft_snapshot_poll
+ */
+raft_status_t raft_snapshot_wait(raft_node_t* node);
+
 /**
  * Check if log compaction should be triggered and perform it
  * Called after applying entries
@@ -1,11 +1,16 @@
 /**
- * storage.c - Persistent storage implementation for Raft state
+ * storage.c - Persistent storage for Raft state over pluggable backends
  *
- * File formats:
- * - raft_state.dat: | magic(4) | version(4) | crc32(4) | term(8) | voted_for(4) | pad(4) |
- * - raft_log.dat: Header + Entry records
- *   Header: | magic(4) | version(4) | base_index(8) | base_term(8) |
- *   Entry:  | record_len(4) | crc32(4) | term(8) | index(8) | cmd_len(4) | command(var) |
+ * A backend (raft_storage_ops_t) keeps the hard state and the log; this
+ * file layers what is common to all of them on top: the sync policy and
+ * group commit, the written/durable index bookkeeping the replication
+ * and commit paths rely on, and cutting off a partly written batch.
+ * Built-in backends live in storage_file.c, storage_mem.c and
+ * storage_mmap.c.
+ *
+ * File formats shared by the on-disk backends:
+ * - raft_terms.dat: | magic(4) | version(4) | crc32(4) | count(4) | runs(16 * count) |
+ *   Each run: | first_index(8) | term(8) |
  */
 
 #include "storage.h"
@@ -15,48 +20,44 @@
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
-#include <sys/stat.h>
 #include <errno.h>
+#include <time.h>
 
-#define STATE_FILE "raft_state.dat"
-#define LOG_FILE   "raft_log.dat"
+#define TERMS_FILE "raft_terms.dat"
 #define TEMP_SUFFIX ".tmp"
 
-/* State file structure (28 bytes) */
-typedef struct {
-    uint32_t magic;
-    uint32_t version;
-    uint32_t crc32;
-    uint64_t current_term;
-    int32_t voted_for;
-    uint32_t padding;
-} __attribute__((packed)) state_file_t;
-
-/* Log file header (24 bytes) */
+/* Term runs file header (16 bytes + runs) */
 typedef struct {
     uint32_t magic;
     uint32_t version;
-    uint64_t base_index;
-    uint64_t base_term;
-} __attribute__((packed)) log_header_t;
-
-/* Log entry record header (24 bytes + variable command) */
-typedef struct {
-    uint32_t record_len;  /* Total record length including this header */
-    uint32_t crc32;       /* CRC of term + index + cmd_len + command */
-    uint64_t term;
-    uint64_t index;
-    uint32_t cmd_len;
-} __attribute__((packed)) log_record_t;
+    uint32_t crc32;       /* CRC of count + runs */
+    uint32_t count;
+} __attribute__((packed)) terms_header_t;
 
 struct raft_storage {
+    const raft_storage_ops_t* ops;
+    void* impl;           /* Backend state */
     char* data_dir;
-    bool sync_writes;
-    int log_fd;           /* File descriptor for log file */
-    uint64_t log_entries; /* Number of entries in log */
+    bool sync_writes;     /* Sync at all: as opened, unless the policy is none */
+    bool sync_opened;     /* sync_writes as passed to open */
+    raft_sync_policy_t sync_policy;
+    uint64_t written_index;     /* Index of the last record written */
+    uint64_t durable_index;     /* Index of the last record known synced */
+    uint64_t group_commit_us;   /* Group commit window (0 = sync every append) */
+    uint64_t sync_interval_us;  /* RAFT_SYNC_INTERVAL time bound (0 = none) */
+    uint64_t sync_interval_bytes; /* RAFT_SYNC_INTERVAL payload bound (0 = none) */
+    uint64_t pending_since_us;  /* When the oldest unsynced write happened (0 = none) */
+    uint64_t pending_bytes;     /* Payload bytes appended since the last sync */
+    bool state_pending;         /* Hard state written but not yet synced */
 };
 
-static char* make_path(const char* dir, const char* file) {
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
+
+char* raft_storage_path(const char* dir, const char* file) {
     size_t len = strlen(dir) + strlen(file) + 2;
     char* path = malloc(len);
     if (path) {
@@ -105,31 +106,34 @@ static raft_status_t write_file_atomic(const char* path, const void* data,
     return RAFT_OK;
 }
 
-static uint64_t count_log_entries(int fd) {
-    log_header_t header;
-    if (lseek(fd, 0, SEEK_SET) < 0) return 0;
-    if (read(fd, &header, sizeof(header)) != sizeof(header)) return 0;
-    if (header.magic != RAFT_LOG_MAGIC) return 0;
-
-    uint64_t count = 0;
-    log_record_t rec;
-    while (read(fd, &rec, sizeof(rec)) == sizeof(rec)) {
-        if (rec.record_len < sizeof(rec)) break;
-        /* Skip command data */
-        off_t skip = rec.record_len - sizeof(rec);
-        if (lseek(fd, skip, SEEK_CUR) < 0) break;
-        count++;
+const raft_storage_ops_t* raft_storage_backend_ops(raft_storage_backend_t backend) {
+    switch (backend) {
+    case RAFT_STORAGE_FILE:   return &raft_storage_file_ops;
+    case RAFT_STORAGE_MEMORY: return &raft_storage_memory_ops;
+    case RAFT_STORAGE_MMAP:   return &raft_storage_mmap_ops;
     }
-    return count;
+    return NULL;
 }
 
 raft_storage_t* raft_storage_open(const char* data_dir, bool sync_writes) {
-    if (!data_dir) return NULL;
+    return raft_storage_open_io(data_dir, sync_writes, RAFT_IO_SYNC);
+}
 
-    /* Create directory if it doesn't exist */
-    if (mkdir(data_dir, 0755) < 0 && errno != EEXIST) {
-        return NULL;
-    }
+raft_storage_t* raft_storage_open_io(const char* data_dir, bool sync_writes,
+                                      raft_io_backend_t backend) {
+    return raft_storage_open_ops(&raft_storage_file_ops, data_dir, sync_writes, backend);
+}
+
+raft_storage_t* raft_storage_open_backend(const char* data_dir, bool sync_writes,
+                                           raft_storage_backend_t backend) {
+    return raft_storage_open_ops(raft_storage_backend_ops(backend), data_dir,
+                                 sync_writes, RAFT_IO_SYNC);
+}
+
+raft_storage_t* raft_storage_open_ops(const raft_storage_ops_t* ops,
+                                       const char* data_dir, bool sync_writes,
+                                       raft_io_backend_t io_backend) {
+    if (!ops || !data_dir) return NULL;
 
     raft_storage_t* storage = calloc(1, sizeof(raft_storage_t));
     if (!storage) return NULL;
@@ -139,271 +143,399 @@ raft_storage_t* raft_storage_open(const char* data_dir, bool sync_writes) {
         free(storage);
         return NULL;
     }
+    storage->ops = ops;
     storage->sync_writes = sync_writes;
-    storage->log_fd = -1;
+    storage->sync_opened = sync_writes;
+    storage->sync_policy = RAFT_SYNC_ALWAYS;
 
-    /* Open or create log file */
-    char* log_path = make_path(data_dir, LOG_FILE);
-    if (!log_path) {
+    storage->impl = ops->open(data_dir, sync_writes, io_backend);
+    if (!storage->impl) {
         free(storage->data_dir);
         free(storage);
         return NULL;
     }
 
-    storage->log_fd = open(log_path, O_RDWR | O_CREAT, 0644);
-    if (storage->log_fd < 0) {
-        free(log_path);
-        free(storage->data_dir);
-        free(storage);
-        return NULL;
-    }
+    uint64_t first, count;
+    ops->log_info(storage->impl, &first, &storage->written_index, &count);
+    storage->durable_index = storage->written_index;
+    return storage;
+}
 
-    /* Check if log file needs header */
-    struct stat st;
-    if (fstat(storage->log_fd, &st) == 0 && st.st_size == 0) {
-        log_header_t header = {
-            .magic = RAFT_LOG_MAGIC,
-            .version = RAFT_STORAGE_VERSION,
-            .base_index = 0,
-            .base_term = 0,
-        };
-        if (write(storage->log_fd, &header, sizeof(header)) != sizeof(header)) {
-            close(storage->log_fd);
-            free(log_path);
-            free(storage->data_dir);
-            free(storage);
-            return NULL;
-        }
-        if (sync_writes) fsync(storage->log_fd);
-    }
+const char* raft_storage_backend_name(raft_storage_t* storage) {
+    return storage ? storage->ops->name : NULL;
+}
 
-    storage->log_entries = count_log_entries(storage->log_fd);
-    free(log_path);
-    return storage;
+/* Whether syncs are queued and complete later, seen by raft_storage_poll */
+static bool storage_async(raft_storage_t* storage) {
+    return storage->ops->io_backend &&
+           storage->ops->io_backend(storage->impl) == RAFT_IO_URING;
+}
+
+raft_io_backend_t raft_storage_io_backend(raft_storage_t* storage) {
+    return storage && storage_async(storage) ? RAFT_IO_URING : RAFT_IO_SYNC;
 }
 
 void raft_storage_close(raft_storage_t* storage) {
     if (!storage) return;
-    if (storage->log_fd >= 0) {
-        close(storage->log_fd);
-    }
+    storage->ops->close(storage->impl);
     free(storage->data_dir);
     free(storage);
 }
 
-raft_status_t raft_storage_save_state(raft_storage_t* storage,
-                                       uint64_t current_term,
-                                       int32_t voted_for) {
-    if (!storage) return RAFT_INVALID_ARG;
-
-    state_file_t state = {
-        .magic = RAFT_STATE_MAGIC,
-        .version = RAFT_STORAGE_VERSION,
-        .current_term = current_term,
-        .voted_for = voted_for,
-        .padding = 0,
-    };
+/* Make every written record durable */
+static raft_status_t log_sync(raft_storage_t* storage) {
+    raft_status_t status = storage->ops->sync(storage->impl);
+    if (status != RAFT_OK) return status;
+    storage->durable_index = storage->written_index;
+    storage->pending_since_us = 0;
+    storage->pending_bytes = 0;
+    storage->state_pending = false;
+    return RAFT_OK;
+}
 
-    /* Calculate CRC over term and voted_for */
-    state.crc32 = crc32(&state.current_term, sizeof(state.current_term) + sizeof(state.voted_for));
+raft_status_t raft_storage_stage_state(raft_storage_t* storage,
+                                        uint64_t current_term,
+                                        int32_t voted_for) {
+    if (!storage) return RAFT_INVALID_ARG;
+    raft_status_t status = storage->ops->write_state(storage->impl, current_term, voted_for);
+    if (status == RAFT_OK && storage->sync_writes) storage->state_pending = true;
+    return status;
+}
 
-    char* path = make_path(storage->data_dir, STATE_FILE);
-    if (!path) return RAFT_NO_MEMORY;
+raft_status_t raft_storage_sync_state(raft_storage_t* storage) {
+    if (!storage) return RAFT_INVALID_ARG;
+    return storage->state_pending ? log_sync(storage) : RAFT_OK;
+}
 
-    raft_status_t status = write_file_atomic(path, &state, sizeof(state), storage->sync_writes);
-    free(path);
-    return status;
+raft_status_t raft_storage_save_state(raft_storage_t* storage,
+                                       uint64_t current_term,
+                                       int32_t voted_for) {
+    raft_status_t status = raft_storage_stage_state(storage, current_term, voted_for);
+    if (status != RAFT_OK) return status;
+    return raft_storage_sync_state(storage);
 }
 
 raft_status_t raft_storage_load_state(raft_storage_t* storage,
                                        uint64_t* current_term,
                                        int32_t* voted_for) {
     if (!storage || !current_term || !voted_for) return RAFT_INVALID_ARG;
+    return storage->ops->load_state(storage->impl, current_term, voted_for);
+}
 
-    char* path = make_path(storage->data_dir, STATE_FILE);
-    if (!path) return RAFT_NO_MEMORY;
+raft_status_t raft_storage_append_entry(raft_storage_t* storage,
+                                         const raft_entry_t* entry) {
+    return raft_storage_append_entries(storage, entry, 1);
+}
 
-    int fd = open(path, O_RDONLY);
-    free(path);
-    if (fd < 0) {
-        if (errno == ENOENT) return RAFT_NOT_FOUND;
-        return RAFT_IO_ERROR;
-    }
+/* Start syncing every written record; with io_uring durable_index only
+ * moves once raft_storage_poll sees the sync complete */
+static raft_status_t log_sync_start(raft_storage_t* storage) {
+    if (!storage_async(storage)) return log_sync(storage);
+    storage->pending_since_us = 0;
+    storage->pending_bytes = 0;
+    return storage->ops->sync_submit(storage->impl);
+}
 
-    state_file_t state;
-    ssize_t n = read(fd, &state, sizeof(state));
-    close(fd);
+/* Whether unsynced appends have waited long enough, or piled up enough
+ * bytes, that the policy wants them synced now. RAFT_SYNC_BATCH never
+ * syncs on its own account; its callers ask for it. */
+static bool sync_due(raft_storage_t* storage, uint64_t now) {
+    if (storage->pending_since_us == 0) return false;
+    if (storage->sync_policy == RAFT_SYNC_BATCH) return false;
+    if (storage->sync_policy != RAFT_SYNC_INTERVAL) {
+        return now - storage->pending_since_us >= storage->group_commit_us;
+    }
 
-    if (n != sizeof(state)) return RAFT_IO_ERROR;
-    if (state.magic != RAFT_STATE_MAGIC) return RAFT_CORRUPTION;
-    if (state.version != RAFT_STORAGE_VERSION) return RAFT_CORRUPTION;
+    if (storage->sync_interval_bytes != 0 &&
+        storage->pending_bytes >= storage->sync_interval_bytes) {
+        return true;
+    }
+    if (storage->sync_interval_us == 0) return storage->sync_interval_bytes == 0;
+    return now - storage->pending_since_us >= storage->sync_interval_us;
+}
 
-    /* Verify CRC */
-    uint32_t expected_crc = crc32(&state.current_term,
-                                   sizeof(state.current_term) + sizeof(state.voted_for));
-    if (state.crc32 != expected_crc) return RAFT_CORRUPTION;
+raft_status_t raft_storage_append_entries(raft_storage_t* storage,
+                                           const raft_entry_t* entries,
+                                           size_t count) {
+    if (!storage || !entries) return RAFT_INVALID_ARG;
+    if (count == 0) return RAFT_OK;
+
+    raft_status_t status = storage->ops->append(storage->impl, entries, count);
+
+    uint64_t prev_written = storage->written_index;
+    if (status == RAFT_OK) {
+        storage->written_index = entries[count - 1].index;
+        if (!storage->sync_writes) {
+            storage->durable_index = storage->written_index;
+        } else {
+            /* Group commit: the append that makes a sync due syncs
+             * everything written since the oldest unsynced one */
+            uint64_t now = now_us();
+            if (storage->pending_since_us == 0) storage->pending_since_us = now;
+            for (size_t i = 0; i < count; i++) {
+                storage->pending_bytes += entries[i].command_len;
+            }
+            if (sync_due(storage, now)) status = log_sync_start(storage);
+        }
+    }
 
-    *current_term = state.current_term;
-    *voted_for = state.voted_for;
+    /* Never leave part of a batch behind */
+    if (status != RAFT_OK) {
+        storage->written_index = prev_written;
+        if (storage->ops->truncate_after(storage->impl, prev_written) != RAFT_OK) {
+            return RAFT_IO_ERROR;
+        }
+        return status;
+    }
     return RAFT_OK;
 }
 
-raft_status_t raft_storage_append_entry(raft_storage_t* storage,
-                                         const raft_entry_t* entry) {
-    if (!storage || !entry) return RAFT_INVALID_ARG;
-    if (storage->log_fd < 0) return RAFT_IO_ERROR;
-
-    /* Seek to end of file */
-    if (lseek(storage->log_fd, 0, SEEK_END) < 0) return RAFT_IO_ERROR;
-
-    /* Prepare record */
-    log_record_t rec = {
-        .record_len = sizeof(log_record_t) + entry->command_len,
-        .term = entry->term,
-        .index = entry->index,
-        .cmd_len = (uint32_t)entry->command_len,
-    };
-
-    /* Calculate CRC over term, index, cmd_len, and command */
-    uint32_t crc = crc32(&rec.term, sizeof(rec.term) + sizeof(rec.index) + sizeof(rec.cmd_len));
-    if (entry->command && entry->command_len > 0) {
-        crc = crc32_update(crc, entry->command, entry->command_len);
+raft_status_t raft_storage_set_group_commit(raft_storage_t* storage,
+                                             uint64_t window_us) {
+    if (!storage) return RAFT_INVALID_ARG;
+    storage->group_commit_us = window_us;
+    if (window_us == 0 && storage->pending_since_us != 0) {
+        return log_sync(storage);
     }
-    rec.crc32 = crc;
+    return RAFT_OK;
+}
 
-    /* Write record header */
-    if (write(storage->log_fd, &rec, sizeof(rec)) != sizeof(rec)) {
-        return RAFT_IO_ERROR;
-    }
+raft_status_t raft_storage_set_sync_policy(raft_storage_t* storage,
+                                           raft_sync_policy_t policy,
+                                           uint64_t interval_us,
+                                           uint64_t interval_bytes) {
+    if (!storage) return RAFT_INVALID_ARG;
+    if ((unsigned)policy > RAFT_SYNC_NONE) return RAFT_INVALID_ARG;
 
-    /* Write command data */
-    if (entry->command && entry->command_len > 0) {
-        if (write(storage->log_fd, entry->command, entry->command_len) != (ssize_t)entry->command_len) {
-            return RAFT_IO_ERROR;
-        }
+    /* Whatever the old policy left unsynced is synced under it */
+    if (storage->pending_since_us != 0 || storage->state_pending) {
+        raft_status_t status = log_sync(storage);
+        if (status != RAFT_OK) return status;
     }
 
-    if (storage->sync_writes && fsync(storage->log_fd) < 0) {
-        return RAFT_IO_ERROR;
+    storage->sync_policy = policy;
+    storage->sync_interval_us = interval_us;
+    storage->sync_interval_bytes = interval_bytes;
+    storage->sync_writes = storage->sync_opened && policy != RAFT_SYNC_NONE;
+    return RAFT_OK;
+}
+
+raft_sync_policy_t raft_storage_sync_policy(raft_storage_t* storage) {
+    return storage ? storage->sync_policy : RAFT_SYNC_ALWAYS;
+}
+
+raft_status_t raft_storage_sync_if_due(raft_storage_t* storage) {
+    if (!storage) return RAFT_INVALID_ARG;
+    if (!sync_due(storage, now_us())) return RAFT_OK;
+    return log_sync_start(storage);
+}
+
+raft_status_t raft_storage_sync_for_ack(raft_storage_t* storage) {
+    if (!storage) return RAFT_INVALID_ARG;
+    if (storage->sync_policy != RAFT_SYNC_BATCH) return RAFT_OK;
+    if (storage->durable_index >= storage->written_index && !storage->state_pending) {
+        return RAFT_OK;
     }
+    return log_sync(storage);
+}
 
-    storage->log_entries++;
-    return RAFT_OK;
+raft_status_t raft_storage_poll(raft_storage_t* storage) {
+    if (!storage) return RAFT_INVALID_ARG;
+    if (!storage_async(storage)) return RAFT_OK;
+
+    uint64_t synced;
+    raft_status_t status = storage->ops->poll(storage->impl, &synced);
+    if (synced > storage->written_index) synced = storage->written_index;
+    if (synced > storage->durable_index) storage->durable_index = synced;
+    return status;
+}
+
+uint64_t raft_storage_durable_index(raft_storage_t* storage) {
+    return storage ? storage->durable_index : 0;
 }
 
 raft_status_t raft_storage_truncate_log(raft_storage_t* storage,
                                          uint64_t after_index) {
     if (!storage) return RAFT_INVALID_ARG;
-    if (storage->log_fd < 0) return RAFT_IO_ERROR;
 
-    /* Seek to start of entries */
-    if (lseek(storage->log_fd, sizeof(log_header_t), SEEK_SET) < 0) {
-        return RAFT_IO_ERROR;
+    raft_status_t status = storage->ops->truncate_after(storage->impl, after_index);
+    if (status != RAFT_OK) return status;
+
+    uint64_t first, last_kept, count;
+    storage->ops->log_info(storage->impl, &first, &last_kept, &count);
+    storage->written_index = last_kept;
+    if (storage->durable_index > last_kept) storage->durable_index = last_kept;
+
+    if (storage->sync_writes) return log_sync(storage);
+    return RAFT_OK;
+}
+
+raft_status_t raft_storage_compact_log(raft_storage_t* storage,
+                                        uint64_t upto_index) {
+    if (!storage) return RAFT_INVALID_ARG;
+    return storage->ops->compact(storage->impl, upto_index);
+}
+
+raft_status_t raft_storage_set_recovery_threads(raft_storage_t* storage,
+                                                 size_t threads) {
+    if (!storage) return RAFT_INVALID_ARG;
+    if (storage->ops->set_recovery_threads) {
+        storage->ops->set_recovery_threads(storage->impl, threads);
     }
+    return RAFT_OK;
+}
 
-    off_t truncate_pos = sizeof(log_header_t);
-    uint64_t count = 0;
-    log_record_t rec;
+raft_status_t raft_storage_set_segment_size(raft_storage_t* storage,
+                                             size_t segment_size) {
+    if (!storage || segment_size == 0) return RAFT_INVALID_ARG;
+    if (storage->ops->set_segment_size) {
+        storage->ops->set_segment_size(storage->impl, segment_size);
+    }
+    return RAFT_OK;
+}
 
-    while (read(storage->log_fd, &rec, sizeof(rec)) == sizeof(rec)) {
-        if (rec.index > after_index) {
-            /* Truncate here */
-            break;
-        }
-        truncate_pos = lseek(storage->log_fd, 0, SEEK_CUR);
-        if (truncate_pos < 0) return RAFT_IO_ERROR;
-        /* Skip command data */
-        off_t skip = rec.record_len - sizeof(rec);
-        if (skip > 0 && lseek(storage->log_fd, skip, SEEK_CUR) < 0) {
-            return RAFT_IO_ERROR;
-        }
-        truncate_pos = lseek(storage->log_fd, 0, SEEK_CUR);
-        count++;
+raft_status_t raft_storage_save_term_runs(raft_storage_t* storage,
+                                           const raft_term_run_t* runs,
+                                           size_t count) {
+    if (!storage || (count > 0 && !runs)) return RAFT_INVALID_ARG;
+    return storage->ops->save_term_runs(storage->impl, runs, count);
+}
+
+raft_status_t raft_storage_load_term_runs(raft_storage_t* storage,
+                                           raft_term_run_t** runs,
+                                           size_t* count) {
+    if (!storage || !runs || !count) return RAFT_INVALID_ARG;
+    return storage->ops->load_term_runs(storage->impl, runs, count);
+}
+
+raft_status_t raft_storage_write_term_runs(const char* data_dir,
+                                            const raft_term_run_t* runs,
+                                            size_t count, bool sync) {
+    size_t runs_len = count * sizeof(raft_term_run_t);
+    char* buf = malloc(sizeof(terms_header_t) + runs_len);
+    if (!buf) return RAFT_NO_MEMORY;
+
+    terms_header_t* header = (terms_header_t*)buf;
+    header->magic = RAFT_TERMS_MAGIC;
+    header->version = RAFT_STORAGE_VERSION;
+    header->count = (uint32_t)count;
+    if (runs_len > 0) memcpy(buf + sizeof(*header), runs, runs_len);
+    header->crc32 = crc32(&header->count, sizeof(header->count) + runs_len);
+
+    char* path = raft_storage_path(data_dir, TERMS_FILE);
+    if (!path) {
+        free(buf);
+        return RAFT_NO_MEMORY;
     }
 
-    if (ftruncate(storage->log_fd, truncate_pos) < 0) {
+    raft_status_t status = write_file_atomic(path, buf, sizeof(*header) + runs_len, sync);
+    free(path);
+    free(buf);
+    return status;
+}
+
+raft_status_t raft_storage_read_term_runs(const char* data_dir,
+                                           raft_term_run_t** runs,
+                                           size_t* count) {
+    char* path = raft_storage_path(data_dir, TERMS_FILE);
+    if (!path) return RAFT_NO_MEMORY;
+
+    int fd = open(path, O_RDONLY);
+    free(path);
+    if (fd < 0) {
+        if (errno == ENOENT) return RAFT_NOT_FOUND;
         return RAFT_IO_ERROR;
     }
 
-    if (storage->sync_writes && fsync(storage->log_fd) < 0) {
+    terms_header_t header;
+    if (read(fd, &header, sizeof(header)) != sizeof(header)) {
+        close(fd);
         return RAFT_IO_ERROR;
     }
+    if (header.magic != RAFT_TERMS_MAGIC || header.version != RAFT_STORAGE_VERSION) {
+        close(fd);
+        return RAFT_CORRUPTION;
+    }
 
-    storage->log_entries = count;
+    size_t runs_len = (size_t)header.count * sizeof(raft_term_run_t);
+    raft_term_run_t* loaded = malloc(runs_len ? runs_len : 1);
+    if (!loaded) {
+        close(fd);
+        return RAFT_NO_MEMORY;
+    }
+    ssize_t n = read(fd, loaded, runs_len);
+    close(fd);
+    if (n != (ssize_t)runs_len) {
+        free(loaded);
+        return RAFT_IO_ERROR;
+    }
+
+    uint32_t crc = crc32(&header.count, sizeof(header.count));
+    crc = crc32_update(crc, loaded, runs_len);
+    if (crc != header.crc32) {
+        free(loaded);
+        return RAFT_CORRUPTION;
+    }
+
+    *runs = loaded;
+    *count = header.count;
     return RAFT_OK;
 }
 
 raft_status_t raft_storage_sync(raft_storage_t* storage) {
     if (!storage) return RAFT_INVALID_ARG;
-    if (storage->log_fd >= 0 && fsync(storage->log_fd) < 0) {
-        return RAFT_IO_ERROR;
-    }
-    return RAFT_OK;
+    return log_sync(storage);
 }
 
 const char* raft_storage_get_dir(raft_storage_t* storage) {
     return storage ? storage->data_dir : NULL;
 }
 
+/* Hands each shared record to a copying iterator's callback */
+typedef struct {
+    raft_log_iter_fn fn;
+    void* ctx;
+} copy_iter_t;
+
+static raft_status_t copy_iter_cb(void* ctx, uint64_t term, uint64_t index,
+                                  raft_buf_t* owner, const char* command,
+                                  size_t command_len) {
+    (void)owner;
+    copy_iter_t* iter = ctx;
+    return iter->fn(iter->ctx, term, index, command, command_len);
+}
+
 raft_status_t raft_storage_iterate_log(raft_storage_t* storage,
                                         raft_log_iter_fn fn,
                                         void* ctx) {
     if (!storage || !fn) return RAFT_INVALID_ARG;
-    if (storage->log_fd < 0) return RAFT_IO_ERROR;
-
-    /* Seek to start of entries */
-    if (lseek(storage->log_fd, sizeof(log_header_t), SEEK_SET) < 0) {
-        return RAFT_IO_ERROR;
-    }
-
-    log_record_t rec;
-    char* cmd_buf = NULL;
-    size_t cmd_buf_size = 0;
-
-    while (read(storage->log_fd, &rec, sizeof(rec)) == sizeof(rec)) {
-        if (rec.record_len < sizeof(rec)) {
-            free(cmd_buf);
-            return RAFT_CORRUPTION;
-        }
+    copy_iter_t iter = { .fn = fn, .ctx = ctx };
+    return storage->ops->iterate(storage->impl, copy_iter_cb, &iter);
+}
 
-        /* Read command data */
-        size_t cmd_len = rec.cmd_len;
-        if (cmd_len > 0) {
-            if (cmd_len > cmd_buf_size) {
-                char* new_buf = realloc(cmd_buf, cmd_len);
-                if (!new_buf) {
-                    free(cmd_buf);
-                    return RAFT_NO_MEMORY;
-                }
-                cmd_buf = new_buf;
-                cmd_buf_size = cmd_len;
-            }
-            if (read(storage->log_fd, cmd_buf, cmd_len) != (ssize_t)cmd_len) {
-                free(cmd_buf);
-                return RAFT_IO_ERROR;
-            }
-        }
+raft_status_t raft_storage_iterate_log_mapped(raft_storage_t* storage,
+                                               raft_log_iter_shared_fn fn,
+                                               void* ctx) {
+    if (!storage || !fn) return RAFT_INVALID_ARG;
+    return storage->ops->iterate(storage->impl, fn, ctx);
+}
 
-        /* Verify CRC */
-        uint32_t crc = crc32(&rec.term, sizeof(rec.term) + sizeof(rec.index) + sizeof(rec.cmd_len));
-        if (cmd_len > 0) {
-            crc = crc32_update(crc, cmd_buf, cmd_len);
-        }
-        if (crc != rec.crc32) {
-            free(cmd_buf);
-            return RAFT_CORRUPTION;
-        }
+raft_status_t raft_storage_read_entry(raft_storage_t* storage, uint64_t index,
+                                       raft_entry_t* out) {
+    if (!storage || !out || index == 0) return RAFT_INVALID_ARG;
+    return storage->ops->read_entry(storage->impl, index, out);
+}
 
-        /* Call callback */
-        raft_status_t status = fn(ctx, rec.term, rec.index, cmd_buf, cmd_len);
-        if (status != RAFT_OK) {
-            free(cmd_buf);
-            return status;
-        }
-    }
+raft_status_t raft_storage_read_range(raft_storage_t* storage,
+                                       uint64_t lo, uint64_t hi,
+                                       raft_entry_t* out, void** data) {
+    if (!storage) return RAFT_INVALID_ARG;
+    return storage->ops->read_range(storage->impl, lo, hi, out, data);
+}
 
-    free(cmd_buf);
-    return RAFT_OK;
+uint64_t raft_storage_log_bytes(raft_storage_t* storage) {
+    if (!storage || !storage->ops->log_bytes) return 0;
+    return storage->ops->log_bytes(storage->impl);
 }
 
 raft_status_t raft_storage_get_log_info(raft_storage_t* storage,
@@ -411,20 +543,11 @@ raft_status_t raft_storage_get_log_info(raft_storage_t* storage,
                                          uint64_t* base_term,
                                          uint64_t* entry_count) {
     if (!storage) return RAFT_INVALID_ARG;
-    if (storage->log_fd < 0) return RAFT_IO_ERROR;
-
-    if (lseek(storage->log_fd, 0, SEEK_SET) < 0) return RAFT_IO_ERROR;
-
-    log_header_t header;
-    if (read(storage->log_fd, &header, sizeof(header)) != sizeof(header)) {
-        return RAFT_IO_ERROR;
-    }
-
-    if (header.magic != RAFT_LOG_MAGIC) return RAFT_CORRUPTION;
-
-    if (base_index) *base_index = header.base_index;
-    if (base_term) *base_term = header.base_term;
-    if (entry_count) *entry_count = storage->log_entries;
 
+    uint64_t first, last, count;
+    storage->ops->log_info(storage->impl, &first, &last, &count);
+    if (base_index) *base_index = first ? first - 1 : 0;
+    if (base_term) *base_term = 0;
+    if (entry_count) *entry_count = count;
     return RAFT_OK;
 }
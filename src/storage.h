@@ -4,19 +4,85 @@
  * Provides durable storage for:
  * - current_term and voted_for (must survive crashes)
  * - Log entries
+ *
+ * Where they live is up to a backend (raft_storage_ops_t): WAL segments
+ * by default (see wal.h), process memory, or one mapped log file.
  */
 
 #ifndef RAFT_STORAGE_H
 #define RAFT_STORAGE_H
 
 #include "types.h"
+#include "wal.h"
 
 #define RAFT_STATE_MAGIC    0x52414654  /* "RAFT" */
-#define RAFT_LOG_MAGIC      0x524C4F47  /* "RLOG" */
+#define RAFT_TERMS_MAGIC    0x5254524D  /* "RTRM" */
 #define RAFT_STORAGE_VERSION 1
+#define RAFT_STATE_VERSION   2      /* Double-buffered state slots */
+#define RAFT_STATE_VERSION_V1 1     /* Single-slot state file, read only */
 
 typedef struct raft_storage raft_storage_t;
 
+/**
+ * Storage backend operations
+ * A backend does the raw work of keeping hard state and log entries;
+ * storage.c layers the sync policy, group commit and durable-index
+ * bookkeeping on top. Nothing written needs to be durable before sync
+ * returns. Entries marked optional may be NULL.
+ */
+struct raft_storage_ops {
+    const char* name;
+
+    /* Open the backend's state for data_dir; NULL on failure */
+    void* (*open)(const char* data_dir, bool sync_writes, raft_io_backend_t io_backend);
+    void (*close)(void* impl);
+
+    /* Hard state; load returns RAFT_NOT_FOUND if none was ever written */
+    raft_status_t (*write_state)(void* impl, uint64_t current_term, int32_t voted_for);
+    raft_status_t (*load_state)(void* impl, uint64_t* current_term, int32_t* voted_for);
+
+    /* Log; a failed append may leave part of the batch for truncate_after
+     * to cut off. Reads behave like raft_storage_read_entry/_read_range. */
+    raft_status_t (*append)(void* impl, const raft_entry_t* entries, size_t count);
+    raft_status_t (*truncate_after)(void* impl, uint64_t after_index);
+    raft_status_t (*read_entry)(void* impl, uint64_t index, raft_entry_t* out);
+    raft_status_t (*read_range)(void* impl, uint64_t lo, uint64_t hi,
+                                raft_entry_t* out, void** data);
+    raft_status_t (*iterate)(void* impl, raft_log_iter_shared_fn fn, void* ctx);
+    void (*log_info)(void* impl, uint64_t* first_index, uint64_t* last_index,
+                     uint64_t* count);
+    uint64_t (*log_bytes)(void* impl);  /* Bytes the log takes up, optional */
+
+    /* Durability; sync_submit and poll are only used when io_backend
+     * (optional) reports RAFT_IO_URING */
+    raft_status_t (*sync)(void* impl);
+    raft_status_t (*sync_submit)(void* impl);
+    raft_status_t (*poll)(void* impl, uint64_t* synced_index);
+    raft_io_backend_t (*io_backend)(void* impl);
+
+    /* Snapshot hooks: drop the covered prefix, keep compacted terms */
+    raft_status_t (*compact)(void* impl, uint64_t upto_index);
+    raft_status_t (*save_term_runs)(void* impl, const raft_term_run_t* runs, size_t count);
+    raft_status_t (*load_term_runs)(void* impl, raft_term_run_t** runs, size_t* count);
+
+    /* Tuning, optional */
+    void (*set_recovery_threads)(void* impl, size_t threads);
+    void (*set_segment_size)(void* impl, size_t segment_size);
+};
+
+/** WAL segments plus state file (storage_file.c) */
+extern const raft_storage_ops_t raft_storage_file_ops;
+/** Process memory (storage_mem.c) */
+extern const raft_storage_ops_t raft_storage_memory_ops;
+/** One memory-mapped append-only log file (storage_mmap.c) */
+extern const raft_storage_ops_t raft_storage_mmap_ops;
+
+/**
+ * Get the operations of a built-in backend
+ * @return NULL for an unknown backend
+ */
+const raft_storage_ops_t* raft_storage_backend_ops(raft_storage_backend_t backend);
+
 /**
  * Open persistent storage
  * @param data_dir Directory for storage files
@@ -25,6 +91,49 @@ typedef struct raft_storage raft_storage_t;
  */
 raft_storage_t* raft_storage_open(const char* data_dir, bool sync_writes);
 
+/**
+ * Open persistent storage with a chosen WAL I/O backend
+ * With RAFT_IO_URING, appends and syncs are queued on io_uring and only
+ * become durable once raft_storage_poll has seen them complete. Falls
+ * back to RAFT_IO_SYNC where io_uring is unavailable; see
+ * raft_storage_io_backend.
+ */
+raft_storage_t* raft_storage_open_io(const char* data_dir, bool sync_writes,
+                                      raft_io_backend_t backend);
+
+/**
+ * Open persistent storage on a built-in backend with RAFT_IO_SYNC
+ */
+raft_storage_t* raft_storage_open_backend(const char* data_dir, bool sync_writes,
+                                           raft_storage_backend_t backend);
+
+/**
+ * Open persistent storage on any backend
+ * io_backend is passed on to ops->open; backends without asynchronous
+ * I/O ignore it.
+ */
+raft_storage_t* raft_storage_open_ops(const raft_storage_ops_t* ops,
+                                       const char* data_dir, bool sync_writes,
+                                       raft_io_backend_t io_backend);
+
+/**
+ * Get the name of the backend storage runs on
+ */
+const char* raft_storage_backend_name(raft_storage_t* storage);
+
+/**
+ * Get the WAL I/O backend storage actually runs on
+ */
+raft_io_backend_t raft_storage_io_backend(raft_storage_t* storage);
+
+/**
+ * Reap completed asynchronous WAL I/O without blocking
+ * Advances raft_storage_durable_index past syncs that have finished.
+ * A no-op for RAFT_IO_SYNC. Returns RAFT_IO_ERROR once a queued write
+ * or sync has failed.
+ */
+raft_status_t raft_storage_poll(raft_storage_t* storage);
+
 /**
  * Close storage and release resources
  */
@@ -32,15 +141,33 @@ void raft_storage_close(raft_storage_t* storage);
 
 /**
  * Save current_term and voted_for to stable storage
- * Must be called before responding to RPCs
+ * Writes a hard-state record to the WAL and syncs it (along with any
+ * entries written before it). Must be called before responding to RPCs.
  */
 raft_status_t raft_storage_save_state(raft_storage_t* storage,
                                        uint64_t current_term,
                                        int32_t voted_for);
 
+/**
+ * Write current_term and voted_for to the WAL without syncing
+ * The next sync of the log makes it durable with the entries; call
+ * raft_storage_sync_state before replying in case none comes.
+ */
+raft_status_t raft_storage_stage_state(raft_storage_t* storage,
+                                        uint64_t current_term,
+                                        int32_t voted_for);
+
+/**
+ * Sync the WAL if hard state was staged and is not yet durable
+ */
+raft_status_t raft_storage_sync_state(raft_storage_t* storage);
+
 /**
  * Load current_term and voted_for from storage
- * Returns RAFT_NOT_FOUND if no state file exists
+ * Takes the newest of the last hard-state record in the WAL and the
+ * state file, which holds hard state whose record was cut or compacted.
+ * Returns RAFT_NOT_FOUND if neither has any, RAFT_CORRUPTION if the
+ * state file exists but no slot of it checks out.
  */
 raft_status_t raft_storage_load_state(raft_storage_t* storage,
                                        uint64_t* current_term,
@@ -52,6 +179,62 @@ raft_status_t raft_storage_load_state(raft_storage_t* storage,
 raft_status_t raft_storage_append_entry(raft_storage_t* storage,
                                          const raft_entry_t* entry);
 
+/**
+ * Append several log entries with one vectored write and at most one sync
+ * Entries must be consecutive. On failure nothing from the batch is left
+ * in the log file.
+ */
+raft_status_t raft_storage_append_entries(raft_storage_t* storage,
+                                           const raft_entry_t* entries,
+                                           size_t count);
+
+/**
+ * Set the group-commit window for log appends
+ * With a non-zero window, appends are written immediately but synced
+ * together: the first append after the window has elapsed (or a call to
+ * raft_storage_sync_if_due / raft_storage_sync) issues one fdatasync for
+ * everything written since the window opened. 0 syncs every append.
+ */
+raft_status_t raft_storage_set_group_commit(raft_storage_t* storage,
+                                             uint64_t window_us);
+
+/**
+ * Choose when appends are synced (RAFT_SYNC_ALWAYS when opened)
+ * ALWAYS syncs each append, or each group-commit window of them. BATCH
+ * leaves appends unsynced until raft_storage_sync_for_ack. INTERVAL
+ * syncs once interval_us has passed since the oldest unsynced append
+ * or interval_bytes of payload have built up, whichever comes first
+ * (both 0 syncs every append). NONE never syncs, term/vote changes
+ * included, and treats every write as durable. Anything pending is
+ * synced before the policy changes.
+ */
+raft_status_t raft_storage_set_sync_policy(raft_storage_t* storage,
+                                           raft_sync_policy_t policy,
+                                           uint64_t interval_us,
+                                           uint64_t interval_bytes);
+
+/**
+ * Get the sync policy in effect
+ */
+raft_sync_policy_t raft_storage_sync_policy(raft_storage_t* storage);
+
+/**
+ * Sync pending appends if the policy wants them synced by now
+ * Nothing is ever due under RAFT_SYNC_BATCH.
+ */
+raft_status_t raft_storage_sync_if_due(raft_storage_t* storage);
+
+/**
+ * Sync what RAFT_SYNC_BATCH has held back, before it is acked or counted
+ * towards a commit; a no-op under any other policy
+ */
+raft_status_t raft_storage_sync_for_ack(raft_storage_t* storage);
+
+/**
+ * Get the index of the last log record known to be on stable storage
+ */
+uint64_t raft_storage_durable_index(raft_storage_t* storage);
+
 /**
  * Truncate log after given index (for conflict resolution)
  * Removes all entries with index > after_index
@@ -59,6 +242,62 @@ raft_status_t raft_storage_append_entry(raft_storage_t* storage,
 raft_status_t raft_storage_truncate_log(raft_storage_t* storage,
                                          uint64_t after_index);
 
+/**
+ * Drop WAL segments whose entries are all at or below upto_index
+ * Called once a snapshot covers upto_index. Entries sharing a segment
+ * with later ones stay until the whole segment is covered.
+ */
+raft_status_t raft_storage_compact_log(raft_storage_t* storage,
+                                        uint64_t upto_index);
+
+/**
+ * Set how many threads check WAL CRCs in raft_storage_iterate_log_mapped
+ * 0 means one per online CPU, the default. Ignored by other backends.
+ */
+raft_status_t raft_storage_set_recovery_threads(raft_storage_t* storage,
+                                                 size_t threads);
+
+/**
+ * Set the preallocated size of WAL segments created from now on
+ * Defaults to RAFT_WAL_SEGMENT_SIZE. Ignored by other backends.
+ */
+raft_status_t raft_storage_set_segment_size(raft_storage_t* storage,
+                                             size_t segment_size);
+
+/**
+ * Read a single log entry back from storage
+ * On success out->command is a malloc'd copy the caller must free.
+ * One pread at the entry's indexed offset; returns RAFT_NOT_FOUND if
+ * no segment holds index.
+ */
+raft_status_t raft_storage_read_entry(raft_storage_t* storage, uint64_t index,
+                                       raft_entry_t* out);
+
+/**
+ * Read entries lo..hi back from storage, one pread per WAL segment
+ * out must hold hi - lo + 1 entries; their commands point into *data,
+ * which the caller frees. Returns RAFT_NOT_FOUND unless all are stored.
+ */
+raft_status_t raft_storage_read_range(raft_storage_t* storage,
+                                       uint64_t lo, uint64_t hi,
+                                       raft_entry_t* out, void** data);
+
+/**
+ * Save the log's term runs alongside the log
+ * Needed so terms of compacted entries survive a restart.
+ */
+raft_status_t raft_storage_save_term_runs(raft_storage_t* storage,
+                                           const raft_term_run_t* runs,
+                                           size_t count);
+
+/**
+ * Load term runs saved by raft_storage_save_term_runs
+ * Caller must free *runs. Returns RAFT_NOT_FOUND if none were saved.
+ */
+raft_status_t raft_storage_load_term_runs(raft_storage_t* storage,
+                                           raft_term_run_t** runs,
+                                           size_t* count);
+
 /**
  * Sync all pending writes to disk
  */
@@ -69,15 +308,6 @@ raft_status_t raft_storage_sync(raft_storage_t* storage);
  */
 const char* raft_storage_get_dir(raft_storage_t* storage);
 
-/**
- * Callback type for iterating over log entries during recovery
- */
-typedef raft_status_t (*raft_log_iter_fn)(void* ctx,
-                                           uint64_t term,
-                                           uint64_t index,
-                                           const char* command,
-                                           size_t command_len);
-
 /**
  * Iterate over all log entries in storage
  * Calls fn for each entry in order
@@ -86,6 +316,20 @@ raft_status_t raft_storage_iterate_log(raft_storage_t* storage,
                                         raft_log_iter_fn fn,
                                         void* ctx);
 
+/**
+ * Iterate over all log entries with commands left where the backend
+ * keeps them (a mapping of the WAL, see raft_wal_iterate_mapped)
+ */
+raft_status_t raft_storage_iterate_log_mapped(raft_storage_t* storage,
+                                               raft_log_iter_shared_fn fn,
+                                               void* ctx);
+
+/**
+ * Get the bytes the backend's log takes up where it is kept
+ * 0 for backends that do not report it.
+ */
+uint64_t raft_storage_log_bytes(raft_storage_t* storage);
+
 /**
  * Get log metadata (base_index, base_term, entry_count)
  */
@@ -94,4 +338,32 @@ raft_status_t raft_storage_get_log_info(raft_storage_t* storage,
                                          uint64_t* base_term,
                                          uint64_t* entry_count);
 
+/**
+ * Release what the memory backend holds for data_dir
+ * Its contents outlive raft_storage_close so a node can be restarted on
+ * them within the process; this drops them for good. Must not be open.
+ */
+void raft_storage_memory_drop(const char* data_dir);
+
+/* Helpers for backends that keep files in data_dir */
+
+/**
+ * Join data_dir and a file name; the caller frees the result
+ */
+char* raft_storage_path(const char* data_dir, const char* file);
+
+/**
+ * Write term runs to raft_terms.dat in data_dir (temp file + rename)
+ */
+raft_status_t raft_storage_write_term_runs(const char* data_dir,
+                                            const raft_term_run_t* runs,
+                                            size_t count, bool sync);
+
+/**
+ * Read term runs from raft_terms.dat; RAFT_NOT_FOUND if there is none
+ */
+raft_status_t raft_storage_read_term_runs(const char* data_dir,
+                                           raft_term_run_t** runs,
+                                           size_t* count);
+
 #endif /* RAFT_STORAGE_H */
@@ -0,0 +1,410 @@
+/**
+ * storage_file.c - File storage backend: WAL segments plus a state file
+ *
+ * current_term and voted_for are written to the WAL as hard-state records,
+ * so the sync that makes entries durable covers them too. When the
+ * record holding the newest hard state is about to be cut or compacted
+ * away, it is saved to raft_state.dat first; load takes the newer of
+ * the two.
+ *
+ * File formats:
+ * - raft_state.dat: two RAFT_STATE_SLOT_SIZE slots, written alternately, each
+ *   | magic(4) | version(4) | crc32c(4) | term(8) | voted_for(4) | pad(4) | sequence(8) |
+ *   The valid slot with the highest sequence wins. A version 1 file holds
+ *   a single slot without the sequence, checked with CRC32.
+ * - raft_wal_*.seg: log segments, see wal.c
+ * - raft_terms.dat: see storage.c
+ */
+
+#include "storage.h"
+#include "crc32.h"
+#include "param.h"
+#include "wal.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <errno.h>
+
+#define STATE_FILE "raft_state.dat"
+
+/* State slot structure (36 bytes); version 1 files end before sequence */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t crc32;       /* CRC32C of term through sequence (v1: CRC32 of term + vote) */
+    uint64_t current_term;
+    int32_t voted_for;
+    uint32_t padding;
+    uint64_t sequence;
+} __attribute__((packed)) state_slot_t;
+
+#define STATE_SLOT_V1_SIZE  offsetof(state_slot_t, sequence)
+#define STATE_CRC_OFFSET    offsetof(state_slot_t, current_term)
+
+typedef struct {
+    char* data_dir;
+    bool sync_writes;
+    raft_wal_t* wal;            /* Segmented log of entries */
+    int state_fd;               /* Preallocated state file (-1 until first save) */
+    uint64_t state_sequence;    /* Sequence of the newest state slot */
+    int state_slot;             /* Slot holding it; the next save goes in the other */
+} file_store_t;
+
+/* Check one state slot; returns RAFT_NOT_FOUND for a never-written slot */
+static raft_status_t state_slot_check(const state_slot_t* slot, size_t len) {
+    if (len < STATE_SLOT_V1_SIZE || slot->magic == 0) return RAFT_NOT_FOUND;
+    if (slot->magic != RAFT_STATE_MAGIC) return RAFT_CORRUPTION;
+
+    if (slot->version == RAFT_STATE_VERSION_V1) {
+        uint32_t crc = crc32(&slot->current_term,
+                             sizeof(slot->current_term) + sizeof(slot->voted_for));
+        return slot->crc32 == crc ? RAFT_OK : RAFT_CORRUPTION;
+    }
+    if (slot->version != RAFT_STATE_VERSION || len < sizeof(*slot)) return RAFT_CORRUPTION;
+    uint32_t crc = crc32c((const char*)slot + STATE_CRC_OFFSET,
+                          sizeof(*slot) - STATE_CRC_OFFSET);
+    return slot->crc32 == crc ? RAFT_OK : RAFT_CORRUPTION;
+}
+
+/* Read both slots of the state file and pick the newest valid one
+ * A torn write only ever damages the slot being written, so the other
+ * still holds the previous state. */
+static raft_status_t state_scan(int fd, state_slot_t* best, int* best_slot) {
+    bool written = false;
+    bool found = false;
+    for (int i = 0; i < 2; i++) {
+        state_slot_t slot;
+        memset(&slot, 0, sizeof(slot));
+        ssize_t n = pread(fd, &slot, sizeof(slot), (off_t)i * RAFT_STATE_SLOT_SIZE);
+        if (n < 0) return RAFT_IO_ERROR;
+        /* A file too short for even one slot was cut off, not preallocated */
+        if (i == 0 && n > 0 && (size_t)n < STATE_SLOT_V1_SIZE) return RAFT_IO_ERROR;
+
+        raft_status_t status = state_slot_check(&slot, (size_t)n);
+        if (status == RAFT_NOT_FOUND) continue;
+        written = true;
+        if (status != RAFT_OK) continue;
+        if (slot.version == RAFT_STATE_VERSION_V1) slot.sequence = 0;
+        if (!found || slot.sequence > best->sequence) {
+            *best = slot;
+            *best_slot = i;
+            found = true;
+        }
+    }
+    if (found) return RAFT_OK;
+    return written ? RAFT_CORRUPTION : RAFT_NOT_FOUND;
+}
+
+/* Open the state file for in-place updates, creating and preallocating
+ * both slots the first time so later saves never change its size */
+static raft_status_t state_open(file_store_t* store) {
+    char* path = raft_storage_path(store->data_dir, STATE_FILE);
+    if (!path) return RAFT_NO_MEMORY;
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    free(path);
+    if (fd < 0) return RAFT_IO_ERROR;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return RAFT_IO_ERROR;
+    }
+    if (st.st_size < 2 * RAFT_STATE_SLOT_SIZE) {
+        /* New or version 1 file: its single slot stays as slot 0 */
+        if (ftruncate(fd, 2 * RAFT_STATE_SLOT_SIZE) < 0 ||
+            (store->sync_writes && fsync(fd) < 0)) {
+            close(fd);
+            return RAFT_IO_ERROR;
+        }
+        if (store->sync_writes && st.st_size == 0) {
+            int dfd = open(store->data_dir, O_RDONLY | O_DIRECTORY);
+            if (dfd >= 0) {
+                fsync(dfd);
+                close(dfd);
+            }
+        }
+    }
+
+    state_slot_t best;
+    int best_slot = 1;
+    raft_status_t status = state_scan(fd, &best, &best_slot);
+    if (status == RAFT_OK) {
+        store->state_sequence = best.sequence;
+        store->state_slot = best_slot;
+    } else {
+        /* Nothing readable: start over from slot 0 */
+        store->state_sequence = 0;
+        store->state_slot = 1;
+    }
+    store->state_fd = fd;
+    return RAFT_OK;
+}
+
+/* Save hard state to the state file, durably if sync_writes is set */
+static raft_status_t state_file_save(file_store_t* store,
+                                     uint64_t current_term,
+                                     int32_t voted_for) {
+    if (store->state_fd < 0) {
+        raft_status_t status = state_open(store);
+        if (status != RAFT_OK) return status;
+    }
+
+    state_slot_t slot = {
+        .magic = RAFT_STATE_MAGIC,
+        .version = RAFT_STATE_VERSION,
+        .current_term = current_term,
+        .voted_for = voted_for,
+        .padding = 0,
+        .sequence = store->state_sequence + 1,
+    };
+    slot.crc32 = crc32c((const char*)&slot + STATE_CRC_OFFSET,
+                        sizeof(slot) - STATE_CRC_OFFSET);
+
+    /* Overwrite the older slot; the newer one stays intact until this
+     * write is durable */
+    int target = store->state_slot ^ 1;
+    ssize_t n = pwrite(store->state_fd, &slot, sizeof(slot),
+                       (off_t)target * RAFT_STATE_SLOT_SIZE);
+    if (n != (ssize_t)sizeof(slot)) return RAFT_IO_ERROR;
+    if (store->sync_writes && fdatasync(store->state_fd) < 0) return RAFT_IO_ERROR;
+
+    store->state_sequence = slot.sequence;
+    store->state_slot = target;
+    return RAFT_OK;
+}
+
+static raft_status_t state_file_load(file_store_t* store,
+                                     uint64_t* current_term,
+                                     int32_t* voted_for) {
+    int fd = store->state_fd;
+    if (fd < 0) {
+        char* path = raft_storage_path(store->data_dir, STATE_FILE);
+        if (!path) return RAFT_NO_MEMORY;
+        fd = open(path, O_RDONLY);
+        free(path);
+        if (fd < 0) {
+            if (errno == ENOENT) return RAFT_NOT_FOUND;
+            return RAFT_IO_ERROR;
+        }
+    }
+
+    state_slot_t best;
+    int best_slot = 1;
+    raft_status_t status = state_scan(fd, &best, &best_slot);
+    if (fd != store->state_fd) close(fd);
+    if (status != RAFT_OK) return status;
+
+    *current_term = best.current_term;
+    *voted_for = best.voted_for;
+    return RAFT_OK;
+}
+
+/* Copy the newest hard state to the state file before the WAL record
+ * holding it is removed */
+static raft_status_t state_preserve(file_store_t* store) {
+    uint64_t term;
+    int32_t voted_for;
+    if (!raft_wal_hard_state(store->wal, &term, &voted_for)) return RAFT_OK;
+    return state_file_save(store, term, voted_for);
+}
+
+static void* file_open(const char* data_dir, bool sync_writes,
+                       raft_io_backend_t io_backend) {
+    /* Create directory if it doesn't exist */
+    if (mkdir(data_dir, 0755) < 0 && errno != EEXIST) {
+        return NULL;
+    }
+
+    file_store_t* store = calloc(1, sizeof(file_store_t));
+    if (!store) return NULL;
+
+    store->data_dir = strdup(data_dir);
+    if (!store->data_dir) {
+        free(store);
+        return NULL;
+    }
+    store->sync_writes = sync_writes;
+    store->state_fd = -1;
+    store->state_slot = 1;
+
+    store->wal = raft_wal_open(data_dir, RAFT_WAL_SEGMENT_SIZE, sync_writes);
+    if (!store->wal) {
+        free(store->data_dir);
+        free(store);
+        return NULL;
+    }
+    if (io_backend == RAFT_IO_URING) {
+        raft_wal_enable_uring(store->wal, RAFT_WAL_URING_DEPTH);
+    }
+    return store;
+}
+
+static void file_close(void* impl) {
+    file_store_t* store = impl;
+    raft_wal_close(store->wal);
+    if (store->state_fd >= 0) close(store->state_fd);
+    free(store->data_dir);
+    free(store);
+}
+
+static raft_status_t file_write_state(void* impl, uint64_t current_term,
+                                      int32_t voted_for) {
+    file_store_t* store = impl;
+    return raft_wal_append_state(store->wal, current_term, voted_for);
+}
+
+static raft_status_t file_load_state(void* impl, uint64_t* current_term,
+                                     int32_t* voted_for) {
+    file_store_t* store = impl;
+
+    uint64_t file_term;
+    int32_t file_vote;
+    raft_status_t status = state_file_load(store, &file_term, &file_vote);
+    if (status != RAFT_OK && status != RAFT_NOT_FOUND) return status;
+
+    uint64_t wal_term;
+    int32_t wal_vote;
+    if (!raft_wal_hard_state(store->wal, &wal_term, &wal_vote)) {
+        if (status != RAFT_OK) return status;
+        *current_term = file_term;
+        *voted_for = file_vote;
+        return RAFT_OK;
+    }
+
+    /* Hard state only moves forward: a higher term, or a vote in a
+     * term that had none */
+    if (status == RAFT_OK &&
+        (file_term > wal_term ||
+         (file_term == wal_term && wal_vote == -1 && file_vote != -1))) {
+        *current_term = file_term;
+        *voted_for = file_vote;
+    } else {
+        *current_term = wal_term;
+        *voted_for = wal_vote;
+    }
+    return RAFT_OK;
+}
+
+static raft_status_t file_append(void* impl, const raft_entry_t* entries,
+                                 size_t count) {
+    file_store_t* store = impl;
+    return raft_wal_append(store->wal, entries, count);
+}
+
+/* Cut the WAL after after_index, keeping the newest hard state */
+static raft_status_t file_truncate_after(void* impl, uint64_t after_index) {
+    file_store_t* store = impl;
+    if (raft_wal_state_cut_by(store->wal, after_index)) {
+        raft_status_t status = state_preserve(store);
+        if (status != RAFT_OK) return status;
+    }
+    return raft_wal_truncate_after(store->wal, after_index);
+}
+
+static raft_status_t file_read_entry(void* impl, uint64_t index, raft_entry_t* out) {
+    file_store_t* store = impl;
+    return raft_wal_read_entry(store->wal, index, out);
+}
+
+static raft_status_t file_read_range(void* impl, uint64_t lo, uint64_t hi,
+                                     raft_entry_t* out, void** data) {
+    file_store_t* store = impl;
+    return raft_wal_read_range(store->wal, lo, hi, out, data);
+}
+
+static raft_status_t file_iterate(void* impl, raft_log_iter_shared_fn fn, void* ctx) {
+    file_store_t* store = impl;
+    return raft_wal_iterate_mapped(store->wal, fn, ctx);
+}
+
+static void file_log_info(void* impl, uint64_t* first_index, uint64_t* last_index,
+                          uint64_t* count) {
+    file_store_t* store = impl;
+    *first_index = raft_wal_first_index(store->wal);
+    *last_index = raft_wal_last_index(store->wal);
+    *count = raft_wal_entry_count(store->wal);
+}
+
+static uint64_t file_log_bytes(void* impl) {
+    file_store_t* store = impl;
+    return raft_wal_log_bytes(store->wal);
+}
+
+static raft_status_t file_sync(void* impl) {
+    file_store_t* store = impl;
+    return raft_wal_sync(store->wal);
+}
+
+static raft_status_t file_sync_submit(void* impl) {
+    file_store_t* store = impl;
+    return raft_wal_sync_submit(store->wal);
+}
+
+static raft_status_t file_poll(void* impl, uint64_t* synced_index) {
+    file_store_t* store = impl;
+    return raft_wal_poll(store->wal, synced_index);
+}
+
+static raft_io_backend_t file_io_backend(void* impl) {
+    file_store_t* store = impl;
+    return raft_wal_is_async(store->wal) ? RAFT_IO_URING : RAFT_IO_SYNC;
+}
+
+static raft_status_t file_compact(void* impl, uint64_t upto_index) {
+    file_store_t* store = impl;
+    if (raft_wal_state_dropped_by(store->wal, upto_index)) {
+        raft_status_t status = state_preserve(store);
+        if (status != RAFT_OK) return status;
+    }
+    return raft_wal_truncate_before(store->wal, upto_index);
+}
+
+static raft_status_t file_save_term_runs(void* impl, const raft_term_run_t* runs,
+                                         size_t count) {
+    file_store_t* store = impl;
+    return raft_storage_write_term_runs(store->data_dir, runs, count, store->sync_writes);
+}
+
+static raft_status_t file_load_term_runs(void* impl, raft_term_run_t** runs,
+                                         size_t* count) {
+    file_store_t* store = impl;
+    return raft_storage_read_term_runs(store->data_dir, runs, count);
+}
+
+static void file_set_recovery_threads(void* impl, size_t threads) {
+    file_store_t* store = impl;
+    raft_wal_set_verify_threads(store->wal, threads);
+}
+
+static void file_set_segment_size(void* impl, size_t segment_size) {
+    file_store_t* store = impl;
+    raft_wal_set_segment_size(store->wal, segment_size);
+}
+
+const raft_storage_ops_t raft_storage_file_ops = {
+    .name = "file",
+    .open = file_open,
+    .close = file_close,
+    .write_state = file_write_state,
+    .load_state = file_load_state,
+    .append = file_append,
+    .truncate_after = file_truncate_after,
+    .read_entry = file_read_entry,
+    .read_range = file_read_range,
+    .iterate = file_iterate,
+    .log_info = file_log_info,
+    .log_bytes = file_log_bytes,
+    .sync = file_sync,
+    .sync_submit = file_sync_submit,
+    .poll = file_poll,
+    .io_backend = file_io_backend,
+    .compact = file_compact,
+    .save_term_runs = file_save_term_runs,
+    .load_term_runs = file_load_term_runs,
+    .set_recovery_threads = file_set_recovery_threads,
+    .set_segment_size = file_set_segment_size,
+};
@@ -0,0 +1,300 @@
+/**
+ * storage_mem.c - In-memory storage backend
+ *
+ * Keeps hard state, entries and term runs in process memory so the
+ * consensus core can be run and benchmarked without a disk; sync has
+ * nothing to do. What a data_dir holds outlives the handle: opening the
+ * same data_dir again in this process finds it, as a restart would,
+ * until raft_storage_memory_drop releases it. Nothing is written under
+ * data_dir by this backend (snapshots still are, by snapshot.c).
+ */
+
+#include "storage.h"
+#include "buf.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+typedef struct {
+    uint64_t term;
+    raft_buf_t* buf;            /* Command bytes, shared with iterate callers */
+} mem_entry_t;
+
+typedef struct mem_store {
+    char* data_dir;
+    bool is_open;               /* One handle at a time */
+    bool has_state;
+    uint64_t current_term;
+    int32_t voted_for;
+    mem_entry_t* entries;       /* entries[i] has index first_index + i */
+    uint64_t first_index;
+    size_t count;
+    size_t capacity;
+    raft_term_run_t* runs;      /* NULL until term runs are saved */
+    size_t run_count;
+    struct mem_store* next;
+} mem_store_t;
+
+/* Every data_dir's contents, kept across close */
+static pthread_mutex_t stores_lock = PTHREAD_MUTEX_INITIALIZER;
+static mem_store_t* stores;
+
+static mem_store_t** find_store(const char* data_dir) {
+    mem_store_t** link = &stores;
+    while (*link && strcmp((*link)->data_dir, data_dir) != 0) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+/* Drop entries [from, count) */
+static void drop_tail(mem_store_t* store, size_t from) {
+    for (size_t i = from; i < store->count; i++) {
+        raft_buf_unref(store->entries[i].buf);
+    }
+    store->count = from;
+}
+
+static void* mem_open(const char* data_dir, bool sync_writes,
+                      raft_io_backend_t io_backend) {
+    (void)sync_writes; (void)io_backend;
+
+    pthread_mutex_lock(&stores_lock);
+    mem_store_t** link = find_store(data_dir);
+    mem_store_t* store = *link;
+    if (!store) {
+        store = calloc(1, sizeof(mem_store_t));
+        if (store) store->data_dir = strdup(data_dir);
+        if (store && !store->data_dir) {
+            free(store);
+            store = NULL;
+        }
+        if (store) *link = store;
+    } else if (store->is_open) {
+        store = NULL;
+    }
+    if (store) store->is_open = true;
+    pthread_mutex_unlock(&stores_lock);
+    return store;
+}
+
+static void mem_close(void* impl) {
+    mem_store_t* store = impl;
+    pthread_mutex_lock(&stores_lock);
+    store->is_open = false;
+    pthread_mutex_unlock(&stores_lock);
+}
+
+void raft_storage_memory_drop(const char* data_dir) {
+    if (!data_dir) return;
+
+    pthread_mutex_lock(&stores_lock);
+    mem_store_t** link = find_store(data_dir);
+    mem_store_t* store = *link;
+    if (store && !store->is_open) {
+        *link = store->next;
+        drop_tail(store, 0);
+        free(store->entries);
+        free(store->runs);
+        free(store->data_dir);
+        free(store);
+    }
+    pthread_mutex_unlock(&stores_lock);
+}
+
+static raft_status_t mem_write_state(void* impl, uint64_t current_term,
+                                     int32_t voted_for) {
+    mem_store_t* store = impl;
+    store->has_state = true;
+    store->current_term = current_term;
+    store->voted_for = voted_for;
+    return RAFT_OK;
+}
+
+static raft_status_t mem_load_state(void* impl, uint64_t* current_term,
+                                    int32_t* voted_for) {
+    mem_store_t* store = impl;
+    if (!store->has_state) return RAFT_NOT_FOUND;
+    *current_term = store->current_term;
+    *voted_for = store->voted_for;
+    return RAFT_OK;
+}
+
+static raft_status_t mem_append(void* impl, const raft_entry_t* entries,
+                                size_t count) {
+    mem_store_t* store = impl;
+
+    /* Entries follow on from the last one; an empty log starts anywhere */
+    if (store->count == 0) {
+        store->first_index = entries[0].index;
+    } else if (entries[0].index != store->first_index + store->count) {
+        return RAFT_INVALID_ARG;
+    }
+
+    if (store->count + count > store->capacity) {
+        size_t capacity = store->capacity ? store->capacity : 64;
+        while (capacity < store->count + count) capacity *= 2;
+        mem_entry_t* grown = realloc(store->entries, capacity * sizeof(mem_entry_t));
+        if (!grown) return RAFT_NO_MEMORY;
+        store->entries = grown;
+        store->capacity = capacity;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        raft_buf_t* buf = raft_buf_alloc(entries[i].command_len);
+        if (!buf) return RAFT_NO_MEMORY;
+        if (entries[i].command_len > 0) {
+            memcpy(buf->data, entries[i].command, entries[i].command_len);
+        }
+        store->entries[store->count].term = entries[i].term;
+        store->entries[store->count].buf = buf;
+        store->count++;
+    }
+    return RAFT_OK;
+}
+
+static raft_status_t mem_truncate_after(void* impl, uint64_t after_index) {
+    mem_store_t* store = impl;
+    if (store->count == 0) return RAFT_OK;
+    if (after_index < store->first_index) {
+        drop_tail(store, 0);
+    } else if (after_index - store->first_index + 1 < store->count) {
+        drop_tail(store, (size_t)(after_index - store->first_index + 1));
+    }
+    return RAFT_OK;
+}
+
+static raft_status_t mem_compact(void* impl, uint64_t upto_index) {
+    mem_store_t* store = impl;
+    if (store->count == 0 || upto_index < store->first_index) return RAFT_OK;
+
+    size_t dropped = (size_t)(upto_index - store->first_index + 1);
+    if (dropped > store->count) dropped = store->count;
+    for (size_t i = 0; i < dropped; i++) {
+        raft_buf_unref(store->entries[i].buf);
+    }
+    memmove(store->entries, store->entries + dropped,
+            (store->count - dropped) * sizeof(mem_entry_t));
+    store->count -= dropped;
+    store->first_index += dropped;
+    return RAFT_OK;
+}
+
+static const mem_entry_t* mem_find(const mem_store_t* store, uint64_t index) {
+    if (store->count == 0 || index < store->first_index ||
+        index - store->first_index >= store->count) {
+        return NULL;
+    }
+    return &store->entries[index - store->first_index];
+}
+
+static raft_status_t mem_read_entry(void* impl, uint64_t index, raft_entry_t* out) {
+    const mem_entry_t* entry = mem_find(impl, index);
+    if (!entry) return RAFT_NOT_FOUND;
+
+    out->term = entry->term;
+    out->index = index;
+    out->type = RAFT_ENTRY_COMMAND;
+    out->command_len = entry->buf->len;
+    out->command = NULL;
+    if (entry->buf->len > 0) {
+        out->command = malloc(entry->buf->len);
+        if (!out->command) return RAFT_NO_MEMORY;
+        memcpy(out->command, entry->buf->data, entry->buf->len);
+    }
+    return RAFT_OK;
+}
+
+static raft_status_t mem_read_range(void* impl, uint64_t lo, uint64_t hi,
+                                    raft_entry_t* out, void** data) {
+    if (!out || !data || lo == 0 || hi < lo) return RAFT_INVALID_ARG;
+    *data = NULL;
+    if (!mem_find(impl, lo) || !mem_find(impl, hi)) return RAFT_NOT_FOUND;
+
+    size_t total = 0;
+    for (uint64_t index = lo; index <= hi; index++) {
+        total += mem_find(impl, index)->buf->len;
+    }
+    char* buf = malloc(total ? total : 1);
+    if (!buf) return RAFT_NO_MEMORY;
+
+    char* p = buf;
+    for (uint64_t index = lo; index <= hi; index++, out++) {
+        const mem_entry_t* entry = mem_find(impl, index);
+        out->term = entry->term;
+        out->index = index;
+        out->type = RAFT_ENTRY_COMMAND;
+        out->command_len = entry->buf->len;
+        out->command = entry->buf->len > 0 ? p : NULL;
+        memcpy(p, entry->buf->data, entry->buf->len);
+        p += entry->buf->len;
+    }
+    *data = buf;
+    return RAFT_OK;
+}
+
+static raft_status_t mem_iterate(void* impl, raft_log_iter_shared_fn fn, void* ctx) {
+    mem_store_t* store = impl;
+    for (size_t i = 0; i < store->count; i++) {
+        const mem_entry_t* entry = &store->entries[i];
+        raft_status_t status = fn(ctx, entry->term, store->first_index + i, entry->buf,
+                                  entry->buf->data, entry->buf->len);
+        if (status != RAFT_OK) return status;
+    }
+    return RAFT_OK;
+}
+
+static void mem_log_info(void* impl, uint64_t* first_index, uint64_t* last_index,
+                         uint64_t* count) {
+    mem_store_t* store = impl;
+    *first_index = store->count ? store->first_index : 0;
+    *last_index = store->count ? store->first_index + store->count - 1 : 0;
+    *count = store->count;
+}
+
+static raft_status_t mem_sync(void* impl) {
+    (void)impl;
+    return RAFT_OK;
+}
+
+static raft_status_t mem_save_term_runs(void* impl, const raft_term_run_t* runs,
+                                        size_t count) {
+    mem_store_t* store = impl;
+    raft_term_run_t* copy = malloc(count ? count * sizeof(raft_term_run_t) : 1);
+    if (!copy) return RAFT_NO_MEMORY;
+    if (count > 0) memcpy(copy, runs, count * sizeof(raft_term_run_t));
+    free(store->runs);
+    store->runs = copy;
+    store->run_count = count;
+    return RAFT_OK;
+}
+
+static raft_status_t mem_load_term_runs(void* impl, raft_term_run_t** runs,
+                                        size_t* count) {
+    mem_store_t* store = impl;
+    if (!store->runs) return RAFT_NOT_FOUND;
+    size_t len = store->run_count * sizeof(raft_term_run_t);
+    *runs = malloc(len ? len : 1);
+    if (!*runs) return RAFT_NO_MEMORY;
+    if (len > 0) memcpy(*runs, store->runs, len);
+    *count = store->run_count;
+    return RAFT_OK;
+}
+
+const raft_storage_ops_t raft_storage_memory_ops = {
+    .name = "memory",
+    .open = mem_open,
+    .close = mem_close,
+    .write_state = mem_write_state,
+    .load_state = mem_load_state,
+    .append = mem_append,
+    .truncate_after = mem_truncate_after,
+    .read_entry = mem_read_entry,
+    .read_range = mem_read_range,
+    .iterate = mem_iterate,
+    .log_info = mem_log_info,
+    .sync = mem_sync,
+    .compact = mem_compact,
+    .save_term_runs = mem_save_term_runs,
+    .load_term_runs = mem_load_term_runs,
+};
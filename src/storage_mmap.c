@@ -0,0 +1,611 @@
+/**
+ * storage_mmap.c - Memory-mapped storage backend
+ *
+ * Hard state and the log share one file, mapped read/write into an
+ * address range reserved up front so it can grow in place: appends are
+ * memcpy's into the mapping, sync is an msync of the pages dirtied
+ * since the last one, and recovery hands out commands straight from the
+ * mapping.
+ *
+ * File format (raft_mlog.dat):
+ * - Header page (MLOG_HEADER_SIZE bytes): two RAFT_STATE_SLOT_SIZE slots,
+ *   written alternately, each
+ *   | magic(4) | version(4) | crc32c(4) | has_state(4) | sequence(8) |
+ *   | term(8) | first_index(8) | voted_for(4) | pad(4) |
+ *   The valid slot with the highest sequence wins.
+ * - Records, 8-byte aligned, from the end of the header page:
+ *   | crc32c(4) | cmd_len(4) | term(8) | index(8) | command | pad |
+ *   The CRC covers cmd_len through the command. The log is the run of
+ *   records with consecutive indexes from first_index; anything before
+ *   it has been compacted, and a zero index, a bad CRC or a gap ends it.
+ * - raft_terms.dat: see storage.c
+ */
+
+#include "storage.h"
+#include "buf.h"
+#include "crc32.h"
+#include "param.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MLOG_FILE        "raft_mlog.dat"
+#define MLOG_TEMP_FILE   "raft_mlog.dat.tmp"
+#define MLOG_MAGIC       0x524D4C47  /* "RMLG" */
+#define MLOG_VERSION     1
+#define MLOG_HEADER_SIZE 4096
+#define MLOG_ALIGN       8
+
+/* Hard state slot (48 bytes) */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t crc32;         /* CRC32C of has_state through padding */
+    uint32_t has_state;
+    uint64_t sequence;
+    uint64_t current_term;
+    uint64_t first_index;   /* 0 until the first append */
+    int32_t voted_for;
+    uint32_t padding;
+} __attribute__((packed)) mlog_slot_t;
+
+#define SLOT_CRC_OFFSET offsetof(mlog_slot_t, has_state)
+
+/* Record header (24 bytes) */
+typedef struct {
+    uint32_t crc32;
+    uint32_t cmd_len;
+    uint64_t term;
+    uint64_t index;
+} __attribute__((packed)) mlog_record_t;
+
+#define RECORD_CRC_OFFSET offsetof(mlog_record_t, cmd_len)
+
+typedef struct {
+    char* data_dir;
+    char* path;
+    bool sync_writes;
+    int fd;
+    char* base;                 /* Reserved range; the file is mapped at its start */
+    raft_buf_t* owner;          /* Holds the range for commands handed out */
+    size_t mapped;              /* File size, all of it mapped */
+    size_t end;                 /* Where the next record goes */
+    uint64_t* offsets;          /* offsets[i]: record of first_index + i */
+    uint64_t first_index;
+    size_t count;
+    size_t capacity;
+    bool has_state;
+    uint64_t current_term;
+    int32_t voted_for;
+    uint64_t sequence;          /* Sequence of the newest slot */
+    int slot;                   /* Slot holding it; the next write goes in the other */
+    size_t dirty_lo;            /* Record bytes written since the last sync */
+    size_t dirty_hi;
+    bool header_dirty;
+    bool grown;                 /* File extended since the last sync */
+} mmap_store_t;
+
+static size_t record_size(size_t cmd_len) {
+    return (sizeof(mlog_record_t) + cmd_len + MLOG_ALIGN - 1) & ~(size_t)(MLOG_ALIGN - 1);
+}
+
+static size_t grow_round(size_t size) {
+    return (size + RAFT_MMAP_GROW_SIZE - 1) / RAFT_MMAP_GROW_SIZE * RAFT_MMAP_GROW_SIZE;
+}
+
+static void unmap_range(void* data, size_t len, void* ctx) {
+    (void)ctx;
+    munmap(data, len);
+}
+
+/* Reserve the address range and map the first size bytes of fd into it */
+static raft_buf_t* map_file(int fd, size_t size) {
+    void* base = mmap(NULL, RAFT_MMAP_RESERVE_SIZE, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) return NULL;
+    if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, RAFT_MMAP_RESERVE_SIZE);
+        return NULL;
+    }
+    raft_buf_t* owner = raft_buf_wrap(base, RAFT_MMAP_RESERVE_SIZE, unmap_range, NULL);
+    if (!owner) munmap(base, RAFT_MMAP_RESERVE_SIZE);
+    return owner;
+}
+
+/* Extend the file and its mapping to hold at least need bytes */
+static raft_status_t mlog_grow(mmap_store_t* store, size_t need) {
+    if (need <= store->mapped) return RAFT_OK;
+    size_t size = grow_round(need);
+    if (size > RAFT_MMAP_RESERVE_SIZE) return RAFT_NO_MEMORY;
+
+    if (posix_fallocate(store->fd, (off_t)store->mapped, (off_t)(size - store->mapped)) != 0) {
+        return RAFT_IO_ERROR;
+    }
+    if (mmap(store->base + store->mapped, size - store->mapped, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, store->fd, (off_t)store->mapped) == MAP_FAILED) {
+        return RAFT_IO_ERROR;
+    }
+    store->mapped = size;
+    store->grown = true;
+    return RAFT_OK;
+}
+
+static void mark_dirty(mmap_store_t* store, size_t lo, size_t hi) {
+    if (store->dirty_hi == 0) {
+        store->dirty_lo = lo;
+    } else if (lo < store->dirty_lo) {
+        store->dirty_lo = lo;
+    }
+    if (hi > store->dirty_hi) store->dirty_hi = hi;
+}
+
+/* Write hard state and first_index to the older slot */
+static void write_slot(mmap_store_t* store) {
+    mlog_slot_t slot = {
+        .magic = MLOG_MAGIC,
+        .version = MLOG_VERSION,
+        .has_state = store->has_state,
+        .sequence = store->sequence + 1,
+        .current_term = store->current_term,
+        .first_index = store->first_index,
+        .voted_for = store->voted_for,
+    };
+    slot.crc32 = crc32c((const char*)&slot + SLOT_CRC_OFFSET,
+                        sizeof(slot) - SLOT_CRC_OFFSET);
+
+    store->slot ^= 1;
+    store->sequence = slot.sequence;
+    memcpy(store->base + (size_t)store->slot * RAFT_STATE_SLOT_SIZE, &slot, sizeof(slot));
+    store->header_dirty = true;
+}
+
+/* Take the newest valid slot; a foreign magic means this is not our file */
+static raft_status_t load_slots(mmap_store_t* store) {
+    const mlog_slot_t* best = NULL;
+    store->slot = 1;
+    for (int i = 0; i < 2; i++) {
+        const mlog_slot_t* slot =
+            (const mlog_slot_t*)(store->base + (size_t)i * RAFT_STATE_SLOT_SIZE);
+        if (slot->magic == 0) continue;
+        if (slot->magic != MLOG_MAGIC || slot->version != MLOG_VERSION) {
+            return RAFT_CORRUPTION;
+        }
+        uint32_t crc = crc32c((const char*)slot + SLOT_CRC_OFFSET,
+                              sizeof(*slot) - SLOT_CRC_OFFSET);
+        if (crc != slot->crc32) continue;   /* Torn write */
+        if (!best || slot->sequence > best->sequence) {
+            best = slot;
+            store->slot = i;
+        }
+    }
+    if (best) {
+        store->has_state = best->has_state != 0;
+        store->sequence = best->sequence;
+        store->current_term = best->current_term;
+        store->voted_for = best->voted_for;
+        store->first_index = best->first_index;
+    }
+    return RAFT_OK;
+}
+
+static raft_status_t push_offset(mmap_store_t* store, size_t offset) {
+    if (store->count == store->capacity) {
+        size_t capacity = store->capacity ? store->capacity * 2 : 1024;
+        uint64_t* grown = realloc(store->offsets, capacity * sizeof(uint64_t));
+        if (!grown) return RAFT_NO_MEMORY;
+        store->offsets = grown;
+        store->capacity = capacity;
+    }
+    store->offsets[store->count++] = offset;
+    return RAFT_OK;
+}
+
+/* Whether a whole, intact record starts at pos */
+static bool record_valid(const mmap_store_t* store, size_t pos, const mlog_record_t** out) {
+    if (store->mapped - pos < sizeof(mlog_record_t)) return false;
+    const mlog_record_t* rec = (const mlog_record_t*)(store->base + pos);
+    if (rec->index == 0 || record_size(rec->cmd_len) > store->mapped - pos) return false;
+    uint32_t crc = crc32c_update(crc32c((const char*)rec + RECORD_CRC_OFFSET,
+                                        sizeof(*rec) - RECORD_CRC_OFFSET),
+                                 rec + 1, rec->cmd_len);
+    if (crc != rec->crc32) return false;
+    *out = rec;
+    return true;
+}
+
+/* Index the log's records and zero whatever a crash left past them */
+static raft_status_t scan_records(mmap_store_t* store) {
+    size_t pos = MLOG_HEADER_SIZE;
+    const mlog_record_t* rec;
+    while (record_valid(store, pos, &rec)) {
+        if (store->count == 0 && rec->index < store->first_index) {
+            pos += record_size(rec->cmd_len);   /* Compacted */
+            continue;
+        }
+        if (store->count == 0 && store->first_index == 0) {
+            store->first_index = rec->index;
+        }
+        if (rec->index != store->first_index + store->count) break;
+        raft_status_t status = push_offset(store, pos);
+        if (status != RAFT_OK) return status;
+        pos += record_size(rec->cmd_len);
+    }
+    store->end = pos;
+
+    /* pos is 8-byte aligned and mapped a multiple of the grow step */
+    size_t tail = store->mapped;
+    while (tail > pos && *(const uint64_t*)(store->base + tail - 8) == 0) tail -= 8;
+    if (tail > pos) {
+        memset(store->base + pos, 0, tail - pos);
+        if (store->sync_writes && msync(store->base + (pos & ~(size_t)(MLOG_HEADER_SIZE - 1)),
+                                        tail - (pos & ~(size_t)(MLOG_HEADER_SIZE - 1)),
+                                        MS_SYNC) < 0) {
+            return RAFT_IO_ERROR;
+        }
+    }
+    return RAFT_OK;
+}
+
+static void mmap_close(void* impl) {
+    mmap_store_t* store = impl;
+    raft_buf_unref(store->owner);
+    if (store->fd >= 0) close(store->fd);
+    free(store->offsets);
+    free(store->path);
+    free(store->data_dir);
+    free(store);
+}
+
+static void* mmap_open(const char* data_dir, bool sync_writes,
+                       raft_io_backend_t io_backend) {
+    (void)io_backend;
+    if (mkdir(data_dir, 0755) < 0 && errno != EEXIST) {
+        return NULL;
+    }
+
+    mmap_store_t* store = calloc(1, sizeof(mmap_store_t));
+    if (!store) return NULL;
+    store->fd = -1;
+    store->slot = 1;
+    store->sync_writes = sync_writes;
+    store->data_dir = strdup(data_dir);
+    store->path = raft_storage_path(data_dir, MLOG_FILE);
+    if (!store->data_dir || !store->path) goto fail;
+
+    store->fd = open(store->path, O_RDWR | O_CREAT, 0644);
+    if (store->fd < 0) goto fail;
+
+    struct stat st;
+    if (fstat(store->fd, &st) < 0) goto fail;
+    size_t size = (size_t)st.st_size;
+    if (size < MLOG_HEADER_SIZE) {
+        /* New, or torn while being created */
+        if (ftruncate(store->fd, 0) < 0) goto fail;
+        size = 0;
+    }
+    if (size == 0 || size % RAFT_MMAP_GROW_SIZE != 0) {
+        size_t grown = grow_round(size ? size : 1);
+        if (posix_fallocate(store->fd, (off_t)size, (off_t)(grown - size)) != 0) goto fail;
+        if (sync_writes && fsync(store->fd) < 0) goto fail;
+        size = grown;
+    }
+    if (size > RAFT_MMAP_RESERVE_SIZE) goto fail;
+
+    store->owner = map_file(store->fd, size);
+    if (!store->owner) goto fail;
+    store->base = store->owner->data;
+    store->mapped = size;
+
+    if (load_slots(store) != RAFT_OK || scan_records(store) != RAFT_OK) goto fail;
+    return store;
+
+fail:
+    mmap_close(store);
+    return NULL;
+}
+
+static raft_status_t mmap_write_state(void* impl, uint64_t current_term,
+                                      int32_t voted_for) {
+    mmap_store_t* store = impl;
+    store->has_state = true;
+    store->current_term = current_term;
+    store->voted_for = voted_for;
+    write_slot(store);
+    return RAFT_OK;
+}
+
+static raft_status_t mmap_load_state(void* impl, uint64_t* current_term,
+                                     int32_t* voted_for) {
+    mmap_store_t* store = impl;
+    if (!store->has_state) return RAFT_NOT_FOUND;
+    *current_term = store->current_term;
+    *voted_for = store->voted_for;
+    return RAFT_OK;
+}
+
+/* Keep the first keep records; with none left the file starts over */
+static void cut_records(mmap_store_t* store, size_t keep) {
+    size_t cut = keep > 0 ? store->offsets[keep] : MLOG_HEADER_SIZE;
+    memset(store->base + cut, 0, store->end - cut);
+    mark_dirty(store, cut, store->end);
+    store->end = cut;
+    store->count = keep;
+}
+
+static raft_status_t mmap_append(void* impl, const raft_entry_t* entries,
+                                 size_t count) {
+    mmap_store_t* store = impl;
+
+    /* Entries follow on from the last one; an empty log starts anywhere,
+     * over a file cleared of what it held before */
+    if (store->count == 0) {
+        if (store->end > MLOG_HEADER_SIZE) cut_records(store, 0);
+        if (entries[0].index != store->first_index) {
+            store->first_index = entries[0].index;
+            write_slot(store);
+        }
+    } else if (entries[0].index != store->first_index + store->count) {
+        return RAFT_INVALID_ARG;
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].command_len > UINT32_MAX) return RAFT_INVALID_ARG;
+        total += record_size(entries[i].command_len);
+    }
+    raft_status_t status = mlog_grow(store, store->end + total);
+    if (status != RAFT_OK) return status;
+
+    size_t start = store->end;
+    for (size_t i = 0; i < count; i++) {
+        status = push_offset(store, store->end);
+        if (status != RAFT_OK) break;
+
+        mlog_record_t* rec = (mlog_record_t*)(store->base + store->end);
+        rec->cmd_len = (uint32_t)entries[i].command_len;
+        rec->term = entries[i].term;
+        rec->index = entries[i].index;
+        if (entries[i].command_len > 0) {
+            memcpy(rec + 1, entries[i].command, entries[i].command_len);
+        }
+        size_t size = record_size(entries[i].command_len);
+        size_t used = sizeof(*rec) + entries[i].command_len;
+        memset((char*)rec + used, 0, size - used);
+        rec->crc32 = crc32c_update(crc32c((const char*)rec + RECORD_CRC_OFFSET,
+                                          sizeof(*rec) - RECORD_CRC_OFFSET),
+                                   rec + 1, rec->cmd_len);
+        store->end += size;
+    }
+    mark_dirty(store, start, store->end);
+    return status;
+}
+
+static raft_status_t mmap_truncate_after(void* impl, uint64_t after_index) {
+    mmap_store_t* store = impl;
+    if (store->count == 0) return RAFT_OK;
+
+    size_t keep = 0;
+    if (after_index >= store->first_index) {
+        uint64_t kept = after_index - store->first_index + 1;
+        if (kept >= store->count) return RAFT_OK;
+        keep = (size_t)kept;
+    }
+    cut_records(store, keep);
+    return RAFT_OK;
+}
+
+static raft_status_t mmap_sync(void* impl) {
+    mmap_store_t* store = impl;
+
+    if (store->grown) {
+        /* Covers the new file size along with every dirty page */
+        if (fdatasync(store->fd) < 0) return RAFT_IO_ERROR;
+    } else {
+        if (store->header_dirty &&
+            msync(store->base, MLOG_HEADER_SIZE, MS_SYNC) < 0) {
+            return RAFT_IO_ERROR;
+        }
+        if (store->dirty_hi > store->dirty_lo) {
+            size_t lo = store->dirty_lo & ~(size_t)(MLOG_HEADER_SIZE - 1);
+            if (msync(store->base + lo, store->dirty_hi - lo, MS_SYNC) < 0) {
+                return RAFT_IO_ERROR;
+            }
+        }
+    }
+    store->header_dirty = false;
+    store->grown = false;
+    store->dirty_lo = store->dirty_hi = 0;
+    return RAFT_OK;
+}
+
+/* Copy the header and live records to a new file and map that instead;
+ * commands already handed out keep the old mapping alive */
+static raft_status_t mlog_rewrite(mmap_store_t* store) {
+    size_t live_start = store->offsets[0];
+    size_t live = store->end - live_start;
+    size_t size = grow_round(MLOG_HEADER_SIZE + live);
+
+    char* tmp_path = raft_storage_path(store->data_dir, MLOG_TEMP_FILE);
+    if (!tmp_path) return RAFT_NO_MEMORY;
+
+    raft_status_t status = RAFT_IO_ERROR;
+    raft_buf_t* owner = NULL;
+    int fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) goto out;
+    if (posix_fallocate(fd, 0, (off_t)size) != 0 ||
+        pwrite(fd, store->base, MLOG_HEADER_SIZE, 0) != MLOG_HEADER_SIZE ||
+        pwrite(fd, store->base + live_start, live, MLOG_HEADER_SIZE) != (ssize_t)live ||
+        (store->sync_writes && fsync(fd) < 0)) {
+        goto out;
+    }
+    owner = map_file(fd, size);
+    if (!owner) goto out;
+    if (rename(tmp_path, store->path) < 0) goto out;
+
+    raft_buf_unref(store->owner);
+    close(store->fd);
+    store->owner = owner;
+    store->base = owner->data;
+    store->fd = fd;
+    store->mapped = size;
+    store->end = MLOG_HEADER_SIZE + live;
+    for (size_t i = 0; i < store->count; i++) {
+        store->offsets[i] -= live_start - MLOG_HEADER_SIZE;
+    }
+    store->header_dirty = false;
+    store->grown = false;
+    store->dirty_lo = store->dirty_hi = 0;
+    owner = NULL;
+    fd = -1;
+    status = RAFT_OK;
+
+out:
+    if (owner) raft_buf_unref(owner);
+    if (fd >= 0) {
+        close(fd);
+        unlink(tmp_path);
+    }
+    free(tmp_path);
+    return status;
+}
+
+static raft_status_t mmap_compact(void* impl, uint64_t upto_index) {
+    mmap_store_t* store = impl;
+    if (store->count == 0 || upto_index < store->first_index) return RAFT_OK;
+
+    uint64_t dropped = upto_index - store->first_index + 1;
+    if (dropped >= store->count) {
+        store->first_index += store->count;
+        cut_records(store, 0);
+    } else {
+        memmove(store->offsets, store->offsets + dropped,
+                (store->count - (size_t)dropped) * sizeof(uint64_t));
+        store->count -= (size_t)dropped;
+        store->first_index += dropped;
+    }
+    write_slot(store);
+
+    /* Once the dead prefix outweighs the log, stop carrying it */
+    if (store->count > 0) {
+        size_t dead = store->offsets[0] - MLOG_HEADER_SIZE;
+        if (dead >= RAFT_MMAP_GROW_SIZE && dead >= store->end - store->offsets[0]) {
+            return mlog_rewrite(store);
+        }
+    }
+    return store->sync_writes ? mmap_sync(store) : RAFT_OK;
+}
+
+static const mlog_record_t* mmap_find(const mmap_store_t* store, uint64_t index) {
+    if (store->count == 0 || index < store->first_index ||
+        index - store->first_index >= store->count) {
+        return NULL;
+    }
+    return (const mlog_record_t*)(store->base + store->offsets[index - store->first_index]);
+}
+
+static raft_status_t mmap_read_entry(void* impl, uint64_t index, raft_entry_t* out) {
+    const mlog_record_t* rec = mmap_find(impl, index);
+    if (!rec) return RAFT_NOT_FOUND;
+
+    out->term = rec->term;
+    out->index = index;
+    out->type = RAFT_ENTRY_COMMAND;
+    out->command_len = rec->cmd_len;
+    out->command = NULL;
+    if (rec->cmd_len > 0) {
+        out->command = malloc(rec->cmd_len);
+        if (!out->command) return RAFT_NO_MEMORY;
+        memcpy(out->command, rec + 1, rec->cmd_len);
+    }
+    return RAFT_OK;
+}
+
+static raft_status_t mmap_read_range(void* impl, uint64_t lo, uint64_t hi,
+                                     raft_entry_t* out, void** data) {
+    if (!out || !data || lo == 0 || hi < lo) return RAFT_INVALID_ARG;
+    *data = NULL;
+    if (!mmap_find(impl, lo) || !mmap_find(impl, hi)) return RAFT_NOT_FOUND;
+
+    size_t total = 0;
+    for (uint64_t index = lo; index <= hi; index++) {
+        total += mmap_find(impl, index)->cmd_len;
+    }
+    char* buf = malloc(total ? total : 1);
+    if (!buf) return RAFT_NO_MEMORY;
+
+    char* p = buf;
+    for (uint64_t index = lo; index <= hi; index++, out++) {
+        const mlog_record_t* rec = mmap_find(impl, index);
+        out->term = rec->term;
+        out->index = index;
+        out->type = RAFT_ENTRY_COMMAND;
+        out->command_len = rec->cmd_len;
+        out->command = rec->cmd_len > 0 ? p : NULL;
+        memcpy(p, rec + 1, rec->cmd_len);
+        p += rec->cmd_len;
+    }
+    *data = buf;
+    return RAFT_OK;
+}
+
+static raft_status_t mmap_iterate(void* impl, raft_log_iter_shared_fn fn, void* ctx) {
+    mmap_store_t* store = impl;
+    for (size_t i = 0; i < store->count; i++) {
+        const mlog_record_t* rec = (const mlog_record_t*)(store->base + store->offsets[i]);
+        raft_status_t status = fn(ctx, rec->term, store->first_index + i, store->owner,
+                                  (const char*)(rec + 1), rec->cmd_len);
+        if (status != RAFT_OK) return status;
+    }
+    return RAFT_OK;
+}
+
+static void mmap_log_info(void* impl, uint64_t* first_index, uint64_t* last_index,
+                          uint64_t* count) {
+    mmap_store_t* store = impl;
+    *first_index = store->count ? store->first_index : 0;
+    *last_index = store->count ? store->first_index + store->count - 1 : 0;
+    *count = store->count;
+}
+
+/* The file up to the last record, dead prefix included */
+static uint64_t mmap_log_bytes(void* impl) {
+    mmap_store_t* store = impl;
+    return store->end;
+}
+
+static raft_status_t mmap_save_term_runs(void* impl, const raft_term_run_t* runs,
+                                         size_t count) {
+    mmap_store_t* store = impl;
+    return raft_storage_write_term_runs(store->data_dir, runs, count, store->sync_writes);
+}
+
+static raft_status_t mmap_load_term_runs(void* impl, raft_term_run_t** runs,
+                                         size_t* count) {
+    mmap_store_t* store = impl;
+    return raft_storage_read_term_runs(store->data_dir, runs, count);
+}
+
+const raft_storage_ops_t raft_storage_mmap_ops = {
+    .name = "mmap",
+    .open = mmap_open,
+    .close = mmap_close,
+    .write_state = mmap_write_state,
+    .load_state = mmap_load_state,
+    .append = mmap_append,
+    .truncate_after = mmap_truncate_after,
+    .read_entry = mmap_read_entry,
+    .read_range = mmap_read_range,
+    .iterate = mmap_iterate,
+    .log_info = mmap_log_info,
+    .log_bytes = mmap_log_bytes,
+    .sync = mmap_sync,
+    .compact = mmap_compact,
+    .save_term_runs = mmap_save_term_runs,
+    .load_term_runs = mmap_load_term_runs,
+};
@@ -5,6 +5,9 @@
 #include "timer.h"
 #include "raft.h"
 #include "election.h"
+#include "install.h"
+#include "snapshot.h"
+#include "compact.h"
 #include "param.h"
 #include <stdlib.h>
 #include <time.h>
@@ -62,6 +65,7 @@ raft_status_t raft_tick_heartbeat(raft_node_t* node, uint64_t elapsed_ms) {
 
     if (node->heartbeat_timer_ms >= RAFT_HEARTBEAT_INTERVAL_MS) {
         node->heartbeat_timer_ms = 0;
+        raft_install_snapshot_heartbeat(node);
         return raft_replicate_log(node);
     }
 
@@ -71,6 +75,16 @@ raft_status_t raft_tick_heartbeat(raft_node_t* node, uint64_t elapsed_ms) {
 raft_status_t raft_tick(raft_node_t* node, uint64_t elapsed_ms) {
     if (!node) return RAFT_INVALID_ARG;
 
+    /* Close any group-commit window that has run out */
+    raft_sync_wal(node);
+
+    /* Compact behind a background snapshot that has finished; a failed
+     * one is retried by the next raft_maybe_compact */
+    raft_snapshot_poll(node);
+
+    /* Sample the entry rate compaction is scheduled around */
+    raft_compact_tick(node, elapsed_ms);
+
     raft_status_t status = raft_tick_election(node, elapsed_ms);
     if (status != RAFT_OK) return status;
 
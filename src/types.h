@@ -10,6 +10,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <sys/uio.h>
 
 /**
  * Status codes for Raft operations
@@ -44,6 +45,35 @@ typedef enum {
     RAFT_ENTRY_NOOP = 2,        /* No-op (new leader commit) */
 } raft_entry_type_t;
 
+/**
+ * WAL I/O backend
+ */
+typedef enum {
+    RAFT_IO_SYNC = 0,           /* Blocking pwritev/fdatasync on the caller's thread */
+    RAFT_IO_URING = 1,          /* Appends and syncs queued on io_uring */
+} raft_io_backend_t;
+
+/**
+ * When WAL appends are made durable
+ * Entries only count as persisted (towards commit on a leader, in the
+ * match_index a follower acks) once the policy has synced them.
+ */
+typedef enum {
+    RAFT_SYNC_ALWAYS = 0,       /* fdatasync every append (within group_commit_us) */
+    RAFT_SYNC_BATCH = 1,        /* fdatasync only before an ack or a commit needs it */
+    RAFT_SYNC_INTERVAL = 2,     /* fdatasync every sync_interval_ms or sync_interval_bytes */
+    RAFT_SYNC_NONE = 3,         /* Never fdatasync; written counts as persisted */
+} raft_sync_policy_t;
+
+/**
+ * Built-in storage backends
+ */
+typedef enum {
+    RAFT_STORAGE_FILE = 0,      /* WAL segments plus state file (see storage_file.c) */
+    RAFT_STORAGE_MEMORY = 1,    /* Process memory only; nothing reaches disk */
+    RAFT_STORAGE_MMAP = 2,      /* One memory-mapped append-only log file */
+} raft_storage_backend_t;
+
 /**
  * Log entry
  */
@@ -55,6 +85,15 @@ typedef struct raft_entry {
     size_t command_len;       /* Length of command data */
 } raft_entry_t;
 
+/**
+ * Term run - entries from first_index up to the next run's first_index
+ * (or the end of the log) were all written in term
+ */
+typedef struct raft_term_run {
+    uint64_t first_index;     /* First log index written in this term */
+    uint64_t term;            /* Term of the run */
+} raft_term_run_t;
+
 /**
  * Persistent state (must be saved to stable storage before responding to RPCs)
  */
@@ -83,6 +122,7 @@ typedef struct raft_leader_state {
 typedef struct raft_log raft_log_t;
 typedef struct raft_node raft_node_t;
 typedef struct raft_config raft_config_t;
+typedef struct raft_storage_ops raft_storage_ops_t;
 
 /**
  * Callback for applying committed entries to state machine
@@ -95,6 +135,15 @@ typedef void (*raft_apply_fn)(raft_node_t* node, const raft_entry_t* entry, void
 typedef void (*raft_send_fn)(raft_node_t* node, int32_t peer_id, const void* msg,
                              size_t msg_len, void* user_data);
 
+/**
+ * Callback for sending RPC messages as a gather list (optional)
+ * Entry payloads are referenced straight from the log, so the iovecs are
+ * only valid for the duration of the call.
+ */
+typedef void (*raft_sendv_fn)(raft_node_t* node, int32_t peer_id,
+                              const struct iovec* iov, int iovcnt,
+                              void* user_data);
+
 /**
  * Raft configuration
  */
@@ -103,8 +152,22 @@ struct raft_config {
     int32_t num_nodes;        /* Total number of nodes in cluster */
     raft_apply_fn apply_fn;   /* State machine apply callback */
     raft_send_fn send_fn;     /* RPC send callback */
+    raft_sendv_fn sendv_fn;   /* Gather send for AppendEntries (NULL = use send_fn) */
     void* user_data;          /* User data passed to callbacks */
     const char* data_dir;     /* Data directory for persistence (NULL = no persistence) */
+    size_t log_memory_budget; /* Resident log payload bytes before eviction (0 = unlimited) */
+    uint32_t group_commit_us; /* WAL group-commit window in microseconds (0 = sync every append) */
+    raft_io_backend_t io_backend; /* WAL I/O backend (falls back to RAFT_IO_SYNC if unavailable) */
+    uint32_t recovery_threads; /* Threads verifying the WAL at startup (0 = one per CPU) */
+    raft_sync_policy_t sync_policy; /* When appends are synced (default RAFT_SYNC_ALWAYS) */
+    uint32_t sync_interval_ms;  /* RAFT_SYNC_INTERVAL: longest an append waits (0 = no time limit) */
+    size_t sync_interval_bytes; /* RAFT_SYNC_INTERVAL: payload bytes that force a sync (0 = no limit) */
+    raft_storage_backend_t storage_backend; /* Where data_dir's state lives (default RAFT_STORAGE_FILE) */
+    const raft_storage_ops_t* storage_ops; /* Custom backend, overrides storage_backend (NULL = none) */
+    uint32_t snapshot_chunk_size;   /* InstallSnapshot chunk bytes (0 = RAFT_SNAPSHOT_CHUNK_SIZE) */
+    uint32_t snapshot_max_inflight; /* Chunks sent ahead of the ack (0 = RAFT_SNAPSHOT_MAX_INFLIGHT) */
+    size_t compaction_memory_budget;   /* Resident log bytes forcing compaction (0 = RAFT_COMPACT_MEMORY_BUDGET) */
+    uint64_t compaction_disk_budget;   /* Storage log bytes forcing compaction (0 = RAFT_COMPACT_DISK_BUDGET) */
 };
 
 #endif /* RAFT_TYPES_H */
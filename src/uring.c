@@ -0,0 +1,248 @@
+/**
+ * uring.c - Minimal io_uring ring on raw syscalls
+ *
+ * The submission and completion rings are shared with the kernel; the
+ * head/tail indexes are read and published with acquire/release
+ * ordering as io_uring requires.
+ */
+
+#include "uring.h"
+
+#ifdef RAFT_HAVE_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+struct raft_uring {
+    int fd;
+
+    /* Submission ring */
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+    unsigned sq_local_tail;   /* Tail including SQEs not yet published */
+    unsigned to_submit;       /* SQEs queued since the last submit */
+
+    /* Completion ring */
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+
+    /* Mappings to undo */
+    void* sq_ring;
+    size_t sq_ring_len;
+    void* cq_ring;
+    size_t cq_ring_len;
+    size_t sqes_len;
+};
+
+static int uring_setup(unsigned entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                       unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                        flags, NULL, 0);
+}
+
+bool raft_uring_supported(void) {
+    raft_uring_t* ring = raft_uring_create(1);
+    if (!ring) return false;
+    raft_uring_destroy(ring);
+    return true;
+}
+
+raft_uring_t* raft_uring_create(unsigned entries) {
+    raft_uring_t* ring = calloc(1, sizeof(raft_uring_t));
+    if (!ring) return NULL;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = uring_setup(entries, &params);
+    if (ring->fd < 0) {
+        free(ring);
+        return NULL;
+    }
+
+    ring->sq_ring_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_len > ring->sq_ring_len) ring->sq_ring_len = ring->cq_ring_len;
+        ring->cq_ring_len = ring->sq_ring_len;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_len, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        close(ring->fd);
+        free(ring);
+        return NULL;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_len, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            munmap(ring->sq_ring, ring->sq_ring_len);
+            close(ring->fd);
+            free(ring);
+            return NULL;
+        }
+    }
+
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        if (ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_len);
+        munmap(ring->sq_ring, ring->sq_ring_len);
+        close(ring->fd);
+        free(ring);
+        return NULL;
+    }
+
+    char* sq = ring->sq_ring;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = *(unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_entries = *(unsigned*)(sq + params.sq_off.ring_entries);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->sq_local_tail = *ring->sq_tail;
+
+    char* cq = ring->cq_ring;
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = *(unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    return ring;
+}
+
+void raft_uring_destroy(raft_uring_t* ring) {
+    if (!ring) return;
+    munmap(ring->sqes, ring->sqes_len);
+    if (ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_len);
+    munmap(ring->sq_ring, ring->sq_ring_len);
+    close(ring->fd);
+    free(ring);
+}
+
+/* Next free SQE, zeroed, or NULL if the submission ring is full */
+static struct io_uring_sqe* get_sqe(raft_uring_t* ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_local_tail - head >= ring->sq_entries) return NULL;
+
+    unsigned slot = ring->sq_local_tail & ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[slot];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[slot] = slot;
+    ring->sq_local_tail++;
+    ring->to_submit++;
+    return sqe;
+}
+
+bool raft_uring_prep_write(raft_uring_t* ring, int fd, const void* buf,
+                           size_t len, uint64_t offset, uint64_t user_data) {
+    struct io_uring_sqe* sqe = get_sqe(ring);
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = (uint32_t)len;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    return true;
+}
+
+bool raft_uring_prep_fdatasync(raft_uring_t* ring, int fd, uint64_t user_data) {
+    struct io_uring_sqe* sqe = get_sqe(ring);
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = fd;
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    /* Writes may complete in any order; draining makes the sync cover
+     * everything queued before it */
+    sqe->flags = IOSQE_IO_DRAIN;
+    sqe->user_data = user_data;
+    return true;
+}
+
+raft_status_t raft_uring_submit(raft_uring_t* ring, unsigned wait_nr) {
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+    unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    while (ring->to_submit > 0 || wait_nr > 0) {
+        int ret = uring_enter(ring->fd, ring->to_submit, wait_nr, flags);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return RAFT_IO_ERROR;
+        }
+        ring->to_submit -= (unsigned)ret;
+        /* Waiting covers any completions; stop once everything is in */
+        wait_nr = 0;
+        flags = 0;
+    }
+    return RAFT_OK;
+}
+
+bool raft_uring_peek(raft_uring_t* ring, raft_uring_cqe_t* cqe) {
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    if (head == tail) return false;
+
+    const struct io_uring_cqe* c = &ring->cqes[head & ring->cq_mask];
+    cqe->user_data = c->user_data;
+    cqe->res = c->res;
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+#else /* !RAFT_HAVE_IO_URING */
+
+bool raft_uring_supported(void) {
+    return false;
+}
+
+raft_uring_t* raft_uring_create(unsigned entries) {
+    (void)entries;
+    return NULL;
+}
+
+void raft_uring_destroy(raft_uring_t* ring) {
+    (void)ring;
+}
+
+bool raft_uring_prep_write(raft_uring_t* ring, int fd, const void* buf,
+                           size_t len, uint64_t offset, uint64_t user_data) {
+    (void)ring; (void)fd; (void)buf; (void)len; (void)offset; (void)user_data;
+    return false;
+}
+
+bool raft_uring_prep_fdatasync(raft_uring_t* ring, int fd, uint64_t user_data) {
+    (void)ring; (void)fd; (void)user_data;
+    return false;
+}
+
+raft_status_t raft_uring_submit(raft_uring_t* ring, unsigned wait_nr) {
+    (void)ring; (void)wait_nr;
+    return RAFT_IO_ERROR;
+}
+
+bool raft_uring_peek(raft_uring_t* ring, raft_uring_cqe_t* cqe) {
+    (void)ring; (void)cqe;
+    return false;
+}
+
+#endif /* RAFT_HAVE_IO_URING */
@@ -0,0 +1,73 @@
+/**
+ * uring.h - Minimal io_uring ring on raw syscalls
+ *
+ * Just enough of io_uring for the WAL's asynchronous backend: set up a
+ * ring, queue SQEs, submit, and reap CQEs. Uses io_uring_setup and
+ * io_uring_enter directly, so no liburing is needed. On systems
+ * without <linux/io_uring.h> every call fails and
+ * raft_uring_supported() returns false.
+ */
+
+#ifndef RAFT_URING_H
+#define RAFT_URING_H
+
+#include "types.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define RAFT_HAVE_IO_URING 1
+#endif
+#endif
+
+typedef struct raft_uring raft_uring_t;
+
+/**
+ * One completed operation
+ */
+typedef struct {
+    uint64_t user_data;   /* Value given to raft_uring_prep_* */
+    int32_t res;          /* Bytes transferred, 0, or -errno */
+} raft_uring_cqe_t;
+
+/**
+ * Check whether the kernel lets us create a ring
+ */
+bool raft_uring_supported(void);
+
+/**
+ * Create a ring with room for at least entries queued operations
+ * @return Ring or NULL if io_uring is unavailable
+ */
+raft_uring_t* raft_uring_create(unsigned entries);
+
+/**
+ * Tear down the ring; operations still in flight are abandoned
+ */
+void raft_uring_destroy(raft_uring_t* ring);
+
+/**
+ * Queue a write of len bytes from buf at offset
+ * Returns false if the submission queue is full.
+ */
+bool raft_uring_prep_write(raft_uring_t* ring, int fd, const void* buf,
+                           size_t len, uint64_t offset, uint64_t user_data);
+
+/**
+ * Queue an fdatasync of fd that starts only after every operation
+ * queued before it has completed
+ * Returns false if the submission queue is full.
+ */
+bool raft_uring_prep_fdatasync(raft_uring_t* ring, int fd, uint64_t user_data);
+
+/**
+ * Submit queued operations, waiting for at least wait_nr completions
+ */
+raft_status_t raft_uring_submit(raft_uring_t* ring, unsigned wait_nr);
+
+/**
+ * Take one completion if there is one
+ * @return true if *cqe was filled in
+ */
+bool raft_uring_peek(raft_uring_t* ring, raft_uring_cqe_t* cqe);
+
+#endif /* RAFT_URING_H */
@@ -0,0 +1,1717 @@
+/**
+ * wal.c - Segmented write-ahead log implementation
+ *
+ * File formats:
+ * - raft_wal_<first_index:020>.seg: Segment header + Entry records
+ *   Header: | magic(4) | version(4) | first_index(8) |
+ *   Entry:  | record_len(4) | crc32c(4) | term(8) | index(8) | cmd_len(4) | command(var) |
+ *   State:  | record_len(4) | crc32c(4) | current_term(8) | 0(8) | 4(4) | voted_for(4) |
+ * - raft_wal_spare_<n>.seg: dropped segment waiting to be reused
+ * - raft_wal.ckpt: Checkpoint header + one row per segment it covers
+ *   Header: | magic(4) | version(4) | crc32c(4) | row_count(4) |
+ *           | last_index(8) | last_term(8) | entry_count(8) |
+ *           | state_term(8) | state_segment(8) | state_offset(8) | voted_for(4) | pad(4) |
+ *   Row:    | first_index(8) | count(8) | end(8) |
+ *
+ * Version 4 segments may hold hard-state records between entries;
+ * version 3 segments (entries only, CRC32C) and version 2 segments
+ * (CRC32) are still read, and the first append after opening one starts
+ * a new segment so a file never mixes formats.
+ *
+ * A hard-state record carries current_term and voted_for and is written
+ * like an entry with index 0, which no entry has. It is not counted or
+ * indexed as a record of its segment; the segment's end simply moves
+ * past it, so the sync that makes the entries around it durable covers
+ * it too. Hard state only ever moves forward (a higher term, or a vote
+ * in a term that had none), so the newest one is the greatest seen
+ * and stale copies in a recycled spare can never win. Truncation and
+ * compaction may remove the record holding it; raft_wal_state_cut_by
+ * and raft_wal_state_dropped_by let the caller keep it elsewhere first.
+ * A last segment filled with hard state alone has no next index to name
+ * a successor after, so it is replaced by one holding the newest record.
+ *
+ * Segments are preallocated, so the end of a segment is not its file
+ * size: records are read until one is zero, fails its CRC or does not
+ * carry the next expected index. A reused spare still holds records
+ * from before it was dropped, but their indexes are all lower than
+ * anything appended after the drop, so the index check rejects them.
+ *
+ * Each segment keeps the offset of every record, built by the scan at
+ * open and extended by appends, so truncation and random reads go
+ * straight to the record instead of walking headers.
+ *
+ * The checkpoint records how many records each segment held and where
+ * they ended, as of the last segment roll or clean close. Open trusts
+ * it for the segments it covers and only scans what was written after
+ * it, leaving those segments unindexed; recovery's walk checks their
+ * CRCs and builds the index in the same pass, and anything else that
+ * needs the offsets first builds them from the record headers. Since
+ * a checkpoint only ever describes synced records, the one thing that
+ * can make it wrong is cutting records it covers, so suffix truncation
+ * below its last index deletes it first.
+ *
+ * With an io_uring ring attached, appends and syncs are queued on the
+ * ring instead of issued inline. Records are copied into a staging
+ * buffer owned by the write, since the caller's entries may be freed
+ * before it completes. Anything that needs the file quiescent (rolling,
+ * truncation, reads, close) drains the ring first.
+ *
+ * Recovery can walk each segment through a read-only mapping and hand
+ * out payloads in place. Record boundaries are found from the offset
+ * index or a walk over the headers, then CRCs are checked in chunks
+ * across a thread pool; the callback still sees records one at a time
+ * in index order on the calling thread. The mapping lives in a
+ * raft_buf_t that unmaps it when the last entry pointing into it is
+ * dropped. Truncation keeps a segment's size (it re-preallocates) and
+ * recycling only ever reuses segments whose entries were all compacted,
+ * so a mapping never sees the bytes under a live entry change or
+ * disappear.
+ */
+
+#define _GNU_SOURCE
+#include "wal.h"
+#include "crc32.h"
+#include "param.h"
+#include "uring.h"
+#include "buf.h"
+#include "pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+
+#define SEGMENT_PREFIX      "raft_wal_"
+#define SEGMENT_SUFFIX      ".seg"
+#define SEGMENT_DIGITS      20
+#define SPARE_FORMAT        "raft_wal_spare_%u.seg"
+#define CHECKPOINT_FILE     "raft_wal.ckpt"
+#define CHECKPOINT_TMP_FILE "raft_wal.ckpt.tmp"
+
+/* Entries per pwritev call (two iovecs each, within IOV_MAX) */
+#define WRITE_BATCH_ENTRIES 512
+
+/* Bytes per pread when scanning or replaying a segment */
+#define READ_CHUNK_SIZE     (1024 * 1024)
+
+/* Segment file header (16 bytes) */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t first_index;
+} __attribute__((packed)) segment_header_t;
+
+/* Log entry record header (28 bytes + variable command) */
+typedef struct {
+    uint32_t record_len;  /* Total record length including this header */
+    uint32_t crc32;       /* CRC32C of term + index + cmd_len + command */
+    uint64_t term;
+    uint64_t index;
+    uint32_t cmd_len;
+} __attribute__((packed)) log_record_t;
+
+/* Checkpoint file header (72 bytes), followed by row_count rows */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t crc32;        /* CRC of everything after this field */
+    uint32_t row_count;
+    uint64_t last_index;   /* Last record covered */
+    uint64_t last_term;    /* Its term */
+    uint64_t entry_count;  /* Records across all rows */
+    uint64_t state_term;   /* Newest hard state in the rows (0 = none) */
+    uint64_t state_segment; /* First index of the segment holding it */
+    uint64_t state_offset; /* Its offset in that segment */
+    int32_t state_voted_for;
+    uint32_t padding;
+} __attribute__((packed)) checkpoint_header_t;
+
+/* One covered segment (24 bytes) */
+typedef struct {
+    uint64_t first_index;
+    uint64_t count;
+    uint64_t end;
+} __attribute__((packed)) checkpoint_row_t;
+
+/* One segment file
+ * Offsets are stored as 32-bit deltas from the segment start, half the
+ * size of an off_t per entry; segments are capped well below 4GB. */
+typedef struct {
+    uint64_t first_index;  /* Index of the first record (names the file) */
+    uint64_t count;        /* Records in the segment */
+    off_t end;             /* Offset just past the last record */
+    uint32_t* offsets;     /* Offset of each record in the segment */
+    uint64_t offsets_capacity;
+    bool indexed;          /* offsets filled in (false if checkpointed) */
+    uint32_t version;      /* Format version from the segment header */
+} wal_segment_t;
+
+/* Sequential reader over one segment
+ * Reads in READ_CHUNK_SIZE preads so a scan costs one syscall per
+ * chunk rather than two per record. */
+typedef struct {
+    int fd;
+    char* buf;
+    size_t capacity;
+    off_t start;           /* File offset of buf[0] */
+    size_t len;            /* Bytes of buf holding file data */
+} segment_reader_t;
+
+/* An operation in flight on the ring */
+typedef struct {
+    char* buf;             /* Staged records for a write, NULL for a sync */
+    size_t len;
+    uint64_t index;        /* Sync: last index it makes durable */
+} wal_op_t;
+
+struct raft_wal {
+    char* dir;
+    size_t segment_size;    /* Preallocation for new segments */
+    bool sync;              /* Sync rolled segments and directory changes */
+    wal_segment_t* segs;    /* Segments in index order; last is active */
+    size_t seg_count;
+    size_t seg_capacity;
+    int fd;                 /* Active segment, -1 if there is none */
+    uint64_t entry_count;   /* Records across all segments */
+    unsigned spares;        /* Spare files raft_wal_spare_0..spares-1 */
+    bool dir_dirty;         /* Segments created or removed since last sync */
+    raft_uring_t* ring;     /* Asynchronous backend (NULL = inline I/O) */
+    uint64_t inflight;      /* Ring operations not yet reaped */
+    uint64_t synced_index;  /* Last index covered by a completed sync */
+    raft_status_t io_status; /* First error reported by a completion */
+    uint64_t ckpt_index;    /* Last index the checkpoint file covers */
+    uint64_t ckpt_term;     /* Its term, if open trusted the checkpoint */
+    size_t verify_threads;  /* Threads checking CRCs in mapped iteration */
+    bool has_state;         /* A hard-state record has been seen */
+    uint64_t state_term;    /* Newest hard state */
+    int32_t state_voted_for;
+    bool state_located;     /* Its record is still in a segment: */
+    uint64_t state_segment; /*   first index of that segment */
+    off_t state_offset;     /*   and its offset there */
+};
+
+/* What verification reads out of each record for the callback */
+typedef struct {
+    uint64_t term;
+    uint32_t cmd_len;
+} decoded_record_t;
+
+/* One segment's records, split into tasks for the verification pool */
+typedef struct {
+    const char* data;            /* Mapped segment */
+    const wal_segment_t* seg;
+    uint64_t count;              /* Records whose boundaries are known */
+    decoded_record_t* decoded;
+    uint64_t* first_bad;         /* Per task: first record failing, or count */
+} verify_ctx_t;
+
+/* Account for every completion the ring has posted */
+static void wal_reap(raft_wal_t* wal) {
+    raft_uring_cqe_t cqe;
+    while (raft_uring_peek(wal->ring, &cqe)) {
+        wal_op_t* op = (wal_op_t*)(uintptr_t)cqe.user_data;
+        if (op->buf) {
+            if (cqe.res != (int32_t)op->len && wal->io_status == RAFT_OK) {
+                wal->io_status = RAFT_IO_ERROR;
+            }
+            free(op->buf);
+        } else if (cqe.res < 0) {
+            if (wal->io_status == RAFT_OK) wal->io_status = RAFT_IO_ERROR;
+        } else if (op->index > wal->synced_index) {
+            wal->synced_index = op->index;
+        }
+        free(op);
+        wal->inflight--;
+    }
+}
+
+/* Wait for every queued operation to complete */
+static raft_status_t wal_drain(raft_wal_t* wal) {
+    if (!wal->ring) return RAFT_OK;
+    while (wal->inflight > 0) {
+        if (raft_uring_submit(wal->ring, 1) != RAFT_OK) return RAFT_IO_ERROR;
+        wal_reap(wal);
+    }
+    return wal->io_status;
+}
+
+/* Queue op on the ring, making room by waiting if the ring is full */
+static raft_status_t wal_queue(raft_wal_t* wal, int fd, wal_op_t* op, off_t offset) {
+    for (;;) {
+        bool queued = op->buf
+            ? raft_uring_prep_write(wal->ring, fd, op->buf, op->len, (uint64_t)offset,
+                                    (uint64_t)(uintptr_t)op)
+            : raft_uring_prep_fdatasync(wal->ring, fd, (uint64_t)(uintptr_t)op);
+        if (queued) break;
+        if (raft_uring_submit(wal->ring, 1) != RAFT_OK) return RAFT_IO_ERROR;
+        wal_reap(wal);
+    }
+    wal->inflight++;
+    return RAFT_OK;
+}
+
+/* Copy a run of records into one buffer and queue a write of it */
+static raft_status_t wal_queue_write(raft_wal_t* wal, const struct iovec* iov,
+                                     int iovcnt, size_t bytes, off_t offset) {
+    wal_op_t* op = malloc(sizeof(wal_op_t));
+    char* buf = malloc(bytes);
+    if (!op || !buf) {
+        free(op);
+        free(buf);
+        return RAFT_NO_MEMORY;
+    }
+    size_t pos = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        memcpy(buf + pos, iov[i].iov_base, iov[i].iov_len);
+        pos += iov[i].iov_len;
+    }
+    *op = (wal_op_t){ .buf = buf, .len = bytes };
+
+    raft_status_t status = wal_queue(wal, wal->fd, op, offset);
+    if (status != RAFT_OK) {
+        free(buf);
+        free(op);
+    }
+    return status;
+}
+
+static void segment_path(const raft_wal_t* wal, uint64_t first_index,
+                         char* path, size_t len) {
+    snprintf(path, len, "%s/" SEGMENT_PREFIX "%0*llu" SEGMENT_SUFFIX,
+             wal->dir, SEGMENT_DIGITS, (unsigned long long)first_index);
+}
+
+static void spare_path(const raft_wal_t* wal, unsigned n, char* path, size_t len) {
+    int used = snprintf(path, len, "%s/", wal->dir);
+    snprintf(path + used, len - used, SPARE_FORMAT, n);
+}
+
+/* Parse "raft_wal_<20 digits>.seg"; spares and other files don't match */
+static bool parse_segment_name(const char* name, uint64_t* first_index) {
+    size_t prefix = strlen(SEGMENT_PREFIX);
+    if (strlen(name) != prefix + SEGMENT_DIGITS + strlen(SEGMENT_SUFFIX)) return false;
+    if (strncmp(name, SEGMENT_PREFIX, prefix) != 0) return false;
+    if (strcmp(name + prefix + SEGMENT_DIGITS, SEGMENT_SUFFIX) != 0) return false;
+
+    uint64_t value = 0;
+    for (size_t i = 0; i < SEGMENT_DIGITS; i++) {
+        char c = name[prefix + i];
+        if (c < '0' || c > '9') return false;
+        value = value * 10 + (uint64_t)(c - '0');
+    }
+    *first_index = value;
+    return true;
+}
+
+static int compare_segments(const void* a, const void* b) {
+    uint64_t x = ((const wal_segment_t*)a)->first_index;
+    uint64_t y = ((const wal_segment_t*)b)->first_index;
+    return (x > y) - (x < y);
+}
+
+/* Reserve the whole segment up front so appends never extend the file;
+ * file systems without fallocate just get a sparse file */
+static int preallocate(int fd, size_t size) {
+    if (fallocate(fd, 0, 0, (off_t)size) == 0) return 0;
+    if (errno != EOPNOTSUPP && errno != ENOSYS) return -1;
+    struct stat st;
+    if (fstat(fd, &st) < 0) return -1;
+    if (st.st_size >= (off_t)size) return 0;
+    return ftruncate(fd, (off_t)size);
+}
+
+/* Sync the directory if segment files were created or removed */
+static raft_status_t sync_dir(raft_wal_t* wal) {
+    /* New and removed segment files only count once the directory
+     * entry is on disk too */
+    if (wal->dir_dirty) {
+        int dfd = open(wal->dir, O_RDONLY | O_DIRECTORY);
+        if (dfd < 0) return RAFT_IO_ERROR;
+        int rc = fsync(dfd);
+        close(dfd);
+        if (rc < 0) return RAFT_IO_ERROR;
+        wal->dir_dirty = false;
+    }
+    return RAFT_OK;
+}
+
+/* Fill in a record header (including its CRC) for entry */
+static void record_init(log_record_t* rec, const raft_entry_t* entry) {
+    size_t cmd_len = entry->command ? entry->command_len : 0;
+
+    rec->record_len = sizeof(log_record_t) + cmd_len;
+    rec->term = entry->term;
+    rec->index = entry->index;
+    rec->cmd_len = (uint32_t)cmd_len;
+
+    /* Calculate CRC over term, index, cmd_len, and command */
+    uint32_t crc = crc32c(&rec->term, sizeof(rec->term) + sizeof(rec->index) + sizeof(rec->cmd_len));
+    if (cmd_len > 0) {
+        crc = crc32c_update(crc, entry->command, cmd_len);
+    }
+    rec->crc32 = crc;
+}
+
+/* CRC of a record in a segment of the given format version */
+static uint32_t record_crc(const log_record_t* rec, const char* command, uint32_t version) {
+    uint32_t (*update)(uint32_t, const void*, size_t) =
+        version >= RAFT_WAL_VERSION_CRC32C ? crc32c_update : crc32_update;
+    uint32_t crc = update(0, &rec->term, sizeof(rec->term) + sizeof(rec->index) + sizeof(rec->cmd_len));
+    if (rec->cmd_len > 0) {
+        crc = update(crc, command, rec->cmd_len);
+    }
+    return crc;
+}
+
+/* Check a whole record held in memory at data (at least the header)
+ * Returns false unless it is a well-formed record for expected_index
+ * whose bytes are all present and match its CRC */
+static bool record_parse(const char* data, size_t avail, uint64_t expected_index,
+                         uint32_t version, log_record_t* rec) {
+    if (avail < sizeof(*rec)) return false;
+    memcpy(rec, data, sizeof(*rec));
+    if (rec->index != expected_index) return false;
+    if (rec->cmd_len > RAFT_MAX_COMMAND_SIZE) return false;
+    if (rec->record_len != sizeof(*rec) + (size_t)rec->cmd_len) return false;
+    if (avail < rec->record_len) return false;
+    return record_crc(rec, data + sizeof(*rec), version) == rec->crc32;
+}
+
+/* Pointer to len bytes of the file at pos, or NULL if it ends first */
+static const char* reader_get(segment_reader_t* r, off_t pos, size_t len) {
+    if (pos >= r->start && pos + (off_t)len <= r->start + (off_t)r->len) {
+        return r->buf + (pos - r->start);
+    }
+
+    size_t want = len > READ_CHUNK_SIZE ? len : READ_CHUNK_SIZE;
+    if (want > r->capacity) {
+        char* grown = realloc(r->buf, want);
+        if (!grown) return NULL;
+        r->buf = grown;
+        r->capacity = want;
+    }
+    ssize_t n = pread(r->fd, r->buf, want, pos);
+    r->start = pos;
+    r->len = n > 0 ? (size_t)n : 0;
+    return r->len >= len ? r->buf : NULL;
+}
+
+/* Read and check the record at pos, leaving its bytes in the reader */
+static bool reader_record(segment_reader_t* r, off_t pos, uint64_t expected_index,
+                          uint32_t version, log_record_t* rec, const char** command) {
+    const char* data = reader_get(r, pos, sizeof(*rec));
+    if (!data) return false;
+    memcpy(rec, data, sizeof(*rec));
+    if (rec->record_len < sizeof(*rec) ||
+        rec->record_len > sizeof(*rec) + RAFT_MAX_COMMAND_SIZE) {
+        return false;
+    }
+    data = reader_get(r, pos, rec->record_len);
+    if (!data || !record_parse(data, rec->record_len, expected_index, version, rec)) {
+        return false;
+    }
+    *command = data + sizeof(*rec);
+    return true;
+}
+
+/* Whether a record header (already checked) is a hard-state record */
+static bool record_is_state(const log_record_t* rec) {
+    return rec->index == 0 && rec->cmd_len == sizeof(int32_t) &&
+           rec->record_len == sizeof(*rec) + sizeof(int32_t);
+}
+
+/* Note a hard-state record found or written at offset in segment
+ * first_index, if it is at least as new as the newest so far */
+static void state_note(raft_wal_t* wal, uint64_t term, int32_t voted_for,
+                       uint64_t first_index, off_t offset) {
+    if (wal->has_state &&
+        (term < wal->state_term ||
+         (term == wal->state_term && voted_for == -1 && wal->state_voted_for != -1))) {
+        return;
+    }
+    wal->has_state = true;
+    wal->state_term = term;
+    wal->state_voted_for = voted_for;
+    wal->state_located = true;
+    wal->state_segment = first_index;
+    wal->state_offset = offset;
+}
+
+/* Length of the hard-state records at data (none if it is anything else)
+ * Only for records already known good, as in an indexed segment */
+static size_t skip_state_records(const char* data, size_t avail) {
+    size_t skipped = 0;
+    log_record_t rec;
+    while (avail - skipped >= sizeof(rec)) {
+        memcpy(&rec, data + skipped, sizeof(rec));
+        if (!record_is_state(&rec)) break;
+        skipped += rec.record_len;
+    }
+    return skipped;
+}
+
+/* Make room in seg's offset index for needed records in all */
+static bool segment_reserve(wal_segment_t* seg, uint64_t needed) {
+    if (needed <= seg->offsets_capacity) return true;
+    uint64_t capacity = seg->offsets_capacity ? seg->offsets_capacity : 256;
+    while (capacity < needed) capacity *= 2;
+    uint32_t* grown = realloc(seg->offsets, capacity * sizeof(uint32_t));
+    if (!grown) return false;
+    seg->offsets = grown;
+    seg->offsets_capacity = capacity;
+    return true;
+}
+
+/* Offset of the record for index within seg (seg->end if past the last) */
+static off_t record_offset(const wal_segment_t* seg, uint64_t index) {
+    uint64_t i = index - seg->first_index;
+    return i < seg->count ? (off_t)seg->offsets[i] : seg->end;
+}
+
+/* Find where the valid records of an opened segment end, starting
+ * from seg->end and indexing each record found if seg is indexed
+ * Hard-state records on the way are noted in wal. Returns true if the
+ * scan stopped at something other than zeroes, i.e. a torn or stale
+ * record follows the last good one */
+static bool scan_segment(raft_wal_t* wal, int fd, wal_segment_t* seg) {
+    segment_reader_t reader = { .fd = fd };
+    log_record_t rec;
+    const char* command;
+    for (;;) {
+        if (reader_record(&reader, seg->end, seg->first_index + seg->count,
+                          seg->version, &rec, &command)) {
+            if (seg->indexed) {
+                if (!segment_reserve(seg, seg->count + 1)) break;
+                seg->offsets[seg->count] = (uint32_t)seg->end;
+            }
+            seg->count++;
+        } else if (seg->version >= RAFT_WAL_VERSION &&
+                   reader_record(&reader, seg->end, 0, seg->version, &rec, &command) &&
+                   record_is_state(&rec)) {
+            int32_t voted_for;
+            memcpy(&voted_for, command, sizeof(voted_for));
+            state_note(wal, rec.term, voted_for, seg->first_index, seg->end);
+        } else {
+            break;
+        }
+        seg->end += rec.record_len;
+    }
+
+    const char* next = reader_get(&reader, seg->end, sizeof(uint32_t));
+    uint32_t next_len = 0;
+    if (next) memcpy(&next_len, next, sizeof(next_len));
+    free(reader.buf);
+    return next_len != 0;
+}
+
+/* Cut a segment at offset and re-preallocate it so everything past the
+ * cut reads back as zeroes */
+static raft_status_t segment_zero_tail(raft_wal_t* wal, int fd, off_t offset) {
+    if (ftruncate(fd, offset) < 0) return RAFT_IO_ERROR;
+    if (preallocate(fd, wal->segment_size) < 0) return RAFT_IO_ERROR;
+    return RAFT_OK;
+}
+
+static int segment_open(const raft_wal_t* wal, uint64_t first_index) {
+    char path[PATH_MAX];
+    segment_path(wal, first_index, path, sizeof(path));
+    return open(path, O_RDWR);
+}
+
+/* fd for reading seg: the active segment's, or a fresh one to close
+ * Queued writes to the active segment are completed first */
+static int segment_read_fd(raft_wal_t* wal, const wal_segment_t* seg) {
+    if (seg == &wal->segs[wal->seg_count - 1]) {
+        if (wal_drain(wal) != RAFT_OK) return -1;
+        return wal->fd;
+    }
+    return segment_open(wal, seg->first_index);
+}
+
+static void segment_read_done(raft_wal_t* wal, int fd) {
+    if (fd >= 0 && fd != wal->fd) close(fd);
+}
+
+/* Build seg's offset index from its record headers
+ * Segments open took from the checkpoint have none until something
+ * needs it; CRCs are left to whoever reads the records. */
+static raft_status_t segment_index(raft_wal_t* wal, wal_segment_t* seg) {
+    if (seg->indexed) return RAFT_OK;
+    if (!segment_reserve(seg, seg->count)) return RAFT_NO_MEMORY;
+
+    segment_reader_t reader = { .fd = segment_read_fd(wal, seg) };
+    if (reader.fd < 0) return RAFT_IO_ERROR;
+
+    raft_status_t status = RAFT_OK;
+    off_t pos = sizeof(segment_header_t);
+    for (uint64_t i = 0; i <= seg->count; i++) {
+        /* Step over hard-state records, including any after the last entry */
+        const char* data;
+        log_record_t rec;
+        while (pos < seg->end &&
+               (data = reader_get(&reader, pos, sizeof(rec))) != NULL) {
+            memcpy(&rec, data, sizeof(rec));
+            if (!record_is_state(&rec)) break;
+            pos += rec.record_len;
+        }
+        if (i == seg->count) break;
+
+        data = reader_get(&reader, pos, sizeof(rec));
+        if (data) memcpy(&rec, data, sizeof(rec));
+        if (!data || rec.index != seg->first_index + i ||
+            rec.record_len != sizeof(rec) + (size_t)rec.cmd_len) {
+            status = RAFT_CORRUPTION;
+            break;
+        }
+        seg->offsets[i] = (uint32_t)pos;
+        pos += rec.record_len;
+    }
+    if (status == RAFT_OK && pos != seg->end) status = RAFT_CORRUPTION;
+
+    segment_read_done(wal, reader.fd);
+    free(reader.buf);
+    if (status == RAFT_OK) seg->indexed = true;
+    return status;
+}
+
+static void checkpoint_path(const raft_wal_t* wal, const char* name,
+                            char* path, size_t len) {
+    snprintf(path, len, "%s/%s", wal->dir, name);
+}
+
+/* Record where the records of segs[0..count) end
+ * Called only once they are synced (or sync is off). The file is
+ * replaced by rename without an fsync of its own: after a crash it is
+ * the old checkpoint, the new one, or one failing its CRC that open
+ * ignores, and each of those is safe to trust or skip. */
+static void checkpoint_write(raft_wal_t* wal, size_t count) {
+    while (count > 0 && wal->segs[count - 1].count == 0) count--;
+    if (count == 0) return;
+
+    /* The last record's term, read back from its header */
+    wal_segment_t* last = &wal->segs[count - 1];
+    if (segment_index(wal, last) != RAFT_OK) return;
+    int fd = segment_read_fd(wal, last);
+    if (fd < 0) return;
+    log_record_t rec;
+    ssize_t n = pread(fd, &rec, sizeof(rec), last->offsets[last->count - 1]);
+    segment_read_done(wal, fd);
+    if (n != sizeof(rec)) return;
+
+    size_t size = sizeof(checkpoint_header_t) + count * sizeof(checkpoint_row_t);
+    char* buf = malloc(size);
+    if (!buf) return;
+
+    checkpoint_header_t* header = (checkpoint_header_t*)buf;
+    checkpoint_row_t* rows = (checkpoint_row_t*)(buf + sizeof(*header));
+    uint32_t row_count = 0;
+    uint64_t entries = 0;
+    bool state_covered = false;
+    for (size_t i = 0; i < count; i++) {
+        const wal_segment_t* seg = &wal->segs[i];
+        if (seg->count == 0) continue;
+        rows[row_count++] = (checkpoint_row_t){
+            .first_index = seg->first_index,
+            .count = seg->count,
+            .end = (uint64_t)seg->end,
+        };
+        entries += seg->count;
+        if (wal->state_located && wal->state_segment == seg->first_index) {
+            state_covered = true;
+        }
+    }
+    *header = (checkpoint_header_t){
+        .magic = RAFT_WAL_CKPT_MAGIC,
+        .version = RAFT_WAL_CKPT_VERSION,
+        .row_count = row_count,
+        .last_index = last->first_index + last->count - 1,
+        .last_term = rec.term,
+        .entry_count = entries,
+    };
+    /* Hard state is only vouched for where the rows are */
+    if (state_covered) {
+        header->state_term = wal->state_term;
+        header->state_segment = wal->state_segment;
+        header->state_offset = (uint64_t)wal->state_offset;
+        header->state_voted_for = wal->state_voted_for;
+    }
+    size = sizeof(*header) + row_count * sizeof(checkpoint_row_t);
+    size_t skip = offsetof(checkpoint_header_t, row_count);
+    header->crc32 = crc32c(buf + skip, size - skip);
+
+    char tmp[PATH_MAX];
+    char path[PATH_MAX];
+    checkpoint_path(wal, CHECKPOINT_TMP_FILE, tmp, sizeof(tmp));
+    checkpoint_path(wal, CHECKPOINT_FILE, path, sizeof(path));
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        bool written = write(fd, buf, size) == (ssize_t)size;
+        close(fd);
+        if (written && rename(tmp, path) == 0) {
+            wal->ckpt_index = header->last_index;
+        } else {
+            unlink(tmp);
+        }
+    }
+    free(buf);
+}
+
+/* Delete the checkpoint before cutting records it covers
+ * The removal must be on disk first or a crash could bring back a
+ * checkpoint describing records that are gone. */
+static raft_status_t checkpoint_remove(raft_wal_t* wal) {
+    char path[PATH_MAX];
+    checkpoint_path(wal, CHECKPOINT_FILE, path, sizeof(path));
+    if (unlink(path) < 0 && errno != ENOENT) return RAFT_IO_ERROR;
+    wal->ckpt_index = 0;
+    wal->ckpt_term = 0;
+    wal->dir_dirty = true;
+    return wal->sync ? sync_dir(wal) : RAFT_OK;
+}
+
+/* Read and check the checkpoint file
+ * Returns its rows (malloc'd) or NULL if there is no usable one */
+static checkpoint_row_t* checkpoint_load(const raft_wal_t* wal,
+                                         checkpoint_header_t* header) {
+    char path[PATH_MAX];
+    checkpoint_path(wal, CHECKPOINT_FILE, path, sizeof(path));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    checkpoint_row_t* rows = NULL;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(*header) &&
+        pread(fd, header, sizeof(*header), 0) == sizeof(*header) &&
+        header->magic == RAFT_WAL_CKPT_MAGIC &&
+        header->version == RAFT_WAL_CKPT_VERSION &&
+        header->row_count > 0 &&
+        (size_t)st.st_size == sizeof(*header) +
+                              (size_t)header->row_count * sizeof(checkpoint_row_t)) {
+        size_t len = (size_t)st.st_size;
+        char* buf = malloc(len);
+        if (buf && pread(fd, buf, len, 0) == (ssize_t)len) {
+            size_t skip = offsetof(checkpoint_header_t, row_count);
+            if (crc32c(buf + skip, len - skip) == header->crc32) {
+                rows = malloc(header->row_count * sizeof(checkpoint_row_t));
+                if (rows) {
+                    memcpy(rows, buf + sizeof(*header),
+                           header->row_count * sizeof(checkpoint_row_t));
+                }
+            }
+        }
+        free(buf);
+    }
+    close(fd);
+    return rows;
+}
+
+/* Remove a segment file, keeping it as a spare if allowed and wanted */
+static void segment_remove(raft_wal_t* wal, uint64_t first_index, bool recycle) {
+    char path[PATH_MAX];
+    segment_path(wal, first_index, path, sizeof(path));
+
+    if (recycle && wal->spares < RAFT_WAL_SPARE_SEGMENTS) {
+        char spare[PATH_MAX];
+        spare_path(wal, wal->spares, spare, sizeof(spare));
+        if (rename(path, spare) == 0) {
+            wal->spares++;
+            wal->dir_dirty = true;
+            return;
+        }
+    }
+    unlink(path);
+    wal->dir_dirty = true;
+}
+
+/* Start a new active segment whose first record will be first_index */
+static raft_status_t segment_create(raft_wal_t* wal, uint64_t first_index) {
+    if (wal->seg_count == wal->seg_capacity) {
+        size_t capacity = wal->seg_capacity ? wal->seg_capacity * 2 : 8;
+        wal_segment_t* grown = realloc(wal->segs, capacity * sizeof(wal_segment_t));
+        if (!grown) return RAFT_NO_MEMORY;
+        wal->segs = grown;
+        wal->seg_capacity = capacity;
+    }
+
+    /* The segment being left must be durable before anything lands in
+     * the next one, or a crash could leave a hole in the middle */
+    raft_status_t drained = wal_drain(wal);
+    if (drained != RAFT_OK) return drained;
+    if (wal->fd >= 0) {
+        if (wal->sync && fdatasync(wal->fd) < 0) return RAFT_IO_ERROR;
+        close(wal->fd);
+        wal->fd = -1;
+        checkpoint_write(wal, wal->seg_count);
+    }
+
+    char path[PATH_MAX];
+    segment_path(wal, first_index, path, sizeof(path));
+
+    int fd = -1;
+    if (wal->spares > 0) {
+        char spare[PATH_MAX];
+        spare_path(wal, wal->spares - 1, spare, sizeof(spare));
+        if (rename(spare, path) == 0) {
+            wal->spares--;
+            fd = open(path, O_RDWR);
+        }
+    }
+    if (fd < 0) {
+        fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return RAFT_IO_ERROR;
+    }
+    wal->dir_dirty = true;
+
+    segment_header_t header = {
+        .magic = RAFT_WAL_MAGIC,
+        .version = RAFT_WAL_VERSION,
+        .first_index = first_index,
+    };
+    if (preallocate(fd, wal->segment_size) < 0 ||
+        pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+        close(fd);
+        unlink(path);
+        return RAFT_IO_ERROR;
+    }
+
+    wal->segs[wal->seg_count++] = (wal_segment_t){
+        .first_index = first_index,
+        .end = sizeof(header),
+        .indexed = true,
+        .version = RAFT_WAL_VERSION,
+    };
+    wal->fd = fd;
+    return RAFT_OK;
+}
+
+/* Drop the last segment, making the one before it active */
+static raft_status_t segment_drop_last(raft_wal_t* wal) {
+    wal_segment_t* seg = &wal->segs[wal->seg_count - 1];
+    wal_drain(wal);
+    if (wal->fd >= 0) {
+        close(wal->fd);
+        wal->fd = -1;
+    }
+    /* Never recycle a suffix: its records carry indexes that may be
+     * appended again and would pass the index check */
+    segment_remove(wal, seg->first_index, false);
+    wal->entry_count -= seg->count;
+    free(seg->offsets);
+    wal->seg_count--;
+
+    if (wal->seg_count > 0) {
+        wal->fd = segment_open(wal, wal->segs[wal->seg_count - 1].first_index);
+        if (wal->fd < 0) return RAFT_IO_ERROR;
+    }
+    return RAFT_OK;
+}
+
+/* Replace the last segment, full of hard-state records alone, with a
+ * file holding just rec; a new segment would reuse its first index and
+ * so its file name. The rename leaves either the old file or the new
+ * one, and rec is at least as new as anything the old one held. */
+static raft_status_t segment_rewrite_state(raft_wal_t* wal, const log_record_t* rec,
+                                           int32_t voted_for) {
+    wal_segment_t* seg = &wal->segs[wal->seg_count - 1];
+    raft_status_t drained = wal_drain(wal);
+    if (drained != RAFT_OK) return drained;
+
+    char path[PATH_MAX];
+    char tmp[PATH_MAX + 4];
+    segment_path(wal, seg->first_index, path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return RAFT_IO_ERROR;
+    segment_header_t header = {
+        .magic = RAFT_WAL_MAGIC,
+        .version = RAFT_WAL_VERSION,
+        .first_index = seg->first_index,
+    };
+    struct iovec iov[3] = {
+        { .iov_base = &header, .iov_len = sizeof(header) },
+        { .iov_base = (void*)rec, .iov_len = sizeof(*rec) },
+        { .iov_base = &voted_for, .iov_len = sizeof(voted_for) },
+    };
+    size_t bytes = sizeof(header) + rec->record_len;
+    if (preallocate(fd, wal->segment_size) < 0 ||
+        pwritev(fd, iov, 3, 0) != (ssize_t)bytes ||
+        (wal->sync && fdatasync(fd) < 0) ||
+        rename(tmp, path) < 0) {
+        close(fd);
+        unlink(tmp);
+        return RAFT_IO_ERROR;
+    }
+    wal->dir_dirty = true;
+
+    if (wal->fd >= 0) close(wal->fd);
+    wal->fd = fd;
+    seg->version = RAFT_WAL_VERSION;
+    seg->end = sizeof(header);
+    state_note(wal, rec->term, voted_for, seg->first_index, seg->end);
+    seg->end += rec->record_len;
+    return RAFT_OK;
+}
+
+/* Gather spare files left by an earlier run as raft_wal_spare_0..n-1 */
+static void collect_spares(raft_wal_t* wal) {
+    char from[PATH_MAX];
+    char to[PATH_MAX];
+    for (unsigned i = 0; i < RAFT_WAL_SPARE_SEGMENTS; i++) {
+        spare_path(wal, i, from, sizeof(from));
+        if (access(from, F_OK) != 0) continue;
+        if (i != wal->spares) {
+            spare_path(wal, wal->spares, to, sizeof(to));
+            if (rename(from, to) < 0) continue;
+        }
+        wal->spares++;
+    }
+}
+
+/* Find the segments in dir and where the log ends in each */
+static raft_status_t load_segments(raft_wal_t* wal) {
+    DIR* d = opendir(wal->dir);
+    if (!d) return RAFT_IO_ERROR;
+
+    struct dirent* ent;
+    while ((ent = readdir(d)) != NULL) {
+        uint64_t first_index;
+        if (!parse_segment_name(ent->d_name, &first_index)) continue;
+        if (wal->seg_count == wal->seg_capacity) {
+            size_t capacity = wal->seg_capacity ? wal->seg_capacity * 2 : 8;
+            wal_segment_t* grown = realloc(wal->segs, capacity * sizeof(wal_segment_t));
+            if (!grown) {
+                closedir(d);
+                return RAFT_NO_MEMORY;
+            }
+            wal->segs = grown;
+            wal->seg_capacity = capacity;
+        }
+        wal->segs[wal->seg_count++] = (wal_segment_t){ .first_index = first_index };
+    }
+    closedir(d);
+    if (wal->seg_count > 1) {
+        qsort(wal->segs, wal->seg_count, sizeof(wal_segment_t), compare_segments);
+    }
+
+    /* The checkpoint covers the first trusted segments if its rows,
+     * past any whose segments were since compacted, name exactly those
+     * files in order */
+    checkpoint_header_t ckpt;
+    checkpoint_row_t* rows = checkpoint_load(wal, &ckpt);
+    size_t trusted = 0;
+    size_t first_row = 0;
+    if (rows) {
+        uint64_t entries = 0;
+        for (uint32_t r = 0; r < ckpt.row_count; r++) entries += rows[r].count;
+        const checkpoint_row_t* last_row = &rows[ckpt.row_count - 1];
+        bool consistent = entries == ckpt.entry_count &&
+            last_row->first_index + last_row->count - 1 == ckpt.last_index;
+
+        while (first_row < ckpt.row_count && wal->seg_count > 0 &&
+               rows[first_row].first_index < wal->segs[0].first_index) {
+            first_row++;
+        }
+        size_t covered = ckpt.row_count - first_row;
+        if (consistent && covered > 0 && covered <= wal->seg_count) {
+            trusted = covered;
+            for (size_t i = 0; i < covered; i++) {
+                if (rows[first_row + i].first_index != wal->segs[i].first_index) {
+                    trusted = 0;
+                    break;
+                }
+            }
+        }
+        /* Even an unused checkpoint must go before its records are cut */
+        wal->ckpt_index = ckpt.last_index;
+        if (trusted > 0) wal->ckpt_term = ckpt.last_term;
+
+        /* Hard state in a trusted segment is taken as found there */
+        for (size_t i = 0; i < trusted && ckpt.state_term != 0; i++) {
+            if (wal->segs[i].first_index == ckpt.state_segment) {
+                state_note(wal, ckpt.state_term, ckpt.state_voted_for,
+                           ckpt.state_segment, (off_t)ckpt.state_offset);
+                break;
+            }
+        }
+    }
+
+    raft_status_t status = RAFT_OK;
+    size_t kept = 0;
+    for (size_t i = 0; i < wal->seg_count; i++) {
+        wal_segment_t seg = wal->segs[i];
+        int fd = segment_open(wal, seg.first_index);
+        if (fd < 0) {
+            status = RAFT_IO_ERROR;
+            break;
+        }
+
+        /* A segment whose header never made it to disk holds nothing */
+        segment_header_t header;
+        if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+            header.magic != RAFT_WAL_MAGIC ||
+            header.first_index != seg.first_index) {
+            close(fd);
+            segment_remove(wal, seg.first_index, false);
+            continue;
+        }
+        if (header.version != RAFT_WAL_VERSION &&
+            header.version != RAFT_WAL_VERSION_CRC32C &&
+            header.version != RAFT_WAL_VERSION_CRC32) {
+            close(fd);
+            status = RAFT_CORRUPTION;
+            break;
+        }
+        seg.version = header.version;
+
+        /* Checkpointed records are taken as they are; only what was
+         * written after the checkpoint is scanned */
+        bool last = (i == wal->seg_count - 1);
+        bool torn = false;
+        if (i < trusted) {
+            seg.count = rows[first_row + i].count;
+            seg.end = (off_t)rows[first_row + i].end;
+            if (last) torn = scan_segment(wal, fd, &seg);
+        } else {
+            seg.end = sizeof(segment_header_t);
+            seg.indexed = true;
+            torn = scan_segment(wal, fd, &seg);
+        }
+        if (last && torn) {
+            /* Cut the torn tail so appends land right after the last
+             * good record */
+            if (segment_zero_tail(wal, fd, seg.end) != RAFT_OK) {
+                close(fd);
+                free(seg.offsets);
+                status = RAFT_IO_ERROR;
+                break;
+            }
+        }
+        if (last) {
+            wal->fd = fd;
+        } else {
+            close(fd);
+        }
+        wal->segs[kept++] = seg;
+        wal->entry_count += seg.count;
+    }
+    wal->seg_count = kept;
+    free(rows);
+    return status;
+}
+
+raft_wal_t* raft_wal_open(const char* dir, size_t segment_size, bool sync) {
+    if (!dir) return NULL;
+
+    raft_wal_t* wal = calloc(1, sizeof(raft_wal_t));
+    if (!wal) return NULL;
+
+    wal->dir = strdup(dir);
+    if (!wal->dir) {
+        free(wal);
+        return NULL;
+    }
+    wal->segment_size = segment_size;
+    wal->sync = sync;
+    wal->fd = -1;
+    wal->verify_threads = RAFT_RECOVERY_THREADS;
+
+    collect_spares(wal);
+    if (load_segments(wal) != RAFT_OK) {
+        raft_wal_close(wal);
+        return NULL;
+    }
+    return wal;
+}
+
+void raft_wal_close(raft_wal_t* wal) {
+    if (!wal) return;
+    if (wal->ring) {
+        wal_drain(wal);
+    }
+    /* A clean close leaves a checkpoint covering everything */
+    if (wal->fd >= 0 && wal->io_status == RAFT_OK &&
+        (!wal->sync || fdatasync(wal->fd) == 0)) {
+        checkpoint_write(wal, wal->seg_count);
+    }
+    if (wal->ring) {
+        raft_uring_destroy(wal->ring);
+    }
+    if (wal->fd >= 0) {
+        close(wal->fd);
+    }
+    for (size_t i = 0; i < wal->seg_count; i++) {
+        free(wal->segs[i].offsets);
+    }
+    free(wal->segs);
+    free(wal->dir);
+    free(wal);
+}
+
+void raft_wal_set_verify_threads(raft_wal_t* wal, size_t threads) {
+    if (wal) wal->verify_threads = threads;
+}
+
+void raft_wal_set_segment_size(raft_wal_t* wal, size_t segment_size) {
+    /* Offsets within a segment must fit the 32-bit index even with an
+     * oversized record at the end */
+    if (wal && segment_size > sizeof(segment_header_t) &&
+        segment_size <= UINT32_MAX / 2) {
+        wal->segment_size = segment_size;
+    }
+}
+
+raft_status_t raft_wal_append(raft_wal_t* wal, const raft_entry_t* entries,
+                              size_t count) {
+    if (!wal || !entries) return RAFT_INVALID_ARG;
+    if (count == 0) return RAFT_OK;
+
+    log_record_t* recs = malloc(count * sizeof(log_record_t));
+    if (!recs) return RAFT_NO_MEMORY;
+    for (size_t i = 0; i < count; i++) {
+        record_init(&recs[i], &entries[i]);
+    }
+
+    /* Write headers and commands straight from the entries' memory, one
+     * pwritev per run of entries that fits in the active segment */
+    struct iovec iov[2 * WRITE_BATCH_ENTRIES];
+    raft_status_t status = RAFT_OK;
+    for (size_t done = 0; done < count && status == RAFT_OK; ) {
+        wal_segment_t* seg = wal->seg_count ? &wal->segs[wal->seg_count - 1] : NULL;
+        uint64_t index = entries[done].index;
+        bool follows = seg && wal->fd >= 0 && index == seg->first_index + seg->count &&
+                       seg->version == RAFT_WAL_VERSION;
+        bool fits = seg && (seg->count == 0 ||
+                            (size_t)seg->end + recs[done].record_len <= wal->segment_size);
+        if (!follows || !fits) {
+            /* An empty segment that doesn't fit what comes next is
+             * replaced rather than left behind, unless it holds hard
+             * state; then it stays until compacted */
+            if (seg && seg->count == 0 && seg->end == sizeof(segment_header_t)) {
+                status = segment_drop_last(wal);
+                if (status != RAFT_OK) break;
+            }
+            status = segment_create(wal, index);
+            if (status != RAFT_OK) break;
+            seg = &wal->segs[wal->seg_count - 1];
+        }
+        if (!seg->indexed) {
+            status = segment_index(wal, seg);
+            if (status != RAFT_OK) break;
+        }
+        if (!segment_reserve(seg, seg->count + count - done)) {
+            status = RAFT_NO_MEMORY;
+            break;
+        }
+
+        /* The first record always goes in, even one bigger than a
+         * whole segment */
+        int iovcnt = 0;
+        size_t bytes = 0;
+        size_t n = 0;
+        while (done + n < count && n < WRITE_BATCH_ENTRIES) {
+            const log_record_t* rec = &recs[done + n];
+            if (n > 0) {
+                if (rec->index != seg->first_index + seg->count + n) break;
+                if ((size_t)seg->end + bytes + rec->record_len > wal->segment_size) break;
+            }
+            iov[iovcnt].iov_base = (void*)rec;
+            iov[iovcnt].iov_len = sizeof(log_record_t);
+            iovcnt++;
+            if (rec->cmd_len > 0) {
+                iov[iovcnt].iov_base = entries[done + n].command;
+                iov[iovcnt].iov_len = rec->cmd_len;
+                iovcnt++;
+            }
+            bytes += rec->record_len;
+            n++;
+        }
+
+        if (wal->ring) {
+            status = wal_queue_write(wal, iov, iovcnt, bytes, seg->end);
+            if (status != RAFT_OK) break;
+        } else if (pwritev(wal->fd, iov, iovcnt, seg->end) != (ssize_t)bytes) {
+            status = RAFT_IO_ERROR;
+            break;
+        }
+        for (size_t i = 0; i < n; i++) {
+            seg->offsets[seg->count + i] = (uint32_t)seg->end;
+            seg->end += recs[done + i].record_len;
+        }
+        seg->count += n;
+        wal->entry_count += n;
+        done += n;
+    }
+
+    free(recs);
+    if (status == RAFT_OK && wal->ring) {
+        status = raft_uring_submit(wal->ring, 0);
+    }
+    return status;
+}
+
+raft_status_t raft_wal_append_state(raft_wal_t* wal, uint64_t current_term,
+                                    int32_t voted_for) {
+    if (!wal) return RAFT_INVALID_ARG;
+
+    raft_entry_t entry = {
+        .term = current_term,
+        .index = 0,
+        .command = (char*)&voted_for,
+        .command_len = sizeof(voted_for),
+    };
+    log_record_t rec;
+    record_init(&rec, &entry);
+
+    wal_segment_t* seg = wal->seg_count ? &wal->segs[wal->seg_count - 1] : NULL;
+    bool usable = seg && wal->fd >= 0 && seg->version == RAFT_WAL_VERSION &&
+                  (size_t)seg->end + rec.record_len <= wal->segment_size;
+    if (!usable && seg && seg->count == 0 && seg->end > (off_t)sizeof(segment_header_t)) {
+        return segment_rewrite_state(wal, &rec, voted_for);
+    }
+    if (!usable) {
+        uint64_t next = seg ? seg->first_index + seg->count : raft_wal_last_index(wal) + 1;
+        if (seg && seg->count == 0 && seg->end == sizeof(segment_header_t)) {
+            raft_status_t status = segment_drop_last(wal);
+            if (status != RAFT_OK) return status;
+        }
+        raft_status_t status = segment_create(wal, next);
+        if (status != RAFT_OK) return status;
+        seg = &wal->segs[wal->seg_count - 1];
+    }
+
+    struct iovec iov[2] = {
+        { .iov_base = &rec, .iov_len = sizeof(rec) },
+        { .iov_base = &voted_for, .iov_len = sizeof(voted_for) },
+    };
+    if (wal->ring) {
+        raft_status_t status = wal_queue_write(wal, iov, 2, rec.record_len, seg->end);
+        if (status == RAFT_OK) status = raft_uring_submit(wal->ring, 0);
+        if (status != RAFT_OK) return status;
+    } else if (pwritev(wal->fd, iov, 2, seg->end) != (ssize_t)rec.record_len) {
+        return RAFT_IO_ERROR;
+    }
+    state_note(wal, current_term, voted_for, seg->first_index, seg->end);
+    seg->end += rec.record_len;
+    return RAFT_OK;
+}
+
+bool raft_wal_hard_state(raft_wal_t* wal, uint64_t* current_term,
+                         int32_t* voted_for) {
+    if (!wal || !wal->has_state) return false;
+    if (current_term) *current_term = wal->state_term;
+    if (voted_for) *voted_for = wal->state_voted_for;
+    return true;
+}
+
+/* Segment whose first index is first_index, or NULL */
+static wal_segment_t* segment_named(raft_wal_t* wal, uint64_t first_index) {
+    for (size_t i = wal->seg_count; i > 0; i--) {
+        if (wal->segs[i - 1].first_index == first_index) return &wal->segs[i - 1];
+    }
+    return NULL;
+}
+
+bool raft_wal_state_cut_by(raft_wal_t* wal, uint64_t after_index) {
+    if (!wal || !wal->state_located) return false;
+    wal_segment_t* seg = segment_named(wal, wal->state_segment);
+    if (!seg) return false;
+    if (seg->first_index > after_index) return true;
+
+    /* Cut inside its segment: it goes if it lies past the cut record */
+    uint64_t keep = after_index - seg->first_index + 1;
+    if (keep >= seg->count) return false;
+    if (segment_index(wal, seg) != RAFT_OK) return true;
+    return wal->state_offset >= record_offset(seg, seg->first_index + keep);
+}
+
+bool raft_wal_state_dropped_by(raft_wal_t* wal, uint64_t upto_index) {
+    if (!wal || !wal->state_located) return false;
+    for (size_t i = 0; i < wal->seg_count; i++) {
+        const wal_segment_t* seg = &wal->segs[i];
+        bool droppable = seg->count == 0
+            ? i < wal->seg_count - 1
+            : seg->first_index + seg->count - 1 <= upto_index;
+        if (!droppable) return false;
+        if (seg->first_index == wal->state_segment) return true;
+    }
+    return false;
+}
+
+raft_status_t raft_wal_sync(raft_wal_t* wal) {
+    if (!wal) return RAFT_INVALID_ARG;
+    raft_status_t status = wal_drain(wal);
+    if (status != RAFT_OK) return status;
+    if (wal->fd >= 0 && fdatasync(wal->fd) < 0) return RAFT_IO_ERROR;
+    status = sync_dir(wal);
+    if (status != RAFT_OK) return status;
+    wal->synced_index = raft_wal_last_index(wal);
+    return RAFT_OK;
+}
+
+raft_status_t raft_wal_enable_uring(raft_wal_t* wal, unsigned depth) {
+    if (!wal) return RAFT_INVALID_ARG;
+    if (wal->ring) return RAFT_OK;
+    wal->ring = raft_uring_create(depth);
+    return wal->ring ? RAFT_OK : RAFT_IO_ERROR;
+}
+
+bool raft_wal_is_async(raft_wal_t* wal) {
+    return wal && wal->ring;
+}
+
+raft_status_t raft_wal_sync_submit(raft_wal_t* wal) {
+    if (!wal) return RAFT_INVALID_ARG;
+    if (!wal->ring) return raft_wal_sync(wal);
+    if (wal->fd < 0) return RAFT_OK;
+
+    /* Directory changes are rare (one per segment); sync them inline */
+    raft_status_t status = sync_dir(wal);
+    if (status != RAFT_OK) return status;
+
+    wal_op_t* op = malloc(sizeof(wal_op_t));
+    if (!op) return RAFT_NO_MEMORY;
+    *op = (wal_op_t){ .index = raft_wal_last_index(wal) };
+    status = wal_queue(wal, wal->fd, op, 0);
+    if (status != RAFT_OK) {
+        free(op);
+        return status;
+    }
+    return raft_uring_submit(wal->ring, 0);
+}
+
+raft_status_t raft_wal_poll(raft_wal_t* wal, uint64_t* synced_index) {
+    if (!wal) return RAFT_INVALID_ARG;
+    if (wal->ring && wal->inflight > 0) wal_reap(wal);
+    if (synced_index) *synced_index = wal->synced_index;
+    return wal->io_status;
+}
+
+raft_status_t raft_wal_truncate_after(raft_wal_t* wal, uint64_t after_index) {
+    if (!wal) return RAFT_INVALID_ARG;
+
+    /* A failed write is dealt with by cutting it off here */
+    wal_drain(wal);
+    wal->io_status = RAFT_OK;
+    if (raft_wal_state_cut_by(wal, after_index)) wal->state_located = false;
+    if (wal->synced_index > after_index) wal->synced_index = after_index;
+    if (wal->ckpt_index > after_index) {
+        raft_status_t status = checkpoint_remove(wal);
+        if (status != RAFT_OK) return status;
+    }
+
+    /* Whole segments past the cut point go */
+    while (wal->seg_count > 0 &&
+           wal->segs[wal->seg_count - 1].first_index > after_index) {
+        raft_status_t status = segment_drop_last(wal);
+        if (status != RAFT_OK) return status;
+    }
+    if (wal->seg_count == 0 || wal->fd < 0) return RAFT_OK;
+
+    /* The segment holding the cut point is truncated there; this also
+     * clears anything a failed append left past the last record */
+    wal_segment_t* seg = &wal->segs[wal->seg_count - 1];
+    uint64_t keep = after_index - seg->first_index + 1;
+    if (keep > seg->count) keep = seg->count;
+    raft_status_t status = segment_index(wal, seg);
+    if (status != RAFT_OK) return status;
+
+    off_t offset = record_offset(seg, seg->first_index + keep);
+    status = segment_zero_tail(wal, wal->fd, offset);
+    if (status != RAFT_OK) return status;
+
+    wal->entry_count -= seg->count - keep;
+    seg->count = keep;
+    seg->end = offset;
+    return RAFT_OK;
+}
+
+raft_status_t raft_wal_truncate_before(raft_wal_t* wal, uint64_t upto_index) {
+    if (!wal) return RAFT_INVALID_ARG;
+
+    /* Segments left holding only hard state go with the ones before them */
+    size_t drop = 0;
+    while (drop < wal->seg_count) {
+        const wal_segment_t* seg = &wal->segs[drop];
+        bool droppable = seg->count == 0
+            ? drop < wal->seg_count - 1
+            : seg->first_index + seg->count - 1 <= upto_index;
+        if (!droppable) break;
+        drop++;
+    }
+    if (drop == 0) return RAFT_OK;
+    if (raft_wal_state_dropped_by(wal, upto_index)) wal->state_located = false;
+
+    if (drop == wal->seg_count && wal->fd >= 0) {
+        wal_drain(wal);
+        close(wal->fd);
+        wal->fd = -1;
+    }
+    for (size_t i = 0; i < drop; i++) {
+        segment_remove(wal, wal->segs[i].first_index, true);
+        wal->entry_count -= wal->segs[i].count;
+        free(wal->segs[i].offsets);
+    }
+    memmove(wal->segs, wal->segs + drop,
+            (wal->seg_count - drop) * sizeof(wal_segment_t));
+    wal->seg_count -= drop;
+    return RAFT_OK;
+}
+
+/* Call fn for the records of one segment */
+static raft_status_t iterate_segment(raft_wal_t* wal, wal_segment_t* seg,
+                                     raft_log_iter_fn fn, void* ctx,
+                                     segment_reader_t* reader) {
+    raft_status_t indexed = segment_index(wal, seg);
+    if (indexed != RAFT_OK) return indexed;
+
+    reader->fd = segment_read_fd(wal, seg);
+    reader->len = 0;
+    if (reader->fd < 0) return RAFT_IO_ERROR;
+
+    raft_status_t status = RAFT_OK;
+    for (uint64_t i = 0; i < seg->count; i++) {
+        log_record_t rec;
+        const char* command;
+        if (!reader_record(reader, seg->offsets[i], seg->first_index + i,
+                           seg->version, &rec, &command)) {
+            status = RAFT_CORRUPTION;
+            break;
+        }
+        status = fn(ctx, rec.term, rec.index, rec.cmd_len > 0 ? command : NULL,
+                    rec.cmd_len);
+        if (status != RAFT_OK) break;
+    }
+
+    segment_read_done(wal, reader->fd);
+    return status;
+}
+
+raft_status_t raft_wal_iterate(raft_wal_t* wal, raft_log_iter_fn fn, void* ctx) {
+    if (!wal || !fn) return RAFT_INVALID_ARG;
+
+    segment_reader_t reader = { .fd = -1 };
+    raft_status_t status = RAFT_OK;
+    for (size_t i = 0; i < wal->seg_count && status == RAFT_OK; i++) {
+        status = iterate_segment(wal, &wal->segs[i], fn, ctx, &reader);
+    }
+    free(reader.buf);
+    return status;
+}
+
+static void unmap_segment(void* data, size_t len, void* ctx) {
+    (void)ctx;
+    munmap(data, len);
+}
+
+/* The first len bytes of seg in a buffer: a read-only mapping, or a
+ * heap copy if the file cannot be mapped */
+static raft_buf_t* segment_load(raft_wal_t* wal, const wal_segment_t* seg, size_t len) {
+    int fd = segment_read_fd(wal, seg);
+    if (fd < 0) return NULL;
+
+    raft_buf_t* buf = NULL;
+    void* map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    if (map != MAP_FAILED) {
+        madvise(map, len, MADV_SEQUENTIAL);
+        buf = raft_buf_wrap(map, len, unmap_segment, NULL);
+        if (!buf) munmap(map, len);
+    } else if ((buf = raft_buf_alloc(len)) != NULL) {
+        if (pread(fd, buf->data, len, 0) != (ssize_t)len) {
+            raft_buf_unref(buf);
+            buf = NULL;
+        }
+    }
+
+    segment_read_done(wal, fd);
+    return buf;
+}
+
+/* Fill in seg's offset index from the record headers in data
+ * Returns how many records were found before one that cannot be right;
+ * their CRCs are still unchecked */
+static uint64_t locate_records(wal_segment_t* seg, const char* data) {
+    size_t pos = sizeof(segment_header_t);
+    for (uint64_t r = 0; r < seg->count; r++) {
+        log_record_t rec;
+        pos += skip_state_records(data + pos, (size_t)seg->end - pos);
+        if ((size_t)seg->end - pos < sizeof(rec)) return r;
+        memcpy(&rec, data + pos, sizeof(rec));
+        if (rec.index != seg->first_index + r ||
+            rec.record_len != sizeof(rec) + (size_t)rec.cmd_len ||
+            rec.record_len > (size_t)seg->end - pos) {
+            return r;
+        }
+        seg->offsets[r] = (uint32_t)pos;
+        pos += rec.record_len;
+    }
+    return seg->count;
+}
+
+/* Check the CRCs of one task's records and decode their headers */
+static void verify_task(void* arg, size_t task) {
+    verify_ctx_t* v = (verify_ctx_t*)arg;
+    uint64_t lo = (uint64_t)task * RAFT_RECOVERY_TASK_RECORDS;
+    uint64_t hi = lo + RAFT_RECOVERY_TASK_RECORDS;
+    if (hi > v->count) hi = v->count;
+
+    v->first_bad[task] = v->count;
+    for (uint64_t r = lo; r < hi; r++) {
+        size_t pos = v->seg->offsets[r];
+        log_record_t rec;
+        if (!record_parse(v->data + pos, (size_t)v->seg->end - pos,
+                          v->seg->first_index + r, v->seg->version, &rec)) {
+            v->first_bad[task] = r;
+            return;
+        }
+        v->decoded[r] = (decoded_record_t){ .term = rec.term, .cmd_len = rec.cmd_len };
+    }
+}
+
+raft_status_t raft_wal_iterate_mapped(raft_wal_t* wal, raft_log_iter_shared_fn fn,
+                                      void* ctx) {
+    if (!wal || !fn) return RAFT_INVALID_ARG;
+
+    raft_pool_t* pool = NULL;
+    decoded_record_t* decoded = NULL;
+    uint64_t* first_bad = NULL;
+    uint64_t capacity = 0;
+
+    raft_status_t status = RAFT_OK;
+    for (size_t i = 0; i < wal->seg_count && status == RAFT_OK; i++) {
+        wal_segment_t* seg = &wal->segs[i];
+        if (seg->count == 0) continue;
+
+        if (seg->count > capacity) {
+            free(decoded);
+            free(first_bad);
+            capacity = seg->count;
+            decoded = malloc(capacity * sizeof(decoded_record_t));
+            first_bad = malloc((capacity / RAFT_RECOVERY_TASK_RECORDS + 1) * sizeof(uint64_t));
+            if (!decoded || !first_bad) {
+                status = RAFT_NO_MEMORY;
+                break;
+            }
+        }
+        if (!seg->indexed && !segment_reserve(seg, seg->count)) {
+            status = RAFT_NO_MEMORY;
+            break;
+        }
+
+        raft_buf_t* owner = segment_load(wal, seg, (size_t)seg->end);
+        if (!owner) {
+            status = RAFT_IO_ERROR;
+            break;
+        }
+
+        /* Boundaries first, then the CRCs in parallel */
+        verify_ctx_t v = {
+            .data = owner->data,
+            .seg = seg,
+            .count = seg->indexed ? seg->count : locate_records(seg, owner->data),
+            .decoded = decoded,
+            .first_bad = first_bad,
+        };
+        size_t tasks = (size_t)((v.count + RAFT_RECOVERY_TASK_RECORDS - 1) /
+                                RAFT_RECOVERY_TASK_RECORDS);
+        if (tasks > 1 && !pool) pool = raft_pool_create(wal->verify_threads);
+        raft_pool_run(pool, verify_task, &v, tasks);
+
+        uint64_t good = v.count;
+        for (size_t t = 0; t < tasks; t++) {
+            if (first_bad[t] < good) good = first_bad[t];
+        }
+
+        /* Records go to fn in order, stopping at the first bad one */
+        for (uint64_t r = 0; r < good && status == RAFT_OK; r++) {
+            uint64_t index = seg->first_index + r;
+            if (index == wal->ckpt_index && wal->ckpt_term != 0 &&
+                decoded[r].term != wal->ckpt_term) {
+                status = RAFT_CORRUPTION;
+                break;
+            }
+            const char* command = decoded[r].cmd_len > 0
+                ? owner->data + seg->offsets[r] + sizeof(log_record_t) : NULL;
+            status = fn(ctx, decoded[r].term, index, owner, command, decoded[r].cmd_len);
+        }
+        if (status == RAFT_OK && good < seg->count) status = RAFT_CORRUPTION;
+        if (status == RAFT_OK) seg->indexed = true;
+
+        /* Entries kept by fn hold their own references; from here on
+         * they are read at random */
+        if (owner->free_fn == unmap_segment) {
+            madvise(owner->data, owner->len, MADV_NORMAL);
+        }
+        raft_buf_unref(owner);
+    }
+
+    raft_pool_destroy(pool);
+    free(decoded);
+    free(first_bad);
+    return status;
+}
+
+/* Segment holding index, or NULL */
+static wal_segment_t* find_segment(raft_wal_t* wal, uint64_t index) {
+    size_t lo = 0;
+    size_t hi = wal->seg_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (wal->segs[mid].first_index <= index) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) return NULL;
+    wal_segment_t* seg = &wal->segs[lo - 1];
+    return index < seg->first_index + seg->count ? seg : NULL;
+}
+
+raft_status_t raft_wal_read_entry(raft_wal_t* wal, uint64_t index,
+                                  raft_entry_t* out) {
+    if (!wal || !out) return RAFT_INVALID_ARG;
+
+    memset(out, 0, sizeof(*out));
+    wal_segment_t* seg = find_segment(wal, index);
+    if (!seg) return RAFT_NOT_FOUND;
+    raft_status_t status = segment_index(wal, seg);
+    if (status != RAFT_OK) return status;
+
+    off_t pos = record_offset(seg, index);
+    size_t len = (size_t)(record_offset(seg, index + 1) - pos);
+    char* buf = malloc(len);
+    if (!buf) return RAFT_NO_MEMORY;
+
+    int fd = segment_read_fd(wal, seg);
+    if (fd < 0) {
+        free(buf);
+        return RAFT_IO_ERROR;
+    }
+    ssize_t n = pread(fd, buf, len, pos);
+    segment_read_done(wal, fd);
+
+    log_record_t rec;
+    if (n != (ssize_t)len || !record_parse(buf, len, index, seg->version, &rec)) {
+        free(buf);
+        return n < 0 ? RAFT_IO_ERROR : RAFT_CORRUPTION;
+    }
+
+    /* Hand back the command alone at the start of the buffer */
+    out->term = rec.term;
+    out->index = rec.index;
+    out->type = RAFT_ENTRY_COMMAND;
+    out->command_len = rec.cmd_len;
+    if (rec.cmd_len > 0) {
+        memmove(buf, buf + sizeof(rec), rec.cmd_len);
+        out->command = buf;
+    } else {
+        free(buf);
+    }
+    return RAFT_OK;
+}
+
+raft_status_t raft_wal_read_range(raft_wal_t* wal, uint64_t lo, uint64_t hi,
+                                  raft_entry_t* out, void** data) {
+    if (!wal || !out || !data || lo == 0 || hi < lo) return RAFT_INVALID_ARG;
+    *data = NULL;
+
+    wal_segment_t* first = find_segment(wal, lo);
+    wal_segment_t* last = find_segment(wal, hi);
+    if (!first || !last) return RAFT_NOT_FOUND;
+
+    /* Segments in between must cover the range without gaps */
+    size_t total = 0;
+    for (wal_segment_t* seg = first; seg <= last; seg++) {
+        if (seg > first && seg->first_index != (seg - 1)->first_index + (seg - 1)->count) {
+            return RAFT_NOT_FOUND;
+        }
+        raft_status_t status = segment_index(wal, seg);
+        if (status != RAFT_OK) return status;
+        uint64_t from = seg == first ? lo : seg->first_index;
+        uint64_t to = seg == last ? hi : seg->first_index + seg->count - 1;
+        total += (size_t)(record_offset(seg, to + 1) - record_offset(seg, from));
+    }
+
+    char* buf = malloc(total);
+    if (!buf) return RAFT_NO_MEMORY;
+
+    /* One pread per segment; records are parsed in place and the
+     * entries point into the buffer */
+    char* p = buf;
+    raft_entry_t* entry = out;
+    for (const wal_segment_t* seg = first; seg <= last; seg++) {
+        uint64_t from = seg == first ? lo : seg->first_index;
+        uint64_t to = seg == last ? hi : seg->first_index + seg->count - 1;
+        off_t pos = record_offset(seg, from);
+        size_t len = (size_t)(record_offset(seg, to + 1) - pos);
+
+        int fd = segment_read_fd(wal, seg);
+        ssize_t n = fd >= 0 ? pread(fd, p, len, pos) : -1;
+        segment_read_done(wal, fd);
+        if (n != (ssize_t)len) {
+            free(buf);
+            return RAFT_IO_ERROR;
+        }
+
+        /* Hard-state records may sit between entries; each entry is
+         * found at its indexed offset */
+        for (uint64_t index = from; index <= to; index++, entry++) {
+            log_record_t rec;
+            char* r = p + (record_offset(seg, index) - pos);
+            size_t avail = (size_t)(record_offset(seg, index + 1) - record_offset(seg, index));
+            if (!record_parse(r, avail, index, seg->version, &rec)) {
+                free(buf);
+                return RAFT_CORRUPTION;
+            }
+            entry->term = rec.term;
+            entry->index = rec.index;
+            entry->type = RAFT_ENTRY_COMMAND;
+            entry->command = rec.cmd_len > 0 ? r + sizeof(rec) : NULL;
+            entry->command_len = rec.cmd_len;
+        }
+        p += len;
+    }
+
+    *data = buf;
+    return RAFT_OK;
+}
+
+uint64_t raft_wal_first_index(raft_wal_t* wal) {
+    if (!wal) return 0;
+    for (size_t i = 0; i < wal->seg_count; i++) {
+        if (wal->segs[i].count > 0) return wal->segs[i].first_index;
+    }
+    return 0;
+}
+
+uint64_t raft_wal_last_index(raft_wal_t* wal) {
+    if (!wal) return 0;
+    for (size_t i = wal->seg_count; i > 0; i--) {
+        const wal_segment_t* seg = &wal->segs[i - 1];
+        if (seg->count > 0) return seg->first_index + seg->count - 1;
+    }
+    return 0;
+}
+
+uint64_t raft_wal_entry_count(raft_wal_t* wal) {
+    return wal ? wal->entry_count : 0;
+}
+
+size_t raft_wal_segment_count(raft_wal_t* wal) {
+    return wal ? wal->seg_count : 0;
+}
+
+uint64_t raft_wal_log_bytes(raft_wal_t* wal) {
+    if (!wal) return 0;
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < wal->seg_count; i++) bytes += (uint64_t)wal->segs[i].end;
+    return bytes;
+}
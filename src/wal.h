@@ -0,0 +1,223 @@
+/**
+ * wal.h - Segmented write-ahead log for Raft log entries
+ *
+ * The WAL is a series of fixed-size, preallocated segment files in the
+ * data directory, each named after the index of its first record. Only
+ * the last segment is appended to. Dropping a compacted prefix removes
+ * (or recycles) whole segments; truncating a conflicting suffix only
+ * touches the segments past the cut point.
+ *
+ * The WAL does the file work only; when to sync is up to storage.c.
+ */
+
+#ifndef RAFT_WAL_H
+#define RAFT_WAL_H
+
+#include "types.h"
+#include "buf.h"
+
+#define RAFT_WAL_MAGIC      0x5257414C  /* "RWAL" */
+#define RAFT_WAL_VERSION    4           /* Hard-state records among entries */
+#define RAFT_WAL_VERSION_CRC32C 3       /* Entries only, read only */
+#define RAFT_WAL_VERSION_CRC32 2        /* Entries checked with CRC32, read only */
+
+#define RAFT_WAL_CKPT_MAGIC   0x5257434B  /* "RWCK" */
+#define RAFT_WAL_CKPT_VERSION 3
+
+typedef struct raft_wal raft_wal_t;
+
+/**
+ * Callback type for iterating over log entries during recovery
+ */
+typedef raft_status_t (*raft_log_iter_fn)(void* ctx,
+                                           uint64_t term,
+                                           uint64_t index,
+                                           const char* command,
+                                           size_t command_len);
+
+/**
+ * Callback type for iterating with payloads left where they are
+ * command points into owner; the callee keeps it valid past the call
+ * by taking a reference with raft_buf_ref.
+ */
+typedef raft_status_t (*raft_log_iter_shared_fn)(void* ctx,
+                                                  uint64_t term,
+                                                  uint64_t index,
+                                                  raft_buf_t* owner,
+                                                  const char* command,
+                                                  size_t command_len);
+
+/**
+ * Open the WAL segments in dir, creating none until the first append
+ * Scans existing segments and zeroes any torn record at the tail.
+ * @param segment_size Preallocated size of each new segment
+ * @param sync If true, segments are synced when rolled and created
+ * @return WAL handle or NULL on failure
+ */
+raft_wal_t* raft_wal_open(const char* dir, size_t segment_size, bool sync);
+
+/**
+ * Close all segment files and release the handle
+ */
+void raft_wal_close(raft_wal_t* wal);
+
+/**
+ * Set how many threads raft_wal_iterate_mapped checks CRCs on
+ * 0 means one per online CPU (RAFT_RECOVERY_THREADS by default).
+ */
+void raft_wal_set_verify_threads(raft_wal_t* wal, size_t threads);
+
+/**
+ * Set the size of segments created from now on
+ */
+void raft_wal_set_segment_size(raft_wal_t* wal, size_t segment_size);
+
+/**
+ * Write entries at the end of the log without syncing
+ * Starts a new segment when the current one is full or the entries do
+ * not follow on from it. On failure part of the batch may have been
+ * written; the caller cuts it off with raft_wal_truncate_after.
+ */
+raft_status_t raft_wal_append(raft_wal_t* wal, const raft_entry_t* entries,
+                              size_t count);
+
+/**
+ * Write a hard-state record (current_term, voted_for) without syncing
+ * It goes in the active segment after the entries written so far and
+ * becomes durable with them on the next raft_wal_sync. A segment is
+ * started at the next index if there is none to write it to.
+ */
+raft_status_t raft_wal_append_state(raft_wal_t* wal, uint64_t current_term,
+                                    int32_t voted_for);
+
+/**
+ * Get the newest hard state written to the WAL
+ * Newest means highest term, then a vote over none. Also reports state
+ * whose record has since been cut or compacted away.
+ * @return false if no hard-state record was ever found or written
+ */
+bool raft_wal_hard_state(raft_wal_t* wal, uint64_t* current_term,
+                         int32_t* voted_for);
+
+/**
+ * Check whether raft_wal_truncate_after(after_index) would remove the
+ * record holding the newest hard state
+ */
+bool raft_wal_state_cut_by(raft_wal_t* wal, uint64_t after_index);
+
+/**
+ * Check whether raft_wal_truncate_before(upto_index) would remove the
+ * record holding the newest hard state
+ */
+bool raft_wal_state_dropped_by(raft_wal_t* wal, uint64_t upto_index);
+
+/**
+ * Make everything written so far durable (fdatasync + directory sync)
+ * Waits for any queued asynchronous I/O first.
+ */
+raft_status_t raft_wal_sync(raft_wal_t* wal);
+
+/**
+ * Attach an io_uring ring of the given depth for appends and syncs
+ * From then on raft_wal_append and raft_wal_sync_submit only queue
+ * their I/O; raft_wal_poll reports what has completed.
+ * Returns RAFT_IO_ERROR if io_uring is unavailable.
+ */
+raft_status_t raft_wal_enable_uring(raft_wal_t* wal, unsigned depth);
+
+/**
+ * Check whether appends and syncs go through io_uring
+ */
+bool raft_wal_is_async(raft_wal_t* wal);
+
+/**
+ * Start making everything written so far durable
+ * With io_uring the sync is queued behind the pending writes and its
+ * completion shows up in raft_wal_poll; otherwise it is raft_wal_sync.
+ */
+raft_status_t raft_wal_sync_submit(raft_wal_t* wal);
+
+/**
+ * Reap completed asynchronous I/O without blocking
+ * @param synced_index Set to the last index known durable
+ * @return RAFT_IO_ERROR once any queued write or sync has failed
+ */
+raft_status_t raft_wal_poll(raft_wal_t* wal, uint64_t* synced_index);
+
+/**
+ * Remove all records with index > after_index
+ * Later segments are deleted; the segment holding the cut point is
+ * truncated at the cut's indexed offset and re-preallocated. Hard-state
+ * records past the cut go with the entries.
+ */
+raft_status_t raft_wal_truncate_after(raft_wal_t* wal, uint64_t after_index);
+
+/**
+ * Drop every segment whose records all have index <= upto_index
+ * Segments holding only hard-state records go too, unless active.
+ * Dropped segments are kept as spares for reuse, up to
+ * RAFT_WAL_SPARE_SEGMENTS, and deleted beyond that.
+ */
+raft_status_t raft_wal_truncate_before(raft_wal_t* wal, uint64_t upto_index);
+
+/**
+ * Call fn for every record in index order, verifying CRCs
+ */
+raft_status_t raft_wal_iterate(raft_wal_t* wal, raft_log_iter_fn fn, void* ctx);
+
+/**
+ * Call fn for every record in index order without copying payloads
+ * Each segment is mapped read-only (MADV_SEQUENTIAL while it is walked)
+ * and records are checked in place, their CRCs in parallel on the
+ * verification threads; fn is only ever called on the calling thread.
+ * The mapping is unmapped once the last reference to its owner buffer
+ * is dropped. Falls back to reading the segment into memory if it
+ * cannot be mapped.
+ */
+raft_status_t raft_wal_iterate_mapped(raft_wal_t* wal, raft_log_iter_shared_fn fn,
+                                      void* ctx);
+
+/**
+ * Read one record with a single pread at its indexed offset
+ * out->command is malloc'd and the caller must free it. Returns
+ * RAFT_NOT_FOUND if no segment holds index.
+ */
+raft_status_t raft_wal_read_entry(raft_wal_t* wal, uint64_t index,
+                                  raft_entry_t* out);
+
+/**
+ * Read records lo..hi with one pread per segment they span
+ * out must hold hi - lo + 1 entries. Their commands point into *data,
+ * a single malloc'd block the caller frees. Returns RAFT_NOT_FOUND
+ * unless every index in the range is present.
+ */
+raft_status_t raft_wal_read_range(raft_wal_t* wal, uint64_t lo, uint64_t hi,
+                                  raft_entry_t* out, void** data);
+
+/**
+ * Index of the first record (0 if empty)
+ */
+uint64_t raft_wal_first_index(raft_wal_t* wal);
+
+/**
+ * Index of the last record (0 if empty)
+ */
+uint64_t raft_wal_last_index(raft_wal_t* wal);
+
+/**
+ * Number of records across all segments
+ */
+uint64_t raft_wal_entry_count(raft_wal_t* wal);
+
+/**
+ * Number of segment files currently holding the log
+ */
+size_t raft_wal_segment_count(raft_wal_t* wal);
+
+/**
+ * Bytes written to the segments holding the log, headers included
+ * (not the preallocated space past them)
+ */
+uint64_t raft_wal_log_bytes(raft_wal_t* wal);
+
+#endif /* RAFT_WAL_H */
@@ -0,0 +1,194 @@
+/**
+ * bench_compress.c - Snapshot compression ratio and throughput
+ *
+ * Runs the LZ codec over key/value text (the kind of state that
+ * compresses well) and over random bytes (which does not), one
+ * RAFT_SNAPSHOT_BLOCK_SIZE block at a time: on one thread, then with the
+ * blocks spread over a pool of one thread per CPU, as the snapshot
+ * writer does. Last, whole snapshots of the text written and read back
+ * through a writer and reader, uncompressed and compressed; GB/s is of
+ * the state as pushed, before compression.
+ *
+ * Usage: bench_compress [data_dir] [state_mb]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "bench_common.h"
+#include "../../src/lz.h"
+#include "../../src/pool.h"
+#include "../../src/param.h"
+#include "../../src/snapshot.h"
+
+#define DEFAULT_STATE_MB  256
+#define CHUNK_SIZE        (64 * 1024)
+
+static void remove_dir(const char* dir) {
+    char cmd[600];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    system(cmd);
+}
+
+static char* make_text(size_t len) {
+    char* state = malloc(len + 64);
+    size_t at = 0;
+    for (uint64_t k = 0; at < len; k++) {
+        at += (size_t)sprintf(state + at, "user:%08llu={\"name\":\"n%llu\",\"tier\":%llu};",
+                              (unsigned long long)(k * 7919 % 10000019),
+                              (unsigned long long)(k % 1000), (unsigned long long)(k % 4));
+    }
+    return state;
+}
+
+static char* make_noise(size_t len) {
+    char* state = malloc(len);
+    uint64_t x = 88172645463325252ull;
+    for (size_t i = 0; i < len; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        state[i] = (char)x;
+    }
+    return state;
+}
+
+/* The state split into blocks, each compressed into its own slot */
+typedef struct {
+    const char* src;
+    size_t len;
+    char* dst;
+    size_t slot;
+    size_t* packed;
+    char* out;                  /* Decompressed again */
+} codec_ctx_t;
+
+static size_t block_len(const codec_ctx_t* c, size_t block) {
+    size_t left = c->len - block * RAFT_SNAPSHOT_BLOCK_SIZE;
+    return left < RAFT_SNAPSHOT_BLOCK_SIZE ? left : RAFT_SNAPSHOT_BLOCK_SIZE;
+}
+
+static void compress_task(void* ctx, size_t block) {
+    codec_ctx_t* c = ctx;
+    c->packed[block] = raft_lz_compress(c->src + block * RAFT_SNAPSHOT_BLOCK_SIZE,
+                                        block_len(c, block), c->dst + block * c->slot, c->slot);
+}
+
+static void decompress_task(void* ctx, size_t block) {
+    codec_ctx_t* c = ctx;
+    size_t n;
+    raft_lz_decompress(c->dst + block * c->slot, c->packed[block],
+                       c->out + block * RAFT_SNAPSHOT_BLOCK_SIZE, block_len(c, block), &n);
+}
+
+static void bench_codec(const char* name, const char* state, size_t len, raft_pool_t* pool) {
+    size_t blocks = (len + RAFT_SNAPSHOT_BLOCK_SIZE - 1) / RAFT_SNAPSHOT_BLOCK_SIZE;
+    codec_ctx_t c = {
+        .src = state,
+        .len = len,
+        .slot = raft_lz_bound(RAFT_SNAPSHOT_BLOCK_SIZE),
+        .packed = calloc(blocks, sizeof(size_t)),
+        .out = malloc(len),
+    };
+    c.dst = malloc(blocks * c.slot);
+    memset(c.dst, 1, blocks * c.slot);     /* Fault the pages in outside the timing */
+    memset(c.out, 1, len);
+
+    uint64_t start = bench_now_ns();
+    raft_pool_run(pool, compress_task, &c, blocks);
+    uint64_t compress_ns = bench_now_ns() - start;
+
+    start = bench_now_ns();
+    raft_pool_run(pool, decompress_task, &c, blocks);
+    uint64_t decompress_ns = bench_now_ns() - start;
+
+    size_t packed = 0;
+    for (size_t i = 0; i < blocks; i++) packed += c.packed[i];
+    printf("  %-28s %8zu %8.2f %12.2f %12.2f%s\n", name, raft_pool_threads(pool),
+           (double)len / packed, (double)len / compress_ns, (double)len / decompress_ns,
+           memcmp(c.out, state, len) == 0 ? "" : "  (MISMATCH)");
+
+    free(c.dst);
+    free(c.out);
+    free(c.packed);
+}
+
+static void bench_snapshot(const char* dir, const char* name, uint32_t codec,
+                           const char* state, size_t len) {
+    raft_set_snapshot_compression(NULL, codec);
+
+    uint64_t start = bench_now_ns();
+    raft_snapshot_writer_t* writer;
+    raft_snapshot_writer_open(dir, 1, 1, &writer);
+    for (size_t done = 0; done < len; done += CHUNK_SIZE) {
+        raft_snapshot_writer_write(writer, state + done,
+                                   len - done < CHUNK_SIZE ? len - done : CHUNK_SIZE);
+    }
+    raft_snapshot_writer_commit(writer);
+    uint64_t write_ns = bench_now_ns() - start;
+
+    char path[600];
+    struct stat st;
+    snprintf(path, sizeof(path), "%s/%s", dir, RAFT_SNAPSHOT_FILE);
+    stat(path, &st);
+
+    char* chunk = malloc(CHUNK_SIZE);
+    start = bench_now_ns();
+    raft_snapshot_meta_t meta;
+    raft_snapshot_reader_t* reader;
+    raft_snapshot_reader_open(dir, &meta, &reader);
+    raft_status_t status;
+    size_t n;
+    do {
+        status = raft_snapshot_reader_read(reader, chunk, CHUNK_SIZE, &n);
+    } while (status == RAFT_OK && n > 0);
+    raft_snapshot_reader_close(reader);
+    uint64_t read_ns = bench_now_ns() - start;
+    free(chunk);
+
+    printf("  %-28s %10.1f %8.2f %12.2f %12.2f%s\n", name, st.st_size / (1024.0 * 1024.0),
+           (double)len / st.st_size, (double)len / write_ns, (double)len / read_ns,
+           status == RAFT_OK ? "" : "  (READ FAILED)");
+    raft_set_snapshot_compression(NULL, RAFT_SNAPSHOT_CODEC_NONE);
+}
+
+int main(int argc, char** argv) {
+    const char* root = argc > 1 ? argv[1] : "/tmp";
+    size_t state_len = (argc > 2 ? strtoull(argv[2], NULL, 10) : DEFAULT_STATE_MB) << 20;
+
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s/raft_bench_compress_%d", root, getpid());
+    mkdir(dir, 0755);
+
+    char* text = make_text(state_len);
+    char* noise = make_noise(state_len);
+    raft_pool_t* single = raft_pool_create(1);
+    raft_pool_t* pool = raft_pool_create(0);
+
+    printf("Raft Snapshot Compression Benchmark\n");
+    printf("===================================\n");
+    printf("  %zu MB state, %d KB blocks, under %s\n\n", state_len >> 20,
+           RAFT_SNAPSHOT_BLOCK_SIZE / 1024, root);
+    printf("  %-28s %8s %8s %12s %12s\n", "Codec", "Threads", "Ratio", "Comp GB/s",
+           "Decomp GB/s");
+    bench_codec("LZ, key/value text", text, state_len, single);
+    bench_codec("LZ, random bytes", noise, state_len, single);
+    if (raft_pool_threads(pool) > 1) {
+        bench_codec("LZ, key/value text", text, state_len, pool);
+        bench_codec("LZ, random bytes", noise, state_len, pool);
+    }
+
+    printf("\n  %-28s %10s %8s %12s %12s\n", "Snapshot (key/value text)", "File(MB)", "Ratio",
+           "Write GB/s", "Read GB/s");
+    bench_snapshot(dir, "Uncompressed", RAFT_SNAPSHOT_CODEC_NONE, text, state_len);
+    bench_snapshot(dir, "LZ", RAFT_SNAPSHOT_CODEC_LZ, text, state_len);
+
+    raft_pool_destroy(pool);
+    raft_pool_destroy(single);
+    free(noise);
+    free(text);
+    remove_dir(dir);
+    return 0;
+}
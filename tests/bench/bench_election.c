@@ -0,0 +1,237 @@
+/**
+ * bench_election.c - Election latency with term/vote persistence enabled
+ *
+ * Times the durable term/vote write on its own, next to the temp file +
+ * fsync + rename it replaced, a new term plus an entry with one sync
+ * against two, and the paths that wait on it: starting an election,
+ * granting a vote in a newer term, and a follower taking a newer term
+ * from an AppendEntries carrying an entry.
+ *
+ * Usage: bench_election [data_dir]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "bench_common.h"
+#include "../../src/raft.h"
+#include "../../src/election.h"
+#include "../../src/storage.h"
+#include "../../src/log.h"
+#include "../../src/replication.h"
+
+#define WARMUP_OPS 20
+#define BENCH_OPS  500
+
+static void remove_dir(const char* dir) {
+    char cmd[600];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    system(cmd);
+}
+
+/* The previous scheme: write raft_state.dat.tmp, fsync, rename over */
+static void save_by_rename(const char* dir, uint64_t term, int32_t voted_for) {
+    char path[600], tmp[600];
+    snprintf(path, sizeof(path), "%s/raft_state.dat", dir);
+    snprintf(tmp, sizeof(tmp), "%s/raft_state.dat.tmp", dir);
+    struct {
+        uint32_t magic, version, crc;
+        uint64_t term;
+        int32_t voted_for;
+        uint32_t pad;
+    } __attribute__((packed)) state = { RAFT_STATE_MAGIC, RAFT_STATE_VERSION_V1, 0,
+                                        term, voted_for, 0 };
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (write(fd, &state, sizeof(state)) != (ssize_t)sizeof(state)) abort();
+    fsync(fd);
+    close(fd);
+    rename(tmp, path);
+}
+
+static void bench_save_rename(const char* dir) {
+    for (int i = 0; i < WARMUP_OPS; i++) save_by_rename(dir, i, 0);
+
+    bench_result_t result;
+    bench_init(&result, BENCH_OPS);
+    for (int i = 0; i < BENCH_OPS; i++) {
+        uint64_t start = bench_now_ns();
+        save_by_rename(dir, WARMUP_OPS + i, 0);
+        bench_record(&result, bench_now_ns() - start);
+    }
+    bench_print(&result, "State Save (temp file + rename)");
+    bench_free(&result);
+}
+
+static void bench_save_state(const char* dir) {
+    raft_storage_t* storage = raft_storage_open(dir, true);
+    for (int i = 0; i < WARMUP_OPS; i++) raft_storage_save_state(storage, i, 0);
+
+    bench_result_t result;
+    bench_init(&result, BENCH_OPS);
+    for (int i = 0; i < BENCH_OPS; i++) {
+        uint64_t start = bench_now_ns();
+        raft_storage_save_state(storage, WARMUP_OPS + i, 0);
+        bench_record(&result, bench_now_ns() - start);
+    }
+    bench_print(&result, "State Save (WAL record)");
+    bench_free(&result);
+    raft_storage_close(storage);
+}
+
+/* A follower's view of an AppendEntries in a new term: the term and
+ * the entry made durable by separate syncs, or staged and synced once */
+static void bench_term_and_entry(const char* dir, bool staged) {
+    raft_storage_t* storage = raft_storage_open(dir, true);
+    char command[64];
+    memset(command, 'e', sizeof(command));
+
+    bench_result_t result;
+    bench_init(&result, BENCH_OPS);
+    for (int i = 0; i < WARMUP_OPS + BENCH_OPS; i++) {
+        uint64_t term = (uint64_t)i + 1;
+        raft_entry_t entry = { .term = term, .index = (uint64_t)i + 1,
+                               .command = command, .command_len = sizeof(command) };
+        uint64_t start = bench_now_ns();
+        if (staged) {
+            raft_storage_stage_state(storage, term, -1);
+        } else {
+            raft_storage_save_state(storage, term, -1);
+        }
+        raft_storage_append_entries(storage, &entry, 1);
+        raft_storage_sync_state(storage);
+        if (i >= WARMUP_OPS) bench_record(&result, bench_now_ns() - start);
+    }
+    bench_print(&result, staged ? "New Term + Entry (one sync)" : "New Term + Entry (two syncs)");
+    bench_free(&result);
+    raft_storage_close(storage);
+}
+
+/* Each call bumps the term and persists the self-vote */
+static void bench_election_start(const char* dir) {
+    raft_config_t config = { .node_id = 0, .num_nodes = 3, .data_dir = dir };
+    raft_node_t* node = raft_create(&config);
+    raft_start(node);
+    for (int i = 0; i < WARMUP_OPS; i++) raft_start_election(node);
+
+    bench_result_t result;
+    bench_init(&result, BENCH_OPS);
+    for (int i = 0; i < BENCH_OPS; i++) {
+        uint64_t start = bench_now_ns();
+        raft_start_election(node);
+        bench_record(&result, bench_now_ns() - start);
+    }
+    bench_print(&result, "Election Start (persisted)");
+    bench_free(&result);
+    raft_destroy(node);
+}
+
+/* A request from a newer term: step down, then grant the vote */
+static void bench_vote_grant(const char* dir) {
+    raft_config_t config = { .node_id = 0, .num_nodes = 3, .data_dir = dir };
+    raft_node_t* node = raft_create(&config);
+    raft_start(node);
+
+    raft_request_vote_t request = {
+        .type = RAFT_MSG_REQUEST_VOTE,
+        .candidate_id = 1,
+        .last_log_index = 0,
+        .last_log_term = 0,
+    };
+    raft_request_vote_response_t response;
+    for (int i = 0; i < WARMUP_OPS; i++) {
+        request.term = node->persistent.current_term + 1;
+        raft_handle_request_vote(node, &request, &response);
+    }
+
+    bench_result_t result;
+    bench_init(&result, BENCH_OPS);
+    for (int i = 0; i < BENCH_OPS; i++) {
+        request.term = node->persistent.current_term + 1;
+        uint64_t start = bench_now_ns();
+        raft_handle_request_vote(node, &request, &response);
+        bench_record(&result, bench_now_ns() - start);
+    }
+    bench_print(&result, "Vote Grant, New Term (persisted)");
+    bench_free(&result);
+    raft_destroy(node);
+}
+
+/* Every request carries one entry and a term the follower has not seen */
+static void bench_append_new_term(const char* dir) {
+    raft_config_t config = { .node_id = 0, .num_nodes = 3, .data_dir = dir };
+    raft_node_t* node = raft_create(&config);
+    raft_start(node);
+
+    struct {
+        raft_append_entries_t header;
+        uint64_t term;
+        uint32_t command_len;
+        char command[64];
+    } __attribute__((packed)) msg;
+    memset(&msg, 0, sizeof(msg));
+    memset(msg.command, 'a', sizeof(msg.command));
+    msg.header.type = RAFT_MSG_APPEND_ENTRIES;
+    msg.header.leader_id = 1;
+    msg.header.entries_count = 1;
+    msg.command_len = sizeof(msg.command);
+
+    bench_result_t result;
+    bench_init(&result, BENCH_OPS);
+    raft_append_entries_response_t response;
+    for (int i = 0; i < WARMUP_OPS + BENCH_OPS; i++) {
+        msg.header.term = node->persistent.current_term + 1;
+        msg.header.prev_log_index = raft_log_last_index(node->log);
+        msg.header.prev_log_term = raft_log_last_term(node->log);
+        msg.term = msg.header.term;
+        uint64_t start = bench_now_ns();
+        raft_handle_append_entries_with_log(node, &msg, sizeof(msg), &response);
+        if (i >= WARMUP_OPS) bench_record(&result, bench_now_ns() - start);
+    }
+    bench_print(&result, "AppendEntries, New Term (persisted)");
+    bench_free(&result);
+    raft_destroy(node);
+}
+
+int main(int argc, char** argv) {
+    const char* root = argc > 1 ? argv[1] : "/tmp";
+
+    printf("Raft Election Benchmark\n");
+    printf("=======================\n");
+    printf("  Every term/vote change synced to disk under %s\n\n", root);
+
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s/raft_bench_election_%d", root, getpid());
+
+    mkdir(dir, 0755);
+    bench_save_rename(dir);
+    remove_dir(dir);
+
+    mkdir(dir, 0755);
+    bench_save_state(dir);
+    remove_dir(dir);
+
+    mkdir(dir, 0755);
+    bench_term_and_entry(dir, false);
+    remove_dir(dir);
+
+    mkdir(dir, 0755);
+    bench_term_and_entry(dir, true);
+    remove_dir(dir);
+
+    mkdir(dir, 0755);
+    bench_election_start(dir);
+    remove_dir(dir);
+
+    mkdir(dir, 0755);
+    bench_vote_grant(dir);
+    remove_dir(dir);
+
+    mkdir(dir, 0755);
+    bench_append_new_term(dir);
+    remove_dir(dir);
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+/**
+ * bench_install.c - InstallSnapshot throughput through the network simulator
+ *
+ * A leader whose log is compacted into a snapshot brings an empty
+ * follower up to date over network_sim, for a few chunk sizes and
+ * in-flight windows, and once with messages being dropped so stalled
+ * windows have to be resent. Simulated time advances 1 ms per step
+ * with a fixed one-way delay, so simulated MB/s shows how far the
+ * window is from covering the round trip; wall-clock MB/s is what the
+ * disk and message handling cost.
+ *
+ * Usage: bench_install [data_dir] [state_mb] [delay_ms]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "bench_common.h"
+#include "../integration/network_sim.h"
+#include "../../src/raft.h"
+#include "../../src/timer.h"
+#include "../../src/election.h"
+#include "../../src/snapshot.h"
+#include "../../src/log.h"
+
+#define DEFAULT_STATE_MB   64
+#define DEFAULT_DELAY_MS   1
+#define SNAPSHOT_INDEX     1000
+#define MAX_SIM_MS         600000
+
+static network_sim_t network;
+static raft_node_t* nodes[2];
+
+static void remove_dir(const char* dir) {
+    char cmd[600];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    system(cmd);
+}
+
+static void deliver_message(int32_t from, int32_t to, const void* data, size_t len,
+                            void* ctx) {
+    (void)ctx;
+    raft_receive_message(nodes[to], from, data, len);
+}
+
+static void bench_send(raft_node_t* node, int32_t peer, const void* msg, size_t len,
+                       void* ud) {
+    (void)ud;
+    net_send(&network, node->node_id, peer, msg, len);
+}
+
+/* The leader's snapshot, taken at SNAPSHOT_INDEX */
+static void write_snapshot(const char* dir, size_t state_len) {
+    char chunk[64 * 1024];
+    for (size_t i = 0; i < sizeof(chunk); i++) chunk[i] = (char)(i * 31);
+
+    raft_snapshot_writer_t* writer;
+    raft_snapshot_writer_open(dir, SNAPSHOT_INDEX, 1, &writer);
+    for (size_t done = 0; done < state_len; done += sizeof(chunk)) {
+        size_t len = state_len - done < sizeof(chunk) ? state_len - done : sizeof(chunk);
+        raft_snapshot_writer_write(writer, chunk, len);
+    }
+    raft_snapshot_writer_commit(writer);
+}
+
+static void bench_transfer(const char* root, size_t state_len, uint64_t delay_ms,
+                           uint32_t chunk_kb, uint32_t inflight, double drop_rate) {
+    char leader_dir[512], follower_dir[512];
+    snprintf(leader_dir, sizeof(leader_dir), "%s/raft_bench_install_%d_0", root, getpid());
+    snprintf(follower_dir, sizeof(follower_dir), "%s/raft_bench_install_%d_1", root, getpid());
+    mkdir(leader_dir, 0755);
+    mkdir(follower_dir, 0755);
+    write_snapshot(leader_dir, state_len);
+
+    net_init(&network, 2);
+    net_set_delay(&network, delay_ms, delay_ms);
+    net_set_drop_rate(&network, drop_rate);
+
+    raft_config_t config = {
+        .num_nodes = 2,
+        .send_fn = bench_send,
+        .snapshot_chunk_size = chunk_kb * 1024,
+        .snapshot_max_inflight = inflight,
+    };
+    for (int32_t i = 0; i < 2; i++) {
+        config.node_id = i;
+        config.data_dir = i == 0 ? leader_dir : follower_dir;
+        nodes[i] = raft_create(&config);
+        raft_start(nodes[i]);
+        raft_reset_election_timer(nodes[i]);
+    }
+    raft_log_reset(nodes[0]->log, SNAPSHOT_INDEX, 1);
+    nodes[0]->persistent.current_term = 1;
+    raft_become_leader(nodes[0]);
+
+    /* The follower's rejection of the first entry after the snapshot
+     * sends the leader back to index 1, which only the snapshot has */
+    uint64_t start = bench_now_ns();
+    uint64_t sim_ms = 0;
+    uint64_t index;
+    raft_propose(nodes[0], "entry", 5, &index);
+    while (nodes[1]->log->base_index < SNAPSHOT_INDEX && sim_ms < MAX_SIM_MS) {
+        raft_tick(nodes[0], 1);
+        raft_tick(nodes[1], 1);
+        net_tick(&network, 1, deliver_message, NULL);
+        sim_ms++;
+    }
+    uint64_t wall_ns = bench_now_ns() - start;
+
+    double mb = state_len / (1024.0 * 1024.0);
+    char name[64];
+    snprintf(name, sizeof(name), "%u KB x %u%s", chunk_kb, inflight,
+             drop_rate > 0 ? " (1% drop)" : "");
+    printf("  %-24s %10.1f %10.1f %10.1f %10.0f %8s\n", name, wall_ns / 1e6,
+           mb / (wall_ns / 1e9), sim_ms ? mb / (sim_ms / 1e3) : 0.0,
+           (double)network.messages_sent,
+           nodes[1]->log->base_index == SNAPSHOT_INDEX ? "yes" : "NO");
+
+    net_clear_pending(&network);
+    raft_destroy(nodes[0]);
+    raft_destroy(nodes[1]);
+    remove_dir(leader_dir);
+    remove_dir(follower_dir);
+}
+
+int main(int argc, char** argv) {
+    const char* root = argc > 1 ? argv[1] : "/tmp";
+    size_t state_len = (argc > 2 ? strtoull(argv[2], NULL, 10) : DEFAULT_STATE_MB) << 20;
+    uint64_t delay_ms = argc > 3 ? strtoull(argv[3], NULL, 10) : DEFAULT_DELAY_MS;
+
+    raft_timer_seed(42);
+    srand(42);
+
+    printf("Raft InstallSnapshot Benchmark\n");
+    printf("==============================\n");
+    printf("  %zu MB snapshot, %llu ms one-way delay, under %s\n\n", state_len >> 20,
+           (unsigned long long)delay_ms, root);
+    printf("  %-24s %10s %10s %10s %10s %8s\n", "Chunk x In-flight", "Wall(ms)",
+           "Wall MB/s", "Sim MB/s", "Messages", "Done");
+
+    bench_transfer(root, state_len, delay_ms, 64, 1, 0.0);
+    bench_transfer(root, state_len, delay_ms, 64, 8, 0.0);
+    bench_transfer(root, state_len, delay_ms, 256, 8, 0.0);
+    bench_transfer(root, state_len, delay_ms, 1024, 4, 0.0);
+    bench_transfer(root, state_len, delay_ms, 256, 8, 0.01);
+    return 0;
+}
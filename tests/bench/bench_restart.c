@@ -0,0 +1,112 @@
+/**
+ * bench_restart.c - Restart time against log size
+ *
+ * Writes a log of N entries, then times reopening storage alone and a
+ * full node restart (open + recovery), with the WAL checkpoint left by
+ * a clean shutdown and without it, as after a crash.
+ *
+ * Usage: bench_restart [data_dir] [entries...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "bench_common.h"
+#include "../../src/raft.h"
+#include "../../src/storage.h"
+
+#define COMMAND_SIZE    64
+#define WRITE_BATCH     10000
+
+static void remove_dir(const char* dir) {
+    char cmd[600];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    system(cmd);
+}
+
+static void write_log(const char* dir, uint64_t count) {
+    static char command[COMMAND_SIZE];
+    memset(command, 'r', sizeof(command));
+
+    raft_entry_t* entries = malloc(WRITE_BATCH * sizeof(raft_entry_t));
+    raft_storage_t* storage = raft_storage_open(dir, true);
+    for (uint64_t first = 1; first <= count; first += WRITE_BATCH) {
+        size_t n = 0;
+        for (; n < WRITE_BATCH && first + n <= count; n++) {
+            entries[n] = (raft_entry_t){
+                .term = 1,
+                .index = first + n,
+                .type = RAFT_ENTRY_COMMAND,
+                .command = command,
+                .command_len = sizeof(command),
+            };
+        }
+        raft_storage_append_entries(storage, entries, n);
+    }
+    raft_storage_close(storage);
+    free(entries);
+}
+
+static void drop_checkpoint(const char* dir) {
+    char path[600];
+    snprintf(path, sizeof(path), "%s/raft_wal.ckpt", dir);
+    unlink(path);
+}
+
+/* Time one storage open and one node restart */
+static void bench_restart(const char* dir, uint64_t count, bool checkpoint) {
+    if (!checkpoint) drop_checkpoint(dir);
+    uint64_t start = bench_now_ns();
+    raft_storage_t* storage = raft_storage_open(dir, true);
+    uint64_t open_ns = bench_now_ns() - start;
+    raft_storage_close(storage);
+
+    if (!checkpoint) drop_checkpoint(dir);
+    raft_config_t config = { .node_id = 0, .num_nodes = 3, .data_dir = dir };
+    start = bench_now_ns();
+    raft_node_t* node = raft_create(&config);
+    uint64_t restart_ns = bench_now_ns() - start;
+    uint64_t recovered = raft_log_last_index(node->log);
+    raft_destroy(node);
+
+    printf("  %10llu %-12s %12.1f %14.1f %14.0f%s\n",
+           (unsigned long long)count, checkpoint ? "checkpoint" : "none",
+           open_ns / 1e6, restart_ns / 1e6, count * 1e9 / restart_ns,
+           recovered == count ? "" : "  (incomplete)");
+}
+
+int main(int argc, char** argv) {
+    const char* root = argc > 1 ? argv[1] : "/tmp";
+    uint64_t default_counts[] = { 1000000, 10000000 };
+    uint64_t* counts = default_counts;
+    int num_counts = 2;
+    if (argc > 2) {
+        num_counts = argc - 2;
+        counts = malloc(num_counts * sizeof(uint64_t));
+        for (int i = 0; i < num_counts; i++) {
+            counts[i] = strtoull(argv[i + 2], NULL, 10);
+        }
+    }
+
+    printf("Raft Restart Benchmark\n");
+    printf("======================\n");
+    printf("  %d-byte commands, warm page cache\n\n", COMMAND_SIZE);
+    printf("  %10s %-12s %12s %14s %14s\n", "Entries", "Checkpoint",
+           "Open(ms)", "Restart(ms)", "Entries/sec");
+
+    for (int i = 0; i < num_counts; i++) {
+        char dir[512];
+        snprintf(dir, sizeof(dir), "%s/raft_bench_restart_%d_%d", root, getpid(), i);
+        mkdir(dir, 0755);
+        write_log(dir, counts[i]);
+
+        bench_restart(dir, counts[i], true);
+        bench_restart(dir, counts[i], false);
+        remove_dir(dir);
+    }
+
+    if (counts != default_counts) free(counts);
+    return 0;
+}
@@ -0,0 +1,146 @@
+/**
+ * bench_snapshot_load.c - Loading a snapshot on restart, copied against mapped
+ *
+ * Writes a snapshot of each given size, drops it from the page cache as
+ * a restart would find it, then loads it three ways: raft_snapshot_load
+ * into one buffer, raft_snapshot_map checking the CRC, and
+ * raft_snapshot_map without. "Ready" is when the state machine could
+ * start serving; "Scan" adds touching every page of the state, as a
+ * state machine that needs all of it would. A load that would not fit
+ * in free memory is skipped.
+ *
+ * Usage: bench_snapshot_load [data_dir] [state_mb ...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "bench_common.h"
+#include "../../src/snapshot.h"
+#include "../../src/param.h"
+
+#define CHUNK_SIZE  (1024 * 1024)
+#define PAGE_STRIDE 4096
+
+static void remove_dir(const char* dir) {
+    char cmd[600];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    system(cmd);
+}
+
+/* Evict the snapshot's pages so the load reads them from disk */
+static void drop_cache(const char* dir) {
+    char path[600];
+    snprintf(path, sizeof(path), "%s/%s", dir, RAFT_SNAPSHOT_FILE);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+static void write_snapshot(const char* dir, size_t state_len) {
+    char* chunk = malloc(CHUNK_SIZE);
+    for (size_t i = 0; i < CHUNK_SIZE; i++) chunk[i] = (char)(i * 31);
+
+    raft_snapshot_writer_t* writer;
+    raft_snapshot_writer_open(dir, 1, 1, &writer);
+    for (size_t done = 0; done < state_len; done += CHUNK_SIZE) {
+        size_t len = state_len - done < CHUNK_SIZE ? state_len - done : CHUNK_SIZE;
+        raft_snapshot_writer_write(writer, chunk, len);
+    }
+    raft_snapshot_writer_commit(writer);
+    free(chunk);
+}
+
+/* One byte per page, so every page is faulted in */
+static unsigned scan(const void* data, size_t len) {
+    const volatile unsigned char* p = data;
+    unsigned sum = 0;
+    for (size_t i = 0; i < len; i += PAGE_STRIDE) sum += p[i];
+    return sum;
+}
+
+/* MemAvailable: free memory plus what the page cache would give up */
+static size_t available_bytes(void) {
+    FILE* f = fopen("/proc/meminfo", "r");
+    if (!f) return SIZE_MAX;
+    char line[128];
+    size_t kb = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "MemAvailable: %zu kB", &kb) == 1) break;
+    }
+    fclose(f);
+    return kb ? kb << 10 : SIZE_MAX;
+}
+
+static void report(const char* name, uint64_t ready_ns, uint64_t scan_ns, size_t len,
+                   size_t heap) {
+    printf("  %-26s %10.1f %10.1f %10.0f %10zu\n", name, ready_ns / 1e6, scan_ns / 1e6,
+           len / (1024.0 * 1024.0) / (scan_ns / 1e9), heap >> 20);
+}
+
+static void bench_load(const char* dir, size_t state_len) {
+    size_t avail = available_bytes();
+    if (state_len > avail / 10 * 9) {
+        printf("  %-26s    skipped: %zu MB available\n", "raft_snapshot_load", avail >> 20);
+        return;
+    }
+
+    drop_cache(dir);
+    raft_snapshot_meta_t meta;
+    void* data;
+    size_t len;
+    uint64_t start = bench_now_ns();
+    raft_snapshot_load(dir, &meta, &data, &len);
+    uint64_t ready = bench_now_ns() - start;
+    scan(data, len);
+    report("raft_snapshot_load", ready, bench_now_ns() - start, len, len);
+    free(data);
+}
+
+static void bench_map(const char* dir, bool verify) {
+    drop_cache(dir);
+    raft_snapshot_meta_t meta;
+    raft_snapshot_mapping_t* mapping;
+    uint64_t start = bench_now_ns();
+    raft_snapshot_map(dir, &meta, verify, &mapping);
+    uint64_t ready = bench_now_ns() - start;
+    size_t len = raft_snapshot_mapping_length(mapping);
+    scan(raft_snapshot_mapping_data(mapping), len);
+    report(verify ? "raft_snapshot_map" : "raft_snapshot_map (no CRC)", ready,
+           bench_now_ns() - start, len, 0);
+    raft_snapshot_unmap(mapping);
+}
+
+int main(int argc, char** argv) {
+    const char* root = argc > 1 ? argv[1] : "/tmp";
+    size_t default_mb[] = { 1024, 10240 };
+    int num_sizes = argc > 2 ? argc - 2 : 2;
+
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s/raft_bench_snapshot_load_%d", root, getpid());
+
+    printf("Raft Snapshot Load Benchmark\n");
+    printf("============================\n");
+    printf("  Snapshots under %s, page cache dropped before each load\n", root);
+
+    for (int i = 0; i < num_sizes; i++) {
+        size_t state_mb = argc > 2 ? strtoull(argv[i + 2], NULL, 10) : default_mb[i];
+        size_t state_len = state_mb << 20;
+        mkdir(dir, 0755);
+        write_snapshot(dir, state_len);
+
+        printf("\n  %zu MB state\n", state_mb);
+        printf("  %-26s %10s %10s %10s %10s\n", "Mode", "Ready(ms)", "Scan(ms)",
+               "Scan MB/s", "Heap(MB)");
+        bench_load(dir, state_len);
+        bench_map(dir, true);
+        bench_map(dir, false);
+        remove_dir(dir);
+    }
+    return 0;
+}
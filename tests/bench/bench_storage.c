@@ -0,0 +1,119 @@
+/**
+ * bench_storage.c - The same workload on each storage backend
+ *
+ * Times single-entry appends that are synced before returning, proposals
+ * on a single-node leader (so the whole consensus path down to storage)
+ * and reopening a node on the log those proposals left. The memory
+ * backend shows what the core costs with the disk taken out.
+ *
+ * Usage: bench_storage [data_dir] [operations] [command_size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "bench_common.h"
+#include "../../src/raft.h"
+#include "../../src/storage.h"
+
+#define DEFAULT_OPS           2000
+#define DEFAULT_COMMAND_SIZE  256
+#define WARMUP_OPS            20
+
+static void remove_dir(const char* dir) {
+    char cmd[600];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    system(cmd);
+    raft_storage_memory_drop(dir);
+}
+
+/* Append and sync one entry at a time */
+static void bench_append(const char* dir, raft_storage_backend_t backend, size_t ops,
+                         const char* command, size_t command_size, bench_result_t* result) {
+    raft_storage_t* storage = raft_storage_open_backend(dir, true, backend);
+    for (size_t i = 0; i < WARMUP_OPS + ops; i++) {
+        raft_entry_t entry = { .term = 1, .index = i + 1,
+                               .command = (char*)command, .command_len = command_size };
+        uint64_t start = bench_now_ns();
+        raft_storage_append_entry(storage, &entry);
+        if (i >= WARMUP_OPS) bench_record(result, bench_now_ns() - start);
+    }
+    raft_storage_close(storage);
+}
+
+/* Propose on a single-node leader, then time bringing it back up */
+static uint64_t bench_propose(const char* dir, raft_storage_backend_t backend, size_t ops,
+                              const char* command, size_t command_size,
+                              bench_result_t* result) {
+    raft_config_t config = { .node_id = 0, .num_nodes = 1, .data_dir = dir,
+                             .storage_backend = backend };
+    raft_node_t* node = raft_create(&config);
+    raft_start(node);
+    for (size_t i = 0; i < WARMUP_OPS + ops; i++) {
+        uint64_t index;
+        uint64_t start = bench_now_ns();
+        raft_propose(node, command, command_size, &index);
+        if (i >= WARMUP_OPS) bench_record(result, bench_now_ns() - start);
+    }
+    raft_destroy(node);
+
+    uint64_t start = bench_now_ns();
+    node = raft_create(&config);
+    uint64_t took = bench_now_ns() - start;
+    raft_destroy(node);
+    return took;
+}
+
+int main(int argc, char** argv) {
+    const char* root = argc > 1 ? argv[1] : "/tmp";
+    size_t ops = argc > 2 ? strtoull(argv[2], NULL, 10) : DEFAULT_OPS;
+    size_t command_size = argc > 3 ? strtoull(argv[3], NULL, 10) : DEFAULT_COMMAND_SIZE;
+
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s/raft_bench_storage_%d", root, getpid());
+    char* command = malloc(command_size);
+    memset(command, 'b', command_size);
+
+    printf("Raft Storage Backend Benchmark\n");
+    printf("==============================\n");
+    printf("  %zu operations per run, %zu-byte commands, under %s\n\n",
+           ops, command_size, root);
+    printf("  %-8s %12s %10s %10s %12s %10s %10s %12s\n", "Backend",
+           "Appends/s", "P50(us)", "P99(us)", "Proposals/s", "P50(us)", "P99(us)",
+           "Restart(ms)");
+
+    raft_storage_backend_t backends[] = {
+        RAFT_STORAGE_FILE, RAFT_STORAGE_MMAP, RAFT_STORAGE_MEMORY,
+    };
+    for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++) {
+        bench_result_t append, propose;
+        bench_init(&append, ops);
+        bench_init(&propose, ops);
+
+        mkdir(dir, 0755);
+        bench_append(dir, backends[b], ops, command, command_size, &append);
+        remove_dir(dir);
+
+        mkdir(dir, 0755);
+        uint64_t restart = bench_propose(dir, backends[b], ops, command, command_size,
+                                         &propose);
+        remove_dir(dir);
+
+        printf("  %-8s %12.0f %10.1f %10.1f %12.0f %10.1f %10.1f %12.2f\n",
+               raft_storage_backend_ops(backends[b])->name,
+               (double)append.total_ops * 1e9 / append.total_time_ns,
+               bench_percentile(&append, 50) / 1000.0,
+               bench_percentile(&append, 99) / 1000.0,
+               (double)propose.total_ops * 1e9 / propose.total_time_ns,
+               bench_percentile(&propose, 50) / 1000.0,
+               bench_percentile(&propose, 99) / 1000.0,
+               restart / 1e6);
+        bench_free(&append);
+        bench_free(&propose);
+    }
+
+    free(command);
+    return 0;
+}
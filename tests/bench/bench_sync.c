@@ -0,0 +1,125 @@
+/**
+ * bench_sync.c - Append latency and durability lag for each sync policy
+ *
+ * Plays a follower taking AppendEntries requests of a given size: each
+ * request appends its entries, syncs whatever the policy wants synced
+ * before the ack, then ticks (which syncs interval appends that have
+ * come due). A leader is played the same way with single-entry
+ * proposals and a commit check only every few of them. Reports
+ * entries/s, per-request latency and how many of the written entries
+ * were still unsynced at each ack or commit check, i.e. could not yet
+ * be counted as persisted.
+ *
+ * Usage: bench_sync [data_dir] [requests] [command_size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "bench_common.h"
+#include "../../src/storage.h"
+
+#define DEFAULT_REQUESTS      1000
+#define DEFAULT_COMMAND_SIZE  256
+#define WARMUP_REQUESTS       20
+
+typedef struct {
+    const char* name;
+    raft_sync_policy_t policy;
+    uint64_t interval_us;
+    uint64_t interval_bytes;
+} policy_case_t;
+
+static void remove_dir(const char* dir) {
+    char cmd[600];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    system(cmd);
+}
+
+/* Run requests of batch entries each, acking every ack_every requests */
+static void bench_policy(const char* dir, const policy_case_t* pc, size_t batch,
+                         size_t ack_every, size_t requests, size_t command_size) {
+    mkdir(dir, 0755);
+    raft_storage_t* storage = raft_storage_open(dir, true);
+    raft_storage_set_sync_policy(storage, pc->policy, pc->interval_us, pc->interval_bytes);
+
+    char* command = malloc(command_size);
+    memset(command, 's', command_size);
+    raft_entry_t* entries = malloc(batch * sizeof(raft_entry_t));
+
+    bench_result_t result;
+    bench_init(&result, requests);
+    uint64_t index = 0;
+    uint64_t unsynced = 0;
+    uint64_t acks = 0;
+    uint64_t elapsed = 0;
+    for (size_t r = 0; r < WARMUP_REQUESTS + requests; r++) {
+        for (size_t i = 0; i < batch; i++) {
+            entries[i] = (raft_entry_t){ .term = 1, .index = ++index,
+                                         .command = command, .command_len = command_size };
+        }
+        uint64_t start = bench_now_ns();
+        raft_storage_append_entries(storage, entries, batch);
+        bool ack = (r + 1) % ack_every == 0;
+        if (ack) raft_storage_sync_for_ack(storage);
+        raft_storage_sync_if_due(storage);
+        uint64_t took = bench_now_ns() - start;
+        if (r < WARMUP_REQUESTS) continue;
+
+        bench_record(&result, took);
+        elapsed += took;
+        if (ack) {
+            unsynced += index - raft_storage_durable_index(storage);
+            acks++;
+        }
+    }
+
+    printf("  %-16s %8zu %6zu %12.0f %10.1f %10.1f %12.1f\n", pc->name, batch, ack_every,
+           (double)requests * batch * 1e9 / elapsed,
+           bench_percentile(&result, 50) / 1000.0,
+           bench_percentile(&result, 99) / 1000.0,
+           acks ? (double)unsynced / acks : 0.0);
+
+    bench_free(&result);
+    free(entries);
+    free(command);
+    raft_storage_close(storage);
+    remove_dir(dir);
+}
+
+int main(int argc, char** argv) {
+    const char* root = argc > 1 ? argv[1] : "/tmp";
+    size_t requests = argc > 2 ? strtoull(argv[2], NULL, 10) : DEFAULT_REQUESTS;
+    size_t command_size = argc > 3 ? strtoull(argv[3], NULL, 10) : DEFAULT_COMMAND_SIZE;
+
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s/raft_bench_sync_%d", root, getpid());
+
+    printf("Raft Sync Policy Benchmark\n");
+    printf("==========================\n");
+    printf("  %zu requests per run, %zu-byte commands, under %s\n\n",
+           requests, command_size, root);
+    printf("  %-16s %8s %6s %12s %10s %10s %12s\n", "Policy", "Entries", "Acks",
+           "Entries/s", "P50(us)", "P99(us)", "Unsynced/ack");
+
+    policy_case_t cases[] = {
+        { "always",          RAFT_SYNC_ALWAYS,   0,    0 },
+        { "batch",           RAFT_SYNC_BATCH,    0,    0 },
+        { "interval 2ms",    RAFT_SYNC_INTERVAL, 2000, 0 },
+        { "interval 64KB",   RAFT_SYNC_INTERVAL, 0,    64 * 1024 },
+        { "none",            RAFT_SYNC_NONE,     0,    0 },
+    };
+    /* Entries per request, requests per ack: follower requests of one
+     * and of 16 entries, then a leader checking commit every 8 proposals */
+    size_t shapes[][2] = { { 1, 1 }, { 16, 1 }, { 1, 8 } };
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+            bench_policy(dir, &cases[c], shapes[s][0], shapes[s][1], requests,
+                         command_size);
+        }
+        printf("\n");
+    }
+    return 0;
+}
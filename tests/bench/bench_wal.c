@@ -0,0 +1,195 @@
+/**
+ * bench_wal.c - WAL append throughput and group commit
+ *
+ * Compares one sync per entry against one sync per batch, measures
+ * entries/sec for single-entry appends as the group-commit window grows,
+ * and compares the blocking and io_uring I/O backends.
+ *
+ * Usage: bench_wal [data_dir] [entries]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "bench_common.h"
+#include "../../src/storage.h"
+
+#define DEFAULT_ENTRIES 2000
+#define BATCH_SIZE      1000
+#define COMMAND_SIZE    128
+
+static char base_dir[256];
+static int run_counter = 0;
+
+static raft_storage_t* open_fresh_io(char* dir, size_t len, raft_io_backend_t backend) {
+    snprintf(dir, len, "%s/run_%d", base_dir, run_counter++);
+    return raft_storage_open_io(dir, true, backend);
+}
+
+static raft_storage_t* open_fresh(char* dir, size_t len) {
+    return open_fresh_io(dir, len, RAFT_IO_SYNC);
+}
+
+static void remove_dir(const char* dir) {
+    char cmd[600];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    system(cmd);
+}
+
+/* 1000 entries appended one by one vs in a single call */
+static void bench_batch_vs_single(void) {
+    static char command[COMMAND_SIZE];
+    memset(command, 'x', sizeof(command));
+
+    raft_entry_t* entries = malloc(BATCH_SIZE * sizeof(raft_entry_t));
+    for (size_t i = 0; i < BATCH_SIZE; i++) {
+        entries[i].term = 1;
+        entries[i].index = i + 1;
+        entries[i].type = RAFT_ENTRY_COMMAND;
+        entries[i].command = command;
+        entries[i].command_len = sizeof(command);
+    }
+
+    char dir[512];
+    raft_storage_t* storage = open_fresh(dir, sizeof(dir));
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < BATCH_SIZE; i++) {
+        raft_storage_append_entry(storage, &entries[i]);
+    }
+    uint64_t single_ns = bench_now_ns() - start;
+    raft_storage_close(storage);
+    remove_dir(dir);
+
+    storage = open_fresh(dir, sizeof(dir));
+    start = bench_now_ns();
+    raft_storage_append_entries(storage, entries, BATCH_SIZE);
+    uint64_t batch_ns = bench_now_ns() - start;
+    raft_storage_close(storage);
+    remove_dir(dir);
+
+    printf("\n%d-entry batch (%d-byte commands), one sync per call:\n",
+           BATCH_SIZE, COMMAND_SIZE);
+    printf("  %-20s %10.2f ms %12.0f entries/sec\n", "append_entry x1000",
+           single_ns / 1e6, BATCH_SIZE * 1e9 / single_ns);
+    printf("  %-20s %10.2f ms %12.0f entries/sec\n", "append_entries",
+           batch_ns / 1e6, BATCH_SIZE * 1e9 / batch_ns);
+
+    free(entries);
+}
+
+/* Single-entry appends with a given group-commit window */
+static void bench_window(uint64_t window_us, uint64_t count) {
+    static char command[COMMAND_SIZE];
+    memset(command, 'y', sizeof(command));
+
+    char dir[512];
+    raft_storage_t* storage = open_fresh(dir, sizeof(dir));
+    raft_storage_set_group_commit(storage, window_us);
+
+    uint64_t syncs = 0;
+    uint64_t durable = 0;
+    uint64_t start = bench_now_ns();
+    for (uint64_t i = 1; i <= count; i++) {
+        raft_entry_t entry = {
+            .term = 1,
+            .index = i,
+            .type = RAFT_ENTRY_COMMAND,
+            .command = command,
+            .command_len = sizeof(command),
+        };
+        raft_storage_append_entry(storage, &entry);
+        if (raft_storage_durable_index(storage) != durable) {
+            durable = raft_storage_durable_index(storage);
+            syncs++;
+        }
+    }
+    raft_storage_sync(storage);
+    syncs++;
+    uint64_t elapsed = bench_now_ns() - start;
+
+    printf("  %10llu %14.0f %10llu %14.1f\n",
+           (unsigned long long)window_us, count * 1e9 / elapsed,
+           (unsigned long long)syncs, (double)count / syncs);
+
+    raft_storage_close(storage);
+    remove_dir(dir);
+}
+
+/* Single-entry appends, each followed by a sync, on one backend
+ * Reports how long the caller spends inside append calls and how long
+ * until every entry is durable */
+static void bench_backend(raft_io_backend_t backend, const char* name, uint64_t count) {
+    static char command[COMMAND_SIZE];
+    memset(command, 'z', sizeof(command));
+
+    char dir[512];
+    raft_storage_t* storage = open_fresh_io(dir, sizeof(dir), backend);
+    if (raft_storage_io_backend(storage) != backend) {
+        printf("  %-10s unavailable\n", name);
+        raft_storage_close(storage);
+        remove_dir(dir);
+        return;
+    }
+
+    uint64_t in_append = 0;
+    uint64_t start = bench_now_ns();
+    for (uint64_t i = 1; i <= count; i++) {
+        raft_entry_t entry = {
+            .term = 1,
+            .index = i,
+            .type = RAFT_ENTRY_COMMAND,
+            .command = command,
+            .command_len = sizeof(command),
+        };
+        uint64_t t0 = bench_now_ns();
+        raft_storage_append_entry(storage, &entry);
+        in_append += bench_now_ns() - t0;
+        raft_storage_poll(storage);
+    }
+    while (raft_storage_durable_index(storage) < count) {
+        raft_storage_poll(storage);
+        usleep(50);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    printf("  %-10s %14.2f %14.2f %14.0f\n", name,
+           in_append / 1e3 / count, elapsed / 1e6, count * 1e9 / elapsed);
+
+    raft_storage_close(storage);
+    remove_dir(dir);
+}
+
+int main(int argc, char** argv) {
+    const char* root = argc > 1 ? argv[1] : "/tmp";
+    uint64_t count = argc > 2 ? strtoull(argv[2], NULL, 10) : DEFAULT_ENTRIES;
+
+    snprintf(base_dir, sizeof(base_dir), "%s/raft_bench_wal_%d", root, getpid());
+    if (mkdir(base_dir, 0755) < 0) {
+        perror(base_dir);
+        return 1;
+    }
+
+    printf("Raft WAL Benchmark\n");
+    printf("==================\n");
+    printf("  Data dir: %s\n", base_dir);
+
+    bench_batch_vs_single();
+
+    uint64_t windows[] = { 0, 50, 200, 1000, 5000 };
+    printf("\nGroup commit, %llu single-entry appends:\n", (unsigned long long)count);
+    printf("  %10s %14s %10s %14s\n", "Window(us)", "Entries/sec", "Syncs", "Entries/sync");
+    for (size_t i = 0; i < sizeof(windows) / sizeof(windows[0]); i++) {
+        bench_window(windows[i], count);
+    }
+
+    printf("\nI/O backends, %llu single-entry appends, sync per append:\n",
+           (unsigned long long)count);
+    printf("  %-10s %14s %14s %14s\n", "Backend", "In append(us)", "Durable(ms)", "Entries/sec");
+    bench_backend(RAFT_IO_SYNC, "sync", count);
+    bench_backend(RAFT_IO_URING, "io_uring", count);
+
+    remove_dir(base_dir);
+    return 0;
+}
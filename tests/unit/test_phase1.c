@@ -141,6 +141,254 @@ TEST(test_log_term_at) {
     raft_log_destroy(log);
 }
 
+TEST(test_log_segment_boundaries) {
+    raft_log_t* log = raft_log_create();
+    uint64_t total = RAFT_LOG_SEGMENT_ENTRIES * 3 + 7;
+    uint64_t index;
+
+    /* Fill several segments and keep a pointer into the first one */
+    for (uint64_t i = 1; i <= total; i++) {
+        raft_log_append(log, i / 100 + 1, "x", 1, &index);
+        assert(index == i);
+    }
+    const raft_entry_t* early = raft_log_get(log, 10);
+    assert(early != NULL && early->index == 10);
+
+    /* Appending more must not move existing entries */
+    raft_log_append(log, 99, "y", 1, &index);
+    assert(raft_log_get(log, 10) == early);
+
+    /* Compact past two segment boundaries */
+    uint64_t cut = RAFT_LOG_SEGMENT_ENTRIES * 2 + 5;
+    assert(raft_log_truncate_before(log, cut) == RAFT_OK);
+    assert(raft_log_count(log) == total + 1 - (cut - 1));
+    assert(raft_log_get(log, cut - 1) == NULL);
+    assert(raft_log_get(log, cut)->index == cut);
+    assert(raft_log_term_at(log, cut - 1) == (cut - 1) / 100 + 1);
+
+    /* Truncate the tail back across a boundary, then append again */
+    uint64_t keep = RAFT_LOG_SEGMENT_ENTRIES * 3 - 1;
+    assert(raft_log_truncate_after(log, keep) == RAFT_OK);
+    assert(raft_log_last_index(log) == keep);
+    raft_log_append(log, 100, "z", 1, &index);
+    assert(index == keep + 1);
+    assert(raft_log_get(log, index)->term == 100);
+
+    /* Reset discards everything */
+    raft_log_reset(log, 5000, 7);
+    assert(raft_log_count(log) == 0);
+    assert(raft_log_last_index(log) == 5000);
+    assert(raft_log_last_term(log) == 7);
+    raft_log_append(log, 8, "w", 1, &index);
+    assert(index == 5001);
+
+    raft_log_destroy(log);
+}
+
+TEST(test_log_payload_sizes) {
+    raft_log_t* log = raft_log_create();
+    size_t sizes[] = { 0, 1, RAFT_LOG_INLINE_SIZE, RAFT_LOG_INLINE_SIZE + 1,
+                       4096, RAFT_LOG_ARENA_CHUNK_SIZE, 3 * RAFT_LOG_ARENA_CHUNK_SIZE };
+    size_t n = sizeof(sizes) / sizeof(sizes[0]);
+    char* buf = malloc(3 * RAFT_LOG_ARENA_CHUNK_SIZE);
+
+    /* Inline, arena and heap payloads must all round-trip */
+    for (int round = 0; round < 2; round++) {
+        for (size_t i = 0; i < n; i++) {
+            memset(buf, 'a' + (int)i + round, sizes[i]);
+            raft_log_append(log, 1, buf, sizes[i], NULL);
+        }
+        for (size_t i = 0; i < n; i++) {
+            const raft_entry_t* e = raft_log_get(log, i + 1);
+            assert(e->command_len == sizes[i]);
+            for (size_t j = 0; j < sizes[i]; j++) {
+                assert(e->command[j] == (char)('a' + i + round));
+            }
+        }
+        /* Drop the tail inside the segment; the arena is rewound */
+        raft_log_truncate_after(log, 0);
+    }
+
+    /* Many arena-sized payloads spanning several chunks */
+    for (int i = 0; i < 500; i++) {
+        memset(buf, i & 0x7f, 200);
+        raft_log_append(log, 1, buf, 200, NULL);
+    }
+    raft_log_truncate_after(log, 250);
+    for (int i = 250; i < 500; i++) {
+        memset(buf, (i + 1) & 0x7f, 200);
+        raft_log_append(log, 2, buf, 200, NULL);
+    }
+    for (int i = 0; i < 500; i++) {
+        const raft_entry_t* e = raft_log_get(log, (uint64_t)i + 1);
+        char expect = (char)((i < 250 ? i : i + 1) & 0x7f);
+        assert(e->command[0] == expect && e->command[199] == expect);
+    }
+
+    free(buf);
+    raft_log_destroy(log);
+}
+
+TEST(test_log_term_runs) {
+    raft_log_t* log = raft_log_create();
+
+    /* Terms 1 x3, 2 x2, 5 x4 */
+    uint64_t terms[] = { 1, 1, 1, 2, 2, 5, 5, 5, 5 };
+    for (size_t i = 0; i < 9; i++) {
+        raft_log_append(log, terms[i], "c", 1, NULL);
+    }
+
+    size_t run_count;
+    raft_log_term_runs(log, &run_count);
+    assert(run_count == 3);
+    assert(raft_log_first_index_of_term(log, 2) == 4);
+    assert(raft_log_last_index_of_term(log, 2) == 5);
+    assert(raft_log_last_index_of_term(log, 5) == 9);
+    assert(raft_log_first_index_of_term(log, 3) == 0);
+
+    /* Terms stay answerable after compaction */
+    raft_log_truncate_before(log, 8);
+    assert(raft_log_get(log, 4) == NULL);
+    assert(raft_log_term_at(log, 2) == 1);
+    assert(raft_log_term_at(log, 4) == 2);
+    assert(raft_log_term_at(log, 7) == 5);
+
+    /* Tail truncation drops runs past the cut */
+    raft_log_truncate_after(log, 7);
+    raft_log_append(log, 6, "c", 1, NULL);
+    assert(raft_log_term_at(log, 8) == 6);
+    assert(raft_log_last_index_of_term(log, 5) == 7);
+
+    /* Restoring after a reset keeps history up to the snapshot point */
+    size_t n;
+    const raft_term_run_t* runs = raft_log_term_runs(log, &n);
+    raft_term_run_t saved[8];
+    memcpy(saved, runs, n * sizeof(*runs));
+    raft_log_reset(log, 7, 5);
+    assert(raft_log_term_at(log, 4) == 0);
+    raft_log_restore_term_runs(log, saved, n);
+    assert(raft_log_term_at(log, 4) == 2);
+    assert(raft_log_term_at(log, 7) == 5);
+    assert(raft_log_term_at(log, 8) == 0);
+
+    raft_log_destroy(log);
+}
+
+/* Loader that regenerates the payload written by test_log_eviction */
+static raft_status_t fill_loader(void* ctx, uint64_t index, uint64_t term,
+                                 char** command, size_t* command_len) {
+    (void)term;
+    size_t len = *(size_t*)ctx;
+    *command = malloc(len);
+    memset(*command, (int)(index & 0xff), len);
+    *command_len = len;
+    return RAFT_OK;
+}
+
+TEST(test_log_eviction) {
+    raft_log_t* log = raft_log_create();
+    size_t len = 200;
+    char cmd[200];
+
+    for (uint64_t i = 1; i <= RAFT_LOG_SEGMENT_ENTRIES + 10; i++) {
+        memset(cmd, (int)(i & 0xff), len);
+        raft_log_append(log, 1, cmd, len, NULL);
+    }
+
+    raft_log_memory_t mem;
+    raft_log_memory(log, &mem);
+    size_t before = mem.resident_bytes;
+    assert(before > 0);
+
+    /* Nothing is evicted without a loader */
+    raft_log_evict(log, raft_log_last_index(log), 0);
+    raft_log_memory(log, &mem);
+    assert(mem.evictions == 0);
+
+    raft_log_set_loader(log, fill_loader, &len);
+    raft_log_evict(log, RAFT_LOG_SEGMENT_ENTRIES, 0);
+    raft_log_memory(log, &mem);
+    assert(mem.evictions == RAFT_LOG_SEGMENT_ENTRIES);
+    assert(mem.evicted_bytes == RAFT_LOG_SEGMENT_ENTRIES * len);
+    assert(mem.resident_bytes < before);
+
+    /* Evicted payloads are read back transparently */
+    const raft_entry_t* entry = raft_log_get(log, 7);
+    assert(entry != NULL);
+    assert(entry->command_len == len);
+    assert((unsigned char)entry->command[0] == 7);
+    raft_log_memory(log, &mem);
+    assert(mem.reloads == 1);
+    assert(mem.evicted_bytes == (RAFT_LOG_SEGMENT_ENTRIES - 1) * len);
+
+    /* ...and evicted again on the next pass */
+    raft_log_evict(log, RAFT_LOG_SEGMENT_ENTRIES, 0);
+    raft_log_memory(log, &mem);
+    assert(mem.evicted_bytes == RAFT_LOG_SEGMENT_ENTRIES * len);
+
+    /* Compaction forgets evicted payloads */
+    raft_log_truncate_before(log, RAFT_LOG_SEGMENT_ENTRIES + 1);
+    raft_log_memory(log, &mem);
+    assert(mem.evicted_bytes == 0);
+
+    raft_log_destroy(log);
+}
+
+TEST(test_log_append_batch) {
+    raft_log_t* log = raft_log_create();
+    raft_log_append(log, 1, "first", 5, NULL);
+
+    char big_a[300], big_b[500];
+    memset(big_a, 'a', sizeof(big_a));
+    memset(big_b, 'b', sizeof(big_b));
+
+    raft_entry_t batch[] = {
+        { .term = 1, .command = "small", .command_len = 5 },
+        { .term = 2, .command = big_a, .command_len = sizeof(big_a) },
+        { .term = 2, .command = NULL, .command_len = 0 },
+        { .term = 3, .command = big_b, .command_len = sizeof(big_b) },
+    };
+
+    uint64_t first_index;
+    assert(raft_log_append_batch(log, batch, 4, &first_index) == RAFT_OK);
+    assert(first_index == 2);
+    assert(raft_log_count(log) == 5);
+    assert(raft_log_last_term(log) == 3);
+    assert(raft_log_first_index_of_term(log, 2) == 3);
+
+    const raft_entry_t* e2 = raft_log_get(log, 2);
+    const raft_entry_t* e3 = raft_log_get(log, 3);
+    const raft_entry_t* e4 = raft_log_get(log, 4);
+    const raft_entry_t* e5 = raft_log_get(log, 5);
+    assert(e2->command_len == 5 && memcmp(e2->command, "small", 5) == 0);
+    assert(e4->command == NULL && e4->command_len == 0);
+    assert(memcmp(e3->command, big_a, sizeof(big_a)) == 0);
+    assert(memcmp(e5->command, big_b, sizeof(big_b)) == 0);
+
+    /* Large payloads share one contiguous block */
+    assert(e5->command == e3->command + sizeof(big_a));
+
+    /* Batches can cross segment boundaries */
+    raft_entry_t* many = calloc(RAFT_LOG_SEGMENT_ENTRIES * 2, sizeof(raft_entry_t));
+    for (size_t i = 0; i < RAFT_LOG_SEGMENT_ENTRIES * 2; i++) {
+        many[i].term = 4;
+        many[i].command = big_a;
+        many[i].command_len = 100 + i % 50;
+    }
+    assert(raft_log_append_batch(log, many, RAFT_LOG_SEGMENT_ENTRIES * 2, NULL) == RAFT_OK);
+    assert(raft_log_count(log) == 5 + RAFT_LOG_SEGMENT_ENTRIES * 2);
+    assert(raft_log_get(log, raft_log_last_index(log))->command_len ==
+           100 + (RAFT_LOG_SEGMENT_ENTRIES * 2 - 1) % 50);
+
+    /* Truncating part of the batch keeps the rest intact */
+    raft_log_truncate_after(log, 3);
+    assert(raft_log_count(log) == 3);
+    assert(memcmp(raft_log_get(log, 3)->command, big_a, sizeof(big_a)) == 0);
+
+    free(many);
+    raft_log_destroy(log);
+}
+
 /* ========== Raft Node Tests ========== */
 
 TEST(test_node_create_destroy) {
@@ -289,6 +537,11 @@ int main(void) {
     RUN_TEST(test_log_truncate_after);
     RUN_TEST(test_log_truncate_before);
     RUN_TEST(test_log_term_at);
+    RUN_TEST(test_log_segment_boundaries);
+    RUN_TEST(test_log_payload_sizes);
+    RUN_TEST(test_log_term_runs);
+    RUN_TEST(test_log_eviction);
+    RUN_TEST(test_log_append_batch);
 
     printf("\nRaft Node Tests:\n");
     RUN_TEST(test_node_create_destroy);
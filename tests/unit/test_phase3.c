@@ -409,6 +409,195 @@ TEST(test_propose_and_commit) {
     raft_destroy(node);
 }
 
+/* Test 11: Owned proposals are replicated without copying */
+static const void* gather_payload = NULL;
+static size_t gather_total = 0;
+
+static void capture_sendv(raft_node_t* node, int32_t peer_id,
+                          const struct iovec* iov, int iovcnt, void* user_data) {
+    (void)node; (void)peer_id; (void)user_data;
+    gather_total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        gather_total += iov[i].iov_len;
+    }
+    /* Header, entry prefix, then the payload itself */
+    gather_payload = (iovcnt == 3) ? iov[2].iov_base : NULL;
+}
+
+TEST(test_propose_owned_zero_copy) {
+    raft_timer_seed(42);
+    clear_messages();
+
+    raft_config_t config = {
+        .node_id = 0,
+        .num_nodes = 3,
+        .send_fn = capture_send,
+        .sendv_fn = capture_sendv,
+    };
+    raft_node_t* node = raft_create(&config);
+    raft_start(node);
+    raft_reset_election_timer(node);
+    make_leader(node);
+
+    size_t len = 64 * 1024;
+    char* cmd = malloc(len);
+    memset(cmd, 'z', len);
+
+    uint64_t index;
+    assert(raft_propose_owned(node, cmd, len, &index) == RAFT_OK);
+    assert(index == 1);
+
+    /* Log and wire both reference the caller's buffer */
+    const raft_entry_t* entry = raft_log_get(node->log, 1);
+    assert(entry->command == cmd);
+    assert(gather_payload == cmd);
+    assert(gather_total == sizeof(raft_append_entries_t) + 12 + len);
+
+    /* Owned proposal fails cleanly when not leader; caller keeps buffer */
+    raft_step_down(node, node->persistent.current_term + 1);
+    char* again = malloc(16);
+    assert(raft_propose_owned(node, again, 16, NULL) == RAFT_NOT_LEADER);
+    free(again);
+
+    raft_destroy(node);
+}
+
+/* Test 12: Conflict hints let the leader skip a whole term */
+TEST(test_conflict_hint_skips_term) {
+    raft_timer_seed(42);
+    clear_messages();
+
+    raft_node_t* leader = create_test_node(0, 3);
+    raft_node_t* follower = create_test_node(1, 3);
+
+    /* Follower holds a stale term-1 tail the leader never had */
+    for (int i = 0; i < 3; i++) raft_log_append(follower->log, 1, "old", 3, NULL);
+    for (int i = 0; i < 5; i++) raft_log_append(follower->log, 2, "stale", 5, NULL);
+
+    /* Leader: same term-1 prefix, then term 3 */
+    for (int i = 0; i < 3; i++) raft_log_append(leader->log, 1, "old", 3, NULL);
+    for (int i = 0; i < 5; i++) raft_log_append(leader->log, 3, "new", 3, NULL);
+    leader->persistent.current_term = 3;
+    raft_become_leader(leader);
+    leader->persistent.current_term = 4;
+
+    clear_messages();
+    raft_replicate_to_peer(leader, 1);
+    assert(msg_count == 1);
+
+    raft_append_entries_response_t response;
+    raft_handle_append_entries_with_log(follower, messages[0].data,
+                                         messages[0].len, &response);
+    assert(response.success == false);
+    assert(response.conflict_term == 2);
+    assert(response.conflict_index == 4);
+
+    /* One round trip jumps back past the entire conflicting term */
+    raft_handle_append_entries_response(leader, 1, &response);
+    assert(leader->leader_state.next_index[1] == 4);
+
+    raft_destroy(leader);
+    raft_destroy(follower);
+}
+
+/* Test 13: A short message only acknowledges the entries it held */
+TEST(test_truncated_append_acks_parsed) {
+    raft_timer_seed(42);
+    clear_messages();
+
+    raft_node_t* leader = create_test_node(0, 3);
+    raft_node_t* follower = create_test_node(1, 3);
+
+    /* Follower agrees on entry 1, then holds a stale term-1 tail */
+    for (int i = 0; i < 3; i++) raft_log_append(follower->log, 1, "old", 3, NULL);
+    raft_log_append(leader->log, 1, "old", 3, NULL);
+    raft_log_append(leader->log, 2, "new", 3, NULL);
+    raft_log_append(leader->log, 2, "new", 3, NULL);
+    leader->persistent.current_term = 2;
+    raft_become_leader(leader);
+
+    clear_messages();
+    leader->leader_state.next_index[1] = 1;
+    raft_replicate_to_peer(leader, 1);
+    assert(msg_count == 1);
+    raft_append_entries_t* request = (raft_append_entries_t*)messages[0].data;
+    assert(request->entries_count == 3);
+
+    /* Cut the last two entries off but leave entries_count claiming them */
+    size_t entry_len = (messages[0].len - sizeof(raft_append_entries_t)) / 3;
+    raft_append_entries_response_t response;
+    raft_handle_append_entries_with_log(follower, messages[0].data,
+                                         messages[0].len - 2 * entry_len, &response);
+    assert(response.success == true);
+    assert(response.match_index == 1);
+    assert(follower->verified_index == 1);
+
+    raft_destroy(leader);
+    raft_destroy(follower);
+}
+
+/* Test 14: An entry whose payload cannot be read back ends the batch */
+static raft_status_t failing_loader(void* ctx, uint64_t index, uint64_t term,
+                                    char** command, size_t* command_len) {
+    (void)term;
+    if (index == *(uint64_t*)ctx) return RAFT_IO_ERROR;
+    *command = malloc(200);
+    memset(*command, (int)index, 200);
+    *command_len = 200;
+    return RAFT_OK;
+}
+
+TEST(test_unloadable_entry_ends_batch) {
+    raft_timer_seed(42);
+    clear_messages();
+
+    raft_node_t* leader = create_test_node(0, 3);
+    raft_node_t* follower = create_test_node(1, 3);
+
+    char cmd[200];
+    for (int i = 1; i <= 4; i++) {
+        memset(cmd, i, sizeof(cmd));
+        raft_log_append(leader->log, 1, cmd, sizeof(cmd), NULL);
+    }
+    leader->persistent.current_term = 1;
+    raft_become_leader(leader);
+
+    uint64_t broken = 3;
+    raft_log_set_loader(leader->log, failing_loader, &broken);
+    raft_log_evict(leader->log, 4, 0);
+
+    /* Only the entries before the broken one go out */
+    clear_messages();
+    leader->leader_state.next_index[1] = 1;
+    raft_replicate_to_peer(leader, 1);
+    assert(msg_count == 1);
+    raft_append_entries_t* request = (raft_append_entries_t*)messages[0].data;
+    assert(request->entries_count == 2);
+    assert(messages[0].len == sizeof(raft_append_entries_t) + 2 * (12 + sizeof(cmd)));
+
+    raft_append_entries_response_t response;
+    raft_handle_append_entries_with_log(follower, messages[0].data,
+                                         messages[0].len, &response);
+    assert(response.success == true);
+    assert(response.match_index == 2);
+    assert(raft_log_last_index(follower->log) == 2);
+    assert(raft_log_get(follower->log, 2)->command[0] == 2);
+
+    /* The gather path stops at the same place */
+    leader->sendv_fn = capture_sendv;
+    raft_replicate_to_peer(leader, 1);
+    assert(gather_total == sizeof(raft_append_entries_t) + 2 * (12 + sizeof(cmd)));
+
+    /* Nothing is sent past it until it loads again */
+    broken = 0;
+    raft_log_evict(leader->log, 4, 0);
+    raft_replicate_to_peer(leader, 1);
+    assert(gather_total == sizeof(raft_append_entries_t) + 4 * (12 + sizeof(cmd)));
+
+    raft_destroy(leader);
+    raft_destroy(follower);
+}
+
 int main(void) {
     printf("Phase 3: Log Replication Tests\n");
     printf("==============================\n\n");
@@ -423,6 +612,10 @@ int main(void) {
     RUN_TEST(test_follower_updates_commit_index);
     RUN_TEST(test_three_node_replication);
     RUN_TEST(test_propose_and_commit);
+    RUN_TEST(test_propose_owned_zero_copy);
+    RUN_TEST(test_conflict_hint_skips_term);
+    RUN_TEST(test_truncated_append_acks_parsed);
+    RUN_TEST(test_unloadable_entry_ends_batch);
 
     printf("\n==============================\n");
     printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
@@ -12,10 +12,12 @@
 #include "../src/election.h"
 #include "../src/timer.h"
 #include "../src/storage.h"
+#include "../src/wal.h"
 #include "../src/snapshot.h"
 #include "../src/recovery.h"
 #include "../src/crc32.h"
 #include "../src/rpc.h"
+#include "../src/replication.h"
 #include "../src/param.h"
 
 static int tests_run = 0;
@@ -39,17 +41,25 @@ static char* make_test_dir(void) {
     return dir;
 }
 
+/* Backend the generic tests run on */
+static raft_storage_backend_t backend = RAFT_STORAGE_FILE;
+
+static raft_storage_t* open_storage(const char* dir, bool sync_writes) {
+    return raft_storage_open_backend(dir, sync_writes, backend);
+}
+
 static void remove_dir(const char* dir) {
     char cmd[256];
     snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
     system(cmd);
+    raft_storage_memory_drop(dir);
 }
 
 /* Test 1: Storage lifecycle - open and close */
 TEST(test_storage_lifecycle) {
     char* dir = make_test_dir();
 
-    raft_storage_t* storage = raft_storage_open(dir, true);
+    raft_storage_t* storage = open_storage(dir, true);
     assert(storage != NULL);
     assert(raft_storage_get_dir(storage) != NULL);
     assert(strcmp(raft_storage_get_dir(storage), dir) == 0);
@@ -63,7 +73,7 @@ TEST(test_storage_lifecycle) {
 TEST(test_save_and_load_state) {
     char* dir = make_test_dir();
 
-    raft_storage_t* storage = raft_storage_open(dir, true);
+    raft_storage_t* storage = open_storage(dir, true);
     assert(storage != NULL);
 
     raft_status_t status = raft_storage_save_state(storage, 42, 3);
@@ -85,7 +95,7 @@ TEST(test_save_and_load_state) {
 TEST(test_save_and_load_log) {
     char* dir = make_test_dir();
 
-    raft_storage_t* storage = raft_storage_open(dir, true);
+    raft_storage_t* storage = open_storage(dir, true);
     assert(storage != NULL);
 
     raft_entry_t entry1 = { .term = 1, .index = 1, .command = "cmd1", .command_len = 4 };
@@ -116,6 +126,7 @@ TEST(test_recovery_empty) {
         .send_fn = NULL,
         .user_data = NULL,
         .data_dir = dir,
+        .storage_backend = backend,
     };
 
     raft_node_t* node = raft_create(&config);
@@ -140,6 +151,7 @@ TEST(test_recovery_with_state) {
             .node_id = 0,
             .num_nodes = 3,
             .data_dir = dir,
+            .storage_backend = backend,
         };
 
         raft_node_t* node = raft_create(&config);
@@ -161,6 +173,7 @@ TEST(test_recovery_with_state) {
             .node_id = 0,
             .num_nodes = 3,
             .data_dir = dir,
+            .storage_backend = backend,
         };
 
         raft_node_t* node = raft_create(&config);
@@ -176,6 +189,16 @@ TEST(test_recovery_with_state) {
     free(dir);
 }
 
+/* Save hard state and compact away the WAL record holding it, which
+ * moves it to raft_state.dat */
+static void save_state_to_file(raft_storage_t* storage, uint64_t term,
+                               int32_t voted_for, uint64_t index) {
+    raft_entry_t entry = { .term = term, .index = index, .type = RAFT_ENTRY_COMMAND };
+    assert(raft_storage_save_state(storage, term, voted_for) == RAFT_OK);
+    assert(raft_storage_append_entry(storage, &entry) == RAFT_OK);
+    assert(raft_storage_compact_log(storage, index) == RAFT_OK);
+}
+
 /* Test 6: CRC32 corruption detection */
 TEST(test_corruption_detection) {
     char* dir = make_test_dir();
@@ -183,7 +206,7 @@ TEST(test_corruption_detection) {
     raft_storage_t* storage = raft_storage_open(dir, true);
     assert(storage != NULL);
 
-    raft_storage_save_state(storage, 100, 5);
+    save_state_to_file(storage, 100, 5, 1);
     raft_storage_close(storage);
 
     char path[256];
@@ -215,7 +238,7 @@ TEST(test_truncated_file) {
     raft_storage_t* storage = raft_storage_open(dir, true);
     assert(storage != NULL);
 
-    raft_storage_save_state(storage, 50, 2);
+    save_state_to_file(storage, 50, 2, 1);
     raft_storage_close(storage);
 
     char path[256];
@@ -244,6 +267,7 @@ TEST(test_multiple_restarts) {
             .node_id = 0,
             .num_nodes = 3,
             .data_dir = dir,
+            .storage_backend = backend,
         };
 
         raft_node_t* node = raft_create(&config);
@@ -269,7 +293,7 @@ TEST(test_multiple_restarts) {
 TEST(test_log_truncation) {
     char* dir = make_test_dir();
 
-    raft_storage_t* storage = raft_storage_open(dir, true);
+    raft_storage_t* storage = open_storage(dir, true);
     assert(storage != NULL);
 
     raft_entry_t entry1 = { .term = 1, .index = 1, .command = "cmd1", .command_len = 4 };
@@ -334,6 +358,911 @@ TEST(test_phase3_regression) {
     raft_destroy(node);
 }
 
+static int applied_count = 0;
+
+static void count_apply(raft_node_t* node, const raft_entry_t* entry, void* user_data) {
+    (void)node; (void)entry; (void)user_data;
+    applied_count++;
+}
+
+/* Test 11: Payloads beyond the memory budget are evicted and re-read from the WAL */
+TEST(test_memory_budget_eviction) {
+    char* dir = make_test_dir();
+    applied_count = 0;
+
+    raft_config_t config = {
+        .node_id = 0,
+        .num_nodes = 1,
+        .apply_fn = count_apply,
+        .data_dir = dir,
+        .storage_backend = backend,
+        .log_memory_budget = 64 * 1024,
+    };
+
+    raft_node_t* node = raft_create(&config);
+    assert(node != NULL);
+    raft_start(node);
+
+    size_t len = 32 * 1024;
+    char* cmd = malloc(len);
+    for (int i = 1; i <= 8; i++) {
+        memset(cmd, 'a' + i, len);
+        uint64_t index;
+        assert(raft_propose(node, cmd, len, &index) == RAFT_OK);
+        raft_apply_committed(node);
+    }
+    assert(applied_count == 8);
+
+    raft_log_memory_t mem;
+    raft_log_memory(node->log, &mem);
+    assert(mem.resident_bytes <= config.log_memory_budget);
+    assert(mem.evictions >= 6);
+
+    /* A lagging reader still gets the original bytes */
+    const raft_entry_t* entry = raft_log_get(node->log, 2);
+    assert(entry != NULL);
+    assert(entry->command_len == len);
+    assert(entry->command[0] == 'a' + 2 && entry->command[len - 1] == 'a' + 2);
+    raft_log_memory(node->log, &mem);
+    assert(mem.reloads == 1);
+
+    free(cmd);
+    raft_destroy(node);
+    remove_dir(dir);
+    free(dir);
+}
+
+/* Test 12: Group commit shares one sync across a window of appends */
+TEST(test_group_commit) {
+    char* dir = make_test_dir();
+
+    raft_storage_t* storage = open_storage(dir, true);
+    assert(storage != NULL);
+    assert(raft_storage_set_group_commit(storage, 60 * 1000000ULL) == RAFT_OK);
+
+    raft_entry_t entries[3] = {
+        { .term = 1, .index = 1, .command = "cmd1", .command_len = 4 },
+        { .term = 1, .index = 2, .command = "cmd2", .command_len = 4 },
+        { .term = 1, .index = 3, .command = "cmd3", .command_len = 4 },
+    };
+    assert(raft_storage_append_entries(storage, entries, 2) == RAFT_OK);
+    assert(raft_storage_append_entry(storage, &entries[2]) == RAFT_OK);
+
+    /* Written but not yet synced; the window has not run out */
+    assert(raft_storage_durable_index(storage) == 0);
+    assert(raft_storage_sync_if_due(storage) == RAFT_OK);
+    assert(raft_storage_durable_index(storage) == 0);
+
+    assert(raft_storage_sync(storage) == RAFT_OK);
+    assert(raft_storage_durable_index(storage) == 3);
+    raft_storage_close(storage);
+
+    /* A leader only commits its own entries once they are durable */
+    raft_config_t config = {
+        .node_id = 0,
+        .num_nodes = 1,
+        .data_dir = dir,
+        .storage_backend = backend,
+        .group_commit_us = 2000,
+    };
+    raft_node_t* node = raft_create(&config);
+    assert(node != NULL);
+    raft_start(node);
+    assert(node->volatile_state.commit_index == 3);
+
+    uint64_t index;
+    assert(raft_propose(node, "cmd4", 4, &index) == RAFT_OK);
+    assert(raft_propose(node, "cmd5", 4, &index) == RAFT_OK);
+    assert(index == 5);
+    assert(node->volatile_state.commit_index == 3);
+
+    usleep(3000);
+    raft_tick(node, 0);
+    assert(node->volatile_state.commit_index == 5);
+
+    raft_destroy(node);
+    remove_dir(dir);
+    free(dir);
+}
+
+static bool segment_exists(const char* dir, const char* name) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    return access(path, F_OK) == 0;
+}
+
+static void append_sized(raft_storage_t* storage, uint64_t first, uint64_t last,
+                         uint64_t term) {
+    char cmd[100];
+    for (uint64_t i = first; i <= last; i++) {
+        memset(cmd, (int)('a' + i % 26), sizeof(cmd));
+        raft_entry_t entry = { .term = term, .index = i, .command = cmd,
+                               .command_len = sizeof(cmd) };
+        assert(raft_storage_append_entry(storage, &entry) == RAFT_OK);
+    }
+}
+
+/* Test 13: WAL segments roll, recycle and truncate */
+TEST(test_wal_segments) {
+    char* dir = make_test_dir();
+
+    raft_storage_t* storage = raft_storage_open(dir, true);
+    assert(storage != NULL);
+
+    /* 16-byte header + 3 records of 128 bytes fit in 512 */
+    assert(raft_storage_set_segment_size(storage, 512) == RAFT_OK);
+    append_sized(storage, 1, 10, 1);
+    assert(segment_exists(dir, "raft_wal_00000000000000000001.seg"));
+    assert(segment_exists(dir, "raft_wal_00000000000000000004.seg"));
+    assert(segment_exists(dir, "raft_wal_00000000000000000007.seg"));
+    assert(segment_exists(dir, "raft_wal_00000000000000000010.seg"));
+
+    /* Only segments entirely covered go; the first is kept as a spare */
+    uint64_t base_index, base_term, count;
+    assert(raft_storage_compact_log(storage, 5) == RAFT_OK);
+    raft_storage_get_log_info(storage, &base_index, &base_term, &count);
+    assert(base_index == 3 && count == 7);
+    assert(!segment_exists(dir, "raft_wal_00000000000000000001.seg"));
+    assert(segment_exists(dir, "raft_wal_spare_0.seg"));
+
+    /* Suffix truncation deletes later segments and cuts the one holding
+     * the cut point */
+    assert(raft_storage_truncate_log(storage, 7) == RAFT_OK);
+    assert(!segment_exists(dir, "raft_wal_00000000000000000010.seg"));
+    raft_storage_get_log_info(storage, &base_index, &base_term, &count);
+    assert(count == 4);
+    raft_entry_t entry;
+    assert(raft_storage_read_entry(storage, 8, &entry) == RAFT_NOT_FOUND);
+
+    /* The next segment reuses the spare */
+    append_sized(storage, 8, 12, 2);
+    assert(!segment_exists(dir, "raft_wal_spare_0.seg"));
+    assert(segment_exists(dir, "raft_wal_00000000000000000010.seg"));
+    raft_storage_close(storage);
+
+    storage = raft_storage_open(dir, true);
+    assert(storage != NULL);
+    raft_storage_get_log_info(storage, &base_index, &base_term, &count);
+    assert(base_index == 3 && count == 9);
+    assert(raft_storage_read_entry(storage, 8, &entry) == RAFT_OK);
+    assert(entry.term == 2 && entry.command_len == 100 && entry.command[0] == 'a' + 8);
+    free(entry.command);
+    raft_storage_close(storage);
+
+    /* A torn last record is cut off at open; after a crash there is no
+     * checkpoint covering it */
+    char path[256];
+    snprintf(path, sizeof(path), "%s/raft_wal.ckpt", dir);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/raft_wal_00000000000000000010.seg", dir);
+    FILE* f = fopen(path, "r+b");
+    assert(f != NULL);
+    fseek(f, 16 + 2 * 128 + 28, SEEK_SET);
+    fputc('!', f);
+    fclose(f);
+
+    storage = raft_storage_open(dir, true);
+    assert(storage != NULL);
+    raft_storage_get_log_info(storage, &base_index, &base_term, &count);
+    assert(count == 8);
+    assert(raft_storage_read_entry(storage, 12, &entry) == RAFT_NOT_FOUND);
+    append_sized(storage, 12, 12, 2);
+    assert(raft_storage_read_entry(storage, 12, &entry) == RAFT_OK);
+    free(entry.command);
+
+    raft_storage_close(storage);
+    remove_dir(dir);
+    free(dir);
+}
+
+/* Test 14: Offset index serves truncation and reads directly */
+TEST(test_wal_offset_index) {
+    char* dir = make_test_dir();
+
+    raft_storage_t* storage = open_storage(dir, true);
+    assert(storage != NULL);
+    assert(raft_storage_set_segment_size(storage, 512) == RAFT_OK);
+    append_sized(storage, 1, 10, 1);
+
+    /* A range spanning three segments */
+    raft_entry_t entries[10];
+    void* data;
+    assert(raft_storage_read_range(storage, 2, 9, entries, &data) == RAFT_OK);
+    for (uint64_t i = 0; i < 8; i++) {
+        assert(entries[i].index == i + 2);
+        assert(entries[i].command_len == 100);
+        assert(entries[i].command[99] == (char)('a' + (i + 2) % 26));
+    }
+    free(data);
+    assert(raft_storage_read_range(storage, 5, 11, entries, &data) == RAFT_NOT_FOUND);
+
+    /* Cut in the middle of a segment */
+    assert(raft_storage_truncate_log(storage, 5) == RAFT_OK);
+    raft_entry_t entry;
+    assert(raft_storage_read_entry(storage, 6, &entry) == RAFT_NOT_FOUND);
+    assert(raft_storage_read_entry(storage, 5, &entry) == RAFT_OK);
+    assert(entry.index == 5 && entry.command[0] == 'a' + 5);
+    free(entry.command);
+    append_sized(storage, 6, 7, 2);
+    raft_storage_close(storage);
+
+    /* The index is rebuilt at open */
+    storage = open_storage(dir, true);
+    assert(storage != NULL);
+    assert(raft_storage_read_range(storage, 1, 7, entries, &data) == RAFT_OK);
+    assert(entries[4].term == 1 && entries[5].term == 2 && entries[6].index == 7);
+    free(data);
+
+    raft_storage_close(storage);
+    remove_dir(dir);
+    free(dir);
+}
+
+/* Test 15: io_uring backend queues appends and reports completions */
+TEST(test_uring_backend) {
+    char* dir = make_test_dir();
+
+    raft_storage_t* storage = raft_storage_open_io(dir, true, RAFT_IO_URING);
+    assert(storage != NULL);
+    if (raft_storage_io_backend(storage) != RAFT_IO_URING) {
+        /* Kernel without io_uring: the blocking backend stands in */
+        printf("(io_uring unavailable) ");
+    }
+
+    append_sized(storage, 1, 20, 1);
+    for (int i = 0; i < 1000 && raft_storage_durable_index(storage) < 20; i++) {
+        assert(raft_storage_poll(storage) == RAFT_OK);
+        usleep(1000);
+    }
+    assert(raft_storage_durable_index(storage) == 20);
+
+    /* Reads and truncation see every queued write */
+    append_sized(storage, 21, 25, 2);
+    raft_entry_t entry;
+    assert(raft_storage_read_entry(storage, 25, &entry) == RAFT_OK);
+    assert(entry.term == 2);
+    free(entry.command);
+    assert(raft_storage_truncate_log(storage, 22) == RAFT_OK);
+    assert(raft_storage_durable_index(storage) == 22);
+    raft_storage_close(storage);
+
+    storage = raft_storage_open(dir, true);
+    uint64_t base_index, base_term, count;
+    raft_storage_get_log_info(storage, &base_index, &base_term, &count);
+    assert(count == 22);
+    raft_storage_close(storage);
+
+    /* A single-node leader commits once the queued sync completes */
+    raft_config_t config = {
+        .node_id = 0,
+        .num_nodes = 1,
+        .data_dir = dir,
+        .io_backend = RAFT_IO_URING,
+    };
+    raft_node_t* node = raft_create(&config);
+    assert(node != NULL);
+    raft_start(node);
+    uint64_t index;
+    assert(raft_propose(node, "cmd", 3, &index) == RAFT_OK);
+    assert(index == 23);
+    for (int i = 0; i < 1000 && node->volatile_state.commit_index < 23; i++) {
+        usleep(1000);
+        raft_tick(node, 0);
+    }
+    assert(node->volatile_state.commit_index == 23);
+
+    raft_destroy(node);
+    remove_dir(dir);
+    free(dir);
+}
+
+/* Number of mappings of files under dir in this process */
+static int mapping_count(const char* dir) {
+    FILE* f = fopen("/proc/self/maps", "r");
+    if (!f) return -1;
+    char line[512];
+    int count = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (strstr(line, dir)) count++;
+    }
+    fclose(f);
+    return count;
+}
+
+/* Test 16: Recovered payloads point into the WAL mapping until compacted */
+TEST(test_mapped_recovery) {
+    char* dir = make_test_dir();
+
+    raft_storage_t* storage = raft_storage_open(dir, true);
+    assert(storage != NULL);
+    append_sized(storage, 1, 10, 1);
+    raft_storage_close(storage);
+
+    raft_config_t config = { .node_id = 0, .num_nodes = 3, .data_dir = dir };
+    raft_node_t* node = raft_create(&config);
+    assert(node != NULL);
+    assert(raft_log_last_index(node->log) == 10);
+    for (uint64_t i = 1; i <= 10; i++) {
+        const raft_entry_t* entry = raft_log_get(node->log, i);
+        assert(entry != NULL && entry->command_len == 100);
+        assert(entry->command[0] == (char)('a' + i % 26));
+        assert(entry->command[99] == (char)('a' + i % 26));
+    }
+    int maps = mapping_count(dir);
+    if (maps >= 0) {
+        assert(maps == 1);
+
+        /* The last entry keeps the mapping alive */
+        assert(raft_log_truncate_before(node->log, 10) == RAFT_OK);
+        assert(mapping_count(dir) == 1);
+        assert(raft_log_get(node->log, 10)->command[50] == (char)('a' + 10));
+        assert(raft_log_truncate_before(node->log, 11) == RAFT_OK);
+        assert(mapping_count(dir) == 0);
+    }
+
+    raft_destroy(node);
+    remove_dir(dir);
+    free(dir);
+}
+
+static raft_status_t count_entries_cb(void* ctx, uint64_t term, uint64_t index,
+                                      raft_buf_t* owner, const char* command,
+                                      size_t command_len) {
+    (void)term; (void)index; (void)owner; (void)command; (void)command_len;
+    (*(uint64_t*)ctx)++;
+    return RAFT_OK;
+}
+
+/* Test 17: Open trusts the WAL checkpoint and scans only the tail */
+TEST(test_wal_checkpoint) {
+    char* dir = make_test_dir();
+    char ckpt[256];
+    snprintf(ckpt, sizeof(ckpt), "%s/raft_wal.ckpt", dir);
+
+    raft_storage_t* storage = raft_storage_open(dir, true);
+    assert(storage != NULL);
+    assert(raft_storage_set_segment_size(storage, 512) == RAFT_OK);
+    append_sized(storage, 1, 10, 1);
+    raft_storage_close(storage);
+
+    /* Keep the checkpoint from this close */
+    char saved[256];
+    FILE* f = fopen(ckpt, "rb");
+    assert(f != NULL);
+    size_t saved_len = fread(saved, 1, sizeof(saved), f);
+    fclose(f);
+    assert(saved_len > 0 && saved_len < sizeof(saved));
+
+    /* Records written after the checkpoint are found by the tail scan */
+    storage = raft_storage_open(dir, true);
+    append_sized(storage, 11, 12, 1);
+    raft_storage_close(storage);
+    f = fopen(ckpt, "wb");
+    assert(f != NULL);
+    fwrite(saved, 1, saved_len, f);
+    fclose(f);
+
+    storage = raft_storage_open(dir, true);
+    uint64_t base_index, base_term, count;
+    raft_storage_get_log_info(storage, &base_index, &base_term, &count);
+    assert(count == 12);
+    uint64_t seen = 0;
+    assert(raft_storage_iterate_log_mapped(storage, count_entries_cb, &seen) == RAFT_OK);
+    assert(seen == 12);
+
+    /* Cutting checkpointed records deletes the checkpoint first */
+    assert(raft_storage_truncate_log(storage, 5) == RAFT_OK);
+    assert(access(ckpt, F_OK) != 0);
+    raft_storage_close(storage);
+    assert(access(ckpt, F_OK) == 0);
+
+    /* Checkpointed segments aren't scanned at open; the recovery pass
+     * checks their CRCs */
+    char path[256];
+    snprintf(path, sizeof(path), "%s/raft_wal_00000000000000000004.seg", dir);
+    f = fopen(path, "r+b");
+    assert(f != NULL);
+    fseek(f, 16 + 28 + 10, SEEK_SET);
+    fputc('!', f);
+    fclose(f);
+
+    storage = raft_storage_open(dir, true);
+    raft_storage_get_log_info(storage, &base_index, &base_term, &count);
+    assert(count == 5);
+    seen = 0;
+    assert(raft_storage_iterate_log_mapped(storage, count_entries_cb, &seen) == RAFT_CORRUPTION);
+    assert(seen == 3);
+
+    raft_storage_close(storage);
+    remove_dir(dir);
+    free(dir);
+}
+
+/* Test 18: Parallel CRC checks still deliver records in order */
+TEST(test_parallel_verification) {
+    char* dir = make_test_dir();
+
+    /* Several verification tasks' worth of records in one segment */
+    raft_storage_t* storage = raft_storage_open(dir, false);
+    assert(storage != NULL);
+    append_sized(storage, 1, 10000, 1);
+    raft_storage_close(storage);
+
+    /* Damage record 7000: 16-byte header, 128-byte records */
+    char path[256];
+    snprintf(path, sizeof(path), "%s/raft_wal_00000000000000000001.seg", dir);
+    FILE* f = fopen(path, "r+b");
+    assert(f != NULL);
+    fseek(f, 16 + 6999 * 128 + 28 + 50, SEEK_SET);
+    fputc('!', f);
+    fclose(f);
+
+    size_t threads[] = { 1, 4 };
+    for (size_t i = 0; i < 2; i++) {
+        storage = raft_storage_open(dir, false);
+        assert(raft_storage_set_recovery_threads(storage, threads[i]) == RAFT_OK);
+        uint64_t count = 0;
+        assert(raft_storage_iterate_log_mapped(storage, count_entries_cb, &count) ==
+               RAFT_CORRUPTION);
+        assert(count == 6999);
+        raft_storage_close(storage);
+    }
+
+    /* Recovery rebuilds the log from the records before it */
+    raft_config_t config = { .node_id = 0, .num_nodes = 3, .data_dir = dir,
+                             .recovery_threads = 4 };
+    raft_node_t* node = raft_create(&config);
+    assert(node != NULL);
+    assert(raft_log_last_index(node->log) == 6999);
+    assert(raft_log_get(node->log, 6999)->command[0] == (char)('a' + 6999 % 26));
+
+    raft_destroy(node);
+    remove_dir(dir);
+    free(dir);
+}
+
+/* Test 19: CRC32C implementations agree; CRC32 segments stay readable */
+TEST(test_crc32c_format) {
+    assert(crc32("123456789", 9) == 0xCBF43926);
+    assert(crc32c("123456789", 9) == 0xE3069283);
+    assert(crc32c_update_sw(0, "123456789", 9) == 0xE3069283);
+
+    /* Lengths and alignments around the hardware path's block sizes */
+    static unsigned char buf[60000];
+    for (size_t i = 0; i < sizeof(buf); i++) buf[i] = (unsigned char)(i * 131 + (i >> 7));
+    size_t lengths[] = { 0, 1, 7, 8, 9, 63, 767, 768, 769, 24575, 24576, 24577, 59990 };
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        for (size_t off = 0; off < 8; off++) {
+            assert(crc32c_update(0x1234, buf + off, lengths[i]) ==
+                   crc32c_update_sw(0x1234, buf + off, lengths[i]));
+        }
+    }
+    assert(crc32c_update(crc32c(buf, 1000), buf + 1000, 5000) == crc32c(buf, 6000));
+
+    /* A version 2 segment (CRC32 records) from before the switch */
+    char* dir = make_test_dir();
+    char path[256];
+    snprintf(path, sizeof(path), "%s/raft_wal_00000000000000000001.seg", dir);
+    FILE* f = fopen(path, "wb");
+    assert(f != NULL);
+    uint32_t magic = RAFT_WAL_MAGIC;
+    uint32_t version = RAFT_WAL_VERSION_CRC32;
+    uint64_t first_index = 1;
+    fwrite(&magic, 4, 1, f);
+    fwrite(&version, 4, 1, f);
+    fwrite(&first_index, 8, 1, f);
+    for (uint64_t i = 1; i <= 3; i++) {
+        char rec[28 + 4];
+        uint32_t record_len = sizeof(rec);
+        uint64_t term = 1;
+        uint32_t cmd_len = 4;
+        memcpy(rec, &record_len, 4);
+        memcpy(rec + 8, &term, 8);
+        memcpy(rec + 16, &i, 8);
+        memcpy(rec + 24, &cmd_len, 4);
+        memcpy(rec + 28, "old!", 4);
+        uint32_t crc = crc32(rec + 8, 20 + 4);
+        memcpy(rec + 4, &crc, 4);
+        fwrite(rec, sizeof(rec), 1, f);
+    }
+    fclose(f);
+
+    raft_storage_t* storage = raft_storage_open(dir, true);
+    assert(storage != NULL);
+    uint64_t base_index, base_term, count;
+    raft_storage_get_log_info(storage, &base_index, &base_term, &count);
+    assert(count == 3);
+    raft_entry_t entry;
+    assert(raft_storage_read_entry(storage, 2, &entry) == RAFT_OK);
+    assert(entry.command_len == 4 && memcmp(entry.command, "old!", 4) == 0);
+    free(entry.command);
+
+    /* New records go to a new CRC32C segment */
+    append_sized(storage, 4, 5, 2);
+    assert(segment_exists(dir, "raft_wal_00000000000000000004.seg"));
+    raft_storage_close(storage);
+
+    storage = raft_storage_open(dir, true);
+    raft_storage_get_log_info(storage, &base_index, &base_term, &count);
+    assert(count == 5);
+    uint64_t seen = 0;
+    assert(raft_storage_iterate_log_mapped(storage, count_entries_cb, &seen) == RAFT_OK);
+    assert(seen == 5);
+
+    raft_storage_close(storage);
+    remove_dir(dir);
+    free(dir);
+}
+
+/* Test 20: State file slots are updated in place and survive a torn write */
+TEST(test_state_slots) {
+    char* dir = make_test_dir();
+    char path[256];
+    snprintf(path, sizeof(path), "%s/raft_state.dat", dir);
+
+    /* A version 1 file is still read, then upgraded in place */
+    struct {
+        uint32_t magic, version, crc;
+        uint64_t term;
+        int32_t voted_for;
+        uint32_t pad;
+    } __attribute__((packed)) old = { RAFT_STATE_MAGIC, RAFT_STATE_VERSION_V1, 0, 7, 1, 0 };
+    old.crc = crc32(&old.term, sizeof(old.term) + sizeof(old.voted_for));
+    FILE* f = fopen(path, "wb");
+    fwrite(&old, sizeof(old), 1, f);
+    fclose(f);
+
+    raft_storage_t* storage = raft_storage_open(dir, true);
+    uint64_t term;
+    int32_t voted_for;
+    assert(raft_storage_load_state(storage, &term, &voted_for) == RAFT_OK);
+    assert(term == 7 && voted_for == 1);
+
+    struct stat before, after;
+    save_state_to_file(storage, 8, 2, 1);
+    stat(path, &before);
+    assert(before.st_size == 2 * RAFT_STATE_SLOT_SIZE);
+    for (uint64_t t = 9; t <= 20; t++) {
+        save_state_to_file(storage, t, (int32_t)(t % 3), t - 7);
+    }
+    stat(path, &after);
+    assert(after.st_ino == before.st_ino);
+    assert(after.st_size == before.st_size);
+    raft_storage_close(storage);
+
+    /* 13 saves after the version 1 slot: term 20 ended up in slot 1 */
+    storage = raft_storage_open(dir, true);
+    assert(raft_storage_load_state(storage, &term, &voted_for) == RAFT_OK);
+    assert(term == 20 && voted_for == 2);
+    raft_storage_close(storage);
+
+    /* Tear the newest slot; the previous state is still there */
+    f = fopen(path, "r+b");
+    fseek(f, RAFT_STATE_SLOT_SIZE + 12, SEEK_SET);
+    uint64_t bad_term = 999;
+    fwrite(&bad_term, sizeof(bad_term), 1, f);
+    fclose(f);
+
+    storage = raft_storage_open(dir, true);
+    assert(raft_storage_load_state(storage, &term, &voted_for) == RAFT_OK);
+    assert(term == 19 && voted_for == 1);
+
+    /* The next save overwrites the torn slot, not the good one */
+    save_state_to_file(storage, 21, 0, 14);
+    raft_storage_close(storage);
+    storage = raft_storage_open(dir, true);
+    assert(raft_storage_load_state(storage, &term, &voted_for) == RAFT_OK);
+    assert(term == 21 && voted_for == 0);
+
+    raft_storage_close(storage);
+    remove_dir(dir);
+    free(dir);
+}
+
+/* Test 21: Term/vote live in the WAL next to the entries */
+TEST(test_wal_hard_state) {
+    char* dir = make_test_dir();
+    char state_path[256];
+    char ckpt_path[256];
+    snprintf(state_path, sizeof(state_path), "%s/raft_state.dat", dir);
+    snprintf(ckpt_path, sizeof(ckpt_path), "%s/raft_wal.ckpt", dir);
+
+    /* Hard-state records between entries leave reads untouched */
+    raft_storage_t* storage = raft_storage_open(dir, true);
+    assert(raft_storage_save_state(storage, 1, 0) == RAFT_OK);
+    append_sized(storage, 1, 3, 1);
+    assert(raft_storage_stage_state(storage, 2, -1) == RAFT_OK);
+    append_sized(storage, 4, 6, 2);
+    assert(raft_storage_stage_state(storage, 2, 1) == RAFT_OK);
+    assert(raft_storage_sync_state(storage) == RAFT_OK);
+    assert(access(state_path, F_OK) != 0);
+
+    raft_entry_t range[6];
+    void* data;
+    assert(raft_storage_read_range(storage, 1, 6, range, &data) == RAFT_OK);
+    for (int i = 0; i < 6; i++) {
+        assert(range[i].index == (uint64_t)i + 1);
+        assert(range[i].command[0] == (char)('a' + (i + 1) % 26));
+    }
+    free(data);
+    raft_storage_close(storage);
+
+    /* Found through the checkpoint, then by scanning without one */
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) unlink(ckpt_path);
+        storage = raft_storage_open(dir, true);
+        uint64_t term;
+        int32_t voted_for;
+        assert(raft_storage_load_state(storage, &term, &voted_for) == RAFT_OK);
+        assert(term == 2 && voted_for == 1);
+        uint64_t seen = 0;
+        assert(raft_storage_iterate_log_mapped(storage, count_entries_cb, &seen) == RAFT_OK);
+        assert(seen == 6);
+        raft_storage_close(storage);
+    }
+
+    /* Cutting the record holding it saves it to the state file first */
+    storage = raft_storage_open(dir, true);
+    assert(raft_storage_stage_state(storage, 3, -1) == RAFT_OK);
+    assert(raft_storage_truncate_log(storage, 5) == RAFT_OK);
+    assert(access(state_path, F_OK) == 0);
+    raft_storage_close(storage);
+
+    storage = raft_storage_open(dir, true);
+    uint64_t term;
+    int32_t voted_for;
+    assert(raft_storage_load_state(storage, &term, &voted_for) == RAFT_OK);
+    assert(term == 3 && voted_for == -1);
+    raft_storage_close(storage);
+
+    /* A follower stepping down takes the term from the WAL on restart */
+    raft_config_t config = { .node_id = 0, .num_nodes = 3, .data_dir = dir };
+    raft_node_t* node = raft_create(&config);
+    assert(node->persistent.current_term == 3);
+    raft_request_vote_t request = {
+        .type = RAFT_MSG_REQUEST_VOTE,
+        .term = 4,
+        .candidate_id = 2,
+        .last_log_index = 5,
+        .last_log_term = 2,
+    };
+    raft_request_vote_response_t response;
+    assert(raft_handle_request_vote(node, &request, &response) == RAFT_OK);
+    assert(response.vote_granted);
+    raft_destroy(node);
+
+    node = raft_create(&config);
+    assert(node->persistent.current_term == 4);
+    assert(node->persistent.voted_for == 2);
+    assert(raft_log_last_index(node->log) == 5);
+    raft_destroy(node);
+    remove_dir(dir);
+    free(dir);
+
+    /* A segment filled with hard state alone is rewritten in place; a new
+     * one would share its first index, and so its file */
+    dir = make_test_dir();
+    storage = raft_storage_open(dir, true);
+    assert(raft_storage_set_segment_size(storage, 4096) == RAFT_OK);
+    append_sized(storage, 1, 3, 1);
+    for (int i = 0; i < 400; i++) {
+        assert(raft_storage_save_state(storage, 10 + (uint64_t)i, i % 3) == RAFT_OK);
+    }
+    append_sized(storage, 4, 5, 409);
+    assert(raft_storage_compact_log(storage, 3) == RAFT_OK);
+    raft_storage_close(storage);
+
+    storage = raft_storage_open(dir, true);
+    uint64_t base, count;
+    assert(raft_storage_get_log_info(storage, &base, NULL, &count) == RAFT_OK);
+    assert(base == 3 && count == 2);
+    raft_entry_t entry;
+    assert(raft_storage_read_entry(storage, 5, &entry) == RAFT_OK);
+    assert(entry.term == 409 && entry.command[0] == (char)('a' + 5));
+    free(entry.command);
+    assert(raft_storage_load_state(storage, &term, &voted_for) == RAFT_OK);
+    assert(term == 409 && voted_for == 399 % 3);
+    raft_storage_close(storage);
+
+    remove_dir(dir);
+    free(dir);
+}
+
+/* Test 22: Each sync policy decides when an append counts as durable */
+TEST(test_sync_policies) {
+    char* dir = make_test_dir();
+    raft_entry_t entries[5] = {
+        { .term = 1, .index = 1, .command = "cmd1", .command_len = 4 },
+        { .term = 1, .index = 2, .command = "cmd2", .command_len = 4 },
+        { .term = 1, .index = 3, .command = "cmd3", .command_len = 4 },
+        { .term = 1, .index = 4, .command = "cmd4", .command_len = 4 },
+        { .term = 1, .index = 5, .command = "cmd5", .command_len = 4 },
+    };
+
+    /* Batch: nothing is synced until an ack or commit asks for it */
+    raft_storage_t* storage = open_storage(dir, true);
+    assert(raft_storage_set_sync_policy(storage, RAFT_SYNC_BATCH, 0, 0) == RAFT_OK);
+    assert(raft_storage_append_entries(storage, entries, 2) == RAFT_OK);
+    assert(raft_storage_durable_index(storage) == 0);
+    assert(raft_storage_sync_for_ack(storage) == RAFT_OK);
+    assert(raft_storage_durable_index(storage) == 2);
+
+    /* Interval: synced once enough payload has built up, or time passed */
+    assert(raft_storage_set_sync_policy(storage, RAFT_SYNC_INTERVAL, 1000, 8) == RAFT_OK);
+    assert(raft_storage_append_entry(storage, &entries[2]) == RAFT_OK);
+    assert(raft_storage_durable_index(storage) == 2);
+    assert(raft_storage_sync_for_ack(storage) == RAFT_OK);
+    assert(raft_storage_durable_index(storage) == 2);
+    usleep(2000);
+    assert(raft_storage_sync_if_due(storage) == RAFT_OK);
+    assert(raft_storage_durable_index(storage) == 3);
+    assert(raft_storage_set_sync_policy(storage, RAFT_SYNC_INTERVAL, 0, 8) == RAFT_OK);
+    assert(raft_storage_append_entry(storage, &entries[3]) == RAFT_OK);
+    assert(raft_storage_durable_index(storage) == 3);
+    assert(raft_storage_append_entry(storage, &entries[4]) == RAFT_OK);
+    assert(raft_storage_durable_index(storage) == 5);
+    raft_storage_close(storage);
+
+    /* None: written counts as durable straight away */
+    remove_dir(dir);
+    mkdir(dir, 0755);
+    storage = open_storage(dir, true);
+    assert(raft_storage_set_sync_policy(storage, RAFT_SYNC_NONE, 0, 0) == RAFT_OK);
+    assert(raft_storage_sync_policy(storage) == RAFT_SYNC_NONE);
+    assert(raft_storage_append_entries(storage, entries, 4) == RAFT_OK);
+    assert(raft_storage_durable_index(storage) == 4);
+    raft_storage_close(storage);
+    remove_dir(dir);
+    mkdir(dir, 0755);
+
+    /* A batch leader syncs its own entries once a follower's ack would
+     * otherwise commit them */
+    raft_config_t config = {
+        .node_id = 0,
+        .num_nodes = 3,
+        .data_dir = dir,
+        .storage_backend = backend,
+        .sync_policy = RAFT_SYNC_BATCH,
+    };
+    raft_node_t* node = raft_create(&config);
+    raft_start(node);
+    raft_start_election(node);
+    raft_request_vote_response_t vote = {
+        .type = RAFT_MSG_REQUEST_VOTE_RESPONSE,
+        .term = node->persistent.current_term,
+        .vote_granted = true,
+    };
+    raft_handle_request_vote_response(node, 1, &vote);
+    assert(node->role == RAFT_LEADER);
+
+    uint64_t index;
+    assert(raft_propose(node, "cmd", 3, &index) == RAFT_OK);
+    assert(raft_durable_index(node) < index);
+    raft_append_entries_response_t ack = {
+        .type = RAFT_MSG_APPEND_ENTRIES_RESPONSE,
+        .term = node->persistent.current_term,
+        .success = true,
+        .match_index = index,
+    };
+    assert(raft_handle_append_entries_response(node, 1, &ack) == RAFT_OK);
+    assert(raft_durable_index(node) == index);
+    assert(node->volatile_state.commit_index == index);
+    raft_destroy(node);
+
+    remove_dir(dir);
+    free(dir);
+}
+
+static int custom_appends = 0;
+
+static raft_status_t counting_append(void* impl, const raft_entry_t* entries,
+                                     size_t count) {
+    custom_appends += (int)count;
+    return raft_storage_memory_ops.append(impl, entries, count);
+}
+
+/* Test 23: Caller-supplied backend ops take precedence over the built-in choice */
+TEST(test_custom_storage_ops) {
+    char* dir = make_test_dir();
+    raft_storage_ops_t ops = raft_storage_memory_ops;
+    ops.name = "counting";
+    ops.append = counting_append;
+
+    raft_config_t config = {
+        .node_id = 0,
+        .num_nodes = 1,
+        .data_dir = dir,
+        .storage_backend = RAFT_STORAGE_MMAP,
+        .storage_ops = &ops,
+    };
+    raft_node_t* node = raft_create(&config);
+    assert(node != NULL);
+    assert(strcmp(raft_storage_backend_name(node->storage), "counting") == 0);
+    raft_start(node);
+
+    int before = custom_appends;
+    uint64_t index;
+    assert(raft_propose(node, "cmd1", 4, &index) == RAFT_OK);
+    assert(raft_propose(node, "cmd2", 4, &index) == RAFT_OK);
+    assert(custom_appends == before + 2);
+    raft_destroy(node);
+
+    /* Nothing went to disk, yet a restart in this process finds the log */
+    assert(!segment_exists(dir, "raft_mlog.dat"));
+    node = raft_create(&config);
+    assert(node != NULL);
+    assert(raft_log_last_index(node->log) == index);
+    raft_destroy(node);
+
+    remove_dir(dir);
+    free(dir);
+}
+
+/* Test 24: The mmap log grows, sheds its compacted prefix and cuts a torn tail */
+TEST(test_mmap_backend) {
+    char* dir = make_test_dir();
+    raft_storage_t* storage = raft_storage_open_backend(dir, true, RAFT_STORAGE_MMAP);
+    assert(storage != NULL);
+    assert(strcmp(raft_storage_backend_name(storage), "mmap") == 0);
+
+    /* Past the first RAFT_MMAP_GROW_SIZE of file */
+    size_t len = 64 * 1024;
+    char* cmd = malloc(len);
+    for (uint64_t i = 1; i <= 100; i++) {
+        memset(cmd, 'a' + i % 26, len);
+        raft_entry_t entry = { .term = 1, .index = i, .command = cmd, .command_len = len };
+        assert(raft_storage_append_entry(storage, &entry) == RAFT_OK);
+    }
+    assert(raft_storage_durable_index(storage) == 100);
+    assert(raft_storage_save_state(storage, 3, 1) == RAFT_OK);
+
+    /* The dead prefix now outweighs the log, so the file is rewritten */
+    assert(raft_storage_compact_log(storage, 90) == RAFT_OK);
+    char path[256];
+    snprintf(path, sizeof(path), "%s/raft_mlog.dat", dir);
+    struct stat st;
+    assert(stat(path, &st) == 0 && st.st_size == RAFT_MMAP_GROW_SIZE);
+    raft_entry_t entry;
+    assert(raft_storage_read_entry(storage, 90, &entry) == RAFT_NOT_FOUND);
+    assert(raft_storage_read_entry(storage, 91, &entry) == RAFT_OK);
+    assert(entry.command_len == len && entry.command[len - 1] == 'a' + 91 % 26);
+    free(entry.command);
+    raft_storage_close(storage);
+
+    /* Half a record after the last one, as a crash mid-append leaves it */
+    FILE* f = fopen(path, "r+b");
+    assert(f != NULL);
+    fseek(f, 4096 + 10 * ((24 + len + 7) & ~(size_t)7), SEEK_SET);
+    uint64_t torn[3] = { 0xdeadbeef, 1, 101 };
+    fwrite(torn, sizeof(torn), 1, f);
+    fclose(f);
+
+    storage = raft_storage_open_backend(dir, true, RAFT_STORAGE_MMAP);
+    assert(storage != NULL);
+    uint64_t base_index, base_term, count;
+    assert(raft_storage_get_log_info(storage, &base_index, &base_term, &count) == RAFT_OK);
+    assert(base_index == 90 && count == 10);
+    uint64_t term;
+    int32_t voted_for;
+    assert(raft_storage_load_state(storage, &term, &voted_for) == RAFT_OK);
+    assert(term == 3 && voted_for == 1);
+
+    raft_entry_t next = { .term = 3, .index = 101, .command = "cmd", .command_len = 3 };
+    assert(raft_storage_append_entry(storage, &next) == RAFT_OK);
+    raft_storage_close(storage);
+    storage = raft_storage_open_backend(dir, true, RAFT_STORAGE_MMAP);
+    assert(raft_storage_get_log_info(storage, &base_index, &base_term, &count) == RAFT_OK);
+    assert(count == 11);
+    assert(raft_storage_read_entry(storage, 101, &entry) == RAFT_OK);
+    assert(entry.term == 3 && memcmp(entry.command, "cmd", 3) == 0);
+    free(entry.command);
+
+    free(cmd);
+    raft_storage_close(storage);
+    remove_dir(dir);
+    free(dir);
+}
+
 int main(void) {
     printf("Phase 4: Persistence and Recovery Tests\n");
     printf("========================================\n\n");
@@ -348,6 +1277,38 @@ int main(void) {
     RUN_TEST(test_multiple_restarts);
     RUN_TEST(test_log_truncation);
     RUN_TEST(test_phase3_regression);
+    RUN_TEST(test_memory_budget_eviction);
+    RUN_TEST(test_group_commit);
+    RUN_TEST(test_wal_segments);
+    RUN_TEST(test_wal_offset_index);
+    RUN_TEST(test_uring_backend);
+    RUN_TEST(test_mapped_recovery);
+    RUN_TEST(test_wal_checkpoint);
+    RUN_TEST(test_parallel_verification);
+    RUN_TEST(test_crc32c_format);
+    RUN_TEST(test_state_slots);
+    RUN_TEST(test_wal_hard_state);
+    RUN_TEST(test_sync_policies);
+    RUN_TEST(test_custom_storage_ops);
+    RUN_TEST(test_mmap_backend);
+
+    /* The backend-independent tests again on the other built-in backends */
+    raft_storage_backend_t others[] = { RAFT_STORAGE_MEMORY, RAFT_STORAGE_MMAP };
+    for (size_t b = 0; b < sizeof(others) / sizeof(others[0]); b++) {
+        backend = others[b];
+        printf("\n  On the %s backend:\n", raft_storage_backend_ops(backend)->name);
+        RUN_TEST(test_storage_lifecycle);
+        RUN_TEST(test_save_and_load_state);
+        RUN_TEST(test_save_and_load_log);
+        RUN_TEST(test_recovery_empty);
+        RUN_TEST(test_recovery_with_state);
+        RUN_TEST(test_multiple_restarts);
+        RUN_TEST(test_log_truncation);
+        RUN_TEST(test_memory_budget_eviction);
+        RUN_TEST(test_group_commit);
+        RUN_TEST(test_wal_offset_index);
+        RUN_TEST(test_sync_policies);
+    }
 
     printf("\n========================================\n");
     printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
@@ -18,6 +18,8 @@
 #include "../src/rpc.h"
 #include "../src/param.h"
 #include "../src/log.h"
+#include "../src/replication.h"
+#include "../src/lz.h"
 
 static int tests_run = 0;
 static int tests_passed = 0;
@@ -35,6 +37,7 @@ static int test_counter = 0;
 
 /* External function for resetting membership state between tests */
 extern void raft_membership_reset(void);
+extern void raft_snapshot_reset_callback(void);
 
 static char* make_test_dir(void) {
     char* dir = malloc(64);
@@ -446,6 +449,793 @@ TEST(test_phase4_regression) {
     free(dir);
 }
 
+/* Test 11: Batch propose persists the whole batch */
+TEST(test_batch_propose_persisted) {
+    char* dir = make_test_dir();
+
+    raft_config_t config = {
+        .node_id = 0,
+        .num_nodes = 3,
+        .data_dir = dir,
+    };
+
+    raft_node_t* node = raft_create(&config);
+    assert(node != NULL);
+    raft_start(node);
+    raft_become_leader(node);
+
+    char big[1000];
+    memset(big, 'x', sizeof(big));
+    const char* commands[] = { "a", big, "ccc", big };
+    size_t lens[] = { 1, sizeof(big), 3, 500 };
+
+    uint64_t first_index;
+    assert(raft_propose_batch(node, commands, lens, 4, &first_index) == RAFT_OK);
+    assert(first_index == 1);
+
+    uint64_t base_index, base_term, count;
+    raft_storage_get_log_info(node->storage, &base_index, &base_term, &count);
+    assert(count == 4);
+
+    raft_entry_t entry;
+    assert(raft_storage_read_entry(node->storage, 4, &entry) == RAFT_OK);
+    assert(entry.command_len == 500);
+    assert(memcmp(entry.command, big, 500) == 0);
+    free(entry.command);
+
+    raft_destroy(node);
+
+    /* Every entry comes back after a restart */
+    node = raft_create(&config);
+    assert(node != NULL);
+    assert(raft_log_count(node->log) == 4);
+    assert(raft_log_get(node->log, 2)->command_len == sizeof(big));
+    assert(memcmp(raft_log_get(node->log, 3)->command, "ccc", 3) == 0);
+
+    raft_destroy(node);
+    raft_membership_reset();
+    remove_dir(dir);
+    free(dir);
+}
+
+static raft_status_t stream_state_cb(raft_node_t* node, raft_snapshot_writer_t* writer,
+                                     void* user_data) {
+    (void)node; (void)user_data;
+    char chunk[1000];
+    for (int i = 0; i < 4; i++) {
+        memset(chunk, 'a' + i, sizeof(chunk));
+        raft_status_t status = raft_snapshot_writer_write(writer, chunk, sizeof(chunk));
+        if (status != RAFT_OK) return status;
+    }
+    return RAFT_OK;
+}
+
+/* Test 12: Snapshots are written and read back in chunks */
+TEST(test_snapshot_streaming) {
+    char* dir = make_test_dir();
+
+    /* Chunks smaller and larger than the staging buffer */
+    raft_snapshot_writer_t* writer;
+    assert(raft_snapshot_writer_open(dir, 20, 3, &writer) == RAFT_OK);
+    size_t big = RAFT_SNAPSHOT_BUFFER_SIZE + 100;
+    char* expected = malloc(3 * 1000 + 2 * big);
+    size_t total = 0;
+    for (int i = 0; i < 5; i++) {
+        size_t len = i % 2 ? big : 1000;
+        memset(expected + total, 'a' + i, len);
+        assert(raft_snapshot_writer_write(writer, expected + total, len) == RAFT_OK);
+        total += len;
+    }
+    assert(raft_snapshot_writer_length(writer) == total);
+    assert(!raft_snapshot_exists(dir));
+    assert(raft_snapshot_writer_commit(writer) == RAFT_OK);
+
+    raft_snapshot_meta_t meta;
+    raft_snapshot_reader_t* reader;
+    assert(raft_snapshot_reader_open(dir, &meta, &reader) == RAFT_OK);
+    assert(meta.last_index == 20 && meta.last_term == 3);
+    assert(raft_snapshot_reader_length(reader) == total);
+    char buf[4096];
+    size_t done = 0, n;
+    do {
+        assert(raft_snapshot_reader_read(reader, buf, sizeof(buf), &n) == RAFT_OK);
+        assert(memcmp(buf, expected + done, n) == 0);
+        done += n;
+    } while (n > 0);
+    assert(done == total);
+    raft_snapshot_reader_close(reader);
+
+    /* A damaged state byte is caught by the read that reaches the end */
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", dir, RAFT_SNAPSHOT_FILE);
+    FILE* f = fopen(path, "r+b");
+    assert(f != NULL);
+    fseek(f, 40 + 10, SEEK_SET);
+    fputc('z', f);
+    fclose(f);
+    assert(raft_snapshot_reader_open(dir, &meta, &reader) == RAFT_OK);
+    raft_status_t status;
+    do {
+        status = raft_snapshot_reader_read(reader, buf, sizeof(buf), &n);
+    } while (status == RAFT_OK && n > 0);
+    assert(status == RAFT_CORRUPTION);
+    raft_snapshot_reader_close(reader);
+
+    /* An aborted writer leaves the committed snapshot in place */
+    assert(raft_snapshot_writer_open(dir, 30, 4, &writer) == RAFT_OK);
+    assert(raft_snapshot_writer_write(writer, "x", 1) == RAFT_OK);
+    raft_snapshot_writer_abort(writer);
+    assert(raft_snapshot_load_meta(dir, &meta) == RAFT_OK);
+    assert(meta.last_index == 20);
+    strcat(path, ".tmp");
+    assert(access(path, F_OK) != 0);
+
+    /* Auto-compaction streams the state through the writer callback */
+    raft_config_t config = { .node_id = 0, .num_nodes = 1, .data_dir = dir };
+    raft_node_t* node = raft_create(&config);
+    assert(node != NULL);
+    raft_set_snapshot_writer(node, stream_state_cb, NULL);
+    for (int i = 0; i < RAFT_AUTO_COMPACTION_THRESHOLD; i++) {
+        raft_log_append(node->log, 1, "cmd", 3, NULL);
+    }
+    node->volatile_state.last_applied = RAFT_AUTO_COMPACTION_THRESHOLD;
+    assert(raft_maybe_compact(node) == RAFT_OK);
+    raft_destroy(node);
+
+    void* state;
+    size_t state_len;
+    assert(raft_snapshot_load(dir, &meta, &state, &state_len) == RAFT_OK);
+    assert(meta.last_index == RAFT_AUTO_COMPACTION_THRESHOLD && state_len == 4000);
+    assert(((char*)state)[0] == 'a' && ((char*)state)[3999] == 'd');
+    free(state);
+
+    free(expected);
+    raft_snapshot_reset_callback();
+    remove_dir(dir);
+    free(dir);
+}
+
+/* Messages between the two nodes of test 13, delivered by hand */
+#define INSTALL_QUEUE_MAX 64
+static struct {
+    int32_t to;
+    void* msg;
+    size_t len;
+} install_queue[INSTALL_QUEUE_MAX];
+static size_t install_queued = 0;
+
+static size_t install_bytes = 0;     /* Snapshot bytes the leader has sent */
+
+static void install_send(raft_node_t* node, int32_t peer, const void* msg, size_t len,
+                         void* ud) {
+    (void)node; (void)ud;
+    assert(install_queued < INSTALL_QUEUE_MAX);
+    if (*(const raft_msg_type_t*)msg == RAFT_MSG_INSTALL_SNAPSHOT) {
+        install_bytes += ((const raft_install_snapshot_t*)msg)->data_len;
+    }
+    install_queue[install_queued].to = peer;
+    install_queue[install_queued].msg = malloc(len);
+    memcpy(install_queue[install_queued].msg, msg, len);
+    install_queue[install_queued].len = len;
+    install_queued++;
+}
+
+/* Deliver what is queued, newest first; what it sends waits for the next call */
+static void install_deliver(raft_node_t** nodes, bool drop) {
+    size_t count = install_queued;
+    void* msgs[INSTALL_QUEUE_MAX];
+    int32_t to[INSTALL_QUEUE_MAX];
+    size_t lens[INSTALL_QUEUE_MAX];
+    for (size_t i = 0; i < count; i++) {
+        msgs[i] = install_queue[i].msg;
+        to[i] = install_queue[i].to;
+        lens[i] = install_queue[i].len;
+    }
+    install_queued = 0;
+    for (size_t i = count; i-- > 0; ) {
+        if (!drop) raft_receive_message(nodes[to[i]], 1 - to[i], msgs[i], lens[i]);
+        free(msgs[i]);
+    }
+}
+
+static char* restored_state = NULL;
+static size_t restored_len = 0;
+
+static raft_status_t restore_state_cb(raft_node_t* node, const raft_snapshot_meta_t* meta,
+                                      raft_snapshot_reader_t* reader, void* user_data) {
+    (void)node; (void)meta; (void)user_data;
+    restored_len = (size_t)raft_snapshot_reader_length(reader);
+    restored_state = malloc(restored_len);
+    size_t done = 0, n;
+    do {
+        raft_status_t status = raft_snapshot_reader_read(reader, restored_state + done,
+                                                         restored_len - done, &n);
+        if (status != RAFT_OK) return status;
+        done += n;
+    } while (n > 0);
+    return RAFT_OK;
+}
+
+/* Test 13: InstallSnapshot is sent in chunks, out of order, and resumes after loss */
+TEST(test_install_snapshot_chunked) {
+    char* leader_dir = make_test_dir();
+    char* follower_dir = make_test_dir();
+    raft_node_t* nodes[2];
+
+    raft_config_t config = {
+        .node_id = 0,
+        .num_nodes = 2,
+        .send_fn = install_send,
+        .data_dir = leader_dir,
+        .snapshot_chunk_size = 4096,
+        .snapshot_max_inflight = 4,
+    };
+    nodes[0] = raft_create(&config);
+    config.node_id = 1;
+    config.data_dir = follower_dir;
+    nodes[1] = raft_create(&config);
+    assert(nodes[0] && nodes[1]);
+    raft_start(nodes[0]);
+    raft_start(nodes[1]);
+    raft_set_snapshot_restore(nodes[1], restore_state_cb, NULL);
+
+    /* The leader has compacted everything up to 50 into its snapshot */
+    size_t state_len = 100000;
+    char* state = malloc(state_len);
+    for (size_t i = 0; i < state_len; i++) state[i] = (char)(i * 7);
+    assert(raft_snapshot_create(leader_dir, 50, 1, state, state_len) == RAFT_OK);
+    raft_log_reset(nodes[0]->log, 50, 1);
+    nodes[0]->persistent.current_term = 1;
+    raft_become_leader(nodes[0]);
+    uint64_t index;
+    raft_propose(nodes[0], "cmd51", 5, &index);
+    raft_propose(nodes[0], "cmd52", 5, &index);
+    install_deliver(nodes, true);
+
+    /* A follower that needs entry 1 gets a window of chunks */
+    nodes[0]->leader_state.next_index[1] = 1;
+    assert(raft_replicate_to_peer(nodes[0], 1) == RAFT_OK);
+    assert(install_queued == 4);
+    raft_msg_type_t type;
+    memcpy(&type, install_queue[0].msg, sizeof(type));
+    assert(type == RAFT_MSG_INSTALL_SNAPSHOT);
+
+    /* Reordered chunks are all kept; the acks open the window again */
+    install_deliver(nodes, false);
+    install_deliver(nodes, false);
+    assert(install_queued == 4);
+
+    /* Lose the next window: the leader resends it from the follower's
+     * ack once a heartbeat interval passes without progress */
+    install_deliver(nodes, true);
+    raft_tick(nodes[0], RAFT_HEARTBEAT_INTERVAL_MS);
+    assert(install_queued == 0);
+    raft_tick(nodes[0], RAFT_HEARTBEAT_INTERVAL_MS);
+    assert(install_queued == 4);
+    raft_install_snapshot_t chunk;
+    memcpy(&chunk, install_queue[0].msg, sizeof(chunk));
+    assert(chunk.offset == 4 * 4096);
+
+    for (int i = 0; i < 100 && install_queued > 0; i++) {
+        install_deliver(nodes, false);
+    }
+    assert(install_queued == 0);
+
+    /* Installed, restored, and caught up with the entries after it */
+    assert(nodes[1]->log->base_index == 50 && nodes[1]->log->base_term == 1);
+    assert(restored_len == state_len && memcmp(restored_state, state, state_len) == 0);
+    assert(nodes[0]->leader_state.match_index[1] == 52);
+    assert(raft_log_last_index(nodes[1]->log) == 52);
+    void* loaded;
+    size_t loaded_len;
+    raft_snapshot_meta_t meta;
+    assert(raft_snapshot_load(follower_dir, &meta, &loaded, &loaded_len) == RAFT_OK);
+    assert(meta.last_index == 50 && loaded_len == state_len);
+    free(loaded);
+
+    raft_destroy(nodes[0]);
+    raft_destroy(nodes[1]);
+    free(restored_state);
+    restored_state = NULL;
+    free(state);
+    raft_snapshot_reset_callback();
+    remove_dir(leader_dir);
+    remove_dir(follower_dir);
+    free(leader_dir);
+    free(follower_dir);
+}
+
+/* Test 14: Snapshot state mapped in place and handed to the state machine */
+static raft_snapshot_mapping_t* kept_mapping = NULL;
+
+static raft_status_t restore_mapped_cb(raft_node_t* node, const raft_snapshot_meta_t* meta,
+                                       raft_snapshot_mapping_t* mapping, void* user_data) {
+    (void)node; (void)meta; (void)user_data;
+    kept_mapping = mapping;
+    return RAFT_OK;
+}
+
+TEST(test_snapshot_mapped) {
+    raft_snapshot_reset_callback();
+    char* dir = make_test_dir();
+
+    size_t len = 3 * 4096 + 123;
+    char* state = malloc(len);
+    for (size_t i = 0; i < len; i++) state[i] = (char)(i * 7);
+    assert(raft_snapshot_create(dir, 30, 4, state, len) == RAFT_OK);
+
+    raft_snapshot_meta_t meta;
+    raft_snapshot_mapping_t* mapping;
+    assert(raft_snapshot_map(dir, &meta, true, &mapping) == RAFT_OK);
+    assert(meta.last_index == 30 && meta.last_term == 4);
+    assert(raft_snapshot_mapping_length(mapping) == len);
+    assert(memcmp(raft_snapshot_mapping_data(mapping), state, len) == 0);
+
+    /* A later snapshot replaces the file, not what is mapped */
+    assert(raft_snapshot_create(dir, 40, 4, "new", 3) == RAFT_OK);
+    assert(memcmp(raft_snapshot_mapping_data(mapping), state, len) == 0);
+    raft_snapshot_unmap(mapping);
+
+    /* An empty state maps to nothing */
+    assert(raft_snapshot_create(dir, 41, 4, NULL, 0) == RAFT_OK);
+    assert(raft_snapshot_map(dir, &meta, true, &mapping) == RAFT_OK);
+    assert(raft_snapshot_mapping_length(mapping) == 0);
+    assert(raft_snapshot_mapping_data(mapping) == NULL);
+    raft_snapshot_unmap(mapping);
+
+    /* A damaged state byte is caught only when verifying */
+    assert(raft_snapshot_create(dir, 50, 5, state, len) == RAFT_OK);
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", dir, RAFT_SNAPSHOT_FILE);
+    FILE* f = fopen(path, "r+b");
+    assert(f != NULL);
+    fseek(f, 40 + 5000, SEEK_SET);
+    fputc(state[5000] ^ 1, f);
+    fclose(f);
+    assert(raft_snapshot_map(dir, &meta, true, &mapping) == RAFT_CORRUPTION);
+    assert(raft_snapshot_map(dir, &meta, false, &mapping) == RAFT_OK);
+    raft_snapshot_unmap(mapping);
+
+    /* Installing hands the mapping over; the state machine releases it */
+    assert(raft_snapshot_create(dir, 60, 6, state, len) == RAFT_OK);
+    raft_config_t config = { .node_id = 0, .num_nodes = 1, .data_dir = dir };
+    raft_node_t* node = raft_create(&config);
+    assert(node != NULL);
+    raft_set_snapshot_restore_mapped(node, restore_mapped_cb, NULL);
+    assert(raft_snapshot_install_file(node, &meta) == RAFT_OK);
+    assert(meta.last_index == 60);
+    assert(node->log->base_index == 60);
+    assert(kept_mapping != NULL);
+    assert(raft_snapshot_mapping_length(kept_mapping) == len);
+    assert(memcmp(raft_snapshot_mapping_data(kept_mapping), state, len) == 0);
+    raft_snapshot_unmap(kept_mapping);
+    kept_mapping = NULL;
+
+    raft_destroy(node);
+    free(state);
+    remove_dir(dir);
+    free(dir);
+    raft_snapshot_reset_callback();
+}
+
+/* Test 15: Deltas chain on a base until a full snapshot replaces them */
+static char* read_delta(const char* dir, uint32_t i, raft_snapshot_meta_t* meta) {
+    raft_snapshot_reader_t* reader;
+    assert(raft_snapshot_delta_reader_open(dir, i, meta, &reader) == RAFT_OK);
+    size_t len = (size_t)raft_snapshot_reader_length(reader);
+    char* data = calloc(1, len + 1);
+    size_t n;
+    assert(raft_snapshot_reader_read(reader, data, len, &n) == RAFT_OK && n == len);
+    raft_snapshot_reader_close(reader);
+    return data;
+}
+
+static uint64_t delta_since = 0;
+
+static raft_status_t write_delta_cb(raft_node_t* node, uint64_t since_index,
+                                    raft_snapshot_writer_t* writer, void* ud) {
+    (void)node; (void)ud;
+    delta_since = since_index;
+    return raft_snapshot_writer_write(writer, "k=v;", 4);
+}
+
+static raft_status_t write_full_cb(raft_node_t* node, raft_snapshot_writer_t* writer,
+                                   void* ud) {
+    (void)node; (void)ud;
+    return raft_snapshot_writer_write(writer, "full state", 10);
+}
+
+static uint64_t freeze_delta_since = 0;
+
+static raft_status_t write_frozen(void* state, raft_snapshot_writer_t* writer) {
+    return raft_snapshot_writer_write(writer, state, strlen(state));
+}
+
+static raft_status_t freeze_delta_cb(raft_node_t* node, uint64_t since_index,
+                                     raft_snapshot_view_t* view, void* ud) {
+    (void)node; (void)ud;
+    freeze_delta_since = since_index;
+    view->state = strdup("c=3;");
+    view->write = write_frozen;
+    view->release = free;
+    return view->state ? RAFT_OK : RAFT_NO_MEMORY;
+}
+
+TEST(test_snapshot_delta_chain) {
+    raft_snapshot_reset_callback();
+    char* dir = make_test_dir();
+    raft_snapshot_meta_t meta;
+    raft_snapshot_writer_t* writer;
+
+    /* Nothing to chain on without a base */
+    assert(raft_snapshot_delta_writer_open(dir, 5, 1, &writer) == RAFT_NOT_FOUND);
+
+    assert(raft_snapshot_create(dir, 10, 1, "0123456789abcdef", 16) == RAFT_OK);
+    assert(raft_snapshot_delta_writer_open(dir, 20, 1, &writer) == RAFT_OK);
+    assert(raft_snapshot_writer_write(writer, "a=1;", 4) == RAFT_OK);
+    assert(raft_snapshot_writer_commit(writer) == RAFT_OK);
+    assert(raft_snapshot_delta_writer_open(dir, 20, 1, &writer) == RAFT_INVALID_ARG);
+    assert(raft_snapshot_delta_writer_open(dir, 30, 2, &writer) == RAFT_OK);
+    assert(raft_snapshot_writer_write(writer, "b=2;", 4) == RAFT_OK);
+    assert(raft_snapshot_writer_commit(writer) == RAFT_OK);
+
+    /* The tip is what a restart recovers to; the base is read first, then
+     * each delta in order */
+    assert(raft_snapshot_delta_count(dir) == 2);
+    assert(raft_snapshot_load_meta(dir, &meta) == RAFT_OK);
+    assert(meta.last_index == 30 && meta.last_term == 2);
+    void* data;
+    size_t len;
+    assert(raft_snapshot_load(dir, &meta, &data, &len) == RAFT_OK);
+    assert(meta.last_index == 10 && len == 16);
+    free(data);
+    char* delta = read_delta(dir, 0, &meta);
+    assert(meta.last_index == 20 && strcmp(delta, "a=1;") == 0);
+    free(delta);
+    delta = read_delta(dir, 1, &meta);
+    assert(meta.last_index == 30 && strcmp(delta, "b=2;") == 0);
+    free(delta);
+
+    /* A restarted node compacts into deltas on the tip until they hold as
+     * much as the base, then writes the whole state again */
+    raft_config_t config = { .node_id = 0, .num_nodes = 1, .data_dir = dir };
+    raft_node_t* node = raft_create(&config);
+    assert(node != NULL);
+    assert(node->log->base_index == 30);
+    raft_set_snapshot_delta(node, write_delta_cb, NULL);
+    raft_set_snapshot_writer(node, write_full_cb, NULL);
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < RAFT_AUTO_COMPACTION_THRESHOLD; i++) {
+            raft_log_append(node->log, 2, "cmd", 3, NULL);
+        }
+        node->volatile_state.last_applied = raft_log_last_index(node->log);
+        assert(raft_maybe_compact(node) == RAFT_OK);
+    }
+    assert(delta_since == 30 + RAFT_AUTO_COMPACTION_THRESHOLD);
+    assert(raft_snapshot_delta_count(dir) == 4);
+    assert(node->log->base_index == 30 + 2 * RAFT_AUTO_COMPACTION_THRESHOLD);
+    assert(raft_snapshot_load_meta(dir, &meta) == RAFT_OK);
+    assert(meta.last_index == node->log->base_index);
+
+    /* 4 deltas of 4 bytes hold as much as the 16-byte base */
+    for (int i = 0; i < RAFT_AUTO_COMPACTION_THRESHOLD; i++) {
+        raft_log_append(node->log, 2, "cmd", 3, NULL);
+    }
+    node->volatile_state.last_applied = raft_log_last_index(node->log);
+    assert(raft_maybe_compact(node) == RAFT_OK);
+    assert(raft_snapshot_delta_count(dir) == 0);
+    assert(raft_snapshot_load(dir, &meta, &data, &len) == RAFT_OK);
+    assert(meta.last_index == 30 + 3 * RAFT_AUTO_COMPACTION_THRESHOLD);
+    assert(len == 10 && memcmp(data, "full state", 10) == 0);
+    free(data);
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s20.dat", dir, RAFT_SNAPSHOT_DELTA_PREFIX);
+    assert(access(path, F_OK) != 0);
+    snprintf(path, sizeof(path), "%s/%s", dir, RAFT_SNAPSHOT_MANIFEST);
+    assert(access(path, F_OK) != 0);
+
+    /* A frozen delta is written on the snapshot thread, and the log is
+     * compacted once it is on the chain */
+    raft_set_snapshot_freeze_delta(node, freeze_delta_cb, NULL);
+    uint64_t tip = node->log->base_index;
+    for (int i = 0; i < RAFT_AUTO_COMPACTION_THRESHOLD; i++) {
+        raft_log_append(node->log, 2, "cmd", 3, NULL);
+    }
+    node->volatile_state.last_applied = raft_log_last_index(node->log);
+    assert(raft_maybe_compact(node) == RAFT_OK);
+    assert(raft_snapshot_wait(node) == RAFT_OK);
+    assert(freeze_delta_since == tip);
+    assert(raft_snapshot_delta_count(dir) == 1);
+    assert(node->log->base_index == tip + RAFT_AUTO_COMPACTION_THRESHOLD);
+    delta = read_delta(dir, 0, &meta);
+    assert(meta.last_index == node->log->base_index && strcmp(delta, "c=3;") == 0);
+    free(delta);
+
+    raft_destroy(node);
+    remove_dir(dir);
+    free(dir);
+    raft_snapshot_reset_callback();
+}
+
+/* Test 16: A follower that has the base is sent only the delta */
+static char* applied_delta = NULL;
+
+static raft_status_t restore_delta_cb(raft_node_t* node, const raft_snapshot_meta_t* meta,
+                                      raft_snapshot_reader_t* reader, void* user_data) {
+    (void)node; (void)meta; (void)user_data;
+    size_t len = (size_t)raft_snapshot_reader_length(reader);
+    applied_delta = calloc(1, len + 1);
+    size_t n;
+    return raft_snapshot_reader_read(reader, applied_delta, len, &n);
+}
+
+TEST(test_install_snapshot_delta) {
+    raft_snapshot_reset_callback();
+    char* leader_dir = make_test_dir();
+    char* follower_dir = make_test_dir();
+    raft_node_t* nodes[2];
+
+    /* Both hold the base at 50; the leader has chained a delta up to 80 */
+    size_t state_len = 100000;
+    char* state = malloc(state_len);
+    for (size_t i = 0; i < state_len; i++) state[i] = (char)(i * 7);
+    assert(raft_snapshot_create(leader_dir, 50, 1, state, state_len) == RAFT_OK);
+    assert(raft_snapshot_create(follower_dir, 50, 1, state, state_len) == RAFT_OK);
+    raft_snapshot_writer_t* writer;
+    assert(raft_snapshot_delta_writer_open(leader_dir, 80, 1, &writer) == RAFT_OK);
+    assert(raft_snapshot_writer_write(writer, "x=8;", 4) == RAFT_OK);
+    assert(raft_snapshot_writer_commit(writer) == RAFT_OK);
+
+    raft_config_t config = {
+        .node_id = 0,
+        .num_nodes = 2,
+        .send_fn = install_send,
+        .data_dir = leader_dir,
+        .snapshot_chunk_size = 4096,
+        .snapshot_max_inflight = 4,
+    };
+    nodes[0] = raft_create(&config);
+    config.node_id = 1;
+    config.data_dir = follower_dir;
+    nodes[1] = raft_create(&config);
+    assert(nodes[0] && nodes[1]);
+    assert(nodes[0]->log->base_index == 80 && nodes[1]->log->base_index == 50);
+    raft_start(nodes[0]);
+    raft_start(nodes[1]);
+    raft_set_snapshot_restore(nodes[1], restore_state_cb, NULL);
+    raft_set_snapshot_restore_delta(nodes[1], restore_delta_cb, NULL);
+
+    nodes[0]->persistent.current_term = 1;
+    raft_become_leader(nodes[0]);
+    uint64_t index;
+    raft_propose(nodes[0], "cmd81", 5, &index);
+    install_deliver(nodes, true);
+
+    /* One chunk of the base finds out what the follower holds */
+    install_bytes = 0;
+    nodes[0]->leader_state.next_index[1] = 1;
+    assert(raft_replicate_to_peer(nodes[0], 1) == RAFT_OK);
+    assert(install_queued == 1);
+    for (int i = 0; i < 100 && install_queued > 0; i++) {
+        install_deliver(nodes, false);
+    }
+
+    /* Only the delta followed it, and landed on the follower's chain */
+    raft_snapshot_meta_t meta;
+    assert(install_bytes < 4096 + 1024);
+    assert(applied_delta != NULL && strcmp(applied_delta, "x=8;") == 0);
+    assert(nodes[1]->log->base_index == 80);
+    assert(raft_log_last_index(nodes[1]->log) == 81);
+    assert(nodes[0]->leader_state.match_index[1] == 81);
+    assert(raft_snapshot_delta_count(follower_dir) == 1);
+    assert(raft_snapshot_load_meta(follower_dir, &meta) == RAFT_OK);
+    assert(meta.last_index == 80);
+
+    raft_destroy(nodes[0]);
+    raft_destroy(nodes[1]);
+    free(applied_delta);
+    applied_delta = NULL;
+    free(state);
+    raft_snapshot_reset_callback();
+    remove_dir(leader_dir);
+    remove_dir(follower_dir);
+    free(leader_dir);
+    free(follower_dir);
+}
+
+/* Test 17: LZ blocks round-trip, and damaged ones fail cleanly */
+static void lz_round_trip(const char* data, size_t len) {
+    size_t cap = raft_lz_bound(len);
+    char* packed = malloc(cap);
+    char* unpacked = malloc(len + 1);
+    size_t packed_len = raft_lz_compress(data, len, packed, cap);
+    assert(packed_len > 0 && packed_len <= cap);
+    size_t n;
+    assert(raft_lz_decompress(packed, packed_len, unpacked, len, &n) == RAFT_OK);
+    assert(n == len && memcmp(unpacked, data, len) == 0);
+    free(packed);
+    free(unpacked);
+}
+
+/* Key/value text, the kind of state that compresses well */
+static char* make_kv_state(size_t len) {
+    char* state = malloc(len + 32);
+    size_t at = 0;
+    for (uint32_t k = 0; at < len; k++) {
+        at += (size_t)sprintf(state + at, "key:%08u=value-%u;", k * 7919 % 100003, k % 50);
+    }
+    return state;
+}
+
+TEST(test_lz_codec) {
+    size_t len = 300000;
+    char* text = make_kv_state(len);
+    char* noise = malloc(len);
+    uint32_t x = 12345;
+    for (size_t i = 0; i < len; i++) {
+        x = x * 1103515245 + 12345;
+        noise[i] = (char)(x >> 16);
+    }
+    char runs[1000];
+    memset(runs, 'a', sizeof(runs));
+    memset(runs + 500, 'b', 13);
+
+    lz_round_trip("", 0);
+    lz_round_trip("abc", 3);
+    lz_round_trip(runs, sizeof(runs));
+    lz_round_trip(text, len);
+    lz_round_trip(noise, len);
+
+    /* Text shrinks; noise does not fit in less than it took */
+    char* packed = malloc(raft_lz_bound(len));
+    size_t packed_len = raft_lz_compress(text, len, packed, raft_lz_bound(len));
+    assert(packed_len < len / 2);
+    assert(raft_lz_compress(noise, len, packed, len - 1) == 0);
+    packed_len = raft_lz_compress(text, len, packed, raft_lz_bound(len));   /* Again */
+
+    /* Cut short, too small a buffer, or damaged: an error, never an overrun */
+    char* out = malloc(len);
+    size_t n;
+    assert(raft_lz_decompress(packed, packed_len - 1, out, len, &n) == RAFT_CORRUPTION);
+    assert(raft_lz_decompress(packed, packed_len, out, len - 1, &n) == RAFT_CORRUPTION);
+    for (size_t i = 0; i < packed_len; i += 97) {
+        char saved = packed[i];
+        packed[i] = (char)(saved ^ 0x5a);
+        raft_status_t status = raft_lz_decompress(packed, packed_len, out, len, &n);
+        assert(status == RAFT_CORRUPTION || (status == RAFT_OK && n <= len));
+        packed[i] = saved;
+    }
+    assert(raft_lz_decompress(noise, 4096, out, len, &n) == RAFT_CORRUPTION ||
+           n <= len);
+
+    free(out);
+    free(packed);
+    free(noise);
+    free(text);
+}
+
+/* Test 18: Compressed snapshots are read, mapped and installed like any other */
+TEST(test_snapshot_compressed) {
+    raft_snapshot_reset_callback();
+    char* leader_dir = make_test_dir();
+    char* follower_dir = make_test_dir();
+    char path[256];
+    struct stat st;
+
+    /* Several blocks' worth, pushed in odd-sized chunks */
+    size_t state_len = 3 * RAFT_SNAPSHOT_BLOCK_SIZE + 12345;
+    char* state = make_kv_state(state_len);
+    assert(raft_set_snapshot_compression(NULL, 7) == RAFT_INVALID_ARG);
+    assert(raft_set_snapshot_compression(NULL, RAFT_SNAPSHOT_CODEC_LZ) == RAFT_OK);
+    raft_snapshot_writer_t* writer;
+    assert(raft_snapshot_writer_open(leader_dir, 50, 1, &writer) == RAFT_OK);
+    for (size_t done = 0; done < state_len; ) {
+        size_t len = state_len - done < 70001 ? state_len - done : 70001;
+        assert(raft_snapshot_writer_write(writer, state + done, len) == RAFT_OK);
+        done += len;
+    }
+    assert(raft_snapshot_writer_length(writer) == state_len);
+    assert(raft_snapshot_writer_commit(writer) == RAFT_OK);
+    snprintf(path, sizeof(path), "%s/%s", leader_dir, RAFT_SNAPSHOT_FILE);
+    assert(stat(path, &st) == 0 && (size_t)st.st_size < state_len / 2);
+
+    /* Read back in small pieces and whole, and mapped */
+    raft_snapshot_meta_t meta;
+    raft_snapshot_reader_t* reader;
+    assert(raft_snapshot_reader_open(leader_dir, &meta, &reader) == RAFT_OK);
+    assert(raft_snapshot_reader_length(reader) == state_len);
+    char buf[1000];
+    size_t done = 0, n;
+    do {
+        assert(raft_snapshot_reader_read(reader, buf, sizeof(buf), &n) == RAFT_OK);
+        assert(memcmp(buf, state + done, n) == 0);
+        done += n;
+    } while (n > 0);
+    assert(done == state_len);
+    raft_snapshot_reader_close(reader);
+
+    void* loaded;
+    size_t loaded_len;
+    assert(raft_snapshot_load(leader_dir, &meta, &loaded, &loaded_len) == RAFT_OK);
+    assert(meta.last_index == 50 && loaded_len == state_len);
+    assert(memcmp(loaded, state, state_len) == 0);
+    free(loaded);
+
+    raft_snapshot_mapping_t* mapping;
+    assert(raft_snapshot_map(leader_dir, &meta, false, &mapping) == RAFT_OK);
+    assert(raft_snapshot_mapping_length(mapping) == state_len);
+    assert(memcmp(raft_snapshot_mapping_data(mapping), state, state_len) == 0);
+    raft_snapshot_unmap(mapping);
+
+    /* Without a codec the file is as before: version 2, stored as is */
+    assert(raft_set_snapshot_compression(NULL, RAFT_SNAPSHOT_CODEC_NONE) == RAFT_OK);
+    assert(raft_snapshot_create(follower_dir, 10, 1, state, 1000) == RAFT_OK);
+    snprintf(path, sizeof(path), "%s/%s", follower_dir, RAFT_SNAPSHOT_FILE);
+    assert(stat(path, &st) == 0 && st.st_size == 40 + 1000);
+    assert(raft_set_snapshot_compression(NULL, RAFT_SNAPSHOT_CODEC_LZ) == RAFT_OK);
+
+    /* A damaged stored byte fails the read, through the codec or the CRC */
+    assert(raft_snapshot_create(follower_dir, 20, 1, state, state_len) == RAFT_OK);
+    FILE* f = fopen(path, "r+b");
+    assert(f != NULL);
+    fseek(f, 200, SEEK_SET);
+    int c = fgetc(f);
+    fseek(f, 200, SEEK_SET);
+    fputc(c ^ 0x21, f);
+    fclose(f);
+    assert(raft_snapshot_load(follower_dir, &meta, &loaded, &loaded_len) == RAFT_CORRUPTION);
+    assert(raft_snapshot_map(follower_dir, &meta, false, &mapping) == RAFT_CORRUPTION);
+    remove_dir(follower_dir);
+    mkdir(follower_dir, 0755);
+
+    /* InstallSnapshot carries the compressed file; the follower restores
+     * the state from it */
+    raft_node_t* nodes[2];
+    raft_config_t config = {
+        .node_id = 0,
+        .num_nodes = 2,
+        .send_fn = install_send,
+        .data_dir = leader_dir,
+        .snapshot_chunk_size = 16384,
+        .snapshot_max_inflight = 4,
+    };
+    nodes[0] = raft_create(&config);
+    config.node_id = 1;
+    config.data_dir = follower_dir;
+    nodes[1] = raft_create(&config);
+    assert(nodes[0] && nodes[1]);
+    raft_start(nodes[0]);
+    raft_start(nodes[1]);
+    raft_set_snapshot_restore(nodes[1], restore_state_cb, NULL);
+    nodes[0]->persistent.current_term = 1;
+    raft_become_leader(nodes[0]);
+    uint64_t index;
+    raft_propose(nodes[0], "cmd51", 5, &index);
+    install_deliver(nodes, true);
+
+    install_bytes = 0;
+    nodes[0]->leader_state.next_index[1] = 1;
+    assert(raft_replicate_to_peer(nodes[0], 1) == RAFT_OK);
+    for (int i = 0; i < 100 && install_queued > 0; i++) {
+        install_deliver(nodes, false);
+    }
+    assert(install_bytes < state_len / 2);
+    assert(nodes[1]->log->base_index == 50);
+    assert(nodes[0]->leader_state.match_index[1] == 51);
+    assert(restored_len == state_len && memcmp(restored_state, state, state_len) == 0);
+
+    raft_destroy(nodes[0]);
+    raft_destroy(nodes[1]);
+    free(restored_state);
+    restored_state = NULL;
+    free(state);
+    raft_snapshot_reset_callback();
+    remove_dir(leader_dir);
+    remove_dir(follower_dir);
+    free(leader_dir);
+    free(follower_dir);
+}
+
 int main(void) {
     printf("Phase 5: Membership Changes and Optimization Tests\n");
     printf("===================================================\n\n");
@@ -460,6 +1250,14 @@ int main(void) {
     RUN_TEST(test_install_snapshot);
     RUN_TEST(test_membership_persistence);
     RUN_TEST(test_phase4_regression);
+    RUN_TEST(test_batch_propose_persisted);
+    RUN_TEST(test_snapshot_streaming);
+    RUN_TEST(test_install_snapshot_chunked);
+    RUN_TEST(test_snapshot_mapped);
+    RUN_TEST(test_snapshot_delta_chain);
+    RUN_TEST(test_install_snapshot_delta);
+    RUN_TEST(test_lz_codec);
+    RUN_TEST(test_snapshot_compressed);
 
     printf("\n===================================================\n");
     printf("Results: %d/%d tests passed\n", tests_passed, tests_run);
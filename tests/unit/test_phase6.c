@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include "../src/raft.h"
@@ -17,6 +18,7 @@
 #include "../src/rpc.h"
 #include "../src/param.h"
 #include "../src/log.h"
+#include "../src/compact.h"
 
 static int tests_run = 0;
 static int tests_passed = 0;
@@ -438,6 +440,201 @@ TEST(test_transfer_abort) {
     raft_transfer_reset();
 }
 
+/* Test 11: Background compaction keeps the node going while it writes */
+static pthread_mutex_t freeze_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t freeze_cond = PTHREAD_COND_INITIALIZER;
+static bool freeze_released = false;
+static char freeze_state[32] = "frozen state";
+
+static raft_status_t frozen_write(void* state, raft_snapshot_writer_t* writer) {
+    /* Hold the snapshot thread until the test has kept the node busy */
+    pthread_mutex_lock(&freeze_lock);
+    while (!freeze_released) pthread_cond_wait(&freeze_cond, &freeze_lock);
+    pthread_mutex_unlock(&freeze_lock);
+    return raft_snapshot_writer_write(writer, state, strlen(state));
+}
+
+static raft_status_t test_freeze_cb(raft_node_t* n, raft_snapshot_view_t* view, void* ud) {
+    (void)n; (void)ud;
+    view->state = strdup(freeze_state);
+    view->write = frozen_write;
+    view->release = free;
+    return view->state ? RAFT_OK : RAFT_NO_MEMORY;
+}
+
+TEST(test_background_compaction) {
+    raft_snapshot_reset_callback();
+    char* dir = make_test_dir();
+    freeze_released = false;
+
+    raft_config_t config = {
+        .node_id = 0,
+        .num_nodes = 1,
+        .data_dir = dir,
+    };
+
+    raft_node_t* node = raft_create(&config);
+    assert(node != NULL);
+    raft_start(node);
+    raft_set_snapshot_freeze(node, test_freeze_cb, NULL);
+
+    for (int i = 0; i < RAFT_AUTO_COMPACTION_THRESHOLD; i++) {
+        raft_log_append(node->log, 1, "cmd", 3, NULL);
+    }
+    node->volatile_state.last_applied = 600;
+
+    /* Freezes at last_applied and returns without waiting for the write */
+    assert(raft_maybe_compact(node) == RAFT_OK);
+    assert(raft_snapshot_in_progress(node));
+    assert(node->log->base_index == 0);
+
+    /* The state moves on and entries keep arriving; the snapshot still
+     * gets what was frozen */
+    strcpy(freeze_state, "later state");
+    for (int i = 0; i < 100; i++) {
+        raft_log_append(node->log, 1, "cmd", 3, NULL);
+    }
+    node->volatile_state.last_applied = 1100;
+    assert(raft_maybe_compact(node) == RAFT_OK);
+    assert(raft_snapshot_poll(node) == RAFT_OK);
+    assert(raft_snapshot_in_progress(node));
+    assert(node->log->base_index == 0);
+    assert(raft_log_last_index(node->log) == 1100);
+
+    pthread_mutex_lock(&freeze_lock);
+    freeze_released = true;
+    pthread_cond_broadcast(&freeze_cond);
+    pthread_mutex_unlock(&freeze_lock);
+
+    /* Compacted to where it was frozen, not to the later last_applied */
+    assert(raft_snapshot_wait(node) == RAFT_OK);
+    assert(!raft_snapshot_in_progress(node));
+    assert(node->log->base_index == 600);
+    assert(raft_log_last_index(node->log) == 1100);
+
+    raft_snapshot_meta_t meta;
+    void* data;
+    size_t len;
+    assert(raft_snapshot_load(dir, &meta, &data, &len) == RAFT_OK);
+    assert(meta.last_index == 600);
+    assert(len == strlen("frozen state"));
+    assert(memcmp(data, "frozen state", len) == 0);
+    free(data);
+
+    raft_destroy(node);
+    remove_dir(dir);
+    free(dir);
+    strcpy(freeze_state, "frozen state");
+    raft_snapshot_reset_callback();
+}
+
+/* Test 12: Compaction deferred during a burst, forced past its budgets */
+TEST(test_compaction_scheduling) {
+    raft_snapshot_reset_callback();
+    char* dir = make_test_dir();
+
+    raft_config_t config = {
+        .node_id = 0,
+        .num_nodes = 1,
+        .data_dir = dir,
+    };
+
+    raft_node_t* node = raft_create(&config);
+    assert(node != NULL);
+    raft_set_snapshot_callback(node, test_snapshot_cb, NULL);
+
+    /* A threshold's worth of entries in one window is a burst */
+    raft_compact_tick(node, 0);
+    for (int i = 0; i < RAFT_AUTO_COMPACTION_THRESHOLD; i++) {
+        raft_log_append(node->log, 1, "cmd", 3, NULL);
+    }
+    raft_compact_tick(node, RAFT_COMPACT_RATE_WINDOW_MS);
+    node->volatile_state.last_applied = RAFT_AUTO_COMPACTION_THRESHOLD;
+
+    raft_compact_stats_t stats;
+    assert(raft_maybe_compact(node) == RAFT_OK);
+    assert(node->log->base_index == 0);
+    raft_compact_stats(node, &stats);
+    assert(stats.last_decision == RAFT_COMPACT_DEFER);
+    assert(stats.deferred == 1 && stats.runs == 0);
+    assert(stats.entry_rate >= RAFT_COMPACT_BURST_RATE);
+
+    /* Put off until the log is RAFT_COMPACT_MAX_DEFER times too long */
+    uint64_t backlog = (uint64_t)RAFT_AUTO_COMPACTION_THRESHOLD * RAFT_COMPACT_MAX_DEFER;
+    while (raft_log_last_index(node->log) < backlog) {
+        raft_log_append(node->log, 1, "cmd", 3, NULL);
+    }
+    raft_compact_tick(node, RAFT_COMPACT_RATE_WINDOW_MS);
+    node->volatile_state.last_applied = backlog;
+    assert(raft_maybe_compact(node) == RAFT_OK);
+    assert(node->log->base_index == backlog);
+    raft_compact_stats(node, &stats);
+    assert(stats.last_decision == RAFT_COMPACT_FORCE_BACKLOG);
+    assert(stats.forced_backlog == 1 && stats.snapshots == 1);
+
+    /* Once the rate settles, a due compaction just runs */
+    for (int i = 0; i < 2 * RAFT_COMPACT_SLOW_WINDOWS; i++) {
+        raft_compact_tick(node, RAFT_COMPACT_RATE_WINDOW_MS);
+    }
+    for (int i = 0; i < RAFT_AUTO_COMPACTION_THRESHOLD; i++) {
+        raft_log_append(node->log, 1, "cmd", 3, NULL);
+    }
+    node->volatile_state.last_applied = backlog + RAFT_AUTO_COMPACTION_THRESHOLD;
+    assert(raft_maybe_compact(node) == RAFT_OK);
+    assert(node->log->base_index == backlog + RAFT_AUTO_COMPACTION_THRESHOLD);
+    raft_compact_stats(node, &stats);
+    assert(stats.last_decision == RAFT_COMPACT_RUN && stats.runs == 1);
+    raft_destroy(node);
+
+    /* Resident payload over its budget forces compaction early */
+    char* dir2 = make_test_dir();
+    config.data_dir = dir2;
+    config.compaction_memory_budget = 1024;
+    node = raft_create(&config);
+    assert(node != NULL);
+
+    char big[RAFT_LOG_INLINE_SIZE * 4];
+    memset(big, 'x', sizeof(big));
+    for (int i = 0; i < 10; i++) {
+        raft_log_append(node->log, 1, big, sizeof(big), NULL);
+    }
+    node->volatile_state.last_applied = 10;
+    assert(raft_maybe_compact(node) == RAFT_OK);
+    assert(node->log->base_index == 10);
+    raft_compact_stats(node, &stats);
+    assert(stats.last_decision == RAFT_COMPACT_FORCE_MEMORY);
+    assert(stats.forced_memory == 1);
+    raft_destroy(node);
+
+    /* As does the WAL outgrowing its budget */
+    char* dir3 = make_test_dir();
+    config.data_dir = dir3;
+    config.compaction_memory_budget = 0;
+    config.compaction_disk_budget = 1;
+    node = raft_create(&config);
+    assert(node != NULL);
+    raft_start(node);
+
+    for (int i = 0; i < 5; i++) {
+        assert(raft_propose(node, "cmd", 3, NULL) == RAFT_OK);
+    }
+    node->volatile_state.last_applied = raft_log_last_index(node->log);
+    assert(raft_maybe_compact(node) == RAFT_OK);
+    assert(node->log->base_index == node->volatile_state.last_applied);
+    raft_compact_stats(node, &stats);
+    assert(stats.last_decision == RAFT_COMPACT_FORCE_DISK);
+    assert(stats.forced_disk == 1 && stats.storage_bytes > 1);
+
+    raft_destroy(node);
+    remove_dir(dir);
+    remove_dir(dir2);
+    remove_dir(dir3);
+    free(dir);
+    free(dir2);
+    free(dir3);
+    raft_snapshot_reset_callback();
+}
+
 int main(void) {
     printf("Phase 6: Advanced Raft Features Tests\n");
     printf("======================================\n\n");
@@ -452,6 +649,8 @@ int main(void) {
     RUN_TEST(test_auto_compaction_callback);
     RUN_TEST(test_transfer_basic);
     RUN_TEST(test_transfer_abort);
+    RUN_TEST(test_background_compaction);
+    RUN_TEST(test_compaction_scheduling);
 
     printf("\n======================================\n");
     printf("Results: %d/%d tests passed\n", tests_passed, tests_run);